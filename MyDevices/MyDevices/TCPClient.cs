@@ -118,6 +118,11 @@ namespace TransmissionCTRL
                     return true;
                 }
             }
+            else if (data == "ka")
+            {
+                // keepalive of the device, it is confirmed by the transmission control
+                return true;
+            }
             else if (data.StartsWith("rs:status:active"))
             {
                 HeartbeatCounter = 0;
@@ -321,6 +321,11 @@ namespace TransmissionCTRL
                         {
                             RemovePackageFromQueueAndSendNext(package.TransmissionID);
                         }
+                        else if (package.Mode == TransmissionMode.PROBE)
+                        {
+                            // the device measures the round trip time, answer without decryption and queuing
+                            this.SendDataAsync(package.ToProbeReplyString());
+                        }
                         else if (package.Mode == TransmissionMode.DATA)
                         {
                             try
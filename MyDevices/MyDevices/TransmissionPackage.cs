@@ -91,6 +91,25 @@ namespace TransmissionCTRL
             }
         }
 
+        public string ToProbeReplyString()
+        {
+            // the probe data is sent back unchanged, the peer measures the round trip with it
+            var reply = new TransmissionPackage()
+            {
+                DataFormat = this.DataFormat,
+                EncryptionType = TransmissionEncryptionType.NONE,
+                Mode = TransmissionMode.PROBE_REPLY,
+                TransmissionID = this.TransmissionID,
+                IV = this.IV,
+                Data = this.Data
+            };
+            var data = reply.ToTransmissionString();
+
+            this.ErrorFlag = reply.ErrorFlag;
+
+            return data;
+        }
+
         public void FromTransmissionString(string data)
         {
             try
@@ -119,5 +138,5 @@ namespace TransmissionCTRL
 
     public enum TransmissionDataFormat { NONE, PLAIN_TEXT, BASE64 };
     public enum TransmissionEncryptionType { NONE, AES, RSA };
-    public enum TransmissionMode { DATA, CONFIRM, RSA_PUBKEY, AES_KEY };
+    public enum TransmissionMode { DATA, CONFIRM, RSA_PUBKEY, AES_KEY, CREDIT, PROBE, PROBE_REPLY };
 }
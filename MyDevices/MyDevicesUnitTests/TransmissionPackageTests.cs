@@ -94,6 +94,24 @@ namespace MyDevicesUnitTests
             Assert.AreEqual(false, transmissionPackage.ErrorFlag);
         }
 
+        [TestMethod]
+        public void ProbeReplyStringCreation()
+        {
+            // Arrange
+            string probeString = "000000191110003053:12d687";
+            var transmissionPackage = new TransmissionPackage();
+            transmissionPackage.FromTransmissionString(probeString);
+
+            // Act
+            string transmissionString = transmissionPackage.ToProbeReplyString();
+
+            // Assert
+            Assert.AreEqual(TransmissionMode.PROBE, transmissionPackage.Mode);
+            Assert.AreEqual("", transmissionPackage.IV);
+            Assert.AreEqual("000000191110003063:12d687", transmissionString);
+            Assert.AreEqual(false, transmissionPackage.ErrorFlag);
+        }
+
         [TestMethod]
         public void PackageCreationFromString()
         {
@@ -0,0 +1,632 @@
+#include "Arduino.h"
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+
+// longest number: 64 bits in base 2
+#define STRING_NUMBER_SIZE 65
+
+HardwareSerial Serial;
+
+static const char emptyString[1] = { 0 };
+
+String::String()
+: buffer(nullptr), capacity(0), size(0)
+{}
+
+String::String(const char* text)
+: buffer(nullptr), capacity(0), size(0)
+{
+    if(text != nullptr)
+    {
+        this->append(text, strlen(text));
+    }
+}
+
+String::String(const String& other)
+: buffer(nullptr), capacity(0), size(0)
+{
+    this->append(other.c_str(), other.size);
+}
+
+String::String(char c)
+: buffer(nullptr), capacity(0), size(0)
+{
+    this->append(&c, 1);
+}
+
+String::String(int value, unsigned char base)
+: buffer(nullptr), capacity(0), size(0)
+{
+    this->appendNumber((value < 0) ? (0UL - (unsigned long)value) : (unsigned long)value, value < 0, base);
+}
+
+String::String(unsigned int value, unsigned char base)
+: buffer(nullptr), capacity(0), size(0)
+{
+    this->appendNumber(value, false, base);
+}
+
+String::String(long value, unsigned char base)
+: buffer(nullptr), capacity(0), size(0)
+{
+    this->appendNumber((value < 0) ? (0UL - (unsigned long)value) : (unsigned long)value, value < 0, base);
+}
+
+String::String(unsigned long value, unsigned char base)
+: buffer(nullptr), capacity(0), size(0)
+{
+    this->appendNumber(value, false, base);
+}
+
+String::~String()
+{
+    free(this->buffer);
+}
+
+String& String::operator=(const String& other)
+{
+    if(this != &other)
+    {
+        this->size = 0;
+        this->append(other.c_str(), other.size);
+    }
+    return *this;
+}
+
+String& String::operator=(const char* text)
+{
+    // the text can point into this string
+    String copy(text);
+    return (*this = copy);
+}
+
+unsigned int String::length() const
+{
+    return this->size;
+}
+
+const char* String::c_str() const
+{
+    return (this->buffer != nullptr) ? this->buffer : emptyString;
+}
+
+bool String::reserve(unsigned int _size)
+{
+    if(this->buffer != nullptr && this->capacity >= _size)
+    {
+        return true;
+    }
+
+    char* resized = (char*)realloc(this->buffer, _size + 1);
+    if(resized == nullptr)
+    {
+        return false;
+    }
+    if(this->buffer == nullptr)
+    {
+        resized[0] = '\0';
+    }
+    this->buffer = resized;
+    this->capacity = _size;
+    return true;
+}
+
+bool String::concat(const String& other)
+{
+    // appending a string to itself reads the old length
+    return this->append(other.c_str(), other.size);
+}
+
+bool String::concat(const char* text)
+{
+    return (text != nullptr) && this->append(text, strlen(text));
+}
+
+bool String::concat(const char* text, unsigned int length)
+{
+    return (text != nullptr) && this->append(text, length);
+}
+
+bool String::concat(char c)
+{
+    return this->append(&c, 1);
+}
+
+bool String::concat(int value)
+{
+    return this->appendNumber((value < 0) ? (0UL - (unsigned long)value) : (unsigned long)value, value < 0, 10);
+}
+
+bool String::concat(unsigned int value)
+{
+    return this->appendNumber(value, false, 10);
+}
+
+bool String::concat(long value)
+{
+    return this->appendNumber((value < 0) ? (0UL - (unsigned long)value) : (unsigned long)value, value < 0, 10);
+}
+
+bool String::concat(unsigned long value)
+{
+    return this->appendNumber(value, false, 10);
+}
+
+String& String::operator+=(const String& other)
+{
+    this->concat(other);
+    return *this;
+}
+
+String& String::operator+=(const char* text)
+{
+    this->concat(text);
+    return *this;
+}
+
+String& String::operator+=(char c)
+{
+    this->concat(c);
+    return *this;
+}
+
+String& String::operator+=(int value)
+{
+    this->concat(value);
+    return *this;
+}
+
+String& String::operator+=(unsigned int value)
+{
+    this->concat(value);
+    return *this;
+}
+
+String& String::operator+=(long value)
+{
+    this->concat(value);
+    return *this;
+}
+
+String& String::operator+=(unsigned long value)
+{
+    this->concat(value);
+    return *this;
+}
+
+bool String::operator==(const String& other) const
+{
+    return this->size == other.size && memcmp(this->c_str(), other.c_str(), this->size) == 0;
+}
+
+bool String::operator==(const char* text) const
+{
+    return strcmp(this->c_str(), (text != nullptr) ? text : emptyString) == 0;
+}
+
+bool String::operator!=(const String& other) const
+{
+    return !(*this == other);
+}
+
+bool String::operator!=(const char* text) const
+{
+    return !(*this == text);
+}
+
+char String::charAt(unsigned int index) const
+{
+    return (*this)[index];
+}
+
+void String::setCharAt(unsigned int index, char c)
+{
+    if(index < this->size)
+    {
+        this->buffer[index] = c;
+    }
+}
+
+char String::operator[](unsigned int index) const
+{
+    return (index < this->size) ? this->buffer[index] : '\0';
+}
+
+char& String::operator[](unsigned int index)
+{
+    // like the core: writes behind the end go to a dummy
+    static char dummy;
+    if(index >= this->size)
+    {
+        dummy = '\0';
+        return dummy;
+    }
+    return this->buffer[index];
+}
+
+bool String::startsWith(const String& prefix) const
+{
+    return prefix.size <= this->size && memcmp(this->c_str(), prefix.c_str(), prefix.size) == 0;
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+    if(from >= this->size)
+    {
+        return -1;
+    }
+    const char* found = (const char*)memchr(this->buffer + from, c, this->size - from);
+    return (found != nullptr) ? (int)(found - this->buffer) : -1;
+}
+
+int String::indexOf(const String& text, unsigned int from) const
+{
+    if(from > this->size || text.size > this->size - from)
+    {
+        return -1;
+    }
+    for(unsigned int i = from; i + text.size <= this->size; i++)
+    {
+        if(memcmp(this->buffer + i, text.c_str(), text.size) == 0)
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+String String::substring(unsigned int from) const
+{
+    return this->substring(from, this->size);
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+    if(from > to)
+    {
+        unsigned int swap = from;
+        from = to;
+        to = swap;
+    }
+    String result;
+    if(from < this->size)
+    {
+        result.append(this->buffer + from, ((to < this->size) ? to : this->size) - from);
+    }
+    return result;
+}
+
+void String::remove(unsigned int index)
+{
+    if(index < this->size)
+    {
+        this->remove(index, this->size - index);
+    }
+}
+
+void String::remove(unsigned int index, unsigned int count)
+{
+    if(index >= this->size)
+    {
+        return;
+    }
+    if(count > this->size - index)
+    {
+        count = this->size - index;
+    }
+    memmove(this->buffer + index, this->buffer + index + count, this->size - index - count);
+    this->size -= count;
+    this->buffer[this->size] = '\0';
+}
+
+long String::toInt() const
+{
+    return atol(this->c_str());
+}
+
+bool String::append(const char* text, unsigned int length)
+{
+    unsigned int required = this->size + length;
+    if(required > this->capacity || this->buffer == nullptr)
+    {
+        // the text can point into the old buffer
+        ptrdiff_t offset = text - this->buffer;
+        bool inside = this->buffer != nullptr && offset >= 0 && (unsigned int)offset <= this->size;
+
+        // grows by half of the size at least, so appending characters is not quadratic
+        unsigned int grown = this->capacity + (this->capacity / 2);
+        if(!this->reserve((required > grown) ? required : grown))
+        {
+            return false;
+        }
+        if(inside)
+        {
+            text = this->buffer + offset;
+        }
+    }
+    memmove(this->buffer + this->size, text, length);
+    this->size = required;
+    this->buffer[this->size] = '\0';
+    return true;
+}
+
+bool String::appendNumber(unsigned long value, bool negative, unsigned char base)
+{
+    char digits[STRING_NUMBER_SIZE + 1] = { 0 };
+    unsigned int position = sizeof(digits) - 1;
+
+    if(base < 2 || base > 36)
+    {
+        base = 10;
+    }
+    do
+    {
+        unsigned int digit = value % base;
+        digits[--position] = (char)((digit < 10) ? ('0' + digit) : ('a' + digit - 10));
+        value /= base;
+    }
+    while(value > 0);
+
+    if(negative)
+    {
+        digits[--position] = '-';
+    }
+    return this->append(digits + position, sizeof(digits) - 1 - position);
+}
+
+String operator+(const String& left, const String& right)
+{
+    String result(left);
+    result += right;
+    return result;
+}
+
+String operator+(const String& left, const char* right)
+{
+    String result(left);
+    result += right;
+    return result;
+}
+
+String operator+(const char* left, const String& right)
+{
+    String result(left);
+    result += right;
+    return result;
+}
+
+size_t Print::write(const uint8_t* data, size_t length)
+{
+    size_t written = 0;
+    while(written < length && this->write(data[written]) == 1)
+    {
+        written++;
+    }
+    return written;
+}
+
+size_t Print::write(const char* text)
+{
+    return (text != nullptr) ? this->write((const uint8_t*)text, strlen(text)) : 0;
+}
+
+size_t Print::print(const String& text)
+{
+    return this->write((const uint8_t*)text.c_str(), text.length());
+}
+
+size_t Print::print(const char* text)
+{
+    return this->write(text);
+}
+
+size_t Print::print(char c)
+{
+    return this->write((uint8_t)c);
+}
+
+size_t Print::print(int value, int base)
+{
+    return this->print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(unsigned int value, int base)
+{
+    return this->print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(long value, int base)
+{
+    return this->print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+    return this->print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(double value, int digits)
+{
+    return this->printf("%.*f", digits, value);
+}
+
+size_t Print::println()
+{
+    return this->write("\r\n");
+}
+
+size_t Print::println(const String& text)
+{
+    size_t written = this->print(text);
+    return written + this->println();
+}
+
+size_t Print::println(const char* text)
+{
+    size_t written = this->print(text);
+    return written + this->println();
+}
+
+size_t Print::println(char c)
+{
+    size_t written = this->print(c);
+    return written + this->println();
+}
+
+size_t Print::println(int value, int base)
+{
+    size_t written = this->print(value, base);
+    return written + this->println();
+}
+
+size_t Print::println(unsigned int value, int base)
+{
+    size_t written = this->print(value, base);
+    return written + this->println();
+}
+
+size_t Print::println(long value, int base)
+{
+    size_t written = this->print(value, base);
+    return written + this->println();
+}
+
+size_t Print::println(unsigned long value, int base)
+{
+    size_t written = this->print(value, base);
+    return written + this->println();
+}
+
+size_t Print::println(double value, int digits)
+{
+    size_t written = this->print(value, digits);
+    return written + this->println();
+}
+
+size_t Print::printf(const char* format, ...)
+{
+    char buffer[256];
+    va_list arguments;
+
+    va_start(arguments, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, arguments);
+    va_end(arguments);
+
+    if(length < 0)
+    {
+        return 0;
+    }
+    if((size_t)length < sizeof(buffer))
+    {
+        return this->write((const uint8_t*)buffer, length);
+    }
+
+    char* large = (char*)malloc(length + 1);
+    if(large == nullptr)
+    {
+        return 0;
+    }
+    va_start(arguments, format);
+    vsnprintf(large, length + 1, format, arguments);
+    va_end(arguments);
+
+    size_t written = this->write((const uint8_t*)large, length);
+    free(large);
+    return written;
+}
+
+void HardwareSerial::begin(unsigned long baud)
+{
+    (void)baud;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return (fputc(c, stdout) == EOF) ? 0 : 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* data, size_t length)
+{
+    return fwrite(data, 1, length, stdout);
+}
+
+void HardwareSerial::flush()
+{
+    fflush(stdout);
+}
+
+static uint64_t monotonicMicros()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000ULL + (uint64_t)now.tv_nsec / 1000ULL;
+}
+
+// the clocks start with the program like on the board
+static const uint64_t startTime = monotonicMicros();
+
+unsigned long millis()
+{
+    return (unsigned long)((monotonicMicros() - startTime) / 1000ULL);
+}
+
+unsigned long micros()
+{
+    return (unsigned long)(monotonicMicros() - startTime);
+}
+
+void delay(unsigned long ms)
+{
+    struct timespec duration;
+    duration.tv_sec = ms / 1000;
+    duration.tv_nsec = (long)(ms % 1000) * 1000000L;
+    nanosleep(&duration, nullptr);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    struct timespec duration;
+    duration.tv_sec = us / 1000000;
+    duration.tv_nsec = (long)(us % 1000000) * 1000L;
+    nanosleep(&duration, nullptr);
+}
+
+void yield()
+{
+    sched_yield();
+}
+
+// xorshift32, seeded from the clock and the address of the state of the thread
+static thread_local uint32_t randomState = 0;
+
+uint32_t esp_random()
+{
+    if(randomState == 0)
+    {
+        randomState = (uint32_t)monotonicMicros() ^ (uint32_t)(uintptr_t)&randomState ^ (uint32_t)getpid();
+        if(randomState == 0)
+        {
+            randomState = 1;
+        }
+    }
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+long random(long max)
+{
+    return (max > 0) ? (long)(esp_random() % (uint32_t)max) : 0;
+}
+
+long random(long min, long max)
+{
+    return (max > min) ? (min + random(max - min)) : min;
+}
+
+void randomSeed(unsigned long seed)
+{
+    randomState = (seed != 0) ? (uint32_t)seed : 1;
+}
@@ -0,0 +1,159 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/*
+    Part of the Arduino core for the host builds (PlatformIO native environments): String, Print, Serial, the
+    timing functions and random numbers. It covers what the transport code uses and behaves like the esp32 core
+    where the code depends on it (String allocates with malloc/realloc, millis and micros count from the start of
+    the program), it is not a port of the core.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define DEC 10
+#define HEX 16
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+
+class String
+{
+public:
+    String();
+    String(const char* text);
+    String(const String& other);
+    explicit String(char c);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    ~String();
+
+    String& operator=(const String& other);
+    String& operator=(const char* text);
+
+    unsigned int length() const;
+    const char* c_str() const;
+    bool reserve(unsigned int size);
+
+    bool concat(const String& other);
+    bool concat(const char* text);
+    bool concat(const char* text, unsigned int length);
+    bool concat(char c);
+    bool concat(int value);
+    bool concat(unsigned int value);
+    bool concat(long value);
+    bool concat(unsigned long value);
+
+    String& operator+=(const String& other);
+    String& operator+=(const char* text);
+    String& operator+=(char c);
+    String& operator+=(int value);
+    String& operator+=(unsigned int value);
+    String& operator+=(long value);
+    String& operator+=(unsigned long value);
+
+    bool operator==(const String& other) const;
+    bool operator==(const char* text) const;
+    bool operator!=(const String& other) const;
+    bool operator!=(const char* text) const;
+
+    char charAt(unsigned int index) const;
+    void setCharAt(unsigned int index, char c);
+    char operator[](unsigned int index) const;
+    char& operator[](unsigned int index);
+
+    bool startsWith(const String& prefix) const;
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const String& text, unsigned int from = 0) const;
+    String substring(unsigned int from) const;
+    String substring(unsigned int from, unsigned int to) const;
+
+    void remove(unsigned int index);
+    void remove(unsigned int index, unsigned int count);
+    long toInt() const;
+
+private:
+    char* buffer;
+    unsigned int capacity;
+    unsigned int size;
+
+    bool append(const char* text, unsigned int length);
+    bool appendNumber(unsigned long value, bool negative, unsigned char base);
+};
+
+String operator+(const String& left, const String& right);
+String operator+(const String& left, const char* right);
+String operator+(const char* left, const String& right);
+
+class Print
+{
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* data, size_t length);
+    size_t write(const char* text);
+    virtual void flush() {}
+
+    size_t print(const String& text);
+    size_t print(const char* text);
+    size_t print(char c);
+    size_t print(int value, int base = DEC);
+    size_t print(unsigned int value, int base = DEC);
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+
+    size_t println();
+    size_t println(const String& text);
+    size_t println(const char* text);
+    size_t println(char c);
+    size_t println(int value, int base = DEC);
+    size_t println(unsigned int value, int base = DEC);
+    size_t println(long value, int base = DEC);
+    size_t println(unsigned long value, int base = DEC);
+    size_t println(double value, int digits = 2);
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+/**
+ * @brief Serial of the host, writes to stdout
+ */
+class HardwareSerial : public Print
+{
+public:
+    void begin(unsigned long baud);
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* data, size_t length) override;
+    void flush() override;
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+// the generator state is per thread, the host tools run a controller per thread
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+uint32_t esp_random();
+
+#endif
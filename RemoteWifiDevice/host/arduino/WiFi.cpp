@@ -0,0 +1,238 @@
+#include "WiFi.h"
+#include <errno.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+IPAddress::IPAddress()
+: address(0)
+{}
+
+IPAddress::IPAddress(uint8_t first, uint8_t second, uint8_t third, uint8_t fourth)
+: address((uint32_t)first | ((uint32_t)second << 8) | ((uint32_t)third << 16) | ((uint32_t)fourth << 24))
+{}
+
+IPAddress::IPAddress(uint32_t _address)
+: address(_address)
+{}
+
+bool IPAddress::fromString(const char* text)
+{
+    struct in_addr parsed;
+    if(text == nullptr || inet_pton(AF_INET, text, &parsed) != 1)
+    {
+        return false;
+    }
+    // network order has the first octet in the lowest byte in memory
+    memcpy(&this->address, &parsed.s_addr, sizeof(this->address));
+    return true;
+}
+
+String IPAddress::toString() const
+{
+    char text[16] = { 0 };
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(text);
+}
+
+IPAddress::operator uint32_t() const
+{
+    return this->address;
+}
+
+uint8_t IPAddress::operator[](int index) const
+{
+    return (index >= 0 && index < 4) ? (uint8_t)(this->address >> (index * 8)) : 0;
+}
+
+bool IPAddress::operator==(const IPAddress& other) const
+{
+    return this->address == other.address;
+}
+
+bool IPAddress::operator!=(const IPAddress& other) const
+{
+    return this->address != other.address;
+}
+
+WiFiClient::WiFiClient()
+: socket(-1), bufferStart(0), bufferEnd(0)
+{}
+
+WiFiClient::~WiFiClient()
+{
+    this->stop();
+}
+
+int WiFiClient::connect(IPAddress address, uint16_t port)
+{
+    this->stop();
+
+    int descriptor = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(descriptor < 0)
+    {
+        return 0;
+    }
+
+    struct sockaddr_in peer;
+    memset(&peer, 0, sizeof(peer));
+    peer.sin_family = AF_INET;
+    peer.sin_port = htons(port);
+    uint32_t value = address;
+    memcpy(&peer.sin_addr.s_addr, &value, sizeof(value));
+
+    if(::connect(descriptor, (struct sockaddr*)&peer, sizeof(peer)) != 0)
+    {
+        close(descriptor);
+        return 0;
+    }
+    this->socket = descriptor;
+    return 1;
+}
+
+int WiFiClient::connect(const char* host, uint16_t port)
+{
+    IPAddress address;
+    if(address.fromString(host))
+    {
+        return this->connect(address, port);
+    }
+
+    struct addrinfo hints;
+    struct addrinfo* result = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if(getaddrinfo(host, nullptr, &hints, &result) != 0 || result == nullptr)
+    {
+        return 0;
+    }
+    uint32_t value = 0;
+    memcpy(&value, &((struct sockaddr_in*)result->ai_addr)->sin_addr.s_addr, sizeof(value));
+    freeaddrinfo(result);
+
+    return this->connect(IPAddress(value), port);
+}
+
+uint8_t WiFiClient::connected()
+{
+    if(this->socket < 0)
+    {
+        return 0;
+    }
+    // data which was received before the peer closed can still be read
+    if(this->bufferEnd > this->bufferStart)
+    {
+        return 1;
+    }
+
+    uint8_t peek = 0;
+    ssize_t received = recv(this->socket, &peek, 1, MSG_PEEK | MSG_DONTWAIT);
+    if(received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+    {
+        this->stop();
+        return 0;
+    }
+    return 1;
+}
+
+void WiFiClient::stop()
+{
+    if(this->socket >= 0)
+    {
+        close(this->socket);
+        this->socket = -1;
+    }
+    this->bufferStart = 0;
+    this->bufferEnd = 0;
+}
+
+void WiFiClient::setNoDelay(bool noDelay)
+{
+    int value = noDelay ? 1 : 0;
+    if(this->socket >= 0)
+    {
+        setsockopt(this->socket, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+    }
+}
+
+int WiFiClient::available()
+{
+    if(this->bufferEnd == this->bufferStart)
+    {
+        this->fill();
+    }
+    return (int)(this->bufferEnd - this->bufferStart);
+}
+
+int WiFiClient::read()
+{
+    if(this->available() <= 0)
+    {
+        return -1;
+    }
+    return this->buffer[this->bufferStart++];
+}
+
+int WiFiClient::read(uint8_t* data, size_t length)
+{
+    if(this->available() <= 0)
+    {
+        return -1;
+    }
+    size_t count = this->bufferEnd - this->bufferStart;
+    if(count > length)
+    {
+        count = length;
+    }
+    memcpy(data, this->buffer + this->bufferStart, count);
+    this->bufferStart += count;
+    return (int)count;
+}
+
+size_t WiFiClient::write(uint8_t c)
+{
+    return this->write(&c, 1);
+}
+
+size_t WiFiClient::write(const uint8_t* data, size_t length)
+{
+    size_t written = 0;
+    while(this->socket >= 0 && written < length)
+    {
+        ssize_t sent = send(this->socket, data + written, length - written, MSG_NOSIGNAL);
+        if(sent < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            this->stop();
+            break;
+        }
+        written += sent;
+    }
+    return written;
+}
+
+int WiFiClient::fill()
+{
+    if(this->socket < 0)
+    {
+        return 0;
+    }
+
+    ssize_t received = recv(this->socket, this->buffer, sizeof(this->buffer), MSG_DONTWAIT);
+    if(received <= 0)
+    {
+        // a closed connection is reported by connected()
+        return 0;
+    }
+    this->bufferStart = 0;
+    this->bufferEnd = received;
+    return (int)received;
+}
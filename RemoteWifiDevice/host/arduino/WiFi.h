@@ -0,0 +1,67 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include "Arduino.h"
+
+// size of the receive buffer of a client, the transport reads byte by byte
+#define WIFI_CLIENT_BUFFER_SIZE 2048
+
+/**
+ * @brief IPv4 address, the first octet is the lowest byte of the 32 bit value like in the core
+ */
+class IPAddress
+{
+public:
+    IPAddress();
+    IPAddress(uint8_t first, uint8_t second, uint8_t third, uint8_t fourth);
+    IPAddress(uint32_t address);
+
+    bool fromString(const char* text);
+    String toString() const;
+
+    operator uint32_t() const;
+    uint8_t operator[](int index) const;
+    bool operator==(const IPAddress& other) const;
+    bool operator!=(const IPAddress& other) const;
+
+private:
+    uint32_t address;
+};
+
+/**
+ * @brief TCP client on a socket of the host. Connect blocks, reading never blocks, writing blocks until the data
+ *  is in the send buffer of the socket
+ */
+class WiFiClient : public Print
+{
+public:
+    WiFiClient();
+    ~WiFiClient();
+
+    WiFiClient(const WiFiClient&) = delete;
+    WiFiClient& operator=(const WiFiClient&) = delete;
+
+    int connect(IPAddress address, uint16_t port);
+    int connect(const char* host, uint16_t port);
+    uint8_t connected();
+    void stop();
+    void setNoDelay(bool noDelay);
+
+    int available();
+    int read();
+    int read(uint8_t* data, size_t length);
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* data, size_t length) override;
+    using Print::write;
+
+private:
+    int socket;
+    uint8_t buffer[WIFI_CLIENT_BUFFER_SIZE];
+    unsigned int bufferStart;
+    unsigned int bufferEnd;
+
+    int fill();
+};
+
+#endif
@@ -0,0 +1,36 @@
+#include <Arduino.h>
+#include "TransportBenchmark.h"
+
+/*
+    Host build of the transport benchmark (env native-bench): the same cases as the board runs with -DBENCHMARK,
+    the json line goes to stdout and can be compared with tools/bench_compare.py
+
+        pio run -e native-bench -t exec -a "64"
+        .pio/build/native-bench/program 64 > current.json
+*/
+
+int main(int argc, char** argv)
+{
+    TransportBenchmark benchmark;
+    BenchmarkConfig config;
+
+    if(argc > 1)
+    {
+        config.payloadSize = (unsigned int)atoi(argv[1]);
+    }
+    if(argc > 2)
+    {
+        config.minimumTime = (unsigned long)atol(argv[2]);
+    }
+
+    if(!benchmark.Begin(config))
+    {
+        fprintf(stderr, "Error: benchmark could not be started!\n");
+        return 1;
+    }
+    benchmark.Run();
+    benchmark.PrintJson(Serial);
+    Serial.flush();
+
+    return 0;
+}
@@ -0,0 +1,213 @@
+#include <Arduino.h>
+#include "BootState.h"
+#include "ConnectionManager.h"
+#include "ServiceDiscovery.h"
+
+/*
+    Boot path on the host (env native-bootsim): the time from the start of setup() to an established connection, in
+    real time, with the boot state, service discovery and connection manager of the firmware and simulated delays for
+    the parts of the board. The boot state is kept in a file (FileBootStateStore), a wake up from deep sleep is a
+    boot with a valid state (the rtc copy of RtcBootStateStore):
+
+        cold        no boot state: wifi join with a scan, the server is found by the discovery
+        warm        state of the last boot: join of the known access point, the last server without the jitter
+        stale       state of the last boot, but the server has moved: the last server refuses, the discovery answer
+                    is waited for
+
+    Every scenario runs several times with another seed of the connection manager (min, mean and max in ms).
+
+    Arguments: runs per scenario (5), wifi scan and join in ms (2500), join of the known access point in ms (300),
+    discovery answer in ms (1500), connect in ms (20), path of the state file (bootsim.state)
+
+        pio run -e native-bootsim -t exec -a "5"
+*/
+
+#define BOOTSIM_PORT 4000
+
+static const uint8_t bootsimBssid[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+
+// delays of the board and the network (ms)
+struct BootDelays
+{
+    unsigned long scan;
+    unsigned long hintedJoin;
+    unsigned long discovery;
+    unsigned long connect;
+};
+
+// the server accepts connections on one address
+class SimulatedTransport : public IConnectionTransport
+{
+public:
+    SimulatedTransport(const IPAddress& _serverAddress, unsigned long _connectDelay)
+    : serverAddress(_serverAddress), connectDelay(_connectDelay), connected(false)
+    {}
+
+    bool Connect(const IPAddress& address, uint16_t port) override
+    {
+        delay(this->connectDelay);
+        this->connected = (address == this->serverAddress && port == BOOTSIM_PORT);
+        return this->connected;
+    }
+
+    bool IsConnected() override
+    {
+        return this->connected;
+    }
+
+    void Disconnect() override
+    {
+        this->connected = false;
+    }
+
+private:
+    IPAddress serverAddress;
+    unsigned long connectDelay;
+    bool connected;
+};
+
+// saves the server of the connection like the connection events of the firmware
+class BootStateSaver : public IConnectionListener
+{
+public:
+    BootStateSaver(BootState& _state, IBootStateStore& _store)
+    : state(_state), store(_store)
+    {}
+
+    void OnConnected(const DiscoveredServer& server) override
+    {
+        this->state.SetServer((uint32_t)server.address, server.port, server.hostname);
+        this->store.Save(this->state);
+    }
+
+private:
+    BootState& state;
+    IBootStateStore& store;
+};
+
+// setup() and loop() of the firmware up to the connection, returns the time in ms
+static unsigned long runBoot(IBootStateStore& store, const BootDelays& delays, const IPAddress& serverAddress, uint32_t seed)
+{
+    auto start = millis();
+
+    BootState state;
+    bool warmStart = store.Load(state);
+
+    // the known access point is joined without a scan
+    delay(state.HasWifi() ? delays.hintedJoin : delays.scan);
+    state.SetWifi(6, bootsimBssid);
+    store.Save(state);
+
+    itemCollection<ResolvedService> services;
+    ResolvedService service;
+    service.hostname = "server";
+    service.address = serverAddress;
+    service.port = BOOTSIM_PORT;
+    services.AddItem(service);
+
+    FakeServiceResolver resolver(delays.discovery);
+    resolver.SetServices(services);
+
+    ServiceDiscovery discovery;
+    discovery.Begin(&resolver, "_mydevices", "_tcp", "bootsim");
+
+    SimulatedTransport transport(serverAddress, delays.connect);
+    BootStateSaver saver(state, store);
+    ConnectionManager manager;
+    manager.Begin(&transport, nullptr, &discovery, seed);
+    manager.SetListener(&saver);
+
+    if(state.HasServer())
+    {
+        ResolvedService lastServer;
+        lastServer.hostname = state.serverHostname;
+        lastServer.address = IPAddress(state.serverAddress);
+        lastServer.port = state.serverPort;
+        discovery.AddServer(lastServer);
+
+        if(warmStart)
+        {
+            manager.ConnectNow();
+        }
+    }
+
+    while(manager.GetState() != CS_CONNECTED)
+    {
+        discovery.OnLoop();
+        manager.OnLoop();
+        delay(1);
+    }
+    return millis() - start;
+}
+
+static void runScenario(const char* name, IBootStateStore& store, const BootState& initial, const BootDelays& delays,
+    const IPAddress& serverAddress, unsigned int runs)
+{
+    unsigned long minimum = 0;
+    unsigned long maximum = 0;
+    unsigned long sum = 0;
+
+    for(unsigned int run = 0; run < runs; run++)
+    {
+        store.Clear();
+        if(initial.flags != 0)
+        {
+            store.Save(initial);
+        }
+
+        unsigned long time = runBoot(store, delays, serverAddress, run + 1);
+        minimum = (run == 0 || time < minimum) ? time : minimum;
+        maximum = (time > maximum) ? time : maximum;
+        sum += time;
+    }
+
+    printf("%-8s %8lu %8lu %8lu\n", name, minimum, sum / runs, maximum);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int runs = (argc > 1) ? (unsigned int)atoi(argv[1]) : 5;
+    BootDelays delays;
+    delays.scan = (argc > 2) ? (unsigned long)atol(argv[2]) : 2500;
+    delays.hintedJoin = (argc > 3) ? (unsigned long)atol(argv[3]) : 300;
+    delays.discovery = (argc > 4) ? (unsigned long)atol(argv[4]) : 1500;
+    delays.connect = (argc > 5) ? (unsigned long)atol(argv[5]) : 20;
+    const char* path = (argc > 6) ? argv[6] : "bootsim.state";
+
+    if(runs == 0)
+    {
+        fprintf(stderr, "Error: at least one run per scenario\n");
+        return 1;
+    }
+
+    FileBootStateStore store(path);
+    IPAddress serverAddress(192, 168, 1, 10);
+
+    // the state a device keeps after a connection to the server
+    BootState known;
+    known.SetWifi(6, bootsimBssid);
+    known.SetServer((uint32_t)serverAddress, BOOTSIM_PORT, "server");
+
+    BootState moved = known;
+    moved.SetServer((uint32_t)IPAddress(192, 168, 1, 20), BOOTSIM_PORT, "server");
+
+    printf("scenario   min ms  mean ms   max ms\n");
+    runScenario("cold", store, BootState(), delays, serverAddress, runs);
+    runScenario("warm", store, known, delays, serverAddress, runs);
+    runScenario("stale", store, moved, delays, serverAddress, runs);
+
+    // the cold boot leaves the state of the warm boot behind
+    BootState saved;
+    store.Clear();
+    runBoot(store, delays, serverAddress, 1);
+    bool kept = store.Load(saved) && (saved == known);
+    store.Clear();
+
+    if(!kept)
+    {
+        fprintf(stderr, "Error: the boot state of the connection was not saved!\n");
+        return 1;
+    }
+    return 0;
+}
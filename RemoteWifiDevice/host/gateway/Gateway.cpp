@@ -0,0 +1,821 @@
+#include "Gateway.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+GatewayKey::GatewayKey()
+{
+    mbedtls_pk_init(&this->key);
+}
+
+GatewayKey::~GatewayKey()
+{
+    mbedtls_pk_free(&this->key);
+}
+
+GatewayKeyPool::GatewayKeyPool()
+: rsaBits(2048), capacity(0), keyUses(1), currentUses(0), running(false), generated(0)
+{}
+
+GatewayKeyPool::~GatewayKeyPool()
+{
+    this->End();
+}
+
+bool GatewayKeyPool::Begin(unsigned int _rsaBits, unsigned int threads, unsigned int _capacity, unsigned int _keyUses)
+{
+    if(this->running || threads == 0 || _capacity == 0 || _keyUses == 0 || _rsaBits > transmissionProfile.rsaKeyBitsMax)
+    {
+        return false;
+    }
+    this->rsaBits = _rsaBits;
+    this->capacity = _capacity;
+    this->keyUses = _keyUses;
+    this->running = true;
+
+    for(unsigned int i = 0; i < threads; i++)
+    {
+        this->workers.push_back(std::thread(&GatewayKeyPool::generate, this, i));
+    }
+    return true;
+}
+
+void GatewayKeyPool::End()
+{
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->running = false;
+    }
+    this->spaceAvailable.notify_all();
+
+    for(auto& worker : this->workers)
+    {
+        worker.join();
+    }
+    this->workers.clear();
+}
+
+std::shared_ptr<GatewayKey> GatewayKeyPool::Take()
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+
+    if(this->current && this->currentUses < this->keyUses)
+    {
+        this->currentUses++;
+        return this->current;
+    }
+    if(this->keys.empty())
+    {
+        return nullptr;
+    }
+    this->current = this->keys.front();
+    this->currentUses = 1;
+    this->keys.pop_front();
+    this->spaceAvailable.notify_one();
+
+    return this->current;
+}
+
+unsigned long GatewayKeyPool::GetGeneratedCount() const
+{
+    return this->generated;
+}
+
+unsigned int GatewayKeyPool::GetReadyCount()
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->keys.size();
+}
+
+void GatewayKeyPool::generate(unsigned int index)
+{
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context random;
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&random);
+
+    char personalization[32];
+    snprintf(personalization, sizeof(personalization), "gateway-key-%u", index);
+
+    auto ret = mbedtls_ctr_drbg_seed(&random, mbedtls_entropy_func, &entropy, (const unsigned char*)personalization, strlen(personalization));
+    if(ret != 0)
+    {
+        printMBED_TLSError(ret);
+    }
+
+    while(ret == 0)
+    {
+        {
+            std::unique_lock<std::mutex> guard(this->lock);
+            this->spaceAvailable.wait(guard, [this] { return !this->running || this->keys.size() < this->capacity; });
+            if(!this->running)
+            {
+                break;
+            }
+        }
+
+        // generated outside of the lock, the other workers and the event loop go on meanwhile
+        std::shared_ptr<GatewayKey> key = std::make_shared<GatewayKey>();
+        unsigned char pem[1024] = { 0 };
+
+        ret = mbedtls_pk_setup(&key->key, mbedtls_pk_info_from_type(MBEDTLS_PK_RSA));
+        if(ret == 0)
+        {
+            ret = mbedtls_rsa_gen_key(mbedtls_pk_rsa(key->key), mbedtls_ctr_drbg_random, &random, this->rsaBits, 65537);
+        }
+        if(ret == 0)
+        {
+            ret = mbedtls_pk_write_pubkey_pem(&key->key, pem, sizeof(pem));
+        }
+        if(ret != 0)
+        {
+            printMBED_TLSError(ret);
+            break;
+        }
+
+        String armored = (const char*)pem;
+        int start = armored.indexOf('\n');
+        int end = armored.indexOf("-----END");
+        if(start < 0 || end <= start)
+        {
+            break;
+        }
+        key->publicKey = armored.substring(start + 1, end);
+
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->keys.push_back(key);
+        this->generated++;
+    }
+
+    mbedtls_ctr_drbg_free(&random);
+    mbedtls_entropy_free(&entropy);
+}
+
+GatewaySession::GatewaySession()
+: id(0), socket(-1), state(GS_WAIT_KEY), userData(nullptr), connectTime(0), messagesIn(0), messagesOut(0),
+  transmissionID(0), outputStart(0), writeWaiting(false), sentTime(0), resends(0), index(0)
+{
+    mbedtls_aes_init(&this->encryption);
+    mbedtls_aes_init(&this->decryption);
+}
+
+GatewaySession::~GatewaySession()
+{
+    mbedtls_aes_free(&this->decryption);
+    mbedtls_aes_free(&this->encryption);
+}
+
+GatewayStatistics::GatewayStatistics()
+: sessions(0), accepted(0), closed(0), handshakes(0), handshakeErrors(0), messagesIn(0), bytesIn(0), messagesOut(0),
+  retransmissions(0), drops(0), duplicates(0), parseErrors(0), decryptErrors(0), handshakeTime(0)
+{}
+
+Gateway::Gateway()
+: listener(-1), events(-1), keys(nullptr), plugin(nullptr), nextSessionID(0), timer(0)
+{
+    mbedtls_entropy_init(&this->entropy);
+    mbedtls_ctr_drbg_init(&this->random);
+}
+
+Gateway::~Gateway()
+{
+    this->End();
+
+    mbedtls_ctr_drbg_free(&this->random);
+    mbedtls_entropy_free(&this->entropy);
+}
+
+bool Gateway::Begin(uint16_t port, GatewayKeyPool* _keys)
+{
+    if(_keys == nullptr || this->listener >= 0)
+    {
+        return false;
+    }
+    this->keys = _keys;
+
+    const char* personalization = "gateway";
+    auto ret = mbedtls_ctr_drbg_seed(&this->random, mbedtls_entropy_func, &this->entropy, (const unsigned char*)personalization, strlen(personalization));
+    if(ret != 0)
+    {
+        printMBED_TLSError(ret);
+        return false;
+    }
+
+    this->listener = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    this->events = epoll_create1(EPOLL_CLOEXEC);
+    if(this->listener < 0 || this->events < 0)
+    {
+        this->End();
+        return false;
+    }
+
+    int enabled = 1;
+    setsockopt(this->listener, SOL_SOCKET, SO_REUSEADDR, &enabled, sizeof(enabled));
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    // the listener is the only entry without a session
+    event.data.ptr = nullptr;
+
+    if(bind(this->listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(this->listener, SOMAXCONN) != 0
+        || epoll_ctl(this->events, EPOLL_CTL_ADD, this->listener, &event) != 0)
+    {
+        this->End();
+        return false;
+    }
+
+    this->timer = millis();
+    return true;
+}
+
+void Gateway::End()
+{
+    for(auto session : this->sessions)
+    {
+        this->Close(*session);
+    }
+    this->release();
+
+    if(this->listener >= 0)
+    {
+        close(this->listener);
+        this->listener = -1;
+    }
+    if(this->events >= 0)
+    {
+        close(this->events);
+        this->events = -1;
+    }
+}
+
+void Gateway::SetPlugin(IGatewayPlugin* _plugin)
+{
+    this->plugin = _plugin;
+}
+
+void Gateway::OnLoop(int timeout)
+{
+    if(this->events < 0)
+    {
+        return;
+    }
+
+    // sessions waiting for a key are served as soon as the pool has one
+    if(!this->keyWaiters.empty() && timeout > 1)
+    {
+        timeout = 1;
+    }
+
+    epoll_event ready[GATEWAY_EPOLL_EVENTS];
+    int count = epoll_wait(this->events, ready, GATEWAY_EPOLL_EVENTS, timeout);
+
+    for(int i = 0; i < count; i++)
+    {
+        GatewaySession* session = (GatewaySession*)ready[i].data.ptr;
+        if(session == nullptr)
+        {
+            this->accept();
+            continue;
+        }
+        // closed by an earlier event of this round
+        if(session->state == GS_CLOSED)
+        {
+            continue;
+        }
+
+        if(ready[i].events & (EPOLLERR | EPOLLHUP))
+        {
+            this->read(*session);
+            this->Close(*session);
+            continue;
+        }
+        if(ready[i].events & EPOLLOUT)
+        {
+            this->flush(*session);
+        }
+        if((ready[i].events & EPOLLIN) && session->state != GS_CLOSED)
+        {
+            this->read(*session);
+        }
+    }
+
+    this->assignKeys();
+
+    if((millis() - this->timer) >= GATEWAY_TIMER_INTERVAL)
+    {
+        this->timer = millis();
+        this->checkTimers();
+    }
+
+    this->release();
+}
+
+bool Gateway::SendData(GatewaySession& session, const String& data)
+{
+    unsigned char iv[16] = { 0 };
+    unsigned char block[GATEWAY_PAYLOAD_MAX] = { 0 };
+    char encoded[BASE64_ENCODED_LENGTH(GATEWAY_PAYLOAD_MAX) + 1] = { 0 };
+
+    size_t length = data.length();
+    if(session.state != GS_READY || length > GATEWAY_PAYLOAD_MAX || session.sendQueue.size() >= GATEWAY_SEND_QUEUE_MAX)
+    {
+        return false;
+    }
+    size_t paddedLength = ((length + 15) / 16) * 16;
+    memcpy(block, data.c_str(), length);
+
+    if(mbedtls_ctr_drbg_random(&this->random, iv, sizeof(iv)) != 0)
+    {
+        return false;
+    }
+
+    TransmissionPackage package;
+    package.mode = TransmissionMode::DATA;
+    package.encryptionType = TransmissionEncryptionType::AES;
+    package.dataFormat = TransmissionDataFormat::BASE64;
+
+    // the iv is updated by the encryption, so it is encoded first
+    encoded[base64Encode(iv, sizeof(iv), encoded)] = '\0';
+    package.iv = encoded;
+
+    if(mbedtls_aes_crypt_cbc(&session.encryption, MBEDTLS_AES_ENCRYPT, paddedLength, iv, block, block) != 0)
+    {
+        return false;
+    }
+    encoded[base64Encode(block, paddedLength, encoded)] = '\0';
+    package.data = encoded;
+
+    this->queuePackage(session, package);
+    this->statistics.messagesOut++;
+    session.messagesOut++;
+    return true;
+}
+
+void Gateway::Close(GatewaySession& session)
+{
+    if(session.state == GS_CLOSED)
+    {
+        return;
+    }
+
+    if(session.state == GS_READY && this->plugin != nullptr)
+    {
+        this->plugin->OnSessionClosed(session);
+    }
+    if(session.state == GS_WAIT_KEY)
+    {
+        this->keyWaiters.erase(std::remove(this->keyWaiters.begin(), this->keyWaiters.end(), &session), this->keyWaiters.end());
+    }
+    session.state = GS_CLOSED;
+
+    epoll_ctl(this->events, EPOLL_CTL_DEL, session.socket, nullptr);
+    close(session.socket);
+    session.socket = -1;
+
+    this->closedSessions.push_back(&session);
+    this->statistics.sessions--;
+    this->statistics.closed++;
+}
+
+const GatewayStatistics& Gateway::GetStatistics() const
+{
+    return this->statistics;
+}
+
+void Gateway::accept()
+{
+    while(true)
+    {
+        sockaddr_in address;
+        socklen_t addressLength = sizeof(address);
+
+        int client = accept4(this->listener, (sockaddr*)&address, &addressLength, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(client < 0)
+        {
+            if(errno == EMFILE || errno == ENFILE)
+            {
+                // the connection stays in the backlog until a session is closed
+                fprintf(stderr, "gateway: no file descriptor for a new session\n");
+            }
+            return;
+        }
+
+        int enabled = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(enabled));
+
+        GatewaySession* session = new GatewaySession();
+        session->id = ++this->nextSessionID;
+        session->socket = client;
+        session->address = inet_ntoa(address.sin_addr);
+        session->connectTime = millis();
+
+        epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.ptr = session;
+
+        if(epoll_ctl(this->events, EPOLL_CTL_ADD, client, &event) != 0)
+        {
+            close(client);
+            delete session;
+            continue;
+        }
+
+        session->index = this->sessions.size();
+        this->sessions.push_back(session);
+        this->keyWaiters.push_back(session);
+        this->statistics.sessions++;
+        this->statistics.accepted++;
+    }
+}
+
+void Gateway::assignKeys()
+{
+    while(!this->keyWaiters.empty())
+    {
+        std::shared_ptr<GatewayKey> key = this->keys->Take();
+        if(!key)
+        {
+            break;
+        }
+
+        GatewaySession* session = this->keyWaiters.front();
+        this->keyWaiters.pop_front();
+
+        session->key = key;
+        session->state = GS_HANDSHAKE;
+        this->sendRSAKey(*session);
+    }
+}
+
+void Gateway::checkTimers()
+{
+    auto now = millis();
+
+    for(auto session : this->sessions)
+    {
+        if(session->state == GS_CLOSED)
+        {
+            continue;
+        }
+        if(session->state != GS_READY && (now - session->connectTime) >= GATEWAY_HANDSHAKE_TIMEOUT)
+        {
+            this->statistics.handshakeErrors++;
+            this->Close(*session);
+            continue;
+        }
+        if(session->sendQueue.empty() || (now - session->sentTime) < GATEWAY_RETRANSMIT_INTERVAL)
+        {
+            continue;
+        }
+
+        if(session->resends < GATEWAY_RETRANSMIT_MAX)
+        {
+            session->resends++;
+            session->sentTime = now;
+            this->statistics.retransmissions++;
+            this->write(*session, session->sendQueue.front().ToTransmissionString());
+        }
+        else if(session->sendQueue.front().mode == TransmissionMode::RSA_PUBKEY)
+        {
+            // the device never got the key of the session
+            this->statistics.handshakeErrors++;
+            this->Close(*session);
+        }
+        else
+        {
+            this->statistics.drops++;
+            session->sendQueue.pop_front();
+            this->sendNext(*session);
+        }
+    }
+}
+
+void Gateway::release()
+{
+    for(auto session : this->closedSessions)
+    {
+        // the last session takes the place of the released one
+        GatewaySession* last = this->sessions.back();
+        last->index = session->index;
+        this->sessions[session->index] = last;
+        this->sessions.pop_back();
+
+        delete session;
+    }
+    this->closedSessions.clear();
+}
+
+void Gateway::read(GatewaySession& session)
+{
+    char buffer[16384];
+
+    while(session.state != GS_CLOSED)
+    {
+        ssize_t received = recv(session.socket, buffer, sizeof(buffer), 0);
+        if(received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        {
+            this->Close(session);
+            return;
+        }
+        if(received < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+
+        session.input.append(buffer, received);
+
+        // the device ends every frame with a line break
+        size_t start = 0;
+        size_t end;
+        while(session.state != GS_CLOSED && (end = session.input.find('\n', start)) != std::string::npos)
+        {
+            size_t length = end - start;
+            if(length > 0 && session.input[start + length - 1] == '\r')
+            {
+                length--;
+            }
+            if(length > 0)
+            {
+                String frame;
+                frame.concat(session.input.data() + start, length);
+                this->processFrame(session, frame);
+            }
+            start = end + 1;
+        }
+        session.input.erase(0, start);
+
+        if(session.input.length() > transmissionProfile.frameMax)
+        {
+            // no line break within the largest frame, this is not a device
+            this->statistics.parseErrors++;
+            this->Close(session);
+        }
+    }
+}
+
+void Gateway::processFrame(GatewaySession& session, const String& frame)
+{
+    TransmissionPackage package;
+    package.FromTransmissionString(frame);
+
+    if(package.errorFlag)
+    {
+        this->statistics.parseErrors++;
+        return;
+    }
+
+    switch(package.mode)
+    {
+    case TransmissionMode::AES_KEY:
+        this->onSessionKey(session, package);
+        break;
+    case TransmissionMode::DATA:
+        if(package.encryptionType == TransmissionEncryptionType::AES && session.state != GS_READY)
+        {
+            // encrypted without the key of this session, not confirmed so the device does not count it as delivered
+            this->statistics.decryptErrors++;
+            break;
+        }
+        // always confirm, the previous confirmation could have been lost
+        this->write(session, package.ToConfirmationString());
+        this->onData(session, package);
+        break;
+    case TransmissionMode::CONFIRM:
+        if(!session.sendQueue.empty() && session.sendQueue.front().transmissionID == package.transmissionID)
+        {
+            session.sendQueue.pop_front();
+            this->sendNext(session);
+        }
+        break;
+    case TransmissionMode::PROBE:
+        this->write(session, package.ToProbeReplyString());
+        break;
+    default:
+        // credits and probe replies of the device
+        break;
+    }
+}
+
+void Gateway::onSessionKey(GatewaySession& session, const TransmissionPackage& package)
+{
+    if(session.state == GS_READY)
+    {
+        // resent because the confirmation was lost, the key is the same
+        this->write(session, package.ToConfirmationString());
+        return;
+    }
+    if(session.state != GS_HANDSHAKE)
+    {
+        return;
+    }
+
+    unsigned char encrypted[transmissionProfile.rsaKeyBitsMax / 8] = { 0 };
+    unsigned char sessionKey[transmissionProfile.aesKeyBits / 8] = { 0 };
+    size_t encryptedLength = 0;
+    size_t keyLength = 0;
+
+    if(!base64Decode(package.data.c_str(), package.data.length(), encrypted, sizeof(encrypted), encryptedLength)
+        || mbedtls_pk_decrypt(&session.key->key, encrypted, encryptedLength, sessionKey, &keyLength, sizeof(sessionKey),
+            mbedtls_ctr_drbg_random, &this->random) != 0
+        || keyLength != sizeof(sessionKey))
+    {
+        this->statistics.handshakeErrors++;
+        this->Close(session);
+        return;
+    }
+
+    mbedtls_aes_setkey_enc(&session.encryption, sessionKey, transmissionProfile.aesKeyBits);
+    mbedtls_aes_setkey_dec(&session.decryption, sessionKey, transmissionProfile.aesKeyBits);
+    memset(sessionKey, 0, sizeof(sessionKey));
+
+    // the rsa key is not needed anymore, with one key per session it is freed here
+    session.key.reset();
+    session.state = GS_READY;
+
+    this->write(session, package.ToConfirmationString());
+    this->statistics.handshakes++;
+    this->statistics.handshakeTime.Record(millis() - session.connectTime);
+
+    if(this->plugin != nullptr)
+    {
+        this->plugin->OnSessionReady(session);
+    }
+}
+
+void Gateway::onData(GatewaySession& session, const TransmissionPackage& package)
+{
+    if(session.receiveWindow.CheckAndMark(package.transmissionID))
+    {
+        this->statistics.duplicates++;
+        return;
+    }
+
+    ByteSpan payload;
+    unsigned char block[transmissionProfile.payloadMax] = { 0 };
+    size_t length = 0;
+
+    if(package.encryptionType == TransmissionEncryptionType::AES)
+    {
+        if(!this->decrypt(session, package, block, length))
+        {
+            this->statistics.decryptErrors++;
+            return;
+        }
+        // zero padded payload
+        payload = ByteSpan(block, strnlen((const char*)block, length));
+    }
+    else
+    {
+        payload = ByteSpan::FromString(package.data);
+        if(payload.Equals(TRANSMISSION_KEEPALIVE_MESSAGE))
+        {
+            return;
+        }
+    }
+
+    this->statistics.messagesIn++;
+    this->statistics.bytesIn += payload.length;
+    session.messagesIn++;
+
+    if(this->plugin != nullptr)
+    {
+        this->plugin->OnDataReceived(session, payload);
+    }
+}
+
+bool Gateway::decrypt(GatewaySession& session, const TransmissionPackage& package, unsigned char* block, size_t& length)
+{
+    unsigned char iv[16] = { 0 };
+    size_t ivLength = 0;
+
+    if(!base64Decode(package.iv.c_str(), package.iv.length(), iv, sizeof(iv), ivLength) || ivLength != sizeof(iv)
+        || !base64Decode(package.data.c_str(), package.data.length(), block, transmissionProfile.payloadMax, length)
+        || length == 0 || (length % 16) != 0)
+    {
+        return false;
+    }
+    return mbedtls_aes_crypt_cbc(&session.decryption, MBEDTLS_AES_DECRYPT, length, iv, block, block) == 0;
+}
+
+void Gateway::sendRSAKey(GatewaySession& session)
+{
+    TransmissionPackage package;
+    package.mode = TransmissionMode::RSA_PUBKEY;
+    package.encryptionType = TransmissionEncryptionType::TET_NONE;
+    package.dataFormat = TransmissionDataFormat::PLAIN_TEXT;
+    package.data = session.key->publicKey;
+    package.iv = "";
+
+    this->queuePackage(session, package);
+}
+
+void Gateway::queuePackage(GatewaySession& session, TransmissionPackage& package)
+{
+    // the device compares the IDs in 16 bit (see DuplicateWindow)
+    session.transmissionID = (session.transmissionID + 1) & TRANSMISSION_ID_MASK;
+    package.transmissionID = session.transmissionID;
+
+    session.sendQueue.push_back(package);
+    if(session.sendQueue.size() == 1)
+    {
+        this->sendNext(session);
+    }
+}
+
+void Gateway::sendNext(GatewaySession& session)
+{
+    if(session.sendQueue.empty())
+    {
+        return;
+    }
+    session.resends = 0;
+    session.sentTime = millis();
+    this->write(session, session.sendQueue.front().ToTransmissionString());
+}
+
+void Gateway::write(GatewaySession& session, const String& data)
+{
+    if(session.state == GS_CLOSED)
+    {
+        return;
+    }
+
+    if(!session.writeWaiting)
+    {
+        ssize_t sent = send(session.socket, data.c_str(), data.length(), MSG_NOSIGNAL);
+        if(sent < 0)
+        {
+            if(errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                this->Close(session);
+                return;
+            }
+            sent = 0;
+        }
+        if((size_t)sent == data.length())
+        {
+            return;
+        }
+        session.output.append(data.c_str() + sent, data.length() - sent);
+        this->watchWrite(session, true);
+    }
+    else
+    {
+        session.output.append(data.c_str(), data.length());
+    }
+
+    if((session.output.length() - session.outputStart) > GATEWAY_OUTPUT_MAX)
+    {
+        this->Close(session);
+    }
+}
+
+void Gateway::flush(GatewaySession& session)
+{
+    while(session.outputStart < session.output.length())
+    {
+        ssize_t sent = send(session.socket, session.output.data() + session.outputStart, session.output.length() - session.outputStart, MSG_NOSIGNAL);
+        if(sent < 0)
+        {
+            if(errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                this->Close(session);
+            }
+            return;
+        }
+        session.outputStart += sent;
+    }
+
+    session.output.clear();
+    session.outputStart = 0;
+    this->watchWrite(session, false);
+}
+
+void Gateway::watchWrite(GatewaySession& session, bool enabled)
+{
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = enabled ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    event.data.ptr = &session;
+
+    epoll_ctl(this->events, EPOLL_CTL_MOD, session.socket, &event);
+    session.writeWaiting = enabled;
+}
@@ -0,0 +1,253 @@
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TransmissionControl.h"
+
+// resend interval of an unconfirmed package and resends before it is dropped (the rules of the MyDevices server)
+#define GATEWAY_RETRANSMIT_INTERVAL 500
+#define GATEWAY_RETRANSMIT_MAX 3
+// a session which has not sent its aes key within this time is closed
+#define GATEWAY_HANDSHAKE_TIMEOUT 10000
+// interval of the retransmission and handshake timers
+#define GATEWAY_TIMER_INTERVAL 50
+// packages of a session which wait for the confirmation of the package in flight
+#define GATEWAY_SEND_QUEUE_MAX 64
+// unsent bytes of a session before it is closed as too slow
+#define GATEWAY_OUTPUT_MAX 262144
+// largest payload of SendData, one block below the decryption buffer of the device
+#define GATEWAY_PAYLOAD_MAX (transmissionProfile.payloadMax - 16)
+#define GATEWAY_EPOLL_EVENTS 256
+
+static_assert(GATEWAY_RETRANSMIT_MAX >= 1, "an unconfirmed package is resent at least once");
+
+/**
+ * @brief RSA key of the gateway, sent to the device in the RSA_PUBKEY package
+ */
+class GatewayKey
+{
+public:
+    GatewayKey();
+    ~GatewayKey();
+
+    GatewayKey(const GatewayKey&) = delete;
+    GatewayKey& operator=(const GatewayKey&) = delete;
+
+    mbedtls_pk_context key;
+    // base64 of the public key without the pem armor (see TransmissionControl::readAndFormatRSAKey)
+    String publicKey;
+};
+
+/**
+ * @brief Generates the rsa keys of the sessions on worker threads and keeps up to capacity keys ready, so the event
+ *  loop never waits for a key generation. Every key is handed out to keyUses sessions (1 = a key per session).
+ *  Take() is called from the event loop, the key is only used by the thread which took it.
+ */
+class GatewayKeyPool
+{
+public:
+    GatewayKeyPool();
+    ~GatewayKeyPool();
+
+    bool Begin(unsigned int rsaBits, unsigned int threads, unsigned int capacity, unsigned int keyUses);
+    void End();
+
+    /* Returns the key for the next session or nullptr if no key is ready yet */
+    std::shared_ptr<GatewayKey> Take();
+
+    unsigned long GetGeneratedCount() const;
+    unsigned int GetReadyCount();
+
+private:
+    unsigned int rsaBits;
+    unsigned int capacity;
+    unsigned int keyUses;
+
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable spaceAvailable;
+    std::deque<std::shared_ptr<GatewayKey>> keys;
+    std::shared_ptr<GatewayKey> current;
+    unsigned int currentUses;
+    bool running;
+    std::atomic<unsigned long> generated;
+
+    void generate(unsigned int index);
+};
+
+enum GatewaySessionState { GS_WAIT_KEY, GS_HANDSHAKE, GS_READY, GS_CLOSED };
+
+/**
+ * @brief A device connection. The members are owned by the event loop of the gateway, a plugin can read them and
+ *  keep its own state in userData during the callbacks
+ */
+class GatewaySession
+{
+public:
+    GatewaySession();
+    ~GatewaySession();
+
+    GatewaySession(const GatewaySession&) = delete;
+    GatewaySession& operator=(const GatewaySession&) = delete;
+
+    unsigned long id;
+    int socket;
+    String address;
+    GatewaySessionState state;
+    void* userData;
+
+    unsigned long connectTime;
+    unsigned long messagesIn;
+    unsigned long messagesOut;
+
+private:
+    friend class Gateway;
+
+    std::shared_ptr<GatewayKey> key;
+    mbedtls_aes_context encryption;
+    mbedtls_aes_context decryption;
+    unsigned int transmissionID;
+    DuplicateWindow receiveWindow;
+
+    // received bytes of an incomplete line and unsent bytes
+    std::string input;
+    std::string output;
+    size_t outputStart;
+    bool writeWaiting;
+
+    // the first package is in flight, the others wait for its confirmation
+    std::deque<TransmissionPackage> sendQueue;
+    unsigned long sentTime;
+    unsigned int resends;
+
+    // position in the session list of the gateway
+    size_t index;
+};
+
+/**
+ * @brief Receives the data of the sessions. The callbacks run on the event loop, so they must not block, and the
+ *  data is only valid during the call. A plugin can answer with Gateway::SendData or drop the session with
+ *  Gateway::Close inside of the callbacks
+ */
+class IGatewayPlugin
+{
+public:
+    /* The device has sent its aes key, encrypted data can be exchanged now */
+    virtual void OnSessionReady(GatewaySession& session) {}
+    /* Decrypted (or plain text) payload of a data package, resent packages are delivered once */
+    virtual void OnDataReceived(GatewaySession& session, const ByteSpan& data) = 0;
+    /* Called for every session which was ready, before it is released */
+    virtual void OnSessionClosed(GatewaySession& session) {}
+};
+
+class GatewayStatistics
+{
+public:
+    GatewayStatistics();
+
+    unsigned int sessions;
+    unsigned long accepted;
+    unsigned long closed;
+    unsigned long handshakes;
+    unsigned long handshakeErrors;
+    unsigned long messagesIn;
+    unsigned long bytesIn;
+    unsigned long messagesOut;
+    unsigned long retransmissions;
+    unsigned long drops;
+    unsigned long duplicates;
+    unsigned long parseErrors;
+    // encrypted data packages which could not be decrypted or arrived before the aes key
+    unsigned long decryptErrors;
+    // from the accept to the aes key, in ms (includes the wait for a key of the pool)
+    LatencyHistogram handshakeTime;
+};
+
+/**
+ * @brief Server side of the transmission protocol for many device connections on one epoll loop (Linux only):
+ *
+ *      1. on accept the session gets a key of the pool and the RSA_PUBKEY package is sent
+ *      2. the AES_KEY package of the device is decrypted with the private key and confirmed
+ *      3. DATA packages are confirmed every time (the confirmation could have been lost), decrypted and delivered
+ *         to the plugin unless the duplicate window has seen the ID; encrypted packages before the aes key are not
+ *         confirmed. PROBE packages are answered with a PROBE_REPLY
+ *      4. packages to the device are sent one at a time: the next one follows the CONFIRM of the previous one,
+ *         an unconfirmed package is resent every GATEWAY_RETRANSMIT_INTERVAL ms and dropped after
+ *         GATEWAY_RETRANSMIT_MAX resends (an unconfirmed RSA_PUBKEY closes the session)
+ *
+ *  Credits of the device are not evaluated, a single package in flight is within every receive window. The frames
+ *  of the device end with a line break and use the plain framing, like with the MyDevices server.
+ *
+ *      gateway.SetPlugin(&plugin);
+ *      gateway.Begin(port, &keyPool);
+ *      while(running) gateway.OnLoop();
+ */
+class Gateway
+{
+public:
+    Gateway();
+    ~Gateway();
+
+    bool Begin(uint16_t port, GatewayKeyPool* keys);
+    void End();
+
+    void SetPlugin(IGatewayPlugin* _plugin);
+
+    /* Waits up to timeout ms for socket events and processes them and the timers */
+    void OnLoop(int timeout = GATEWAY_TIMER_INTERVAL);
+
+    /**
+     * @brief Queue an encrypted data package for the session. Returns false if the session is not ready, the data
+     *  is larger than GATEWAY_PAYLOAD_MAX or the send queue of the session is full
+     */
+    bool SendData(GatewaySession& session, const String& data);
+
+    /* Close the connection, the session is released at the end of the loop */
+    void Close(GatewaySession& session);
+
+    const GatewayStatistics& GetStatistics() const;
+
+private:
+    int listener;
+    int events;
+    GatewayKeyPool* keys;
+    IGatewayPlugin* plugin;
+    GatewayStatistics statistics;
+
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context random;
+
+    std::vector<GatewaySession*> sessions;
+    std::deque<GatewaySession*> keyWaiters;
+    std::vector<GatewaySession*> closedSessions;
+    unsigned long nextSessionID;
+    unsigned long timer;
+
+    void accept();
+    void assignKeys();
+    void checkTimers();
+    void release();
+
+    void read(GatewaySession& session);
+    void processFrame(GatewaySession& session, const String& frame);
+    void onSessionKey(GatewaySession& session, const TransmissionPackage& package);
+    void onData(GatewaySession& session, const TransmissionPackage& package);
+    bool decrypt(GatewaySession& session, const TransmissionPackage& package, unsigned char* block, size_t& length);
+
+    void sendRSAKey(GatewaySession& session);
+    void queuePackage(GatewaySession& session, TransmissionPackage& package);
+    void sendNext(GatewaySession& session);
+    void write(GatewaySession& session, const String& data);
+    void flush(GatewaySession& session);
+    void watchWrite(GatewaySession& session, bool enabled);
+};
+
+#endif
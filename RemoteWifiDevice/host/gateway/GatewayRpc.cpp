@@ -0,0 +1,297 @@
+#include "GatewayRpc.h"
+
+#define GATEWAY_RPC_PREFIX RPC_COMMAND ":"
+
+GatewayRpc::PendingCall::PendingCall()
+: session(nullptr), callID(0), callback(nullptr), startTime(0), timeout(0)
+{}
+
+GatewayRpc::OutgoingBatch::OutgoingBatch()
+: session(nullptr), calls(0)
+{}
+
+GatewayRpc::GatewayRpc()
+: gateway(nullptr), nextCallID(0)
+{}
+
+void GatewayRpc::Begin(Gateway* _gateway)
+{
+    this->gateway = _gateway;
+}
+
+uint16_t GatewayRpc::Call(GatewaySession& session, const char* method, const String& arguments, IGatewayRpcCallback* callback, unsigned long timeout)
+{
+    if(this->gateway == nullptr || method == nullptr || *method == '\0' || session.state != GS_READY
+        || this->batches[session.id].calls >= GATEWAY_RPC_SESSION_CALLS)
+    {
+        return 0;
+    }
+
+    // the IDs are shared by the sessions, an ID is skipped while the session has a call with it
+    do
+    {
+        this->nextCallID++;
+    }
+    while(this->nextCallID == 0 || this->calls.count(callKey(session, this->nextCallID)) > 0);
+
+    char prefix[8] = { 0 };
+    sprintf(prefix, "%c%x:", RPC_REQUEST_TAG, (unsigned int)this->nextCallID);
+
+    String message = prefix;
+    message += method;
+    if(arguments.length() > 0)
+    {
+        message += COMMAND_DELIMITER;
+        message += arguments;
+    }
+    if(!this->appendMessage(session, message))
+    {
+        return 0;
+    }
+
+    PendingCall call;
+    call.session = &session;
+    call.callID = this->nextCallID;
+    call.callback = callback;
+    call.startTime = millis();
+    call.timeout = timeout;
+    this->calls[callKey(session, call.callID)] = call;
+
+    this->batches[session.id].calls++;
+    this->statistics.calls++;
+
+    return call.callID;
+}
+
+bool GatewayRpc::OnDataReceived(GatewaySession& session, const ByteSpan& data)
+{
+    if(!data.StartsWith(GATEWAY_RPC_PREFIX))
+    {
+        return false;
+    }
+
+    auto batch = (const char*)data.data;
+    unsigned int start = strlen(GATEWAY_RPC_PREFIX);
+
+    for(unsigned int i = start; i <= data.length; i++)
+    {
+        if(i == data.length || batch[i] == RPC_MESSAGE_SEPARATOR)
+        {
+            if(i > start)
+            {
+                this->processMessage(session, batch + start, i - start);
+            }
+            start = i + 1;
+        }
+    }
+
+    // the responses of the batch go out together
+    auto entry = this->batches.find(session.id);
+    if(entry != this->batches.end())
+    {
+        this->flush(entry->second);
+    }
+    return true;
+}
+
+void GatewayRpc::OnSessionClosed(GatewaySession& session)
+{
+    // collected first, the callbacks can start calls of other sessions
+    std::vector<uint64_t> cancelled;
+    for(auto& entry : this->calls)
+    {
+        if(entry.second.session == &session)
+        {
+            cancelled.push_back(entry.first);
+        }
+    }
+    for(auto key : cancelled)
+    {
+        this->complete(key, RS_CANCELLED, CommandSpan());
+    }
+    this->batches.erase(session.id);
+}
+
+void GatewayRpc::OnLoop()
+{
+    for(auto& entry : this->batches)
+    {
+        this->flush(entry.second);
+    }
+
+    if(this->calls.empty())
+    {
+        return;
+    }
+
+    // collected first, the callbacks can start new calls
+    std::vector<uint64_t> expired;
+    auto now = millis();
+
+    for(auto& entry : this->calls)
+    {
+        if((now - entry.second.startTime) >= entry.second.timeout)
+        {
+            expired.push_back(entry.first);
+        }
+    }
+    for(auto key : expired)
+    {
+        if(this->complete(key, RS_TIMEOUT, CommandSpan()))
+        {
+            this->statistics.timeouts++;
+        }
+    }
+}
+
+unsigned int GatewayRpc::GetPendingCount() const
+{
+    return this->calls.size();
+}
+
+const RpcStatistics& GatewayRpc::GetStatistics() const
+{
+    return this->statistics;
+}
+
+bool GatewayRpc::appendMessage(GatewaySession& session, const String& message)
+{
+    if(message.indexOf(RPC_MESSAGE_SEPARATOR) >= 0 || (strlen(GATEWAY_RPC_PREFIX) + message.length()) > RPC_BATCH_MAX)
+    {
+        return false;
+    }
+
+    auto& batch = this->batches[session.id];
+    batch.session = &session;
+
+    // a full batch is sent first, it fails if the send queue of the session is full
+    if(batch.messages.length() > 0 && (batch.messages.length() + 1 + message.length()) > RPC_BATCH_MAX && !this->flush(batch))
+    {
+        return false;
+    }
+
+    if(batch.messages.length() == 0)
+    {
+        batch.messages = GATEWAY_RPC_PREFIX;
+    }
+    else
+    {
+        batch.messages += RPC_MESSAGE_SEPARATOR;
+    }
+    batch.messages += message;
+    return true;
+}
+
+bool GatewayRpc::flush(OutgoingBatch& batch)
+{
+    if(batch.messages.length() == 0)
+    {
+        return true;
+    }
+    if(!this->gateway->SendData(*batch.session, batch.messages))
+    {
+        // sent with the next loop
+        return false;
+    }
+    this->statistics.batchesSent++;
+    batch.messages = "";
+    return true;
+}
+
+void GatewayRpc::processMessage(GatewaySession& session, const char* data, unsigned int length)
+{
+    // tag and hex call ID up to the first delimiter, like RpcEndpoint
+    unsigned int callID = 0;
+    unsigned int i = 1;
+
+    for(; i < length && data[i] != COMMAND_DELIMITER; i++)
+    {
+        char c = data[i];
+        unsigned int value = (c >= '0' && c <= '9') ? (c - '0')
+            : (c >= 'a' && c <= 'f') ? (c - 'a' + 10)
+            : (c >= 'A' && c <= 'F') ? (c - 'A' + 10) : 16;
+
+        if(value > 15 || callID > 0xFFF)
+        {
+            break;
+        }
+        callID = (callID << 4) | value;
+    }
+
+    if(i >= length || data[i] != COMMAND_DELIMITER || callID == 0)
+    {
+        this->statistics.malformed++;
+        return;
+    }
+    i++;
+
+    switch(data[0])
+    {
+    case RPC_REQUEST_TAG:
+        {
+            char response[16] = { 0 };
+            sprintf(response, "%c%x:%u", RPC_RESPONSE_TAG, callID, (unsigned int)RS_UNKNOWN_METHOD);
+            if(this->appendMessage(session, response))
+            {
+                this->statistics.served++;
+            }
+        }
+        break;
+    case RPC_RESPONSE_TAG:
+        {
+            unsigned int status = 0;
+            for(; i < length && data[i] >= '0' && data[i] <= '9'; i++)
+            {
+                status = (status * 10) + (data[i] - '0');
+            }
+            // skip the delimiter in front of the result
+            if(i < length)
+            {
+                i++;
+            }
+            if(this->complete(callKey(session, callID), (status <= RS_CANCELLED) ? (RpcStatus)status : RS_FAILED, CommandSpan(data + i, length - i)))
+            {
+                this->statistics.completed++;
+            }
+            else
+            {
+                // the call has timed out
+                this->statistics.late++;
+            }
+        }
+        break;
+    default:
+        this->statistics.malformed++;
+        break;
+    }
+}
+
+bool GatewayRpc::complete(uint64_t key, RpcStatus status, const CommandSpan& result)
+{
+    auto entry = this->calls.find(key);
+    if(entry == this->calls.end())
+    {
+        return false;
+    }
+
+    // the entry is removed before the callback, so it can start the next call
+    PendingCall call = entry->second;
+    this->calls.erase(entry);
+
+    auto batch = this->batches.find(call.session->id);
+    if(batch != this->batches.end() && batch->second.calls > 0)
+    {
+        batch->second.calls--;
+    }
+
+    if(call.callback != nullptr)
+    {
+        call.callback->OnCallComplete(*call.session, call.callID, status, result);
+    }
+    return true;
+}
+
+uint64_t GatewayRpc::callKey(const GatewaySession& session, uint16_t callID)
+{
+    return ((uint64_t)session.id << 16) | callID;
+}
@@ -0,0 +1,101 @@
+#ifndef GATEWAY_RPC_H
+#define GATEWAY_RPC_H
+
+#include <unordered_map>
+#include "Gateway.h"
+#include "RpcEndpoint.h"
+
+// outstanding calls of one session, more are not started
+#define GATEWAY_RPC_SESSION_CALLS 64
+
+class IGatewayRpcCallback
+{
+public:
+    /**
+     * @brief Called once for every call. The result points into the received payload and is only valid during the
+     *  call. After RS_CANCELLED the session is closed, nothing can be sent to it anymore
+     */
+    virtual void OnCallComplete(GatewaySession& session, uint16_t callID, RpcStatus status, const CommandSpan& result) = 0;
+};
+
+/**
+ * @brief The rpc messages of RpcEndpoint.h on the gateway: calls the methods of the devices (e.g. "get-name" of the
+ *  firmware) and answers the calls of the devices. The gateway has no methods, a request of a device is answered
+ *  with RS_UNKNOWN_METHOD, so the call does not wait for its timeout. The calls of a session which are started in
+ *  the same loop are sent in one package, the responses to a received batch as well. Used by a plugin:
+ *
+ *      void OnSessionReady(GatewaySession& session) override { rpc.Call(session, "get-name", "", this); }
+ *      void OnDataReceived(GatewaySession& session, const ByteSpan& data) override
+ *      {
+ *          if(rpc.OnDataReceived(session, data)) return;
+ *          ...
+ *      }
+ *      void OnSessionClosed(GatewaySession& session) override { rpc.OnSessionClosed(session); }
+ *
+ *      loop: gateway.OnLoop(); rpc.OnLoop();
+ */
+class GatewayRpc
+{
+public:
+    GatewayRpc();
+
+    void Begin(Gateway* gateway);
+
+    /**
+     * @brief Start a call, the callback is called with the response, when the timeout (ms) has expired or when the
+     *  session is closed. Returns the call ID or 0 if the call was not started (the session is not ready, has
+     *  GATEWAY_RPC_SESSION_CALLS calls outstanding or the message is too large or contains the separator)
+     */
+    uint16_t Call(GatewaySession& session, const char* method, const String& arguments, IGatewayRpcCallback* callback, unsigned long timeout = RPC_DEFAULT_TIMEOUT);
+
+    /* Returns true if the payload was a rpc batch, which is processed then */
+    bool OnDataReceived(GatewaySession& session, const ByteSpan& data);
+    /* Completes the calls of the session with RS_CANCELLED */
+    void OnSessionClosed(GatewaySession& session);
+
+    /* Sends the collected messages and completes the calls which timed out */
+    void OnLoop();
+
+    unsigned int GetPendingCount() const;
+    const RpcStatistics& GetStatistics() const;
+
+private:
+    class PendingCall
+    {
+    public:
+        PendingCall();
+
+        GatewaySession* session;
+        uint16_t callID;
+        IGatewayRpcCallback* callback;
+        unsigned long startTime;
+        unsigned long timeout;
+    };
+
+    // messages of a session which were not sent yet
+    class OutgoingBatch
+    {
+    public:
+        OutgoingBatch();
+
+        GatewaySession* session;
+        String messages;
+        unsigned int calls;     // outstanding calls of the session
+    };
+
+    Gateway* gateway;
+    // by session ID and call ID (see callKey)
+    std::unordered_map<uint64_t, PendingCall> calls;
+    // by session ID
+    std::unordered_map<unsigned long, OutgoingBatch> batches;
+    uint16_t nextCallID;
+    RpcStatistics statistics;
+
+    bool appendMessage(GatewaySession& session, const String& message);
+    bool flush(OutgoingBatch& batch);
+    void processMessage(GatewaySession& session, const char* data, unsigned int length);
+    bool complete(uint64_t key, RpcStatus status, const CommandSpan& result);
+    static uint64_t callKey(const GatewaySession& session, uint16_t callID);
+};
+
+#endif
@@ -0,0 +1,232 @@
+#include <Arduino.h>
+#include <atomic>
+#include <signal.h>
+#include <sys/resource.h>
+#include "Gateway.h"
+#include "GatewayRpc.h"
+
+/*
+    Reference gateway on Linux (env native-gateway): accepts the devices on an epoll loop, runs the handshake with a
+    key per session and passes the received data to a plugin. The plugin below counts the messages and, with echo
+    enabled, sends every message back to its device (this loads the send queue and the retransmissions as well).
+    With rpc enabled, the methods of the firmware (get-name, get-metrics, get-link, get-memory) are called in one
+    batch when a session is ready and the results of the first device are printed (see GatewayRpc).
+    Once per second a line with the sessions, handshakes/s and messages/s is printed, at the end (after the given
+    time or on Ctrl+C) a json line with the totals of the run.
+
+    Arguments: port [rsa bits (2048)] [key threads (number of cores)] [sessions per key (1)] [echo (0)] [seconds (0 = until Ctrl+C)] [rpc (0)]
+
+    Benchmark with the load generator of the host, e.g. 2000 sessions with one message per second each:
+
+        pio run -e native-gateway -t exec -a "5000 2048 8 1 0 30"
+        pio run -e native-loadgen -t exec -a "127.0.0.1 5000 2000 8 1000 64 25"
+
+    A handshake costs a key generation (2048 bits take about 50-100 ms on a core) and one rsa decryption, so the
+    handshakes/s are limited by the key threads. More sessions per key raise the rate for a test of the data path.
+*/
+
+#define GATEWAY_REPORT_INTERVAL 1000
+// keys which are generated ahead of the connections
+#define GATEWAY_KEY_POOL_CAPACITY 256
+
+// methods of the firmware (see main.cpp of the device)
+static const char* const deviceMethods[] = { "get-name", "get-metrics", "get-link", "get-memory" };
+
+class CountingPlugin : public IGatewayPlugin, public IGatewayRpcCallback
+{
+public:
+    Gateway* gateway;
+    GatewayRpc rpc;
+    bool echo;
+    bool callMethods;
+    unsigned long echoDropped;
+    unsigned long rpcFailed;
+    // the results of the first session are printed, the others only counted
+    unsigned long printedSession;
+
+    CountingPlugin()
+    : gateway(nullptr), echo(false), callMethods(false), echoDropped(0), rpcFailed(0), printedSession(0)
+    {}
+
+    void OnSessionReady(GatewaySession& session) override
+    {
+        if(!this->callMethods)
+        {
+            return;
+        }
+        for(unsigned int i = 0; i < sizeof(deviceMethods) / sizeof(deviceMethods[0]); i++)
+        {
+            if(this->rpc.Call(session, deviceMethods[i], "", this) == 0)
+            {
+                this->rpcFailed++;
+            }
+        }
+    }
+
+    void OnDataReceived(GatewaySession& session, const ByteSpan& data) override
+    {
+        if(this->rpc.OnDataReceived(session, data))
+        {
+            return;
+        }
+        if(this->echo && !this->gateway->SendData(session, data.ToString()))
+        {
+            this->echoDropped++;
+        }
+    }
+
+    void OnSessionClosed(GatewaySession& session) override
+    {
+        this->rpc.OnSessionClosed(session);
+    }
+
+    void OnCallComplete(GatewaySession& session, uint16_t callID, RpcStatus status, const CommandSpan& result) override
+    {
+        if(status != RS_OK)
+        {
+            this->rpcFailed++;
+            return;
+        }
+        if(this->printedSession == 0)
+        {
+            this->printedSession = session.id;
+        }
+        if(this->printedSession == session.id)
+        {
+            printf("gateway: rpc %s call %x: %s\n", session.address.c_str(), (unsigned int)callID, result.ToString().c_str());
+        }
+    }
+};
+
+static std::atomic<bool> running(true);
+
+static void onSignal(int signal)
+{
+    running = false;
+}
+
+static void raiseFileLimit()
+{
+    // every session is a socket, the default soft limit of 1024 would end at about a thousand sessions
+    rlimit limit;
+    if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+    {
+        fprintf(stderr, "usage: %s port [rsa bits] [key threads] [sessions per key] [echo] [seconds] [rpc]\n", argv[0]);
+        return 1;
+    }
+
+    uint16_t port = (uint16_t)atoi(argv[1]);
+    unsigned int rsaBits = (argc > 2) ? (unsigned int)atoi(argv[2]) : 2048;
+    unsigned int keyThreads = (argc > 3) ? (unsigned int)atoi(argv[3]) : std::thread::hardware_concurrency();
+    unsigned int keyUses = (argc > 4) ? (unsigned int)atoi(argv[4]) : 1;
+    bool echo = (argc > 5) ? (atoi(argv[5]) != 0) : false;
+    unsigned long duration = ((argc > 6) ? (unsigned long)atol(argv[6]) : 0) * 1000;
+    bool callMethods = (argc > 7) ? (atoi(argv[7]) != 0) : false;
+
+    if(keyThreads == 0)
+    {
+        keyThreads = 1;
+    }
+
+    raiseFileLimit();
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    GatewayKeyPool keys;
+    if(!keys.Begin(rsaBits, keyThreads, GATEWAY_KEY_POOL_CAPACITY, keyUses))
+    {
+        fprintf(stderr, "Error: key pool could not be started (at most %u bits)\n", (unsigned int)transmissionProfile.rsaKeyBitsMax);
+        return 1;
+    }
+
+    Gateway gateway;
+    CountingPlugin plugin;
+    plugin.gateway = &gateway;
+    plugin.echo = echo;
+    plugin.callMethods = callMethods;
+    plugin.rpc.Begin(&gateway);
+    gateway.SetPlugin(&plugin);
+
+    if(!gateway.Begin(port, &keys))
+    {
+        fprintf(stderr, "Error: port %u could not be opened\n", (unsigned int)port);
+        return 1;
+    }
+    printf("gateway: listening on port %u, %u bit keys from %u threads, %u sessions per key\n", (unsigned int)port, rsaBits, keyThreads, keyUses);
+    fflush(stdout);
+
+    const GatewayStatistics& statistics = gateway.GetStatistics();
+    GatewayStatistics last;
+    unsigned long peakSessions = 0;
+    auto start = millis();
+    auto reportTimer = start;
+
+    while(running && (duration == 0 || (millis() - start) < duration))
+    {
+        gateway.OnLoop();
+        plugin.rpc.OnLoop();
+
+        if(statistics.sessions > peakSessions)
+        {
+            peakSessions = statistics.sessions;
+        }
+
+        unsigned long elapsed = millis() - reportTimer;
+        if(elapsed >= GATEWAY_REPORT_INTERVAL)
+        {
+            reportTimer = millis();
+
+            printf("gateway: sessions %u handshakes/s %lu msg/s in %lu out %lu B/s %lu handshake p50 %lu p99 %lu ms retx %lu drops %lu errors %lu keys %u\n",
+                statistics.sessions,
+                ((statistics.handshakes - last.handshakes) * 1000) / elapsed,
+                ((statistics.messagesIn - last.messagesIn) * 1000) / elapsed,
+                ((statistics.messagesOut - last.messagesOut) * 1000) / elapsed,
+                ((statistics.bytesIn - last.bytesIn) * 1000) / elapsed,
+                statistics.handshakeTime.GetPercentile(500), statistics.handshakeTime.GetPercentile(990),
+                statistics.retransmissions, statistics.drops, statistics.handshakeErrors + statistics.parseErrors + statistics.decryptErrors,
+                keys.GetReadyCount());
+            fflush(stdout);
+
+            last.handshakes = statistics.handshakes;
+            last.messagesIn = statistics.messagesIn;
+            last.messagesOut = statistics.messagesOut;
+            last.bytesIn = statistics.bytesIn;
+        }
+    }
+
+    unsigned long elapsed = millis() - start;
+    if(elapsed == 0)
+    {
+        elapsed = 1;
+    }
+
+    // the percentiles are the upper bounds of the histogram buckets (see LatencyHistogram)
+    printf("{\"gateway\":{\"rsa_bits\":%u,\"key_threads\":%u,\"sessions_per_key\":%u,\"echo\":%d,\"elapsed_ms\":%lu,"
+        "\"accepted\":%lu,\"peak_sessions\":%lu,\"handshakes\":%lu,\"handshakes_per_s\":%lu,"
+        "\"handshake_ms\":{\"p50\":%lu,\"p90\":%lu,\"p99\":%lu,\"max\":%lu},"
+        "\"messages_in\":%lu,\"messages_in_per_s\":%lu,\"bytes_in_per_s\":%lu,\"messages_out\":%lu,"
+        "\"retransmissions\":%lu,\"drops\":%lu,\"duplicates\":%lu,\"handshake_errors\":%lu,\"parse_errors\":%lu,\"decrypt_errors\":%lu,"
+        "\"echo_dropped\":%lu,\"keys_generated\":%lu,\"rpc_calls\":%lu,\"rpc_completed\":%lu,\"rpc_failed\":%lu,\"rpc_timeouts\":%lu,\"rpc_served\":%lu}}\n",
+        rsaBits, keyThreads, keyUses, echo ? 1 : 0, elapsed,
+        statistics.accepted, peakSessions, statistics.handshakes, (statistics.handshakes * 1000) / elapsed,
+        statistics.handshakeTime.GetPercentile(500), statistics.handshakeTime.GetPercentile(900),
+        statistics.handshakeTime.GetPercentile(990), statistics.handshakeTime.GetMax(),
+        statistics.messagesIn, (statistics.messagesIn * 1000) / elapsed, (statistics.bytesIn * 1000) / elapsed, statistics.messagesOut,
+        statistics.retransmissions, statistics.drops, statistics.duplicates, statistics.handshakeErrors, statistics.parseErrors, statistics.decryptErrors,
+        plugin.echoDropped, keys.GetGeneratedCount(), plugin.rpc.GetStatistics().calls, plugin.rpc.GetStatistics().completed,
+        plugin.rpcFailed, plugin.rpc.GetStatistics().timeouts, plugin.rpc.GetStatistics().served);
+    fflush(stdout);
+
+    gateway.End();
+    keys.End();
+    return 0;
+}
@@ -0,0 +1,194 @@
+#include <Arduino.h>
+#include <algorithm>
+#include <vector>
+#include "LinkSimulator.h"
+#include "LoopbackServer.h"
+#include "RpcEndpoint.h"
+
+/*
+    Link simulator grid on the host (env native-linksim): the transport runs against the in-process server over a
+    LinkSimulator for every combination of loss and latency, in real time. Every cell keeps a window of rpc calls
+    outstanding, the server echoes them, and prints a line. Latency and jitter apply to both directions, the loss only
+    to the frames of the device: the loopback server does not retransmit, so a lost answer would never arrive. The
+    frames of the server are duplicated at the rate of the loss instead, as a server resends a package whose
+    confirmation was lost. Every cell runs with the duplicate filter of the device (see DuplicateWindow) and without:
+
+        filter      duplicate filter of the device on or off
+        goodput     payload bytes of the answered calls per second
+        latency     call round trip in ms (p50, p90, p99, max)
+        lost        calls without an answer within the timeout
+        resent      retransmissions of the transport
+        dropped     frames of the device which the simulator dropped
+        dups        resent packages the device received again
+        late        responses the rpc endpoint got for completed calls, the duplicates which reached the application
+        dec ms      time the device spent decrypting received packages
+
+    Arguments: time per cell in ms (1000), payload size (64), outstanding calls (8), call timeout in ms (3000)
+
+        pio run -e native-linksim -t exec -a "1000 64"
+*/
+
+#define LINKSIM_METHOD "echo"
+#define LINKSIM_RSA_BITS 1024
+#define LINKSIM_SEED 1
+
+static const unsigned int gridLoss[] = { 0, 10, 50, 100 };          // permille
+static const unsigned long gridLatency[] = { 0, 20, 100 };          // ms, the jitter is half of it
+
+// start time of a call by call ID
+static unsigned long startTimes[1 << 16];
+
+class GridCell : public IRpcCallback
+{
+public:
+    std::vector<unsigned long> latencies;
+    unsigned long answered;
+    unsigned long lost;
+
+    GridCell()
+    : answered(0), lost(0)
+    {}
+
+    void OnCallComplete(uint16_t callID, RpcStatus status, const CommandSpan& result) override
+    {
+        if(status != RS_OK)
+        {
+            this->lost++;
+            return;
+        }
+        this->answered++;
+        this->latencies.push_back(micros() - startTimes[callID]);
+    }
+
+    double GetPercentile(unsigned int permille)
+    {
+        if(this->latencies.empty())
+        {
+            return 0.0;
+        }
+        size_t index = (this->latencies.size() * permille) / 1000;
+        if(index >= this->latencies.size())
+        {
+            index = this->latencies.size() - 1;
+        }
+        std::nth_element(this->latencies.begin(), this->latencies.begin() + index, this->latencies.end());
+        return this->latencies[index] / 1000.0;
+    }
+};
+
+static bool runCell(LoopbackServer& server, unsigned int loss, unsigned long latency, unsigned long duration,
+    const String& payload, unsigned int window, unsigned long timeout, bool filter)
+{
+    TransmissionControl controller;
+    RpcEndpoint rpc;
+    LinkSimulator simulator(LINKSIM_SEED);
+    GridCell cell;
+
+    controller.SetDeviceName("linksim");
+    controller.SetDuplicateFilter(filter);
+    controller.SetInterface(&simulator);
+    simulator.SetController(&controller);
+    simulator.SetInterface(&server);
+    server.SetController(&controller);
+    server.SetLink(&simulator);
+
+    if(!rpc.Begin(&controller) || !server.Handshake())
+    {
+        fprintf(stderr, "Error: session could not be started!\n");
+        server.SetLink(nullptr);
+        return false;
+    }
+
+    // the key exchange runs over the clean link, the impairments apply to the session
+    LinkImpairments impairments;
+    impairments.latency = latency;
+    impairments.jitter = latency / 2;
+    impairments.duplicatePermille = loss;
+    simulator.SetIncomingImpairments(impairments);
+    impairments.duplicatePermille = 0;
+    impairments.lossPermille = loss;
+    simulator.SetOutgoingImpairments(impairments);
+
+    auto start = millis();
+    while((millis() - start) < duration || rpc.GetPendingCount() > 0)
+    {
+        while((millis() - start) < duration && rpc.GetPendingCount() < window)
+        {
+            uint16_t callID = rpc.Call(LINKSIM_METHOD, payload, &cell, timeout);
+            if(callID == 0)
+            {
+                break;
+            }
+            startTimes[callID] = micros();
+        }
+
+        rpc.OnLoop();
+        simulator.OnLoop();
+        server.Pump();
+        delayMicroseconds(100);
+    }
+    double elapsed = (millis() - start) / 1000.0;
+
+    printf("%5.1f %8lu %6s %10.0f %8.1f %8.1f %8.1f %8.1f %6lu %7lu %8lu %6lu %6lu %7.1f\n",
+        loss / 10.0,
+        latency,
+        filter ? "on" : "off",
+        (cell.answered * payload.length()) / elapsed,
+        cell.GetPercentile(500),
+        cell.GetPercentile(900),
+        cell.GetPercentile(990),
+        cell.GetPercentile(1000),
+        cell.lost,
+        controller.GetMetrics().retransmissions,
+        simulator.GetOutgoingStatistics().lost,
+        controller.GetMetrics().duplicates,
+        rpc.GetStatistics().late,
+        controller.GetMetrics().decryptTime.GetSum() / 1000.0);
+    fflush(stdout);
+
+    server.EndSession();
+    server.SetLink(nullptr);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long duration = (argc > 1) ? (unsigned long)atol(argv[1]) : 1000;
+    unsigned int payloadSize = (argc > 2) ? (unsigned int)atoi(argv[2]) : 64;
+    unsigned int window = (argc > 3) ? (unsigned int)atoi(argv[3]) : 8;
+    unsigned long timeout = (argc > 4) ? (unsigned long)atol(argv[4]) : 3000;
+
+    if(payloadSize == 0 || payloadSize > (RPC_BATCH_MAX / 2) || window == 0 || window > RPC_CALL_CAPACITY)
+    {
+        fprintf(stderr, "Error: payload size 1..%u and 1..%u outstanding calls\n", (unsigned int)(RPC_BATCH_MAX / 2), (unsigned int)RPC_CALL_CAPACITY);
+        return 1;
+    }
+
+    String payload;
+    for(unsigned int i = 0; i < payloadSize; i++)
+    {
+        payload += (char)('a' + (i % 26));
+    }
+
+    LoopbackServer server;
+    server.SetCallEcho(true);
+    if(!server.Begin(LINKSIM_RSA_BITS))
+    {
+        fprintf(stderr, "Error: server key could not be generated!\n");
+        return 1;
+    }
+
+    printf("loss%% latency filter  goodput/s  p50(ms)  p90(ms)  p99(ms)  max(ms)   lost  resent  dropped   dups   late  dec ms\n");
+    for(unsigned int i = 0; i < sizeof(gridLoss) / sizeof(gridLoss[0]); i++)
+    {
+        for(unsigned int k = 0; k < sizeof(gridLatency) / sizeof(gridLatency[0]); k++)
+        {
+            if(!runCell(server, gridLoss[i], gridLatency[k], duration, payload, window, timeout, true)
+                || !runCell(server, gridLoss[i], gridLatency[k], duration, payload, window, timeout, false))
+            {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
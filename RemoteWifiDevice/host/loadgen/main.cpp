@@ -0,0 +1,172 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "LoadGenerator.h"
+
+/*
+    Load generator on the host (env native-loadgen): many virtual devices over local tcp against a server (e.g.
+    host/gateway or the MyDevices server). The sessions are split over the threads, every thread runs its own
+    LoadGenerator, so the sessions of a thread are not shared with another one. Once per report interval the totals
+    of all threads are printed, at the end a json line with the totals of the run.
+
+    Arguments: host port [sessions (64)] [threads (4)] [message interval ms (100)] [payload size (64)] [seconds (10)]
+
+        pio run -e native-loadgen -t exec -a "127.0.0.1 5000 1000 8"
+
+    A session holds a TransmissionControl, so every thread reserves LOAD_GENERATOR_MAX_SESSIONS of them (256 in the
+    env), more sessions need more threads.
+*/
+
+#define LOADGEN_REPORT_INTERVAL 1000
+// the threads publish their totals at this interval
+#define LOADGEN_PUBLISH_INTERVAL 100
+
+class LoadWorker
+{
+public:
+    LoadGenerator* generator;
+    LoadGeneratorTotals published;
+    std::mutex lock;
+    std::thread thread;
+
+    LoadWorker()
+    : generator(nullptr)
+    {}
+};
+
+static std::atomic<bool> running(true);
+
+static void runWorker(LoadWorker* worker)
+{
+    LoadGeneratorTotals totals;
+    unsigned long publishTimer = millis();
+
+    while(running)
+    {
+        worker->generator->OnLoop();
+
+        if((millis() - publishTimer) >= LOADGEN_PUBLISH_INTERVAL)
+        {
+            publishTimer = millis();
+            worker->generator->GetTotals(totals);
+
+            std::lock_guard<std::mutex> guard(worker->lock);
+            worker->published = totals;
+        }
+        delayMicroseconds(200);
+    }
+
+    worker->generator->GetTotals(totals);
+    std::lock_guard<std::mutex> guard(worker->lock);
+    worker->published = totals;
+}
+
+static void collect(std::vector<LoadWorker*>& workers, LoadGeneratorTotals& totals)
+{
+    totals = LoadGeneratorTotals();
+    for(auto worker : workers)
+    {
+        std::lock_guard<std::mutex> guard(worker->lock);
+        totals.Add(worker->published);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 3)
+    {
+        fprintf(stderr, "usage: %s host port [sessions] [threads] [interval ms] [payload size] [seconds]\n", argv[0]);
+        return 1;
+    }
+
+    IPAddress host;
+    if(!host.fromString(argv[1]))
+    {
+        fprintf(stderr, "Error: invalid host address %s\n", argv[1]);
+        return 1;
+    }
+    uint16_t port = (uint16_t)atoi(argv[2]);
+    unsigned int sessions = (argc > 3) ? (unsigned int)atoi(argv[3]) : 64;
+    unsigned int threads = (argc > 4) ? (unsigned int)atoi(argv[4]) : 4;
+    unsigned long interval = (argc > 5) ? (unsigned long)atol(argv[5]) : 100;
+    unsigned int payloadSize = (argc > 6) ? (unsigned int)atoi(argv[6]) : 64;
+    unsigned long duration = ((argc > 7) ? (unsigned long)atol(argv[7]) : 10) * 1000;
+
+    if(threads == 0 || sessions < threads || ((sessions + threads - 1) / threads) > LOAD_GENERATOR_MAX_SESSIONS)
+    {
+        fprintf(stderr, "Error: 1..%u sessions per thread\n", (unsigned int)LOAD_GENERATOR_MAX_SESSIONS);
+        return 1;
+    }
+
+    std::vector<LoadWorker*> workers;
+    unsigned int firstSession = 0;
+
+    for(unsigned int i = 0; i < threads; i++)
+    {
+        LoadGeneratorConfig config;
+        config.sessionCount = (sessions / threads) + ((i < (sessions % threads)) ? 1 : 0);
+        config.messageInterval = interval;
+        config.payloadSize = payloadSize;
+        config.reportInterval = 0;
+        config.firstSession = firstSession;
+        firstSession += config.sessionCount;
+
+        LoadWorker* worker = new LoadWorker();
+        worker->generator = new LoadGenerator();
+        workers.push_back(worker);
+
+        // connects the sessions of the thread, the threads start one after the other
+        worker->generator->Begin(host, port, config);
+        worker->thread = std::thread(runWorker, worker);
+    }
+
+    LoadGeneratorTotals totals;
+    LoadGeneratorTotals last;
+    auto start = millis();
+    auto reportTimer = start;
+
+    while((millis() - start) < duration)
+    {
+        delay(LOADGEN_REPORT_INTERVAL);
+
+        collect(workers, totals);
+        unsigned long elapsed = millis() - reportTimer;
+        reportTimer = millis();
+
+        printf("loadgen: sessions %u/%u msg/s %lu B/s %lu ack-rtt p50 %lu p90 %lu p99 %lu max %lu ms retx %lu drops %lu connects %lu\n",
+            totals.connected, totals.sessions,
+            ((totals.messages - last.messages) * 1000) / elapsed,
+            ((totals.bytesOut - last.bytesOut) * 1000) / elapsed,
+            totals.ackRTT.GetPercentile(500), totals.ackRTT.GetPercentile(900), totals.ackRTT.GetPercentile(990), totals.ackRTT.GetMax(),
+            totals.retransmissions, totals.drops, totals.reconnects);
+        fflush(stdout);
+        last = totals;
+    }
+
+    running = false;
+    for(auto worker : workers)
+    {
+        worker->thread.join();
+    }
+    collect(workers, totals);
+    unsigned long elapsed = millis() - start;
+
+    // the percentiles are the upper bounds of the histogram buckets (see LatencyHistogram)
+    printf("{\"loadgen\":{\"sessions\":%u,\"threads\":%u,\"interval_ms\":%lu,\"payload\":%u,\"elapsed_ms\":%lu,"
+        "\"connected\":%u,\"messages\":%lu,\"messages_per_s\":%lu,\"bytes_per_s\":%lu,"
+        "\"ack_rtt_ms\":{\"p50\":%lu,\"p90\":%lu,\"p99\":%lu,\"max\":%lu},\"retransmissions\":%lu,\"drops\":%lu,\"connects\":%lu}}\n",
+        sessions, threads, interval, payloadSize, elapsed,
+        totals.connected, totals.messages, (totals.messages * 1000) / elapsed, (totals.bytesOut * 1000) / elapsed,
+        totals.ackRTT.GetPercentile(500), totals.ackRTT.GetPercentile(900), totals.ackRTT.GetPercentile(990), totals.ackRTT.GetMax(),
+        totals.retransmissions, totals.drops, totals.reconnects);
+
+    for(auto worker : workers)
+    {
+        delete worker->generator;
+        delete worker;
+    }
+    return 0;
+}
@@ -0,0 +1,39 @@
+#ifndef BASE64_H
+#define BASE64_H
+
+#include <Arduino.h>
+
+/*
+    Standard base64 (RFC 4648, with padding, no line breaks) as used by the transmission packages
+*/
+
+// vector loops for long inputs on x86 hosts, selected at run time (0 for the scalar loops only)
+#ifndef BASE64_SIMD
+#define BASE64_SIMD 1
+#endif
+
+// number of characters for the given number of bytes
+#define BASE64_ENCODED_LENGTH(length) ((((length) + 2) / 3) * 4)
+
+size_t base64EncodedLength(size_t length);
+
+/**
+ * @brief Exact number of bytes of the decoded data (the padding is taken into account). Returns 0 if the length
+ *  of the input is not a multiple of 4
+ */
+size_t base64DecodedLength(const char* data, size_t length);
+
+/**
+ * @brief Writes exactly base64EncodedLength(length) characters to the output (without terminator) and returns
+ *  the number of characters
+ */
+size_t base64Encode(const unsigned char* data, size_t length, char* output);
+
+/**
+ * @brief Strict decoding: the length must be a multiple of 4, only characters of the alphabet are accepted,
+ *  padding only at the end and the unused bits of the last character must be zero. Returns false if the input
+ *  is invalid or the output is smaller than base64DecodedLength(...). The output may be the same buffer as the input.
+ */
+bool base64Decode(const char* data, size_t length, unsigned char* output, size_t outputSize, size_t& outLen);
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef BOOT_STATE_H
+#define BOOT_STATE_H
+
+#include <Arduino.h>
+#include <stdio.h>
+
+#ifdef ESP32
+#include <Preferences.h>
+#endif
+
+#define BOOT_STATE_HOSTNAME_SIZE 32
+
+// validity of the parts of the boot state
+#define BOOT_STATE_SERVER 0x01
+#define BOOT_STATE_WIFI 0x02
+
+/*
+    Connection hints of the last successful boot. With the hints the device joins the access point without a scan
+    and connects to the last server without waiting for a discovery answer
+*/
+class BootState
+{
+public:
+    BootState();
+
+    uint8_t flags;
+
+    // last server which accepted a connection
+    uint32_t serverAddress;
+    uint16_t serverPort;
+    char serverHostname[BOOT_STATE_HOSTNAME_SIZE];
+
+    // access point of the last wifi connection
+    int32_t wifiChannel;
+    uint8_t wifiBssid[6];
+
+    void Clear();
+    bool HasServer() const;
+    bool HasWifi() const;
+
+    void SetServer(uint32_t address, uint16_t port, const String& hostname);
+    void SetWifi(int32_t channel, const uint8_t* bssid);
+
+    bool operator==(const BootState& other) const;
+    bool operator!=(const BootState& other) const;
+};
+
+/**
+ * @brief Persistence of the boot state. Load returns false if there is no valid state (the state is protected by a
+ *  checksum, a damaged or incompatible state is treated as missing)
+ */
+class IBootStateStore
+{
+public:
+    virtual bool Load(BootState& state) = 0;
+    virtual bool Save(const BootState& state) = 0;
+    virtual void Clear() = 0;
+};
+
+/**
+ * @brief Boot state in a file, for hosts and for devices with a mounted file system
+ */
+class FileBootStateStore : public IBootStateStore
+{
+public:
+    FileBootStateStore(const char* path);
+
+    bool Load(BootState& state) override;
+    bool Save(const BootState& state) override;
+    void Clear() override;
+
+private:
+    String path;
+};
+
+#ifdef ESP32
+/**
+ * @brief Boot state in the rtc memory, which is kept during deep sleep, backed by nvs for a cold boot. The nvs copy
+ *  is only written if the state has changed, so the flash is not worn by every wake up
+ */
+class RtcBootStateStore : public IBootStateStore
+{
+public:
+    RtcBootStateStore();
+
+    bool Load(BootState& state) override;
+    bool Save(const BootState& state) override;
+    void Clear() override;
+
+    /* The state was loaded from the rtc memory (wake up from deep sleep) */
+    bool IsWarmStart() const;
+
+private:
+    Preferences preferences;
+    bool warmStart;
+};
+#endif
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef BYTE_SPAN_H
+#define BYTE_SPAN_H
+
+#include <Arduino.h>
+
+/*
+    Non-owning view into a byte buffer (a received payload, a frame). The referenced buffer is owned by the caller
+    and only valid during the call the span is passed to
+*/
+class ByteSpan
+{
+public:
+    ByteSpan();
+    ByteSpan(const unsigned char* data, unsigned int length);
+
+    /* View of the characters of the string (without the terminator) */
+    static ByteSpan FromString(const String& text);
+
+    const unsigned char* data;
+    unsigned int length;
+
+    bool Equals(const char* text) const;
+    bool StartsWith(const char* text) const;
+
+    /* Copy into a string, for consumers which have to keep the payload */
+    String ToString() const;
+};
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <Arduino.h>
+
+/**
+ * @brief CRC-32 (IEEE 802.3, same result as zlib's crc32). Pass the previous result to continue a checksum over
+ *  several buffers, start with 0. On the esp32 the table driven implementation in the ROM is used.
+ */
+uint32_t crc32Update(uint32_t crc, const unsigned char* data, size_t length);
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef COMMAND_ROUTER_H
+#define COMMAND_ROUTER_H
+
+#include <Arduino.h>
+#include "TransmissionProfile.h"
+
+// number of table slots, must be a power of two (at most half of it can be registered)
+#ifndef COMMAND_ROUTER_CAPACITY
+#define COMMAND_ROUTER_CAPACITY TRANSMISSION_PROFILE_ROUTER_CAPACITY
+#endif
+
+#define COMMAND_MAX_ARGUMENTS 8
+#define COMMAND_DELIMITER ':'
+
+#define COMMAND_HASH_OFFSET 2166136261u
+#define COMMAND_HASH_PRIME 16777619u
+
+/**
+ * @brief FNV-1a hash of a command name. This is constexpr so command IDs can be used as case labels:
+ *  switch(commandID) { case COMMAND_ID("get-name"): ... }
+ */
+constexpr uint32_t commandHash(const char* command, uint32_t hash = COMMAND_HASH_OFFSET)
+{
+    return (*command == '\0') ? hash : commandHash(command + 1, (hash ^ (uint8_t)*command) * COMMAND_HASH_PRIME);
+}
+
+#define COMMAND_ID(command) commandHash(command)
+
+/*
+    Non-owning view into the payload of a command
+*/
+class CommandSpan
+{
+public:
+    CommandSpan();
+    CommandSpan(const char* data, unsigned int length);
+
+    const char* data;
+    unsigned int length;
+
+    bool Equals(const char* text) const;
+    long ToInt() const;
+    String ToString() const;
+};
+
+/**
+ * @brief The arguments of a command (everything after the command and the delimiter), split by the delimiter.
+ *  The arguments point into the dispatched buffer and are only valid during the handler call.
+ */
+class CommandArguments
+{
+public:
+    CommandArguments(const char* data, unsigned int length);
+
+    /* Number of arguments (at most COMMAND_MAX_ARGUMENTS, the last one contains the unsplit rest) */
+    unsigned int GetCount() const;
+    CommandSpan GetAt(unsigned int index) const;
+
+    /* The complete argument section */
+    CommandSpan GetRaw() const;
+
+private:
+    CommandSpan raw;
+    CommandSpan arguments[COMMAND_MAX_ARGUMENTS];
+    unsigned int argumentCount;
+};
+
+class ICommandHandler
+{
+public:
+    virtual void OnCommand(uint32_t commandID, const CommandArguments& arguments) = 0;
+};
+
+/**
+ * @brief Maps command prefixes to handlers. A command is the beginning of a payload up to a delimiter or
+ *  the end (e.g. "rq:status" or "set-name" in "set-name:device"). The lookup hashes the payload once
+ *  while scanning it and probes the table at every delimiter, so the cost depends on the payload and not
+ *  on the number of registered commands. If several registered commands match, the longest one wins.
+ *
+ *  A command only matches up to a delimiter or the end of the payload. This differs from the former
+ *  startsWith(...) chain: "rq:statusx" no longer runs the "rq:status" handler and "get-name:x" runs the
+ *  "get-name" handler with the argument "x". Commands with a different tail must be registered separately.
+ *
+ *  The table is owned by BasicCommandRouter, CommandRouter is the router with COMMAND_ROUTER_CAPACITY slots.
+ */
+class CommandDispatcher
+{
+public:
+    /**
+     * @brief Register a handler for a command. The command string must stay valid (use a literal).
+     *  Returns false if the table is full or the command is already registered
+     */
+    bool Register(const char* command, ICommandHandler* handler);
+    void Unregister(const char* command);
+
+    unsigned int GetCount() const;
+    /* Number of table slots, at most half of them can be registered */
+    unsigned int GetCapacity() const;
+
+    /**
+     * @brief Look up the command of the payload and invoke its handler. Returns true if a handler was found
+     */
+    bool Dispatch(const char* data, unsigned int length) const;
+
+protected:
+    struct RouteEntry
+    {
+        uint32_t hash;
+        const char* command;
+        unsigned int length;
+        ICommandHandler* handler;
+    };
+
+    /* The table must hold capacity entries (a power of two) and live as long as the dispatcher */
+    CommandDispatcher(RouteEntry* table, unsigned int capacity);
+
+private:
+    RouteEntry* routes;
+    unsigned int mask;
+    unsigned int routeCount;
+
+    const RouteEntry* find(uint32_t hash, const char* data, unsigned int length) const;
+};
+
+template <unsigned int capacity>
+class BasicCommandRouter : public CommandDispatcher
+{
+public:
+    static_assert(capacity > 0 && (capacity & (capacity - 1)) == 0, "the capacity of a command router must be a power of two");
+
+    BasicCommandRouter()
+    : CommandDispatcher(table, capacity)
+    {}
+
+private:
+    RouteEntry table[capacity];
+};
+
+typedef BasicCommandRouter<COMMAND_ROUTER_CAPACITY> CommandRouter;
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef CONNECTION_MANAGER_H
+#define CONNECTION_MANAGER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "TransmissionControl.h"
+#include "ServiceDiscovery.h"
+
+// reconnect delay: exponential backoff from the base to the cap, the delay of an attempt is picked at random
+// between zero and the current backoff (full jitter), so a fleet does not reconnect in lockstep
+#ifndef CONNECTION_BACKOFF_BASE
+#define CONNECTION_BACKOFF_BASE 1000
+#endif
+#ifndef CONNECTION_BACKOFF_CAP
+#define CONNECTION_BACKOFF_CAP 10000
+#endif
+// a connection has to stay up this long before the backoff starts over
+#define CONNECTION_STABLE_TIME 10000
+
+// a keepalive is sent if nothing was received for this time, the peer is dead if nothing was received
+// (not even the confirmation of a keepalive) for the dead peer timeout
+#ifndef CONNECTION_KEEPALIVE_INTERVAL
+#define CONNECTION_KEEPALIVE_INTERVAL 5000
+#endif
+#ifndef CONNECTION_DEAD_PEER_TIMEOUT
+#define CONNECTION_DEAD_PEER_TIMEOUT 15000
+#endif
+
+enum ConnectionState { CS_WAITING, CS_CONNECTED };
+
+/**
+ * @brief The socket of the connection manager, so the state machine can be run against a simulated transport
+ */
+class IConnectionTransport
+{
+public:
+    virtual bool Connect(const IPAddress& address, uint16_t port) = 0;
+    virtual bool IsConnected() = 0;
+    virtual void Disconnect() = 0;
+};
+
+class IConnectionListener
+{
+public:
+    virtual void OnConnected(const DiscoveredServer& server) {}
+    virtual void OnDisconnected() {}
+};
+
+class WiFiClientTransport : public IConnectionTransport
+{
+public:
+    WiFiClientTransport(WiFiClient& client);
+
+    bool Connect(const IPAddress& address, uint16_t port) override;
+    bool IsConnected() override;
+    void Disconnect() override;
+
+private:
+    WiFiClient& client;
+};
+
+/**
+ * @brief Connection state machine of a device. Connects to the server selected by the service discovery, signals
+ *  OnClientConnected/OnClientDisconnected to the transmission control on every state change and reconnects with
+ *  jittered exponential backoff. While connected, idle periods are covered by keepalives (confirmed data packages),
+ *  a connection without any received data for the dead peer timeout is closed (half-open connections are not
+ *  reported by the socket until the tcp timeouts expire)
+ */
+class ConnectionManager
+{
+public:
+    ConnectionManager();
+
+    void Begin(IConnectionTransport* transport, TransmissionControl* controller, ServiceDiscovery* discovery, uint32_t seed);
+    void SetListener(IConnectionListener* listener);
+    void SetKeepalive(unsigned long interval, unsigned long deadPeerTimeout);
+
+    void OnLoop();
+
+    /* Skip the delay of the next attempt (e.g. after a wake up with a known server, which is not synchronized
+       with the rest of the fleet) */
+    void ConnectNow();
+
+    ConnectionState GetState() const;
+    /* millis() of the next connection attempt while waiting */
+    unsigned long GetNextAttempt() const;
+    unsigned int GetFailedAttempts() const;
+    unsigned long GetConnects() const;
+    unsigned long GetDeadPeers() const;
+
+private:
+    IConnectionTransport* transport;
+    TransmissionControl* controller;
+    ServiceDiscovery* discovery;
+    IConnectionListener* listener;
+
+    ConnectionState state;
+    unsigned long keepaliveInterval;
+    unsigned long deadPeerTimeout;
+
+    unsigned long nextAttempt;      // millis() of the next connection attempt
+    unsigned int failedAttempts;    // since the last stable connection
+    unsigned long connectedSince;
+    unsigned long keepaliveSent;
+
+    unsigned long connects;
+    unsigned long deadPeers;
+    uint32_t randomState;
+
+    void tryConnect();
+    void onConnectionLost();
+    void scheduleAttempt();
+    void checkPeer();
+    uint32_t nextRandom();
+};
+
+#endif
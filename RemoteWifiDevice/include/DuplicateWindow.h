@@ -0,0 +1,33 @@
+#ifndef DUPLICATE_WINDOW_H
+#define DUPLICATE_WINDOW_H
+
+#include <Arduino.h>
+
+// transmission IDs are transmitted with 4 hex digits
+#define TRANSMISSION_ID_MASK 0xFFFF
+#define DUPLICATE_WINDOW_SIZE 64
+
+/**
+ * @brief Sliding window over the most recently received transmission IDs. The window follows the highest
+ *  ID seen so far and compares IDs in 16 bit serial number arithmetic, so it keeps working when the ID wraps.
+ *  IDs older than the window are reported as duplicates.
+ */
+class DuplicateWindow
+{
+public:
+    DuplicateWindow();
+
+    /**
+     * @brief Registers the ID and returns true if it was already received (or is too old to tell)
+     */
+    bool CheckAndMark(unsigned int transmissionID);
+
+    void Reset();
+
+private:
+    uint64_t bitmap;        // bit n is set if (highestID - n) was received
+    unsigned int highestID;
+    bool empty;
+};
+
+#endif
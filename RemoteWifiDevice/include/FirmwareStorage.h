@@ -0,0 +1,110 @@
+#ifndef FIRMWARE_STORAGE_H
+#define FIRMWARE_STORAGE_H
+
+#include <Arduino.h>
+#include <stdio.h>
+
+#ifdef ESP32
+#include <Preferences.h>
+#include "esp_ota_ops.h"
+#endif
+
+// erase unit of the flash, images are written in blocks of this size
+#define FIRMWARE_BLOCK_SIZE 4096
+#define FIRMWARE_HASH_HEX_LENGTH 64
+
+/*
+    Progress of an interrupted update, identified by the sha-256 of the image
+*/
+class FirmwareProgress
+{
+public:
+    FirmwareProgress();
+
+    char hash[FIRMWARE_HASH_HEX_LENGTH + 1];
+    uint32_t imageSize;
+    uint32_t offset;    // bytes written and persisted, always a multiple of FIRMWARE_BLOCK_SIZE
+
+    bool Matches(const char* hash, uint32_t imageSize) const;
+};
+
+/**
+ * @brief Target of a firmware update. Writes are issued in ascending order at block aligned offsets, each write
+ *  except the last one covers exactly FIRMWARE_BLOCK_SIZE bytes. The progress is saved after every block so an
+ *  interrupted update can continue at the saved offset.
+ */
+class IFirmwareStorage
+{
+public:
+    /* Prepare the storage for an image of the given size, the data before resumeOffset is kept */
+    virtual bool Begin(uint32_t imageSize, uint32_t resumeOffset) = 0;
+    virtual bool Write(uint32_t offset, const unsigned char* data, unsigned int length) = 0;
+    virtual bool Read(uint32_t offset, unsigned char* buffer, unsigned int length) = 0;
+
+    /* The image is complete and verified, make it the active one */
+    virtual bool Finalize() = 0;
+    virtual void Abort() = 0;
+
+    virtual bool LoadProgress(FirmwareProgress& progress) = 0;
+    virtual bool SaveProgress(const FirmwareProgress& progress) = 0;
+    virtual void ClearProgress() = 0;
+};
+
+/**
+ * @brief Stores the image in a file and the progress in a second file next to it ("<path>.progress").
+ *  Works on every target with stdio file support (a mounted LittleFS/SPIFFS on the esp32 or a regular
+ *  file system on a host), so transfer and resume can be tested without flashing the device.
+ */
+class FileFirmwareStorage : public IFirmwareStorage
+{
+public:
+    FileFirmwareStorage(const char* path);
+    ~FileFirmwareStorage();
+
+    bool Begin(uint32_t imageSize, uint32_t resumeOffset) override;
+    bool Write(uint32_t offset, const unsigned char* data, unsigned int length) override;
+    bool Read(uint32_t offset, unsigned char* buffer, unsigned int length) override;
+    bool Finalize() override;
+    void Abort() override;
+
+    bool LoadProgress(FirmwareProgress& progress) override;
+    bool SaveProgress(const FirmwareProgress& progress) override;
+    void ClearProgress() override;
+
+private:
+    String path;
+    String progressPath;
+    FILE* file;
+
+    void close();
+};
+
+#ifdef ESP32
+
+/**
+ * @brief Writes the image into the next ota partition and switches the boot partition on Finalize().
+ *  The progress is kept in the nvs (namespace "ota").
+ */
+class PartitionFirmwareStorage : public IFirmwareStorage
+{
+public:
+    PartitionFirmwareStorage();
+
+    bool Begin(uint32_t imageSize, uint32_t resumeOffset) override;
+    bool Write(uint32_t offset, const unsigned char* data, unsigned int length) override;
+    bool Read(uint32_t offset, unsigned char* buffer, unsigned int length) override;
+    bool Finalize() override;
+    void Abort() override;
+
+    bool LoadProgress(FirmwareProgress& progress) override;
+    bool SaveProgress(const FirmwareProgress& progress) override;
+    void ClearProgress() override;
+
+private:
+    const esp_partition_t* partition;
+    Preferences preferences;
+};
+
+#endif
+
+#endif
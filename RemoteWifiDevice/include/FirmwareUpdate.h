@@ -0,0 +1,157 @@
+#ifndef FIRMWARE_UPDATE_H
+#define FIRMWARE_UPDATE_H
+
+#include <Arduino.h>
+#include "TransmissionControl.h"
+#include "FirmwareStorage.h"
+#include "Checksum.h"
+#include "Base64.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/pk.h"
+
+#ifdef ESP32
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#endif
+
+/*   Update Sequence (all messages are encrypted):
+ *
+ *      1. server -> device: "ota:begin:<image size>:<sha-256 of the image, hex>:<signature, base64>"
+ *                           the signature is the rsa pkcs#1 v1.5 signature of the sha-256 with the private key of
+ *                           the firmware, an update with an invalid signature is rejected before any data is written
+ *      2. device -> server: "ota:ready:<offset>" - the offset to continue from (0 or the offset of an interrupted update)
+ *      3. server -> device: one stream with the image data from <offset> to the end, every fragment payload
+ *                           is a chunk of the image (up to FIRMWARE_CHUNK_SIZE bytes) followed by the crc-32 of
+ *                           the chunk (4 bytes, little endian)
+ *      4. device -> server: "ota:done" after the stored image was read back, its hash and the signature were
+ *                           verified with the public key of the firmware and the boot partition was switched,
+ *                           or "ota:error:<reason>:<offset>" at any time - the update can be continued with a new
+ *                           "ota:begin" and the same image
+ *
+ *   "ota:abort" from the server cancels a running update (the progress is kept).
+ */
+
+#define FIRMWARE_CHUNK_CRC_SIZE 4
+#define FIRMWARE_CHUNK_SIZE (FRAGMENT_PAYLOAD_SIZE - FIRMWARE_CHUNK_CRC_SIZE)
+// one block is received while the other one is written to the flash
+#define FIRMWARE_WRITE_BUFFERS 2
+#define FIRMWARE_WRITER_STACK_SIZE 4096
+#define FIRMWARE_WRITER_PRIORITY 1
+// bytes of the stored image which are read back and hashed per call of OnLoop, the verification does not block the loop
+#define FIRMWARE_VERIFY_CHUNK_SIZE FIRMWARE_BLOCK_SIZE
+// largest signature (4096 bit key)
+#define FIRMWARE_SIGNATURE_MAX 512
+#define FIRMWARE_DIGEST_SIZE 32
+// "ota:begin:" with the image size, the hash and the signature of the largest key, the payload has to hold it
+#define FIRMWARE_BEGIN_COMMAND_MAX (10 + 10 + 1 + FIRMWARE_HASH_HEX_LENGTH + 1 + BASE64_ENCODED_LENGTH(FIRMWARE_SIGNATURE_MAX))
+
+static_assert(FIRMWARE_DIGEST_SIZE * 2 == FIRMWARE_HASH_HEX_LENGTH, "the announced hash is the hex of a sha-256");
+
+#define FIRMWARE_READY_RESPONSE "ota:ready:"
+#define FIRMWARE_DONE_RESPONSE "ota:done"
+#define FIRMWARE_ERROR_RESPONSE "ota:error:"
+
+/**
+ * @brief Receives a firmware image over the stream of a TransmissionControl and writes it to a storage.
+ *  The stream callbacks of the application interface have to be forwarded to this class and OnLoop has to be
+ *  called from the loop. On the esp32 the blocks are written by a separate task, so the next block is received
+ *  while the flash is busy. The progress is shared with this task and guarded by a mutex.
+ *
+ *  Only images signed with the private key of the firmware are accepted, the public key (pem) is passed to Begin.
+ *  The update is a build option of the firmware (-DFIRMWARE_UPDATE, see platformio.ini).
+ */
+class FirmwareUpdate : private ICommandHandler
+{
+public:
+    FirmwareUpdate();
+    ~FirmwareUpdate();
+
+    /**
+     * @brief Registers the update commands at the controller. Returns false (and no command is registered) if the
+     *  public key is not a valid rsa key in pem format
+     */
+    bool Begin(TransmissionControl* controller, IFirmwareStorage* storage, const char* publicKey);
+
+    /* Verifies the received image in steps of FIRMWARE_VERIFY_CHUNK_SIZE bytes */
+    void OnLoop();
+
+    /* An update was started and the image is not verified yet */
+    bool IsActive() const;
+    /* The new image is active after a restart */
+    bool IsRestartPending() const;
+
+    /**
+     * @brief Returns true if the data belongs to the update (then it must not be processed by the application)
+     */
+    bool OnStreamData(uint16_t streamID, uint32_t offset, const unsigned char* data, unsigned int length, uint32_t totalLength, bool last);
+    bool OnStreamAborted(uint16_t streamID);
+    void OnClientDisconnected();
+
+private:
+    enum UpdateState { US_IDLE, US_RECEIVING, US_VERIFYING, US_RESTART_PENDING };
+
+    class WriteBuffer
+    {
+    public:
+        uint32_t offset;
+        unsigned int length;
+        unsigned char data[FIRMWARE_BLOCK_SIZE];
+    };
+
+    TransmissionControl* controller;
+    IFirmwareStorage* storage;
+    UpdateState state;
+    mbedtls_pk_context publicKey;
+    bool publicKeyLoaded;
+
+    // the offset is written by the writer task, it is read with getProgressOffset() while the writer runs
+    FirmwareProgress progress;
+    uint32_t receivedOffset;
+    uint16_t streamID;
+    bool streamBound;
+
+    WriteBuffer* buffers;
+    WriteBuffer* fillBuffer;
+    volatile bool writeFailed;
+
+    unsigned char signature[FIRMWARE_SIGNATURE_MAX];
+    size_t signatureLength;
+    mbedtls_sha256_context hash;
+    uint32_t verifiedOffset;
+
+#ifdef ESP32
+    SemaphoreHandle_t progressLock;
+    QueueHandle_t freeBuffers;
+    QueueHandle_t filledBuffers;
+    TaskHandle_t writerTask;
+
+    static void writerTaskMain(void* parameter);
+#endif
+
+    void OnCommand(uint32_t commandID, const CommandArguments& arguments) override;
+
+    void start(const CommandArguments& arguments);
+    void complete();
+    void finish(const unsigned char* digest);
+    void stop();
+    void fail(const char* reason);
+    void reply(const String& data);
+
+    bool allocateBuffers();
+    void releaseBuffers();
+    WriteBuffer* acquireBuffer();
+    void submitBuffer(WriteBuffer* buffer);
+    bool flushBuffers();
+    bool writeBlock(WriteBuffer* buffer);
+
+    void lockProgress();
+    void unlockProgress();
+    uint32_t getProgressOffset();
+    void resetProgressOffset();
+
+    bool verifySignature(const unsigned char* digest);
+};
+
+#endif
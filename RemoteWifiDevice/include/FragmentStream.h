@@ -0,0 +1,114 @@
+#ifndef FRAGMENT_STREAM_H
+#define FRAGMENT_STREAM_H
+
+#include <Arduino.h>
+
+/*   Fragment Layout (inside the aes encrypted data, little endian):
+ *
+ *      1. Marker (1 byte, 0xB2)
+ *      2. Flags (1 byte, first / last fragment)
+ *      3. Stream ID (2 bytes)
+ *      4. Sequence (2 bytes, index of the fragment in the stream)
+ *      5. Total Length (4 bytes, length of the complete message)
+ *      6. Payload Length (2 bytes)
+ *      7. Payload (? bytes)
+ *
+ *   Every fragment is a regular encrypted DATA package, so it is confirmed and resent like any other package.
+ *   A fragment with the abort flag and without payload tells the receiver that the sender gave up the stream.
+ */
+
+#define FRAGMENT_MARKER 0xB2
+#define FRAGMENT_HEADER_SIZE 12
+// the payload + header must fit into the receive buffer of the decryption, including the block padding
+#define FRAGMENT_PAYLOAD_SIZE 960
+// number of fragments of the outgoing stream which may wait in the transmission queue
+#define FRAGMENT_QUEUE_WINDOW 2
+#define FRAGMENT_MAX_INBOUND_STREAMS 2
+// an inbound stream without a fragment for this time is aborted and its slot is freed (ms)
+#ifndef FRAGMENT_INBOUND_IDLE_TIMEOUT
+#define FRAGMENT_INBOUND_IDLE_TIMEOUT 30000
+#endif
+
+#define FRAGMENT_FLAG_FIRST 0x01
+#define FRAGMENT_FLAG_LAST 0x02
+#define FRAGMENT_FLAG_ABORT 0x04
+
+class FragmentHeader
+{
+public:
+    FragmentHeader();
+
+    uint8_t flags;
+    uint16_t streamID;
+    uint16_t sequence;
+    uint32_t totalLength;
+    uint16_t payloadLength;
+
+    void Write(unsigned char* buffer) const;
+
+    /**
+     * @brief Reads and validates the header, returns false if the data is not a valid fragment
+     */
+    bool Read(const unsigned char* data, unsigned int length);
+
+    static bool IsFragment(const unsigned char* data, unsigned int length);
+};
+
+/**
+ * @brief Provides the data of an outgoing stream. The source is pulled whenever there is room in the
+ *  transmission queue, so only a few fragments of the message are held in memory at a time.
+ */
+class IStreamSource
+{
+public:
+    /* Copy the next bytes of the message into the buffer, return the number of bytes (0 = no data available) */
+    virtual unsigned int Read(unsigned char* buffer, unsigned int size) = 0;
+    virtual void OnStreamComplete(uint16_t streamID, bool success) {}
+};
+
+/**
+ * @brief Tracks the position of inbound streams. Fragments are delivered by the transport in order, a gap in the
+ *  sequence means that the peer dropped a fragment after its retries and the stream is aborted. A stream also ends
+ *  with an abort fragment of the peer or when it was idle for FRAGMENT_INBOUND_IDLE_TIMEOUT (see ExpireIdle).
+ */
+class StreamReassembler
+{
+public:
+    StreamReassembler();
+
+    enum FragmentResult { FR_ACCEPTED, FR_ABORTED, FR_IGNORED };
+
+    /**
+     * @brief Registers the fragment. If it is accepted, offset receives the position of the payload in the message
+     */
+    FragmentResult Accept(const FragmentHeader& header, uint32_t& offset);
+
+    /**
+     * @brief Frees the slot of one stream which is idle for FRAGMENT_INBOUND_IDLE_TIMEOUT. Returns false if there
+     *  is none, call it until it returns false to expire all of them
+     */
+    bool ExpireIdle(unsigned long now, uint16_t& streamID);
+
+    void Reset();
+
+private:
+    class InboundStream
+    {
+    public:
+        InboundStream();
+
+        bool active;
+        uint16_t streamID;
+        uint16_t nextSequence;
+        uint32_t offset;
+        uint32_t totalLength;
+        unsigned long lastActivity;
+    };
+
+    InboundStream streams[FRAGMENT_MAX_INBOUND_STREAMS];
+
+    InboundStream* find(uint16_t streamID);
+    InboundStream* allocate();
+};
+
+#endif
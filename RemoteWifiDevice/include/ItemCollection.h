@@ -255,7 +255,7 @@ public:
 
                     // delete old
                     delete this->_Items[index];
-                    delete this->_Items;
+                    delete[] this->_Items;
 
                     // create new
                     this->_Items = new T *[itemCount - ((unsigned int)1)];
@@ -0,0 +1,89 @@
+#ifndef LINK_ESTIMATOR_H
+#define LINK_ESTIMATOR_H
+
+#include <Arduino.h>
+#include "TransmissionProfile.h"
+
+// number of probes the loss is measured over
+#define LINK_PROBE_HISTORY 32
+#define LINK_SNAPSHOT_VERSION "l1"
+
+/**
+ * @brief Estimate of the round trip time, jitter and loss of the current session. Round trip samples come from
+ *  probe replies and from confirmations of packages which were sent only once (Karn's rule):
+ *
+ *      srtt    smoothed rtt, srtt += (rtt - srtt) / 8                           (RFC 6298)
+ *      rttvar  mean deviation, rttvar += (|srtt - rtt| - rttvar) / 4
+ *      jitter  mean difference of successive samples, jitter += (|d| - jitter) / 16   (RFC 3550)
+ *      rto     srtt + max(1 ms, 4 * rttvar), within the bounds of the profile
+ *
+ *  The loss is the share of the last LINK_PROBE_HISTORY probes which were not answered within twice the rto.
+ *  All times are in microseconds except the rto, which is in milliseconds like the other protocol timers.
+ */
+class LinkEstimator
+{
+public:
+    LinkEstimator();
+
+    void Reset();
+
+    /* Add a round trip sample (us) */
+    void AddSample(uint32_t rtt);
+
+    /* Register a probe which is sent now, returns its sequence number */
+    uint16_t OnProbeSent(uint32_t now);
+    /**
+     * @brief Take the sample of a probe reply. Returns false if the probe is unknown, was answered already or was
+     *  counted as lost, the reply is ignored then
+     */
+    bool OnProbeReply(uint16_t sequence, uint32_t sentTime, uint32_t now);
+    /* Count the probes which were not answered in time as lost, returns the number of new losses */
+    unsigned int ExpireProbes(uint32_t now);
+
+    bool HasSamples() const;
+    unsigned long GetSampleCount() const;
+    uint32_t GetLatestRTT() const;
+    uint32_t GetSmoothedRTT() const;
+    uint32_t GetRTTVariation() const;
+    uint32_t GetMinRTT() const;
+    uint32_t GetJitter() const;
+
+    unsigned long GetProbesSent() const;
+    unsigned long GetProbesLost() const;
+    /* Loss of the recent probes in permille (0 until a probe was answered or lost) */
+    unsigned int GetLossPermille() const;
+
+    /* Retransmission timeout (ms), the initial rto of the profile until the first sample */
+    uint32_t GetRetransmissionTimeout() const;
+
+    /* "l1:<srtt>,<rttvar>,<min>,<jitter>,<samples>,<probes sent>,<probes lost>,<loss permille>,<rto>" (hex) */
+    String ToSnapshotString() const;
+
+private:
+    enum ProbeState { PS_FREE, PS_PENDING, PS_ANSWERED, PS_LOST };
+
+    class ProbeRecord
+    {
+    public:
+        ProbeRecord();
+
+        uint16_t sequence;
+        uint32_t sentTime;
+        ProbeState state;
+    };
+
+    unsigned long samples;
+    uint32_t latestRTT;
+    uint32_t smoothedRTT;
+    uint32_t rttVariation;
+    uint32_t minRTT;
+    uint32_t jitter;
+
+    ProbeRecord probes[LINK_PROBE_HISTORY];
+    uint16_t probeSequence;
+    unsigned int pendingProbes;
+    unsigned long probesSent;
+    unsigned long probesLost;
+};
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef LINK_SIMULATOR_H
+#define LINK_SIMULATOR_H
+
+#include "TransmissionControl.h"
+
+#define LINK_NOISE_MAX 32
+
+/*
+    Impairment settings of one link direction, probabilities are given in permille
+*/
+class LinkImpairments
+{
+public:
+    LinkImpairments();
+
+    unsigned int lossPermille;
+    unsigned int duplicatePermille;
+    unsigned int reorderPermille;
+    unsigned int splitPermille;
+    // one byte of the frame is replaced by a random character
+    unsigned int corruptPermille;
+    // up to LINK_NOISE_MAX random characters are inserted in front of the frame
+    unsigned int noisePermille;
+    unsigned long latency;      // ms
+    unsigned long jitter;       // ms, added uniformly distributed on top of the latency
+};
+
+class LinkStatistics
+{
+public:
+    LinkStatistics();
+
+    unsigned long frames;
+    unsigned long lost;
+    unsigned long duplicated;
+    unsigned long reordered;
+    unsigned long split;
+    unsigned long corrupted;
+    unsigned long noise;
+    unsigned long delivered;
+};
+
+/**
+ * @brief Deterministic lossy link between a TransmissionControl and its transport. The simulator is set as the
+ *  interface of the controller and forwards to the real interface, so it can be inserted without changes on
+ *  either side:
+ *
+ *      simulator.SetController(controller);
+ *      simulator.SetInterface(handler);
+ *      controller->SetInterface(&simulator);
+ *
+ *  Outgoing frames (OutGateway) are impaired and then forwarded to handler->OutGateway, incoming data passed
+ *  to Receive(...) is impaired and then forwarded to controller->OnDataReceived. The same seed always produces
+ *  the same impairment sequence. Delayed frames are released in OnLoop().
+ */
+class LinkSimulator : public ITransmissionControlInterface
+{
+public:
+    LinkSimulator(uint32_t seed);
+
+    void SetController(TransmissionControl* controller);
+    void SetInterface(ITransmissionControlInterface* _interface);
+
+    void SetOutgoingImpairments(const LinkImpairments& impairments);
+    void SetIncomingImpairments(const LinkImpairments& impairments);
+
+    const LinkStatistics& GetOutgoingStatistics() const;
+    const LinkStatistics& GetIncomingStatistics() const;
+
+    /* Data received from the transport, to be delivered to the controller */
+    void Receive(const String& data);
+
+    void OnLoop();
+
+    void OutGateway(const String& data) override;
+    void OnDataDecoded(const ByteSpan& data) override;
+    void OnUnencryptedDataReceived(const ByteSpan& data) override;
+    void OnRecordDecoded(TLVReader& record) override;
+    void OnStreamData(uint16_t streamID, uint32_t offset, const unsigned char* data, unsigned int length, uint32_t totalLength, bool last) override;
+    void OnStreamAborted(uint16_t streamID) override;
+
+private:
+    enum LinkDirection { LD_OUTGOING, LD_INCOMING };
+
+    class SimulatedFrame
+    {
+    public:
+        SimulatedFrame();
+
+        String data;
+        unsigned long dueTime;
+        LinkDirection direction;
+    };
+
+    TransmissionControl* controller;
+    ITransmissionControlInterface* interface;
+
+    LinkImpairments impairments[2];
+    LinkStatistics statistics[2];
+
+    itemCollection<SimulatedFrame> pendingFrames;
+    uint32_t randomState;
+
+    void impair(const String& data, LinkDirection direction);
+    void schedule(const String& data, LinkDirection direction, unsigned long delay);
+    char randomCharacter();
+    void deliver(const String& data, LinkDirection direction);
+    bool chance(unsigned int permille);
+    uint32_t nextRandom();
+};
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef LOAD_GENERATOR_H
+#define LOAD_GENERATOR_H
+
+#include <WiFi.h>
+#include "TransmissionControl.h"
+
+// sessions of one load generator, lwip on the esp32 allows 10 sockets by default (CONFIG_LWIP_MAX_SOCKETS),
+// the host load generator (host/loadgen) raises it with -DLOAD_GENERATOR_MAX_SESSIONS=x
+#ifndef LOAD_GENERATOR_MAX_SESSIONS
+#define LOAD_GENERATOR_MAX_SESSIONS 8
+#endif
+
+class LoadGeneratorConfig
+{
+public:
+    LoadGeneratorConfig();
+
+    unsigned int sessionCount;
+    unsigned long messageInterval;  // ms between two messages of one session
+    unsigned int payloadSize;       // bytes per message
+    bool encrypt;
+    unsigned int churnPermille;     // chance per message interval that a session reconnects
+    unsigned long reportInterval;   // ms, 0 = no report
+    unsigned int firstSession;      // index of the first session, for several generators against one server
+};
+
+/*
+    Counters of all sessions of a load generator
+*/
+class LoadGeneratorTotals
+{
+public:
+    LoadGeneratorTotals();
+
+    unsigned int sessions;
+    unsigned int connected;
+    unsigned long messages;
+    unsigned long framesOut;
+    unsigned long bytesOut;
+    unsigned long retransmissions;
+    unsigned long drops;
+    unsigned long reconnects;
+    LatencyHistogram ackRTT;
+
+    void Add(const LoadGeneratorTotals& other);
+};
+
+/**
+ * @brief One emulated remote device: its own tcp connection, TransmissionControl and handshake,
+ *  answering 'get-name' and 'rq:status' like the regular firmware
+ */
+class VirtualDevice : public ITransmissionControlInterface
+{
+public:
+    VirtualDevice();
+
+    void Begin(unsigned int index, const IPAddress& host, uint16_t port, unsigned long startDelay);
+    void OnLoop(const LoadGeneratorConfig& config, const String& payload);
+
+    bool IsConnected();
+    const TransmissionMetrics& GetMetrics() const;
+    unsigned long GetReconnects() const;
+    unsigned long GetMessagesSent() const;
+
+    void OutGateway(const String& data) override;
+    void OnDataDecoded(const ByteSpan& data) override;
+    void OnUnencryptedDataReceived(const ByteSpan& data) override;
+
+private:
+    WiFiClient client;
+    TransmissionControl control;
+    IPAddress host;
+    uint16_t port;
+
+    unsigned long messageTimer;
+    unsigned long connectTimer;
+    unsigned long reconnects;
+    unsigned long messagesSent;
+
+    void connect();
+    void receive();
+};
+
+/**
+ * @brief Drives several virtual devices from one board against a server and periodically
+ *  prints throughput and acknowledge latency percentiles to the serial output
+ */
+class LoadGenerator
+{
+public:
+    LoadGenerator();
+
+    void Begin(const IPAddress& host, uint16_t port, const LoadGeneratorConfig& config);
+    void OnLoop();
+
+    /* Sums up the counters of the sessions, must be called from the thread which runs OnLoop() */
+    void GetTotals(LoadGeneratorTotals& totals);
+
+private:
+    VirtualDevice sessions[LOAD_GENERATOR_MAX_SESSIONS];
+    LoadGeneratorConfig config;
+    String payload;
+
+    unsigned long reportTimer;
+    unsigned long lastFramesOut;
+    unsigned long lastBytesOut;
+    unsigned long lastMessages;
+
+    void report();
+};
+
+#endif
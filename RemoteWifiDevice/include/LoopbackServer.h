@@ -0,0 +1,125 @@
+#ifndef LOOPBACK_SERVER_H
+#define LOOPBACK_SERVER_H
+
+#include "TransmissionControl.h"
+#include "RpcEndpoint.h"
+
+// rounds of the loop of the controller per pump, a session step needs only a few
+#define LOOPBACK_PUMP_ROUNDS 64
+// largest payload of SendData, one block below the decryption buffer of the controller
+#define LOOPBACK_PAYLOAD_MAX (transmissionProfile.payloadMax - 16)
+
+class LinkSimulator;
+
+/**
+ * @brief The server side of the protocol in-process: sends the rsa key, decrypts and confirms the aes key, confirms
+ *  the packages of the controller and sends encrypted data to it. With SetCallEcho(true) the rpc requests of the
+ *  controller (see RpcEndpoint.h) are answered with their arguments. It is set as the interface of the controller and
+ *  forwards the decoded data to the real interface, like the LinkSimulator:
+ *
+ *      server.SetController(&controller);
+ *      server.SetInterface(&handler);
+ *      controller.SetInterface(&server);
+ *
+ *      server.Handshake();
+ *      server.SendData("...");
+ *      controller.SendData("...", true);
+ *      server.Pump();
+ *      server.EndSession();
+ *
+ *  Frames of the controller are collected and processed in Pump(), so the server never calls back into the
+ *  controller while it is sending.
+ *
+ *  Both directions can run over a LinkSimulator: it is set as the interface of the controller with the server as
+ *  its interface, and SetLink(...) sends the frames of the server through its incoming direction. Delayed frames
+ *  are then delivered in LinkSimulator::OnLoop() and processed in the next Pump().
+ */
+class LoopbackServer : public ITransmissionControlInterface
+{
+public:
+    LoopbackServer();
+    ~LoopbackServer();
+
+    /* Generates the key of the server (2048 bits take several seconds on an esp32) */
+    bool Begin(unsigned int rsaBits);
+
+    void SetController(TransmissionControl* controller);
+    void SetInterface(ITransmissionControlInterface* _interface);
+    /* Send the frames to the controller through the link simulator (nullptr = directly) */
+    void SetLink(LinkSimulator* _link);
+    /* Decrypt the data packages of the controller and answer its rpc requests */
+    void SetCallEcho(bool enabled);
+    /**
+     * @brief Receives the decrypted data packages of the controller, the server side view of the session (nullptr
+     *  = none). The span is zero padded to the aes block size, fragments carry their length in the header
+     */
+    void SetReceiver(ITransmissionControlInterface* _receiver);
+
+    /* Connect the controller and run the key exchange, returns true if the server has the aes key of the session */
+    bool Handshake();
+    /* Disconnect the controller, frames which were not processed are discarded */
+    void EndSession();
+
+    /* Send an encrypted data package to the controller (delivered in the call) */
+    bool SendData(const String& data);
+    /**
+     * @brief Send a credit of the server to the controller, it limits the data packages of the controller. The
+     *  credit is sent again when the controller asks for the window
+     */
+    void SendCredit(uint32_t bytes, uint16_t packages);
+
+    /* Process the frames of the controller until it has nothing more to send */
+    void Pump();
+
+    bool HasSessionKey() const;
+    /* Encrypted data packages received from the controller */
+    unsigned long GetReceivedCount() const;
+    /* Frames of the controller which could not be parsed */
+    unsigned long GetErrorCount() const;
+    /* Rpc requests of the controller which were answered */
+    unsigned long GetAnsweredCount() const;
+    /* Window probes of the controller (credits with the data TRANSMISSION_CREDIT_PROBE) */
+    unsigned long GetWindowProbeCount() const;
+
+    void OutGateway(const String& data) override;
+    void OnDataDecoded(const ByteSpan& data) override;
+    void OnUnencryptedDataReceived(const ByteSpan& data) override;
+    void OnRecordDecoded(TLVReader& record) override;
+
+private:
+    TransmissionControl* controller;
+    ITransmissionControlInterface* interface;
+    ITransmissionControlInterface* receiver;
+    LinkSimulator* link;
+
+    mbedtls_pk_context serverKey;
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context random;
+    mbedtls_aes_context aes;
+    String publicKey;
+    unsigned char sessionKey[transmissionProfile.aesKeyBits / 8];
+    bool sessionKeyReceived;
+    unsigned int transmissionID;
+
+    unsigned long receivedCount;
+    unsigned long errorCount;
+    unsigned long answeredCount;
+    unsigned long windowProbeCount;
+    bool callEcho;
+    // the last credit of this session, the answer to a window probe
+    bool creditSent;
+    uint32_t creditBytes;
+    uint16_t creditPackages;
+
+    // frames of the controller which were not processed yet
+    itemCollection<String> outgoing;
+
+    void sendRSAKey();
+    void receive(const String& frame);
+    bool decrypt(const TransmissionPackage& package, unsigned char* block, size_t& length);
+    void answerCalls(const String& batch);
+    unsigned int nextTransmissionID();
+    void sendToController(const String& frame);
+};
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef MEMORY_MONITOR_H
+#define MEMORY_MONITOR_H
+
+#include <Arduino.h>
+#include <atomic>
+
+#define MEMORY_SNAPSHOT_VERSION "h1"
+
+// number of tasks whose stack high-water mark is reported
+#ifndef MEMORY_MONITOR_TASKS
+#define MEMORY_MONITOR_TASKS 4
+#endif
+
+/*
+    Code paths whose allocations are counted separately. Sites can be nested, allocations are counted for the
+    innermost site, the retained bytes of a site include its nested sites
+*/
+enum MemorySite
+{
+    MS_OTHER,
+    MS_HANDSHAKE,
+    MS_RECEIVE,
+    MS_DECRYPT,
+    MS_SEND,
+    MS_ENCRYPT,
+    MS_DELIVERY,
+    MS_SITE_COUNT
+};
+
+class MemorySiteCounters
+{
+public:
+    MemorySiteCounters();
+
+    unsigned long calls;
+    unsigned long allocations;
+    unsigned long releases;
+    unsigned long allocatedBytes;
+    // bytes which were still allocated when the site was left (negative if the site released older memory)
+    long retainedBytes;
+
+    void Reset();
+};
+
+class MemorySnapshot
+{
+public:
+    MemorySnapshot();
+
+    // heap of the platform (0 where the platform does not report it)
+    size_t heapSize;
+    size_t freeHeap;
+    size_t minimumFreeHeap;
+    size_t largestFreeBlock;
+
+    // counted by the allocation hooks (0 if no allocator is hooked)
+    unsigned long allocations;
+    unsigned long releases;
+    size_t trackedBytes;
+    size_t trackedPeak;
+};
+
+/**
+ * @brief Process wide memory instrumentation: heap usage and fragmentation of the platform, stack high-water marks
+ *  of registered tasks and allocation counters per code path. The counters are fed by allocator hooks: on the esp32
+ *  and the host malloc/free are wrapped at link time if MEMORY_MONITOR_WRAP_MALLOC is defined (see the soak and
+ *  native-bench environments in platformio.ini), other builds can call OnAllocate/OnRelease from their own
+ *  allocator. Without hooks the snapshot only contains the platform values.
+ *
+ *  The code paths are marked with MEMORY_SITE(site), which compiles to nothing unless MEMORY_MONITOR is defined.
+ */
+class MemoryMonitor
+{
+public:
+    static void GetSnapshot(MemorySnapshot& snapshot);
+
+    /**
+     * @brief Report the stack high-water mark of a task (a TaskHandle_t, nullptr for the calling task). Returns
+     *  false if MEMORY_MONITOR_TASKS tasks are registered already
+     */
+    static bool WatchTask(const char* name, void* task);
+    static unsigned int GetTaskCount();
+    static const char* GetTaskName(unsigned int index);
+    /* Stack bytes of the task which were never used (0 on platforms without the information) */
+    static size_t GetStackHighWaterMark(unsigned int index);
+
+    static const MemorySiteCounters& GetSiteCounters(MemorySite site);
+    static void ResetSiteCounters();
+
+    /* Compact text form for the 'rq:memory' request, values in hex like the metrics snapshot */
+    static String ToSnapshotString();
+
+    // allocator hooks, the size is the usable size of the block
+    static void OnAllocate(size_t size);
+    static void OnRelease(size_t size);
+
+    // used by MemorySiteScope
+    static MemorySite EnterSite(MemorySite site, size_t& trackedAtEntry);
+    static void LeaveSite(MemorySite previous, size_t trackedAtEntry);
+};
+
+class MemorySiteScope
+{
+public:
+    MemorySiteScope(MemorySite site);
+    ~MemorySiteScope();
+
+private:
+    MemorySite previous;
+    size_t trackedAtEntry;
+};
+
+#ifdef MEMORY_MONITOR
+#define MEMORY_SITE(site) MemorySiteScope memorySiteScope(site)
+#else
+#define MEMORY_SITE(site) do {} while(0)
+#endif
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef MEMORY_SOAK_H
+#define MEMORY_SOAK_H
+
+#include "TransmissionControl.h"
+#include "MemoryMonitor.h"
+#include "LoopbackServer.h"
+
+// key size of the simulated server, the key is generated once in Begin (2048 bits take several seconds on an esp32)
+#ifndef MEMORY_SOAK_RSA_BITS
+#define MEMORY_SOAK_RSA_BITS 1024
+#endif
+// number of memory samples kept for the trend, older samples are merged pairwise when the table is full
+#define MEMORY_SOAK_SAMPLES 128
+
+class MemorySoakConfig
+{
+public:
+    MemorySoakConfig();
+
+    unsigned long cycles;           // sessions (connect, handshake, messages, disconnect)
+    unsigned int messagesPerCycle;  // encrypted messages in each direction per session
+    unsigned int payloadSize;
+    unsigned long warmupCycles;     // not sampled, pools and caches fill up during the first sessions
+    unsigned long sampleInterval;   // cycles between two samples
+    long growthLimit;               // bytes the trend may rise over the sampled cycles
+};
+
+class MemorySoakResult
+{
+public:
+    MemorySoakResult();
+
+    unsigned long cycles;
+    unsigned long handshakes;
+    unsigned long messagesSent;
+    unsigned long messagesReceived;
+    unsigned long errors;
+
+    // used memory at the first and last sample and the rise of the least squares line between them
+    long firstSample;
+    long lastSample;
+    long trend;
+
+    bool passed;
+};
+
+/**
+ * @brief Long-run memory test of TransmissionControl. The soak runs complete sessions (handshake, encrypted data in
+ *  both directions) between a controller and a LoopbackServer until the configured number of cycles is reached.
+ *  The used memory is sampled after every few sessions, the run fails if the least squares trend of the samples
+ *  rises by more than the growth limit:
+ *
+ *      MemorySoak soak;
+ *      soak.Begin(config);
+ *      while(soak.RunCycle()) {}
+ *      soak.GetResult().passed
+ *
+ *  The used memory is taken from the allocation hooks of the MemoryMonitor if they are active, otherwise from the
+ *  free heap of the platform.
+ */
+class MemorySoak : public ITransmissionControlInterface
+{
+public:
+    MemorySoak();
+
+    bool Begin(const MemorySoakConfig& config);
+
+    /* Run one session, returns false once all cycles are done */
+    bool RunCycle();
+
+    const MemorySoakResult& GetResult() const;
+    void PrintResult(Print& output) const;
+
+    // application interface of the controller under test
+    void OutGateway(const String& data) override;
+    void OnDataDecoded(const ByteSpan& data) override;
+
+private:
+    TransmissionControl control;
+    LoopbackServer server;
+    MemorySoakConfig config;
+    MemorySoakResult result;
+    String payload;
+
+    long samples[MEMORY_SOAK_SAMPLES];
+    unsigned int sampleCount;
+    unsigned long sampleStride;      // cycles between two entries of the sample table
+
+    void sample();
+    long usedMemory() const;
+    long computeTrend() const;
+};
+
+#endif
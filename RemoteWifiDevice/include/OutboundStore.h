@@ -0,0 +1,82 @@
+#ifndef OUTBOUND_STORE_H
+#define OUTBOUND_STORE_H
+
+#include <Arduino.h>
+#include <stdio.h>
+
+#define OUTBOUND_RECORD_HEADER_SIZE 4
+// flags of a stored message
+#define OUTBOUND_FLAG_ENCRYPT 0x01
+#define OUTBOUND_FLAG_PRIORITY_MASK 0x06
+#define OUTBOUND_FLAG_PRIORITY_SHIFT 1
+
+/**
+ * @brief Persistent first-in first-out log of application messages. The messages are stored as given by the
+ *  application (before the encryption), so they can be sent in a later session with the key of that session.
+ *  If a message does not fit, the oldest messages are evicted.
+ */
+class IOutboundStore
+{
+public:
+    virtual bool Append(const unsigned char* data, unsigned int length, uint8_t flags) = 0;
+
+    /**
+     * @brief Copy the oldest message into the buffer. Returns the length of the message (0 = the store is empty
+     *  or the buffer is too small)
+     */
+    virtual unsigned int Peek(unsigned char* buffer, unsigned int size, uint8_t& flags) = 0;
+
+    /* Remove the oldest message */
+    virtual bool Pop() = 0;
+
+    virtual unsigned int GetCount() const = 0;
+    virtual uint32_t GetUsedBytes() const = 0;
+    /* Number of messages which were dropped to make room for new ones */
+    virtual unsigned long GetEvicted() const = 0;
+};
+
+/**
+ * @brief Ring buffer of a fixed capacity in a file (a path on a mounted LittleFS/SPIFFS on the esp32, or a regular
+ *  file on a host). The file starts with a header which holds the position of the oldest message, it is written
+ *  after every change, so the log survives a reset.
+ *
+ *   Record Layout: length (2 bytes, little endian), flags (1 byte), reserved (1 byte), data (? bytes)
+ */
+class FileOutboundStore : public IOutboundStore
+{
+public:
+    FileOutboundStore(const char* path, uint32_t capacity);
+    ~FileOutboundStore();
+
+    /**
+     * @brief Open the log (an existing log with the same capacity is continued). Returns false if the file cannot be created
+     */
+    bool Begin();
+
+    bool Append(const unsigned char* data, unsigned int length, uint8_t flags) override;
+    unsigned int Peek(unsigned char* buffer, unsigned int size, uint8_t& flags) override;
+    bool Pop() override;
+
+    unsigned int GetCount() const override;
+    uint32_t GetUsedBytes() const override;
+    unsigned long GetEvicted() const override;
+
+private:
+    String path;
+    FILE* file;
+
+    uint32_t capacity;
+    uint32_t head;      // ring position of the oldest record
+    uint32_t used;      // bytes of all records
+    unsigned int count;
+    unsigned long evicted;
+
+    bool readHeader();
+    bool writeHeader();
+    bool readRing(uint32_t position, unsigned char* buffer, unsigned int length);
+    bool writeRing(uint32_t position, const unsigned char* data, unsigned int length);
+    bool readRecordHeader(uint32_t position, unsigned int& length, uint8_t& flags);
+    bool dropOldest();
+};
+
+#endif
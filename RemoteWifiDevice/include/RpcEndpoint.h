@@ -0,0 +1,161 @@
+#ifndef RPC_ENDPOINT_H
+#define RPC_ENDPOINT_H
+
+#include <Arduino.h>
+#include "TransmissionControl.h"
+
+/*   RPC Messages (encrypted text payloads, dispatched with the command "rpc"):
+ *
+ *      rpc:<message>\n<message>\n...
+ *
+ *      request     q<call id>:<method>[:<arguments>]
+ *      response    r<call id>:<status>[:<result>]
+ *
+ *   The call ID is hex and chosen by the caller, the status is a RpcStatus (decimal). Messages which are created in
+ *   the same loop are sent together in one package (up to RPC_BATCH_MAX bytes), so a batch of calls costs one
+ *   confirmation of the transport instead of one per call. The responses of a received batch are sent in one package
+ *   as well, in the order the handlers answer - a call which is answered later does not hold back the others.
+ *   Arguments and results must not contain the message separator.
+ *
+ *   The peer is another device with a RpcEndpoint or the gateway (host/gateway, GatewayRpc), which calls the methods
+ *   of the devices and answers their calls with RS_UNKNOWN_METHOD. The MyDevices server has no rpc client and does
+ *   not answer the "rpc" command, so calls of a device to the server end with RS_TIMEOUT. On the host the
+ *   LoopbackServer answers the calls of the tests and benchmarks.
+ */
+
+#define RPC_COMMAND "rpc"
+#define RPC_MESSAGE_SEPARATOR '\n'
+#define RPC_REQUEST_TAG 'q'
+#define RPC_RESPONSE_TAG 'r'
+
+// slots of outstanding calls, must be a power of two
+#ifndef RPC_CALL_CAPACITY
+#define RPC_CALL_CAPACITY TRANSMISSION_PROFILE_RPC_CAPACITY
+#endif
+#define RPC_DEFAULT_TIMEOUT 5000
+// largest batch, one aes block below the decryption buffer of the receiver
+#define RPC_BATCH_MAX (transmissionProfile.payloadMax - 16)
+
+static_assert((RPC_CALL_CAPACITY & (RPC_CALL_CAPACITY - 1)) == 0, "RPC_CALL_CAPACITY must be a power of two");
+
+/*
+    Result of a call. RS_OK, RS_UNKNOWN_METHOD and RS_FAILED are sent by the peer, RS_TIMEOUT and RS_CANCELLED are
+    set by this side when no response arrived in time or the connection was closed.
+*/
+enum RpcStatus { RS_OK, RS_UNKNOWN_METHOD, RS_FAILED, RS_TIMEOUT, RS_CANCELLED };
+
+class IRpcCallback
+{
+public:
+    /**
+     * @brief Called once for every call. The result points into the receive buffer and is only valid during the call
+     */
+    virtual void OnCallComplete(uint16_t callID, RpcStatus status, const CommandSpan& result) = 0;
+};
+
+class RpcStatistics
+{
+public:
+    RpcStatistics();
+
+    unsigned long calls;
+    // calls which got a response in time
+    unsigned long completed;
+    unsigned long timeouts;
+    // responses to calls which were completed already (timed out or cancelled)
+    unsigned long late;
+    unsigned long served;
+    unsigned long batchesSent;
+    unsigned long malformed;
+};
+
+/**
+ * @brief Request/response calls with call IDs over a TransmissionControl. Any number of calls up to
+ *  RPC_CALL_CAPACITY can be outstanding, each has its own timeout and completion callback:
+ *
+ *      rpc.Begin(&controller);
+ *      rpc.RegisterMethod("get-temperature", &sensorHandler);
+ *
+ *      rpc.Call("get-config", "network", &configCallback);
+ *      rpc.Call("get-time", "", &timeCallback, 1000);
+ *
+ *      loop: controller.OnLoop(); rpc.OnLoop();
+ *
+ *  Methods are handled by an ICommandHandler which gets the arguments of the request. It answers with
+ *  Respond(GetCurrentCallID(), ...) during the OnCommand call or later with the ID it has saved.
+ */
+class RpcEndpoint : private ICommandHandler
+{
+public:
+    RpcEndpoint();
+
+    /**
+     * @brief Registers the rpc command at the controller
+     */
+    bool Begin(TransmissionControl* controller);
+
+    /**
+     * @brief Start a call, the callback is called with the response or when the timeout (ms) has expired. Returns
+     *  the call ID or 0 if the call was not started (all slots are in use, the message is too large or contains
+     *  the separator, or the transport does not accept more data)
+     */
+    uint16_t Call(const char* method, const String& arguments, IRpcCallback* callback, unsigned long timeout = RPC_DEFAULT_TIMEOUT);
+    /* Forget a call, its callback is not called. Returns false if the call is not outstanding */
+    bool Cancel(uint16_t callID);
+    unsigned int GetPendingCount() const;
+
+    /**
+     * @brief Register a handler for calls of the peer. The method string must stay valid (use a literal)
+     */
+    bool RegisterMethod(const char* method, ICommandHandler* handler);
+    /* The ID of the request while a method handler is called (0 outside of a handler) */
+    uint16_t GetCurrentCallID() const;
+    /* Answer a request of the peer, returns false if the response is too large or the transport is full */
+    bool Respond(uint16_t callID, RpcStatus status, const String& result);
+
+    /**
+     * @brief Send the collected messages now instead of in the next OnLoop. Returns false if the transport does
+     *  not accept them, they are sent with the next flush then
+     */
+    bool Flush();
+
+    /* Sends the collected messages and completes the calls which timed out */
+    void OnLoop();
+    /* Completes all outstanding calls with RS_CANCELLED, the peer does not answer them in the next session */
+    void OnClientDisconnected();
+
+    const RpcStatistics& GetStatistics() const;
+
+private:
+    class PendingCall
+    {
+    public:
+        PendingCall();
+
+        uint16_t callID;        // 0 = free slot
+        IRpcCallback* callback;
+        unsigned long startTime;
+        unsigned long timeout;
+    };
+
+    TransmissionControl* controller;
+    CommandRouter methods;
+
+    PendingCall calls[RPC_CALL_CAPACITY];
+    unsigned int pendingCount;
+    uint16_t nextCallID;
+    uint16_t currentCallID;
+
+    // messages which were not sent yet
+    String outgoing;
+    RpcStatistics statistics;
+
+    void OnCommand(uint32_t commandID, const CommandArguments& arguments) override;
+
+    uint16_t allocateCallID();
+    bool appendMessage(const char* prefix, const char* name, const String& tail);
+    void processMessage(const char* data, unsigned int length);
+    bool complete(uint16_t callID, RpcStatus status, const CommandSpan& result);
+};
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef SERVICE_DISCOVERY_H
+#define SERVICE_DISCOVERY_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "ItemCollection.h"
+
+#ifdef ESP32
+#include <mdns.h>
+#endif
+
+// interval of the background queries, shorter while no server is known
+#ifndef DISCOVERY_QUERY_INTERVAL
+#define DISCOVERY_QUERY_INTERVAL 30000
+#endif
+#ifndef DISCOVERY_QUERY_INTERVAL_EMPTY
+#define DISCOVERY_QUERY_INTERVAL_EMPTY 2000
+#endif
+// time a query collects answers
+#define DISCOVERY_QUERY_TIMEOUT 1500
+#define DISCOVERY_MAX_RESULTS 8
+// lifetime of an entry if the answer has no ttl (ms)
+#define DISCOVERY_DEFAULT_TTL 120000
+// a server which refused a connection is only selected again after this time (ms), doubled per failure
+#define DISCOVERY_FAILURE_HOLDOFF 5000
+#define DISCOVERY_FAILURE_HOLDOFF_MAX 120000
+
+/*
+    One answer of a service query
+*/
+class ResolvedService
+{
+public:
+    ResolvedService();
+
+    String hostname;
+    IPAddress address;
+    uint16_t port;
+    unsigned long ttl;  // ms, 0 = not given
+};
+
+/**
+ * @brief Backend of the service discovery. A query runs in the background, PollQuery is called from the loop until
+ *  it returns true, then the results are complete
+ */
+class IServiceResolver
+{
+public:
+    virtual bool BeginQuery(const char* service, const char* protocol, unsigned long timeout) = 0;
+    virtual bool PollQuery(itemCollection<ResolvedService>& results) = 0;
+};
+
+#ifdef ESP32
+/**
+ * @brief Resolver on top of the asynchronous mdns queries of the esp-idf (the browse does not block the loop)
+ */
+class MdnsServiceResolver : public IServiceResolver
+{
+public:
+    MdnsServiceResolver();
+    ~MdnsServiceResolver();
+
+    bool BeginQuery(const char* service, const char* protocol, unsigned long timeout) override;
+    bool PollQuery(itemCollection<ResolvedService>& results) override;
+
+private:
+    mdns_search_once_t* search;
+};
+#endif
+
+/**
+ * @brief Resolver with a fixed answer for tests on a host. The answer is returned after the given delay
+ */
+class FakeServiceResolver : public IServiceResolver
+{
+public:
+    FakeServiceResolver(unsigned long delay);
+
+    void SetServices(const itemCollection<ResolvedService>& services);
+    unsigned long GetQueryCount() const;
+
+    bool BeginQuery(const char* service, const char* protocol, unsigned long timeout) override;
+    bool PollQuery(itemCollection<ResolvedService>& results) override;
+
+private:
+    itemCollection<ResolvedService> services;
+    unsigned long delay;
+    unsigned long queryStart;
+    unsigned long queryCount;
+    bool queryActive;
+};
+
+/*
+    Entry of the server table
+*/
+class DiscoveredServer
+{
+public:
+    DiscoveredServer();
+
+    String hostname;
+    IPAddress address;
+    uint16_t port;
+
+    unsigned long expires;          // millis() when the entry is removed if it was not seen again
+    unsigned long connectLatency;   // smoothed connect time in ms (0 = never connected)
+    unsigned int failures;          // consecutive failed connection attempts
+    unsigned long holdoffUntil;     // not selected before this time after a failure
+    uint32_t weight;                // rendezvous hash of the device name and this server
+};
+
+/**
+ * @brief Keeps a table of the servers which offer a service. The service is browsed in the background, entries
+ *  expire with the ttl of their answer. The server for a connection is chosen by rendezvous (highest random weight)
+ *  hashing of the device name, so a fleet of devices spreads evenly over the servers and a device keeps its server
+ *  while the table changes. If the connection fails, the next server in the ranking is selected without a new query:
+ *
+ *      if(discovery.SelectServer(server))
+ *      {
+ *          auto start = millis();
+ *          auto success = client.connect(server.address, server.port);
+ *          discovery.ReportConnectResult(server, success, millis() - start);
+ *      }
+ */
+class ServiceDiscovery
+{
+public:
+    ServiceDiscovery();
+
+    void Begin(IServiceResolver* resolver, const char* service, const char* protocol, const String& deviceName);
+    void OnLoop();
+
+    /* Start a query in the next loop (e.g. after all servers failed) */
+    void Refresh();
+
+    /**
+     * @brief Add a server which is known without a query (e.g. from the boot state of the last connection). It is
+     *  ranked like a discovered server until it expires or fails
+     */
+    void AddServer(const ResolvedService& service);
+
+    /**
+     * @brief Select the server for the next connection attempt. Returns false if no server is known
+     */
+    bool SelectServer(DiscoveredServer& server) const;
+    void ReportConnectResult(const DiscoveredServer& server, bool success, unsigned long latency);
+
+    unsigned int GetServerCount() const;
+    /* Servers in the order of the ranking */
+    const DiscoveredServer& GetServer(unsigned int index) const;
+
+private:
+    IServiceResolver* resolver;
+    String service;
+    String protocol;
+    String deviceName;
+
+    // sorted by the ranking
+    itemCollection<DiscoveredServer> servers;
+    itemCollection<ResolvedService> results;
+
+    unsigned long queryTimer;
+    bool queryActive;
+    bool refreshRequested;
+
+    void mergeResults();
+    void updateServer(const ResolvedService& resolved, unsigned long now);
+    void expireServers();
+    void rankServers();
+    int findServer(const IPAddress& address, uint16_t port) const;
+    uint32_t serverWeight(const DiscoveredServer& server) const;
+    static bool ranksBefore(const DiscoveredServer& a, const DiscoveredServer& b, unsigned long now);
+};
+
+#endif
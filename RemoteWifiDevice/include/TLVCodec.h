@@ -0,0 +1,120 @@
+#ifndef TLV_CODEC_H
+#define TLV_CODEC_H
+
+#include <Arduino.h>
+
+/*   TLV Message Layout:
+ *
+ *      1. Marker (1 byte, 0xB1 - never the first byte of an ascii payload)
+ *      2. Body Length (varint, 2 bytes)
+ *      3. Elements:
+ *          - Key (1 byte): tag (bits 3-7, 0..31) | type (bits 0-2)
+ *          - UINT / INT: varint (INT is zigzag encoded)
+ *          - FLOAT: 4 bytes little endian
+ *          - BYTES / STRING / RECORD: varint length + content (a RECORD contains elements)
+ *
+ *   The body length is required, because the aes payload is zero padded to the block size.
+ */
+
+#define TLV_MESSAGE_MARKER 0xB1
+#define TLV_HEADER_SIZE 3
+#define TLV_MAX_TAG 31
+#define TLV_MAX_NESTING 4
+// records and the message body use a fixed 2 byte length field
+#define TLV_MAX_RECORD_LENGTH 0x3FFF
+
+enum TLVType { TLV_UINT, TLV_INT, TLV_FLOAT, TLV_BYTES, TLV_STRING, TLV_RECORD };
+
+/**
+ * @brief Writes a TLV message into a caller-provided buffer, nothing is allocated. If the buffer is too small
+ *  or a value is invalid the writer enters the error state and ignores all subsequent calls.
+ */
+class TLVWriter
+{
+public:
+    TLVWriter(unsigned char* buffer, unsigned int capacity);
+
+    void WriteUInt(uint8_t tag, uint32_t value);
+    void WriteInt(uint8_t tag, int32_t value);
+    void WriteFloat(uint8_t tag, float value);
+    void WriteBytes(uint8_t tag, const unsigned char* data, unsigned int length);
+    void WriteString(uint8_t tag, const char* text);
+    void WriteString(uint8_t tag, const char* text, unsigned int length);
+
+    void BeginRecord(uint8_t tag);
+    void EndRecord();
+
+    /**
+     * @brief Completes the message header, returns false if the message is invalid (overflow or open records)
+     */
+    bool Finish();
+
+    bool HasError() const;
+    const unsigned char* GetData() const;
+    unsigned int GetLength() const;
+
+private:
+    unsigned char* buffer;
+    unsigned int capacity;
+    unsigned int position;
+    unsigned int recordStart[TLV_MAX_NESTING];
+    unsigned int nestingLevel;
+    bool errorFlag;
+
+    void writeKey(uint8_t tag, TLVType type);
+    void writeVarint(uint32_t value);
+    void writeRaw(const unsigned char* data, unsigned int length);
+    void writeFixedLength(unsigned int offset, unsigned int length);
+};
+
+/**
+ * @brief Reads the elements of a TLV message or record in place. The reader only references the source buffer.
+ *
+ *  while(reader.Next())
+ *  {
+ *      switch(reader.GetTag()) { ... }
+ *  }
+ */
+class TLVReader
+{
+public:
+    TLVReader();
+    TLVReader(const unsigned char* data, unsigned int length);
+
+    /**
+     * @brief Creates a reader for a complete message (validates the marker and the body length)
+     */
+    static TLVReader FromMessage(const unsigned char* data, unsigned int length);
+    static bool IsMessage(const unsigned char* data, unsigned int length);
+
+    bool Next();
+
+    uint8_t GetTag() const;
+    TLVType GetType() const;
+
+    uint32_t GetUInt() const;
+    int32_t GetInt() const;
+    float GetFloat() const;
+    const unsigned char* GetBytes(unsigned int& length) const;
+    String GetString() const;
+    TLVReader GetRecord() const;
+
+    bool HasError() const;
+
+private:
+    const unsigned char* data;
+    unsigned int length;
+    unsigned int position;
+
+    uint8_t tag;
+    TLVType type;
+    uint32_t value;
+    const unsigned char* content;
+    unsigned int contentLength;
+
+    bool errorFlag;
+
+    bool readVarint(uint32_t& out);
+};
+
+#endif
@@ -1,3 +1,6 @@
+#ifndef TRANSMISSION_CONTROL_H
+#define TRANSMISSION_CONTROL_H
+
 #include <Arduino.h>
 #include <mbedtls/pk.h>
 #include <mbedtls/rsa.h>
@@ -5,14 +8,38 @@
 #include "mbedtls/entropy.h"
 #include "mbedtls/ctr_drbg.h"
 #include "mbedtls/error.h"
-#include "mbedtls/base64.h"
 #include "mbedtls/aes.h"
 #include "ItemCollection.h"
+#include "TransmissionMetrics.h"
+#include "TransmissionTrace.h"
+#include "CommandRouter.h"
+#include "TLVCodec.h"
+#include "DuplicateWindow.h"
+#include "FragmentStream.h"
+#include "Base64.h"
+#include "ByteSpan.h"
+#include "OutboundStore.h"
+#include "MemoryMonitor.h"
+#include "Checksum.h"
+#include "TransmissionProfile.h"
+#include "LinkEstimator.h"
 
 #define TRANSMISSION_PACKAGE_IV_DUMMY "0000000000000000";
 #define TRANSMISSION_PACKAGE_DATA_DUMMY "DUMMY";
 
+// plain text bytes which are encrypted and base64 encoded in one step (multiple of the aes block size and of 3)
+#define TRANSMISSION_ENCRYPT_CHUNK_SIZE 48
+
 #define STATUS_REQUEST_RESPONSE "rs:status:active"
+#define METRICS_REQUEST_RESPONSE "rs:metrics:"
+#define MEMORY_REQUEST_RESPONSE "rs:memory:"
+#define LINK_REQUEST_RESPONSE "rs:link:"
+// followed by a raw trace dump (see TransmissionTrace::AppendRaw), decode it with tools/trace_decode.py
+#define TRACE_REQUEST_RESPONSE "rs:trace:"
+// plain text data package which only exists to be confirmed by the peer (see SendKeepalive)
+#define TRANSMISSION_KEEPALIVE_MESSAGE "ka"
+// data of a CREDIT package which asks the peer for its current receive window
+#define TRANSMISSION_CREDIT_PROBE "?"
 
 /*   Transmission Package Layout:
  *      
@@ -24,18 +51,90 @@
  *      6. Mode (1 byte)
  *      7. IV (? bytes)
  *      8. Data (? bytes)
+ *
+ *   A CREDIT package carries the receive window of its sender as plain text data "<bytes>:<packages>": the number of
+ *   bytes and packages the sender of the credit accepts. Every data package which is sent subtracts its frame (the
+ *   layout above) and one package from the credit of the peer, control packages are not counted. When the bytes or
+ *   the packages are used up, the sender waits for the next credit, which replaces the rest of the previous one. The
+ *   receiver sends a new credit after it has processed half of its window, but only to a peer which has sent a credit
+ *   itself (a peer without flow control only gets the credit of the session start). Credits are not confirmed: while
+ *   the window of the peer is closed and data waits, the sender asks for it after the retransmission timeout (doubled
+ *   with every probe up to rtoMax) with a CREDIT package with the data "?", which the peer answers with its current
+ *   credit. Without a credit the peer is not limited.
+ *
+ *   A PROBE package carries plain text data "<sequence>:<timestamp>" (hex, the timestamp is micros() of the sender)
+ *   and has no iv. The peer sends the data back unchanged in a PROBE_REPLY package with the same ID, without
+ *   decryption or confirmation. Probes are neither confirmed nor resent, a missing reply counts as a lost probe.
+ *
+ *   With the sync framing (TF_SYNC) every transmission is preceded by the sync marker and the crc32 of its header:
+ *
+ *      1. Sync Marker (2 bytes, "~~")
+ *      2. Header CRC32 (8 bytes, hex of the crc32 over the 17 header bytes)
+ *      3. Transmission (Data Size bytes, the layout above)
+ *
+ *   The marker can not appear in the header or in base64 data, so after garbage on the stream the receiver finds
+ *   the next frame with a linear search and the crc rejects the (unlikely) marker inside of plain text data. A
+ *   transmission which lost bytes ends at the next valid marker instead of taking the following transmission with it.
  */
 
 enum TransmissionDataFormat { TDF_NONE, PLAIN_TEXT, BASE64 };
 enum TransmissionEncryptionType { TET_NONE, AES, RSA };
-enum TransmissionMode { DATA, CONFIRM, RSA_PUBKEY, AES_KEY };
+enum TransmissionMode { DATA, CONFIRM, RSA_PUBKEY, AES_KEY, CREDIT, PROBE, PROBE_REPLY };
+enum TransmissionFraming { TF_PLAIN, TF_SYNC };
+
+#define TRANSMISSION_SYNC_MARKER "~~"
+#define TRANSMISSION_SYNC_MARKER_SIZE 2
+#define TRANSMISSION_SYNC_PREFIX_SIZE (TRANSMISSION_SYNC_MARKER_SIZE + 8)
+
+// framing of new instances, both sides of a connection must use the same framing
+#ifndef TRANSMISSION_DEFAULT_FRAMING
+#define TRANSMISSION_DEFAULT_FRAMING TF_PLAIN
+#endif
+
+static_assert(TRANSMISSION_DEFAULT_FRAMING == TF_PLAIN || transmissionProfile.syncFraming, "the sync framing is disabled in this profile");
+static_assert(!transmissionProfile.streams || transmissionProfile.payloadMax >= FRAGMENT_HEADER_SIZE + FRAGMENT_PAYLOAD_SIZE,
+    "a fragment of a stream must fit into the decryption buffer");
+
+/*
+    Scheduling class of an outgoing package. Every class has its own queue, control packages are always sent
+    first, interactive packages before bulk packages - except that bulk gets every TRANSMISSION_BULK_SHARE-th
+    turn while both are waiting, so a stream cannot be starved completely.
+*/
+enum TransmissionPriority { TP_CONTROL, TP_INTERACTIVE, TP_BULK, TP_COUNT };
+
+static_assert(TP_COUNT == METRICS_PRIORITY_CLASSES, "every priority class needs its metrics");
+
+#define TRANSMISSION_BULK_SHARE 4
 
 class ITransmissionControlInterface
 {   
 public:
     virtual void OutGateway(const String& data) = 0;
-    virtual void OnDataDecoded(const String& data) = 0;
-    virtual void OnUnencryptedDataReceived(const String& data) = 0;
+
+    /**
+     * @brief Called for decrypted text payloads which are not handled by a registered command and for plain text
+     *  payloads. The span references the receive buffer and is only valid during the call, so a handler which only
+     *  inspects the payload does not need a copy. The default implementations copy the payload into a String and
+     *  call the String overloads
+     */
+    virtual void OnDataDecoded(const ByteSpan& data) { this->OnDataDecoded(data.ToString()); }
+    virtual void OnUnencryptedDataReceived(const ByteSpan& data) { this->OnUnencryptedDataReceived(data.ToString()); }
+
+    virtual void OnDataDecoded(const String& data) {}
+    virtual void OnUnencryptedDataReceived(const String& data) {}
+
+    /**
+     * @brief Called for decrypted payloads in the TLV message format (see TLVCodec.h). The reader
+     *  references the decryption buffer and is only valid during the call
+     */
+    virtual void OnRecordDecoded(TLVReader& record) {}
+
+    /**
+     * @brief Called for every fragment of an inbound stream in order (see FragmentStream.h). The data is only valid
+     *  during the call, so the application can process large messages without holding them in memory
+     */
+    virtual void OnStreamData(uint16_t streamID, uint32_t offset, const unsigned char* data, unsigned int length, uint32_t totalLength, bool last) {}
+    virtual void OnStreamAborted(uint16_t streamID) {}
 };
 
 class TransmissionPackage
@@ -53,10 +152,25 @@ public:
     unsigned int transmissionID;
 
     bool errorFlag;
+    // number of resends
     unsigned int confirmationParam;
+    // micros() of the last send
+    unsigned long sentTimestamp;
+    // ID of the outgoing stream this package is a fragment of (0 = no fragment)
+    unsigned int streamID;
+    // the message of the package is kept in the outbound store until the package is confirmed
+    bool stored;
+    // the complete transmission string, built once and reused for every resend
+    String frame;
+    TransmissionPriority priority;
+    unsigned long queuedTimestamp;
 
-    String ToTransmissionString();
+    /**
+     * @brief Returns the transmission string, it is built from the fields on the first call (if the frame was not set)
+     */
+    const String& ToTransmissionString();
     String ToConfirmationString() const;
+    String ToProbeReplyString() const;
     void FromTransmissionString(const String& transmissionString);
 
     TransmissionPackage& operator=(const TransmissionPackage& other);
@@ -64,26 +178,165 @@ public:
 
 void printMBED_TLSError(int errorCode);
 
-class TransmissionControl
+/**
+ * @brief Append a transmission string with the sync marker and its header crc (TF_SYNC) to the output
+ */
+void appendSyncFrame(String& output, const String& transmissionString);
+
+class TransmissionControl : private ICommandHandler
 {
+    // the frame-encrypt cases measure encryptIntoFrame without the queue
+    friend class TransportBenchmark;
+
 public:
     TransmissionControl();
+    ~TransmissionControl();
 
     void OnDataReceived(const String& data);
-    void SendData(const String& data, bool encrypt);
+
+    /**
+     * @brief Queue data for transmission. Returns false if the data was not accepted because the transmission queue
+     *  is full (see IsThrottled) or because encrypted data cannot be stored and no session key was sent yet
+     */
+    bool SendData(const String& data, bool encrypt, TransmissionPriority priority = TP_INTERACTIVE);
+
+    /**
+     * @brief Send a finished TLV message encrypted. Returns false if the message is invalid, the queue is full or
+     *  the message cannot be stored and no session key was sent yet
+     */
+    bool SendRecord(TLVWriter& record, TransmissionPriority priority = TP_INTERACTIVE);
+
+    /**
+     * @brief Send a large message as a sequence of encrypted fragments which are pulled from the source on demand.
+     *  The source must stay valid until IStreamSource::OnStreamComplete is called. Only one outgoing stream can be
+     *  active at a time. Returns the stream ID or 0 if a stream is already active, no session key was sent yet (or
+     *  the profile has no streams)
+     */
+    uint16_t SendStream(IStreamSource* source, uint32_t totalLength);
+    bool IsStreamActive() const;
+
+    /**
+     * @brief True if the transmission queue is full or the peer has closed its receive window. The application
+     *  should hold back data until this returns false
+     */
+    bool IsThrottled() const;
+
+    /**
+     * @brief Set the receive window which is advertised to the peer (at the start of every session and again after
+     *  half of it was received)
+     */
+    void SetReceiveWindow(uint32_t bytes, uint16_t packages);
+
+    /**
+     * @brief Set a persistent store for messages which are sent while no session is established. The messages are
+     *  queued in the order they were submitted once the peer has confirmed the key of the next session, one at a
+     *  time: a message is removed from the store when its package is confirmed, so a message whose package is lost
+     *  with the connection is sent again in the next session. Control messages and messages above
+     *  transmissionProfile.outboundMessageMax are never stored. Ignored if the profile has no outbound store
+     */
+    void SetOutboundStore(IOutboundStore* store);
+
     void SetInterface(ITransmissionControlInterface* interface);
     void SetDeviceName(const String& name);
 
+    /**
+     * @brief Set the framing of the sent and received transmissions (TF_PLAIN is the format of the server). The
+     *  framing should only be changed while no client is connected. TF_SYNC is ignored if the profile has no sync framing
+     */
+    void SetFraming(TransmissionFraming framing);
+    TransmissionFraming GetFraming() const;
+
+    /**
+     * @brief Resent data packages which were received already are confirmed and dropped before the decryption
+     *  (default). Without the filter they are decrypted and delivered again, this is only meant to measure the
+     *  filter (see host/linksim). The duplicates are counted in both cases
+     */
+    void SetDuplicateFilter(bool enabled);
+
+    /**
+     * @brief Register a handler for decrypted commands (see CommandRouter). Data without a registered command
+     *  is forwarded to ITransmissionControlInterface::OnDataDecoded
+     */
+    bool RegisterCommand(const char* command, ICommandHandler* handler);
+
     void OnClientConnected();
     void OnClientDisconnected();
 
+    /**
+     * @brief Send a keepalive package. The peer confirms it like every data package, so the confirmation proves
+     *  that the connection is alive even if no application data is exchanged. Received keepalives are not forwarded
+     */
+    void SendKeepalive();
+
+    /* millis() of the last data which was received from the peer (or of the connect) */
+    unsigned long GetLastReceiveTime() const;
+
+    /**
+     * @brief Send a probe to measure the round trip time. The probe is not encrypted and not queued, so it is
+     *  sent immediately and measures the link instead of the queue. The profile can send probes periodically
+     */
+    void SendProbe();
+
+    /**
+     * @brief Round trip time, jitter and loss of the current session, it is reset on disconnect. The retransmission
+     *  timeout of the packages is taken from this estimate
+     */
+    const LinkEstimator& GetLinkEstimate() const;
+
     void OnLoop();
 
+    const TransmissionMetrics& GetMetrics() const;
+    void ResetMetrics();
+
 private:
     TransmissionPackage currentPackage;
     ITransmissionControlInterface* interface;
 
+    // the package which waits for its confirmation (and packages which are sent outside of the queue)
     itemCollection<TransmissionPackage> transmissionQueue;
+    // packages which were not sent yet, by priority
+    itemCollection<TransmissionPackage> priorityQueues[TP_COUNT];
+    unsigned int bulkSkipped;
+
+    // receive window of this side and the data received since its last credit
+    uint32_t receiveWindowBytes;
+    uint16_t receiveWindowPackages;
+    uint32_t receivedSinceCreditBytes;
+    uint16_t receivedSinceCreditPackages;
+    // the rest of the last credit of the peer
+    bool peerCreditReceived;
+    uint32_t peerCreditBytes;
+    uint16_t peerCreditPackages;
+    // millis() when the window of the peer was closed or last probed, and the probes since the last credit
+    unsigned long windowProbeTime;
+    unsigned int windowProbes;
+
+    IOutboundStore* outboundStore;
+    // the oldest stored message is queued and waits for its confirmation
+    bool outboundInFlight;
+    // the aes key of the current session was sent, data can be encrypted from now on
+    bool sessionKeySent;
+    // the peer has confirmed the aes key of the current session
+    bool sessionEstablished;
+
+    TransmissionMetrics metrics;
+    CommandRouter commandRouter;
+    DuplicateWindow receiveWindow;
+    bool duplicateFilter;
+    StreamReassembler streamReassembler;
+
+    TransmissionFraming framing;
+    // received data which does not form a complete transmission yet
+    String receiveBuffer;
+    // a received transmission is processed, data from handlers which respond immediately is appended to the buffer
+    bool receiving;
+
+    // outgoing stream
+    IStreamSource* streamSource;
+    uint16_t streamID;
+    uint16_t streamSequence;
+    uint32_t streamLength;
+    uint32_t streamOffset;
 
     String rsa_key;
     String device_name;
@@ -95,19 +348,125 @@ private:
     mbedtls_entropy_context entropy;
 
     bool pk_context_initialized;
+    // the random generator is seeded once and used for all sessions
+    bool random_seeded;
     bool connection_state;
 
     unsigned int transmissionID;
-    unsigned char aes_key[32];
+    unsigned char aes_key[transmissionProfile.aesKeyBits / 8];
+
+    unsigned long lastReceiveTime;
+
+    LinkEstimator linkEstimate;
+    unsigned long lastProbeTime;
 
     void onRSAKeyReceived(const String& data);
     bool readAndFormatRSAKey(const String& data);
-    String decryptReceivedDataWithAESCbc(const String& data, const String& _iv);
+    bool decryptReceivedDataWithAESCbc(const String& data, const String& _iv, unsigned char* output, size_t outputSize, size_t& outLen);
     bool createAESData();
     bool generateRandomIV(unsigned char* _iv);
-    String EncryptDataWithAES(const String& data, String& _iv_out);
+    bool encryptIntoFrame(const unsigned char* data, size_t length, TransmissionPackage& package);
+    bool sendEncrypted(const unsigned char* data, size_t length, TransmissionPriority priority, unsigned int fragmentOfStream = 0, bool stored = false);
+    void pumpStream();
+    void finishStream(bool success);
+    void processFragment(const unsigned char* data, size_t length);
     void decodeAndProcessEncryptedData(const TransmissionPackage& package);
-    bool internalDataProcessing(const String& data);
+    bool internalDataProcessing(const ByteSpan& data);
+    void OnCommand(uint32_t commandID, const CommandArguments& arguments) override;
+    unsigned int splitTransmissions(const String& data);
     void processTransmission(const String& transmissionString);
     void confirmPackageReception(const TransmissionPackage& package);
-};
\ No newline at end of file
+    void onProbeReplyReceived(const String& data);
+    void checkRetransmission();
+    unsigned int nextTransmissionID();
+    void sendOut(const String& transmissionString);
+    size_t sendQueueHead();
+    void sendNextPackage();
+    int selectPriorityQueue();
+    unsigned int getQueuedCount() const;
+    unsigned int getQueuedBytes() const;
+    bool isQueueFull() const;
+    bool isPeerWindowOpen() const;
+    void consumePeerCredit(size_t frameLength);
+    void onCreditReceived(const String& data);
+    void checkPeerWindow();
+    void sendCredit(const char* data);
+    void onDataPackageReceived(size_t frameLength);
+    void advertiseReceiveWindow();
+    bool storeOutbound(const unsigned char* data, size_t length, bool encrypt, TransmissionPriority priority);
+    void flushOutboundStore();
+    void onStoredPackageDone(bool confirmed);
+    void dropStoredPackages();
+    void enqueuePackage(const TransmissionPackage& package);
+};
+
+/**
+ * @brief Base of an application handler for TransmissionFrontEnd. The handler hides the methods it uses with
+ *  methods of the same signature (the ones of ITransmissionControlInterface), they do not have to be virtual
+ */
+class TransmissionHandler
+{
+public:
+    void OutGateway(const String& data) {}
+    void OnDataDecoded(const ByteSpan& data) {}
+    void OnUnencryptedDataReceived(const ByteSpan& data) {}
+    void OnRecordDecoded(TLVReader& record) {}
+    void OnStreamData(uint16_t streamID, uint32_t offset, const unsigned char* data, unsigned int length, uint32_t totalLength, bool last) {}
+    void OnStreamAborted(uint16_t streamID) {}
+};
+
+/**
+ * @brief The interface of the controller for a handler type. The calls of the controller reach the adapter through
+ *  the interface, the calls of the adapter to the handler are bound at compile time and are inlined
+ */
+template<class Handler>
+class TransmissionHandlerAdapter final : public ITransmissionControlInterface
+{
+public:
+    TransmissionHandlerAdapter(Handler& _handler)
+    : handler(_handler)
+    {}
+
+    void OutGateway(const String& data) override { this->handler.OutGateway(data); }
+    void OnDataDecoded(const ByteSpan& data) override { this->handler.OnDataDecoded(data); }
+    void OnUnencryptedDataReceived(const ByteSpan& data) override { this->handler.OnUnencryptedDataReceived(data); }
+    void OnRecordDecoded(TLVReader& record) override { this->handler.OnRecordDecoded(record); }
+    void OnStreamData(uint16_t streamID, uint32_t offset, const unsigned char* data, unsigned int length, uint32_t totalLength, bool last) override
+    {
+        this->handler.OnStreamData(streamID, offset, data, length, totalLength, last);
+    }
+    void OnStreamAborted(uint16_t streamID) override { this->handler.OnStreamAborted(streamID); }
+
+private:
+    Handler& handler;
+};
+
+/**
+ * @brief Controller with a handler type instead of an interface: the handler needs no virtual methods and no copies
+ *  of the payloads (there are no String overloads). The protocol code is shared by all front ends, it stays in
+ *  TransmissionControl.cpp and calls the handler through its adapter
+ *
+ *      class Events : public TransmissionHandler
+ *      {
+ *      public:
+ *          void OutGateway(const String& data) { client.print(data); }
+ *          void OnDataDecoded(const ByteSpan& data) { ... }
+ *      };
+ *      Events events;
+ *      TransmissionFrontEnd<Events> controller(events);
+ */
+template<class Handler>
+class TransmissionFrontEnd : public TransmissionControl
+{
+public:
+    TransmissionFrontEnd(Handler& handler)
+    : adapter(handler)
+    {
+        this->SetInterface(&this->adapter);
+    }
+
+private:
+    TransmissionHandlerAdapter<Handler> adapter;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef TRANSMISSION_METRICS_H
+#define TRANSMISSION_METRICS_H
+
+#include <Arduino.h>
+
+#define METRICS_HISTOGRAM_BUCKETS 12
+// number of priority classes of the transmission queue (see TransmissionPriority)
+#define METRICS_PRIORITY_CLASSES 3
+#define METRICS_SNAPSHOT_VERSION "m1"
+
+/**
+ * @brief Histogram with fixed power-of-two buckets. Bucket 0 counts values below (1 << unitShift),
+ *  bucket i counts values below (1 << (i + unitShift)), the last bucket collects everything above.
+ *  Recording a sample is a shift, a bit-count and an increment, so it can stay enabled at all times.
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram(unsigned int unitShift);
+
+    void Record(unsigned long value);
+    void Reset();
+
+    unsigned long GetCount() const;
+    /* Sum of the recorded values, in their unit */
+    unsigned long GetSum() const;
+    unsigned long GetMax() const;
+    unsigned long GetBucket(unsigned int index) const;
+
+    /* The exclusive upper bound of the bucket, in the unit of the recorded values (0 = open ended) */
+    unsigned long GetBucketUpperBound(unsigned int index) const;
+
+    /**
+     * @brief Upper bound of the bucket which contains the requested percentile (permille, e.g. 990 for p99).
+     *  For the open ended last bucket the maximum recorded value is returned
+     */
+    unsigned long GetPercentile(unsigned int permille) const;
+
+    /* Adds the samples of another histogram with the same unit */
+    void Merge(const LatencyHistogram& other);
+
+    void AppendSnapshot(String& out) const;
+
+private:
+    unsigned int unitShift;
+    unsigned long count;
+    unsigned long sum;
+    unsigned long max;
+    unsigned long buckets[METRICS_HISTOGRAM_BUCKETS];
+};
+
+/*
+    Counters of one priority class of the transmission queue
+*/
+class PriorityClassMetrics
+{
+public:
+    PriorityClassMetrics();
+
+    unsigned long sent;
+    unsigned int queueHighWater;
+    // time from queuing a package until it is sent the first time (milliseconds)
+    LatencyHistogram queueDelay;
+
+    void Reset();
+};
+
+/**
+ * @brief Transport counters of a TransmissionControl instance. The counters are plain integers
+ *  and are only updated from the loop context, so reading them requires no synchronization.
+ */
+class TransmissionMetrics
+{
+public:
+    TransmissionMetrics();
+
+    unsigned long framesIn;
+    unsigned long framesOut;
+    unsigned long bytesIn;
+    unsigned long bytesOut;
+    unsigned long retransmissions;
+    unsigned long drops;
+    unsigned long parseErrors;
+    unsigned int queueHighWater;
+    // resent packages which were received before and not processed again
+    unsigned long duplicates;
+    // packages which were not accepted because the transmission queue was full
+    unsigned long rejected;
+    // number of times a waiting package was held back because the receive window of the peer was closed
+    unsigned long throttled;
+
+    // round trip time from sending a package until its confirmation (milliseconds)
+    LatencyHistogram ackRTT;
+    // time spent in aes + base64 for one message (microseconds)
+    LatencyHistogram encryptTime;
+    LatencyHistogram decryptTime;
+
+    PriorityClassMetrics classes[METRICS_PRIORITY_CLASSES];
+
+    void Reset();
+    void OnQueueDepth(unsigned int depth);
+
+    /**
+     * @brief Creates a compact snapshot of all counters in hex notation:
+     *  "m1:<framesIn>,<framesOut>,<bytesIn>,<bytesOut>,<retransmissions>,<drops>,<parseErrors>,<queueHighWater>,<duplicates>,<rejected>,<throttled>|<ackRTT>|<encryptTime>|<decryptTime>"
+     *  "|<control>|<interactive>|<bulk>"
+     *  where every priority class is written as "<sent>,<queueHighWater>,<queueDelay>"
+     *  and every histogram as "<count>,<max>,<bucket 0>.<bucket 1>. ..."
+     */
+    String ToSnapshotString() const;
+};
+
+#endif
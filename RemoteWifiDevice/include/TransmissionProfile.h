@@ -0,0 +1,179 @@
+#ifndef TRANSMISSION_PROFILE_H
+#define TRANSMISSION_PROFILE_H
+
+#include <stdint.h>
+
+/*
+    Protocol profiles, one of them is selected at compile time with -DTRANSMISSION_PROFILE=x:
+
+        TRANSMISSION_PROFILE_DEFAULT    the limits of the single TRANSMISSION_... defines below, which can still be
+                                        set one by one
+        TRANSMISSION_PROFILE_SMALL      esp32 with little free RAM: small windows and buffers, no streams, no sync
+                                        framing, no outbound store, only errors are traced
+        TRANSMISSION_PROFILE_GATEWAY    high throughput on a host or a gateway: large windows, 4 KiB payloads, the
+                                        link is probed every second
+
+    The active profile is the constexpr transmissionProfile, so the limits are constants for the compiler and the
+    code of disabled features is removed.
+*/
+#define TRANSMISSION_PROFILE_DEFAULT 0
+#define TRANSMISSION_PROFILE_SMALL 1
+#define TRANSMISSION_PROFILE_GATEWAY 2
+
+#ifndef TRANSMISSION_PROFILE
+#define TRANSMISSION_PROFILE TRANSMISSION_PROFILE_DEFAULT
+#endif
+
+// size of the transmission header (see TransmissionControl.h)
+#define TRANSMISSION_HEADER_SIZE 17
+
+// receive window which is advertised to the peer, the application should read at most this many bytes per call of
+// OnDataReceived (the rest stays in the socket and is held back by the tcp flow control)
+#ifndef TRANSMISSION_RECEIVE_WINDOW_BYTES
+#define TRANSMISSION_RECEIVE_WINDOW_BYTES 4096
+#endif
+#ifndef TRANSMISSION_RECEIVE_WINDOW_PACKAGES
+#define TRANSMISSION_RECEIVE_WINDOW_PACKAGES 2
+#endif
+
+// limits of the packages waiting in the priority queues (control packages are not limited)
+#ifndef TRANSMISSION_QUEUE_LIMIT_PACKAGES
+#define TRANSMISSION_QUEUE_LIMIT_PACKAGES 32
+#endif
+#ifndef TRANSMISSION_QUEUE_LIMIT_BYTES
+#define TRANSMISSION_QUEUE_LIMIT_BYTES 16384
+#endif
+
+// largest decrypted payload of a received package
+#ifndef TRANSMISSION_PAYLOAD_MAX
+#define TRANSMISSION_PAYLOAD_MAX 1024
+#endif
+// largest transmission which is accepted, a header with a larger size is treated as garbage
+#ifndef TRANSMISSION_FRAME_MAX
+#define TRANSMISSION_FRAME_MAX 8192
+#endif
+
+// largest message which is held in the outbound store
+#ifndef TRANSMISSION_OUTBOUND_MESSAGE_MAX
+#define TRANSMISSION_OUTBOUND_MESSAGE_MAX 1024
+#endif
+
+// retransmission timeout (ms) before the first rtt sample and its bounds (see LinkEstimator.h), number of sends of a
+// package before it is dropped. The initial rto is the fixed checkup timeout of the earlier versions.
+#ifndef TRANSMISSION_RTO_INITIAL
+#define TRANSMISSION_RTO_INITIAL 500
+#endif
+#ifndef TRANSMISSION_RTO_MIN
+#define TRANSMISSION_RTO_MIN 200
+#endif
+#ifndef TRANSMISSION_RTO_MAX
+#define TRANSMISSION_RTO_MAX 8000
+#endif
+#ifndef TRANSMISSION_SEND_ATTEMPTS
+#define TRANSMISSION_SEND_ATTEMPTS 4
+#endif
+
+// period of the automatic link probes (ms, 0 = probes are only sent with SendProbe)
+#ifndef TRANSMISSION_PROBE_INTERVAL
+#define TRANSMISSION_PROBE_INTERVAL 0
+#endif
+
+// settings of the profiles which the preprocessor needs (see TransmissionTrace.h, CommandRouter.h and RpcEndpoint.h),
+// they are still overridden by -DTRANSMISSION_TRACE_LEVEL=x, -DTRANSMISSION_TRACE_CAPACITY=x,
+// -DCOMMAND_ROUTER_CAPACITY=x and -DRPC_CALL_CAPACITY=x
+#if TRANSMISSION_PROFILE == TRANSMISSION_PROFILE_SMALL
+#define TRANSMISSION_PROFILE_TRACE_LEVEL 1
+#define TRANSMISSION_PROFILE_TRACE_CAPACITY 16
+// the transport registers 6 commands, firmware update and rpc add 3 more
+#define TRANSMISSION_PROFILE_ROUTER_CAPACITY 32
+#define TRANSMISSION_PROFILE_RPC_CAPACITY 8
+#else
+#define TRANSMISSION_PROFILE_TRACE_LEVEL 2
+#define TRANSMISSION_PROFILE_TRACE_CAPACITY 64
+#define TRANSMISSION_PROFILE_ROUTER_CAPACITY 64
+#define TRANSMISSION_PROFILE_RPC_CAPACITY 64
+#endif
+
+class TransmissionProfile
+{
+public:
+    const char* name;
+
+    // receive window of this side
+    uint32_t receiveWindowBytes;
+    uint16_t receiveWindowPackages;
+    // limits of the priority queues
+    uint16_t queueLimitPackages;
+    uint32_t queueLimitBytes;
+
+    // largest decrypted payload (size of the decryption buffer on the stack) and largest received transmission
+    uint16_t payloadMax;
+    uint32_t frameMax;
+    uint16_t outboundMessageMax;
+
+    // retransmission timer
+    uint32_t rtoInitial;
+    uint32_t rtoMin;
+    uint32_t rtoMax;
+    uint8_t sendAttempts;
+    uint32_t probeInterval;
+
+    // session key and the largest rsa key of the peer (size of the buffer of the encrypted session key)
+    uint16_t aesKeyBits;
+    uint16_t rsaKeyBitsMax;
+
+    // features, the code of a disabled feature is not linked
+    bool streams;
+    bool syncFraming;
+    bool outboundStore;
+};
+
+#if TRANSMISSION_PROFILE == TRANSMISSION_PROFILE_SMALL
+
+constexpr TransmissionProfile transmissionProfile = {
+    "small",
+    1024, 1,
+    8, 2048,
+    256, 1024, 256,
+    2000, 300, 8000, 4, 0,
+    256, 2048,
+    false, false, false
+};
+
+#elif TRANSMISSION_PROFILE == TRANSMISSION_PROFILE_GATEWAY
+
+constexpr TransmissionProfile transmissionProfile = {
+    "gateway",
+    65536, 16,
+    256, 262144,
+    4096, 16384, 4096,
+    500, 50, 4000, 6, 1000,
+    256, 4096,
+    true, true, true
+};
+
+#else
+
+constexpr TransmissionProfile transmissionProfile = {
+    "default",
+    TRANSMISSION_RECEIVE_WINDOW_BYTES, TRANSMISSION_RECEIVE_WINDOW_PACKAGES,
+    TRANSMISSION_QUEUE_LIMIT_PACKAGES, TRANSMISSION_QUEUE_LIMIT_BYTES,
+    TRANSMISSION_PAYLOAD_MAX, TRANSMISSION_FRAME_MAX, TRANSMISSION_OUTBOUND_MESSAGE_MAX,
+    TRANSMISSION_RTO_INITIAL, TRANSMISSION_RTO_MIN, TRANSMISSION_RTO_MAX, TRANSMISSION_SEND_ATTEMPTS, TRANSMISSION_PROBE_INTERVAL,
+    256, 2048,
+    true, true, true
+};
+
+#endif
+
+static_assert(transmissionProfile.aesKeyBits == 128 || transmissionProfile.aesKeyBits == 192 || transmissionProfile.aesKeyBits == 256,
+    "aes supports 128, 192 and 256 bit keys");
+static_assert(transmissionProfile.sendAttempts >= 1, "a package is sent at least once");
+static_assert(transmissionProfile.rtoMin > 0 && transmissionProfile.rtoMin <= transmissionProfile.rtoInitial
+    && transmissionProfile.rtoInitial <= transmissionProfile.rtoMax, "the initial rto must be within the rto bounds");
+static_assert(transmissionProfile.payloadMax % 16 == 0, "the decryption buffer holds whole aes blocks");
+// header, base64 iv and the base64 data of the largest payload
+static_assert(transmissionProfile.frameMax >= TRANSMISSION_HEADER_SIZE + 24 + ((transmissionProfile.payloadMax + 2) / 3) * 4,
+    "the largest payload must fit into a frame");
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef TRANSMISSION_TRACE_H
+#define TRANSMISSION_TRACE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "TransmissionProfile.h"
+
+#define TRACE_LEVEL_NONE 0
+#define TRACE_LEVEL_ERROR 1
+#define TRACE_LEVEL_INFO 2
+#define TRACE_LEVEL_DEBUG 3
+
+// events above this level are removed at compile time (set with -DTRANSMISSION_TRACE_LEVEL=x, the default depends on the profile)
+#ifndef TRANSMISSION_TRACE_LEVEL
+#define TRANSMISSION_TRACE_LEVEL TRANSMISSION_PROFILE_TRACE_LEVEL
+#endif
+
+// number of events held in RAM, must be a power of two
+#ifndef TRANSMISSION_TRACE_CAPACITY
+#define TRANSMISSION_TRACE_CAPACITY TRANSMISSION_PROFILE_TRACE_CAPACITY
+#endif
+
+// version in front of a raw dump, tools/trace_decode.py reads dumps of this version
+#define TRACE_DUMP_VERSION "t1"
+// hex characters of a raw record
+#define TRACE_DUMP_RECORD_SIZE 32
+
+enum TraceEventID
+{
+    TE_NONE,
+    TE_RSA_KEY_RECEIVED,
+    TE_RSA_PARAMS_INVALID,
+    TE_RSA_KEY_PARSE_FAILED,
+    TE_RANDOM_SEED_FAILED,
+    TE_AES_KEYGEN_FAILED,
+    TE_AES_KEY_GENERATED,
+    TE_AES_KEY_ENCRYPT_FAILED,
+    TE_AES_KEY_SENT,
+    TE_AES_SETKEY_FAILED,
+    TE_AES_ENCRYPT_FAILED,
+    TE_AES_DECRYPT_FAILED,
+    TE_ENCRYPT_EMPTY_INPUT,
+    // 13 and 15 were the base64 encode events, the IDs are not reused so older dumps still decode
+    TE_BASE64_DECODE_FAILED = 14,
+    TE_FRAME_SIZE_ERROR = 16,
+    TE_FRAME_PARSE_ERROR,
+    TE_PACKAGE_RESENT,
+    TE_PACKAGE_DROPPED,
+    TE_OTA_STARTED,
+    TE_OTA_CHUNK_INVALID,
+    TE_OTA_WRITE_FAILED,
+    TE_OTA_VERIFY_FAILED,
+    TE_OTA_COMPLETE,
+    TE_OUTBOUND_STORED,
+    TE_OUTBOUND_STORE_FAILED,
+    TE_OUTBOUND_STORE_FLUSHED,
+    TE_CONNECTION_ESTABLISHED,
+    TE_CONNECTION_FAILED,
+    TE_CONNECTION_LOST,
+    TE_CONNECTION_DEAD_PEER,
+    TE_FRAME_RESYNC,
+    TE_PROBE_LOST,
+    TE_COMMAND_REGISTER_FAILED,
+    TE_SEND_WITHOUT_SESSION,
+    TE_EVENT_COUNT
+};
+
+/*
+    Binary trace record (16 bytes), the layout is stable so raw dumps can be decoded elsewhere.
+    A raw dump record is the record as 32 hex characters, the fields in this order and most significant
+    digit first: timestamp (8), eventID (4), level (2), reserved (2), arg0 (8), arg1 (8)
+*/
+struct TraceEvent
+{
+    uint32_t timestamp;     // micros()
+    uint16_t eventID;
+    uint8_t level;
+    uint8_t reserved;
+    int32_t arg0;
+    int32_t arg1;
+};
+
+/**
+ * @brief In-RAM ring buffer for transport events. Recording copies 16 bytes into a slot and
+ *  publishes it with a sequence number, it never blocks and never formats text. When the ring
+ *  is full the oldest events are overwritten. Formatting is deferred to Drain(...), which should
+ *  be called outside of the transmission hot path (e.g. at the end of the main loop).
+ */
+class TransmissionTrace
+{
+public:
+    static void Record(uint8_t level, uint16_t eventID, int32_t arg0, int32_t arg1);
+
+    /**
+     * @brief Copy up to maxEvents raw events out of the ring, returns the number of copied events
+     */
+    static unsigned int Read(TraceEvent* events, unsigned int maxEvents);
+
+    /**
+     * @brief Format up to maxEvents events as text lines to the output (0 = all available events)
+     */
+    static unsigned int Drain(Print& output, unsigned int maxEvents = 0);
+
+    /**
+     * @brief Write up to maxEvents events as a raw dump line to the output (0 = all available events), the line
+     *  is TRACE_DUMP_VERSION, ':' and the records. Nothing is written if there is no event
+     */
+    static unsigned int Dump(Print& output, unsigned int maxEvents = 0);
+
+    /**
+     * @brief Append up to maxEvents raw records to the text (0 = all available events), used for the rq:trace response
+     */
+    static unsigned int AppendRaw(String& text, unsigned int maxEvents = 0);
+
+    /* Number of events which were overwritten before they could be read */
+    static unsigned long GetLostCount();
+
+    static const char* GetEventName(uint16_t eventID);
+};
+
+#if TRANSMISSION_TRACE_LEVEL >= TRACE_LEVEL_ERROR
+#define TRACE_ERROR(id, arg0, arg1) TransmissionTrace::Record(TRACE_LEVEL_ERROR, (id), (int32_t)(arg0), (int32_t)(arg1))
+#else
+#define TRACE_ERROR(id, arg0, arg1) do {} while(0)
+#endif
+
+#if TRANSMISSION_TRACE_LEVEL >= TRACE_LEVEL_INFO
+#define TRACE_INFO(id, arg0, arg1) TransmissionTrace::Record(TRACE_LEVEL_INFO, (id), (int32_t)(arg0), (int32_t)(arg1))
+#else
+#define TRACE_INFO(id, arg0, arg1) do {} while(0)
+#endif
+
+#if TRANSMISSION_TRACE_LEVEL >= TRACE_LEVEL_DEBUG
+#define TRACE_DEBUG(id, arg0, arg1) TransmissionTrace::Record(TRACE_LEVEL_DEBUG, (id), (int32_t)(arg0), (int32_t)(arg1))
+#else
+#define TRACE_DEBUG(id, arg0, arg1) do {} while(0)
+#endif
+
+#endif
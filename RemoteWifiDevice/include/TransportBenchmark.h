@@ -0,0 +1,279 @@
+#ifndef TRANSPORT_BENCHMARK_H
+#define TRANSPORT_BENCHMARK_H
+
+#include "TransmissionControl.h"
+#include "LoopbackServer.h"
+#include "RpcEndpoint.h"
+#include "MemoryMonitor.h"
+#include "TLVCodec.h"
+
+#define BENCHMARK_SUITE_NAME "transport"
+#define BENCHMARK_FORMAT_VERSION 1
+
+// key size of the loopback server, the handshake time depends mostly on it
+#ifndef BENCHMARK_RSA_BITS
+#define BENCHMARK_RSA_BITS 2048
+#endif
+// frames in the receive buffer of the frame-split and frame-resync cases
+#define BENCHMARK_SPLIT_FRAMES 8
+// garbage in front of every frame of the frame-resync case
+#define BENCHMARK_RESYNC_NOISE 24
+// method of the rpc cases, the loopback server answers every call with its arguments
+#define BENCHMARK_RPC_METHOD "echo"
+// commands registered in the largest dispatch case and the slots of its router (at most half of them are used)
+#define BENCHMARK_DISPATCH_COMMANDS 200
+#define BENCHMARK_DISPATCH_CAPACITY 512
+// telemetry message of the tlv and text cases, as TLV elements and as the equivalent command
+#define BENCHMARK_TELEMETRY_COMMAND "rs:telemetry"
+#define BENCHMARK_TELEMETRY_MAX 64
+// largest payload of the frame-encrypt cases (above the payload of a single package of the default profile) and the
+// data of the base64 cases
+#define BENCHMARK_FRAME_PAYLOAD_MAX 4096
+// application messages queued in front of every status request of the control-under-bulk case, and its stream
+#define BENCHMARK_BULK_MESSAGES 20
+#define BENCHMARK_BULK_STREAM (64UL * 1024UL)
+// messages the application offers in the flow-100x case per message the peer takes
+#define BENCHMARK_FLOW_OFFERED 100
+// longest stream case which is run, the time of a longer stream overflows the ns per operation of the board
+#ifndef BENCHMARK_STREAM_MAX
+#ifdef ESP32
+#define BENCHMARK_STREAM_MAX (256UL * 1024UL)
+#else
+#define BENCHMARK_STREAM_MAX (16UL * 1024UL * 1024UL)
+#endif
+#endif
+
+enum BenchmarkCase
+{
+    BC_PACKAGE_ENCODE,
+    BC_PACKAGE_DECODE,
+    BC_FRAME_SPLIT,
+    BC_FRAME_RESYNC,
+    BC_COLLECTION,
+    BC_AES_ENCRYPT,
+    BC_AES_DECRYPT,
+    BC_HANDSHAKE,
+    BC_ROUND_TRIP,
+    BC_RPC_CALLS_1,
+    BC_RPC_CALLS_8,
+    BC_RPC_CALLS_64,
+    BC_STREAM_64K,
+    BC_STREAM_1M,
+    BC_STREAM_16M,
+    BC_FLOW_100X,
+    BC_TRACE_RECORD,
+    BC_TRACE_RECORD_DEBUG,
+    BC_DISPATCH_2,
+    BC_DISPATCH_20,
+    BC_DISPATCH_200,
+    BC_TLV_ENCODE,
+    BC_TLV_DECODE,
+    BC_TEXT_ENCODE,
+    BC_TEXT_DECODE,
+    BC_FRAME_ENCRYPT_16,
+    BC_FRAME_ENCRYPT_256,
+    BC_FRAME_ENCRYPT_1K,
+    BC_FRAME_ENCRYPT_4K,
+    BC_BASE64_ENCODE,
+    BC_BASE64_DECODE,
+    BC_CONTROL_UNDER_BULK,
+    BC_DELIVER_STRING,
+    BC_DELIVER_VIRTUAL,
+    BC_DELIVER_STATIC,
+    BC_CASE_COUNT
+};
+
+class BenchmarkConfig
+{
+public:
+    BenchmarkConfig();
+
+    unsigned long minimumTime;      // ms each case runs at least
+    unsigned long minimumIterations;
+    unsigned int payloadSize;
+};
+
+class BenchmarkResult
+{
+public:
+    BenchmarkResult();
+
+    const char* name;
+    unsigned long iterations;
+    unsigned long elapsed;          // us
+    unsigned long nsPerOperation;
+    // allocations per operation in hundredths (0 if the allocations are not counted, see MemoryMonitor)
+    unsigned long allocationsPerOperation;
+    // most bytes the case kept allocated above its start (0 if not sampled or the allocations are not counted)
+    size_t peakBytes;
+    // size of the encoded message (0 if the case does not encode one)
+    unsigned int messageBytes;
+    // bytes the case copies per operation (0 if the case does not count them)
+    unsigned int copiedBytes;
+    // data the case processes per operation, printed as MB/s (0 if the case has no throughput)
+    unsigned int bytesPerOperation;
+    // average latency of the measured message in us (0 if the case does not measure one)
+    unsigned long latency;
+};
+
+/**
+ * @brief Benchmark of the transport layer: package encoding and decoding, the splitting of received data into
+ *  frames (also with garbage between sync framed frames), the item collection, aes with base64, the rsa handshake and encrypted round trips against a
+ *  LoopbackServer. The rpc cases complete calls with the payload as arguments and keep 1, 8 or 64 calls outstanding
+ *  (at most RPC_CALL_CAPACITY), an operation is one call, so 10^9 / ns_per_op is the number of calls per second.
+ *  The stream cases send a message of 64 KB, 1 MB or 16 MB with SendStream, an operation is the whole stream. They
+ *  run at least once instead of the minimum iterations, streams above BENCHMARK_STREAM_MAX are not run or printed.
+ *  In the flow-100x case the application offers BENCHMARK_FLOW_OFFERED encrypted messages per operation and the
+ *  peer grants the credit of a single package, the sender is 100 times faster than the receiver. The messages which
+ *  do not fit into the queues are rejected, the case reports the peak of the kept bytes which has to stay bounded.
+ *  The trace cases record one event per operation at the error level and at the debug level, which is compiled out
+ *  unless TRANSMISSION_TRACE_LEVEL is TRACE_LEVEL_DEBUG (the difference is the cost of an enabled event).
+ *  The dispatch cases register 2, 20 or 200 commands at a router and dispatch one command with an argument per
+ *  operation, the time has to stay the same for every number of commands.
+ *  The tlv and text cases encode or decode one telemetry message per operation (sensor id, temperature, humidity,
+ *  rssi and a status), once as TLV elements and once as the command "rs:telemetry:<id>:<t>:<h>:<rssi>:<status>"
+ *  which is split with CommandArguments. The encode cases report the size of the message before the encryption.
+ *  The frame-encrypt cases encrypt a payload of 16 B, 256 B, 1 KB or 4 KB into a transmission frame per operation
+ *  (TransmissionControl::encryptIntoFrame, without the queue) and report the size of the frame and the bytes copied
+ *  on the way: the frame is written once and only the tail of the payload goes through the padding buffer.
+ *  The base64 cases encode or decode 4 KB of data per operation and report the throughput (with the vector loops of
+ *  Base64.cpp on x86 hosts).
+ *  In the control-under-bulk case the server sends "rq:status" while a stream and BENCHMARK_BULK_MESSAGES application
+ *  messages are queued, an operation lasts until the queues are drained. The case reports the average time until
+ *  the answer reaches the server, which only waits for the package in flight (see TransmissionPriority).
+ *  The deliver cases receive one plain frame of the payload per operation and deliver it to a handler with the
+ *  String overloads of the interface, with the span overloads, or to a handler without virtual methods behind a
+ *  TransmissionFrontEnd (the duplicate filter is off, the frame is the same in every operation).
+ *  Every case runs for a minimum time, the results are written as a single line of json
+ *
+ *      {"suite":"transport","version":1,"platform":"esp32","profile":"default","payload":64,"results":[{"name":"package-encode",...},...]}
+ *
+ *  which tools/bench_compare.py compares against a stored baseline.
+ */
+// application handlers of the deliver cases, they count the delivered messages
+class BenchmarkStringHandler : public ITransmissionControlInterface
+{
+public:
+    unsigned long messages;
+
+    BenchmarkStringHandler();
+    void OutGateway(const String& data) override;
+    void OnUnencryptedDataReceived(const String& data) override;
+};
+
+class BenchmarkSpanHandler : public ITransmissionControlInterface
+{
+public:
+    unsigned long messages;
+
+    BenchmarkSpanHandler();
+    void OutGateway(const String& data) override;
+    void OnUnencryptedDataReceived(const ByteSpan& data) override;
+};
+
+class BenchmarkStaticHandler : public TransmissionHandler
+{
+public:
+    unsigned long messages;
+
+    BenchmarkStaticHandler();
+    void OnUnencryptedDataReceived(const ByteSpan& data) { this->messages += (data.length > 0) ? 1 : 0; }
+};
+
+class TransportBenchmark : public ITransmissionControlInterface, public IRpcCallback, public IStreamSource, public ICommandHandler
+{
+public:
+    TransportBenchmark();
+    ~TransportBenchmark();
+
+    bool Begin(const BenchmarkConfig& config);
+    void Run();
+
+    const BenchmarkResult& GetResult(BenchmarkCase benchmarkCase) const;
+    void PrintJson(Print& output) const;
+
+    // application interface of the controllers under test
+    void OutGateway(const String& data) override;
+    void OnDataDecoded(const ByteSpan& data) override;
+    void OnUnencryptedDataReceived(const ByteSpan& data) override;
+
+    // completion of the calls of the rpc cases
+    void OnCallComplete(uint16_t callID, RpcStatus status, const CommandSpan& result) override;
+
+    // message of the stream cases
+    unsigned int Read(unsigned char* buffer, unsigned int size) override;
+    void OnStreamComplete(uint16_t streamID, bool success) override;
+
+    // handler of the commands of the dispatch cases
+    void OnCommand(uint32_t commandID, const CommandArguments& arguments) override;
+
+private:
+    BenchmarkConfig config;
+    BenchmarkResult results[BC_CASE_COUNT];
+
+    TransmissionControl control;
+    TransmissionControl splitControl;
+    TransmissionControl resyncControl;
+    BenchmarkStringHandler stringHandler;
+    BenchmarkSpanHandler spanHandler;
+    BenchmarkStaticHandler staticHandler;
+    TransmissionControl stringControl;
+    TransmissionControl spanControl;
+    TransmissionFrontEnd<BenchmarkStaticHandler> staticControl;
+    LoopbackServer server;
+    RpcEndpoint rpc;
+
+    String payload;
+    // encrypted frame of the payload and its parts
+    String encodedFrame;
+    TransmissionPackage encodedPackage;
+    String splitBuffer;
+    String resyncBuffer;
+    // single plain frame of the deliver cases
+    String deliverFrame;
+    itemCollection<TransmissionPackage> collection;
+
+    mbedtls_aes_context aes;
+    unsigned char aesKey[32];
+    unsigned long delivered;
+    unsigned long callsCompleted;
+    uint32_t streamPosition;
+    // tracked bytes at the start of the flow case and the most bytes seen while it runs
+    size_t flowBase;
+    size_t flowPeak;
+    // the status request of the control-under-bulk case and the sum of its round trips
+    unsigned long statusSent;
+    bool statusAnswered;
+    unsigned long statusLatency;
+    unsigned long statusAnswers;
+    BasicCommandRouter<BENCHMARK_DISPATCH_CAPACITY> dispatchRouter;
+    // the names must stay valid while they are registered, the payloads carry an argument
+    char dispatchNames[BENCHMARK_DISPATCH_COMMANDS][16];
+    char dispatchPayloads[BENCHMARK_DISPATCH_COMMANDS][20];
+    // encoded telemetry messages of the decode cases
+    unsigned char tlvMessage[BENCHMARK_TELEMETRY_MAX];
+    unsigned int tlvLength;
+    char textMessage[BENCHMARK_TELEMETRY_MAX];
+    unsigned int textLength;
+    String framePayload;
+
+    void measure(BenchmarkCase benchmarkCase);
+    void runCase(BenchmarkCase benchmarkCase, unsigned long iterations);
+    void prepareCase(BenchmarkCase benchmarkCase);
+    void finishCase(BenchmarkCase benchmarkCase);
+    void runCalls(unsigned int concurrency, unsigned long calls);
+    void runStream(uint32_t length);
+    void runFlow();
+    void runControlUnderBulk();
+    unsigned int encodeTelemetryTLV(unsigned long index, unsigned char* buffer, unsigned int size);
+    unsigned int encodeTelemetryText(unsigned long index, char* buffer, unsigned int size);
+    void decodeTelemetryTLV();
+    void decodeTelemetryText();
+    static unsigned int callConcurrency(BenchmarkCase benchmarkCase);
+    static uint32_t streamLength(BenchmarkCase benchmarkCase);
+    static unsigned int dispatchCommands(BenchmarkCase benchmarkCase);
+    static unsigned int framePayloadLength(BenchmarkCase benchmarkCase);
+    static const char* caseName(BenchmarkCase benchmarkCase);
+};
+
+#endif
@@ -0,0 +1,428 @@
+#include "Base64.h"
+
+#define BASE64_INVALID 0xFF
+#define BASE64_PAD '='
+
+// vectorized loops for the host builds on x86, selected at run time. The ESP32 has no vector unit and only uses
+// the scalar loops, no target of the project is an ARM host (so there is no NEON variant)
+#if BASE64_SIMD && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BASE64_X86
+#include <immintrin.h>
+#endif
+
+static const char base64Alphabet[65] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// value of every character, BASE64_INVALID for characters outside of the alphabet (including the padding)
+static const uint8_t base64Values[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x3E, 0xFF, 0xFF, 0xFF, 0x3F,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+    0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+#ifdef BASE64_X86
+// the lookup tables of the vector loops (W. Mula, D. Lemire: "Faster Base64 Encoding and Decoding using AVX2
+// Instructions"), the 256 bit loops use them in both lanes
+
+// every group of 3 bytes in the order [1, 0, 2, 1] for the shifts of the 6 bit values
+static const int8_t base64EncodeShuffle[16] = { 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10 };
+// offset from a value to its character: a-z, 0-9, '+', '/' and A-Z (see encodeGroups)
+static const int8_t base64EncodeOffsets[16] = {
+    'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+    '+' - 62, '/' - 63, 'A', 0, 0
+};
+// the valid high nibbles of a low nibble as bits and the bit of a high nibble, characters from 0x80 on have none
+static const uint8_t base64DecodeMasks[16] = {
+    0xA8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF0, 0x54, 0x50, 0x50, 0x50, 0x54
+};
+static const uint8_t base64DecodeBits[16] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0, 0, 0, 0, 0, 0, 0, 0 };
+// offset from a character to its value by the high nibble, '/' is 3 less than '+'
+static const int8_t base64DecodeOffsets[16] = { 0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0 };
+// the 3 bytes of every 32 bits in order, the last 4 bytes are not used
+static const int8_t base64DecodeShuffle[16] = { 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1 };
+
+enum Base64Vector
+{
+    BV_UNKNOWN,
+    BV_NONE,
+    BV_SSSE3,
+    BV_AVX2
+};
+
+static Base64Vector base64Vector = BV_UNKNOWN;
+
+static Base64Vector getBase64Vector()
+{
+    if(base64Vector == BV_UNKNOWN)
+    {
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+        {
+            base64Vector = BV_AVX2;
+        }
+        else if(__builtin_cpu_supports("ssse3"))
+        {
+            base64Vector = BV_SSSE3;
+        }
+        else
+        {
+            base64Vector = BV_NONE;
+        }
+    }
+    return base64Vector;
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i loadTable(const void* table)
+{
+    return _mm_loadu_si128((const __m128i*)table);
+}
+
+// 16 bytes with 4 groups of 3 bytes (and 4 unused bytes) to 16 characters
+__attribute__((target("ssse3")))
+static inline __m128i encodeGroups(__m128i input)
+{
+    __m128i shuffled = _mm_shuffle_epi8(input, loadTable(base64EncodeShuffle));
+    __m128i high = _mm_mulhi_epu16(_mm_and_si128(shuffled, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+    __m128i low = _mm_mullo_epi16(_mm_and_si128(shuffled, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+    __m128i values = _mm_or_si128(high, low);
+
+    // index of the offset: 0 for a-z, 1 to 10 for 0-9, 11 for '+', 12 for '/' and 13 for A-Z
+    __m128i index = _mm_subs_epu8(values, _mm_set1_epi8(51));
+    __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), values);
+    index = _mm_or_si128(index, _mm_and_si128(upper, _mm_set1_epi8(13)));
+    return _mm_add_epi8(values, _mm_shuffle_epi8(loadTable(base64EncodeOffsets), index));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i encodeGroups(__m256i input)
+{
+    __m256i shuffled = _mm256_shuffle_epi8(input, _mm256_broadcastsi128_si256(loadTable(base64EncodeShuffle)));
+    __m256i high = _mm256_mulhi_epu16(_mm256_and_si256(shuffled, _mm256_set1_epi32(0x0FC0FC00)), _mm256_set1_epi32(0x04000040));
+    __m256i low = _mm256_mullo_epi16(_mm256_and_si256(shuffled, _mm256_set1_epi32(0x003F03F0)), _mm256_set1_epi32(0x01000010));
+    __m256i values = _mm256_or_si256(high, low);
+
+    __m256i index = _mm256_subs_epu8(values, _mm256_set1_epi8(51));
+    __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), values);
+    index = _mm256_or_si256(index, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+    return _mm256_add_epi8(values, _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(loadTable(base64EncodeOffsets)), index));
+}
+
+// 16 characters to 4 groups of 3 bytes in the first 12 bytes, valid is false if a character is not in the alphabet
+__attribute__((target("ssse3")))
+static inline __m128i decodeGroups(__m128i input, bool& valid)
+{
+    __m128i highNibbles = _mm_and_si128(_mm_srli_epi32(input, 4), _mm_set1_epi8(0x0F));
+    __m128i lowNibbles = _mm_and_si128(input, _mm_set1_epi8(0x0F));
+
+    __m128i masks = _mm_shuffle_epi8(loadTable(base64DecodeMasks), lowNibbles);
+    __m128i bits = _mm_shuffle_epi8(loadTable(base64DecodeBits), highNibbles);
+    valid = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(masks, bits), _mm_setzero_si128())) == 0;
+
+    __m128i offsets = _mm_shuffle_epi8(loadTable(base64DecodeOffsets), highNibbles);
+    __m128i slash = _mm_cmpeq_epi8(input, _mm_set1_epi8('/'));
+    offsets = _mm_sub_epi8(offsets, _mm_and_si128(slash, _mm_set1_epi8(3)));
+    __m128i values = _mm_add_epi8(input, offsets);
+
+    // 4 values of 6 bits to 24 bits in every 32 bits
+    values = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    values = _mm_madd_epi16(values, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(values, loadTable(base64DecodeShuffle));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i decodeGroups(__m256i input, bool& valid)
+{
+    __m256i highNibbles = _mm256_and_si256(_mm256_srli_epi32(input, 4), _mm256_set1_epi8(0x0F));
+    __m256i lowNibbles = _mm256_and_si256(input, _mm256_set1_epi8(0x0F));
+
+    __m256i masks = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(loadTable(base64DecodeMasks)), lowNibbles);
+    __m256i bits = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(loadTable(base64DecodeBits)), highNibbles);
+    valid = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(masks, bits), _mm256_setzero_si256())) == 0;
+
+    __m256i offsets = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(loadTable(base64DecodeOffsets)), highNibbles);
+    __m256i slash = _mm256_cmpeq_epi8(input, _mm256_set1_epi8('/'));
+    offsets = _mm256_sub_epi8(offsets, _mm256_and_si256(slash, _mm256_set1_epi8(3)));
+    __m256i values = _mm256_add_epi8(input, offsets);
+
+    values = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+    values = _mm256_madd_epi16(values, _mm256_set1_epi32(0x00011000));
+    return _mm256_shuffle_epi8(values, _mm256_broadcastsi128_si256(loadTable(base64DecodeShuffle)));
+}
+
+// writes the first 12 bytes only, the output may be the input of the decoder and must not be overwritten ahead
+__attribute__((target("ssse3")))
+static inline void storeGroups(unsigned char* output, __m128i groups)
+{
+    uint32_t last = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(groups, 8));
+    _mm_storel_epi64((__m128i*)output, groups);
+    memcpy(output + 8, &last, sizeof(last));
+}
+
+__attribute__((target("ssse3")))
+static size_t encodeSSSE3(const unsigned char* data, size_t length, char* output)
+{
+    size_t position = 0;
+    // every step reads 16 bytes and encodes 12 of them
+    while(length - position >= 16)
+    {
+        __m128i input = _mm_loadu_si128((const __m128i*)(data + position));
+        _mm_storeu_si128((__m128i*)output, encodeGroups(input));
+        position += 12;
+        output += 16;
+    }
+    return position;
+}
+
+__attribute__((target("avx2")))
+static size_t encodeAVX2(const unsigned char* data, size_t length, char* output)
+{
+    size_t position = 0;
+    // the lanes read 16 bytes at 0 and at 12 and encode 12 bytes each
+    while(length - position >= 28)
+    {
+        __m256i input = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(data + position))),
+            _mm_loadu_si128((const __m128i*)(data + position + 12)), 1);
+        _mm256_storeu_si256((__m256i*)output, encodeGroups(input));
+        position += 24;
+        output += 32;
+    }
+    return position;
+}
+
+__attribute__((target("ssse3")))
+static size_t decodeSSSE3(const uint8_t* data, size_t length, unsigned char* output)
+{
+    size_t position = 0;
+    bool valid = true;
+    while(length - position >= 16)
+    {
+        __m128i groups = decodeGroups(_mm_loadu_si128((const __m128i*)(data + position)), valid);
+        if(!valid)
+        {
+            // the scalar loop stops at the invalid character
+            break;
+        }
+        storeGroups(output, groups);
+        position += 16;
+        output += 12;
+    }
+    return position;
+}
+
+__attribute__((target("avx2")))
+static size_t decodeAVX2(const uint8_t* data, size_t length, unsigned char* output)
+{
+    size_t position = 0;
+    bool valid = true;
+    while(length - position >= 32)
+    {
+        __m256i groups = decodeGroups(_mm256_loadu_si256((const __m256i*)(data + position)), valid);
+        if(!valid)
+        {
+            break;
+        }
+        storeGroups(output, _mm256_castsi256_si128(groups));
+        storeGroups(output + 12, _mm256_extracti128_si256(groups, 1));
+        position += 32;
+        output += 24;
+    }
+    return position;
+}
+
+// encodes the longest vector sized part of the data, returns the number of bytes encoded (a multiple of 3)
+static size_t encodeVector(const unsigned char* data, size_t length, char* output)
+{
+    switch(getBase64Vector())
+    {
+    case BV_AVX2:
+        return encodeAVX2(data, length, output);
+    case BV_SSSE3:
+        return encodeSSSE3(data, length, output);
+    default:
+        return 0;
+    }
+}
+
+// decodes the longest vector sized part of the complete groups up to the first invalid character, returns the number
+// of characters decoded (a multiple of 4)
+static size_t decodeVector(const uint8_t* data, size_t length, unsigned char* output)
+{
+    switch(getBase64Vector())
+    {
+    case BV_AVX2:
+        return decodeAVX2(data, length, output);
+    case BV_SSSE3:
+        return decodeSSSE3(data, length, output);
+    default:
+        return 0;
+    }
+}
+#else
+static size_t encodeVector(const unsigned char*, size_t, char*)
+{
+    return 0;
+}
+
+static size_t decodeVector(const uint8_t*, size_t, unsigned char*)
+{
+    return 0;
+}
+#endif
+
+size_t base64EncodedLength(size_t length)
+{
+    return BASE64_ENCODED_LENGTH(length);
+}
+
+size_t base64DecodedLength(const char* data, size_t length)
+{
+    if(data == nullptr || length == 0 || (length % 4) != 0)
+    {
+        return 0;
+    }
+
+    size_t decodedLength = (length / 4) * 3;
+    if(data[length - 1] == BASE64_PAD)
+    {
+        decodedLength--;
+        if(data[length - 2] == BASE64_PAD)
+        {
+            decodedLength--;
+        }
+    }
+    return decodedLength;
+}
+
+size_t base64Encode(const unsigned char* data, size_t length, char* output)
+{
+    size_t encoded = encodeVector(data, length, output);
+    size_t fullGroups = (length - encoded) / 3;
+    char* out = output + (encoded / 3) * 4;
+
+    data += encoded;
+    length -= encoded;
+
+    for(size_t i = 0; i < fullGroups; i++)
+    {
+        uint32_t group = ((uint32_t)data[0] << 16) | ((uint32_t)data[1] << 8) | (uint32_t)data[2];
+
+        out[0] = base64Alphabet[(group >> 18) & 0x3F];
+        out[1] = base64Alphabet[(group >> 12) & 0x3F];
+        out[2] = base64Alphabet[(group >> 6) & 0x3F];
+        out[3] = base64Alphabet[group & 0x3F];
+
+        data += 3;
+        out += 4;
+    }
+
+    switch(length - (fullGroups * 3))
+    {
+    case 1:
+        out[0] = base64Alphabet[data[0] >> 2];
+        out[1] = base64Alphabet[(data[0] & 0x03) << 4];
+        out[2] = BASE64_PAD;
+        out[3] = BASE64_PAD;
+        out += 4;
+        break;
+    case 2:
+        out[0] = base64Alphabet[data[0] >> 2];
+        out[1] = base64Alphabet[((data[0] & 0x03) << 4) | (data[1] >> 4)];
+        out[2] = base64Alphabet[(data[1] & 0x0F) << 2];
+        out[3] = BASE64_PAD;
+        out += 4;
+        break;
+    default:
+        break;
+    }
+    return (size_t)(out - output);
+}
+
+bool base64Decode(const char* data, size_t length, unsigned char* output, size_t outputSize, size_t& outLen)
+{
+    outLen = base64DecodedLength(data, length);
+
+    if(outLen == 0 || outLen > outputSize)
+    {
+        outLen = 0;
+        return false;
+    }
+
+    const uint8_t* in = (const uint8_t*)data;
+    size_t decoded = decodeVector(in, length - 4, output);
+    unsigned char* out = output + (decoded / 4) * 3;
+    size_t fullGroups = ((length - decoded) / 4) - 1;
+
+    in += decoded;
+
+    // all groups except the last one are complete, the output never overtakes the input (3 bytes per 4 characters)
+    for(size_t i = 0; i < fullGroups; i++)
+    {
+        uint8_t a = base64Values[in[0]];
+        uint8_t b = base64Values[in[1]];
+        uint8_t c = base64Values[in[2]];
+        uint8_t d = base64Values[in[3]];
+
+        if((a | b | c | d) & 0x80)
+        {
+            outLen = 0;
+            return false;
+        }
+
+        uint32_t group = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6) | (uint32_t)d;
+        out[0] = (unsigned char)(group >> 16);
+        out[1] = (unsigned char)(group >> 8);
+        out[2] = (unsigned char)group;
+
+        in += 4;
+        out += 3;
+    }
+
+    // last group with optional padding
+    uint8_t a = base64Values[in[0]];
+    uint8_t b = base64Values[in[1]];
+    uint8_t c = (in[2] == BASE64_PAD) ? 0 : base64Values[in[2]];
+    uint8_t d = (in[3] == BASE64_PAD) ? 0 : base64Values[in[3]];
+
+    // a padding in the third position requires one in the fourth
+    if(((a | b | c | d) & 0x80) || (in[2] == BASE64_PAD && in[3] != BASE64_PAD))
+    {
+        outLen = 0;
+        return false;
+    }
+
+    uint32_t group = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6) | (uint32_t)d;
+    size_t remaining = outLen - (size_t)(out - output);
+
+    // the bits which are not part of the output must be zero (canonical encoding)
+    if((remaining == 1 && (group & 0xFFFF) != 0) || (remaining == 2 && (group & 0xFF) != 0))
+    {
+        outLen = 0;
+        return false;
+    }
+
+    out[0] = (unsigned char)(group >> 16);
+    if(remaining > 1)
+    {
+        out[1] = (unsigned char)(group >> 8);
+    }
+    if(remaining > 2)
+    {
+        out[2] = (unsigned char)group;
+    }
+    return true;
+}
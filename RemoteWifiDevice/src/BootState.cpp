@@ -0,0 +1,211 @@
+#include "BootState.h"
+#include "Checksum.h"
+
+#define BOOT_STATE_MAGIC 0x31545342  // "BST1"
+
+/*   Stored Record Layout: magic (4 bytes), state (sizeof(BootState) bytes), crc-32 of magic and state (4 bytes)
+ *
+ *   The size of the state is part of the magic, so a state of a firmware with another layout is not loaded.
+ */
+#define BOOT_STATE_RECORD_SIZE (4 + sizeof(BootState) + 4)
+
+static uint32_t recordMagic()
+{
+    return BOOT_STATE_MAGIC ^ (uint32_t)sizeof(BootState);
+}
+
+static void packRecord(const BootState& state, unsigned char* record)
+{
+    uint32_t magic = recordMagic();
+    memcpy(record, &magic, 4);
+    memcpy(record + 4, &state, sizeof(BootState));
+
+    uint32_t crc = crc32Update(0, record, 4 + sizeof(BootState));
+    memcpy(record + 4 + sizeof(BootState), &crc, 4);
+}
+
+static bool unpackRecord(const unsigned char* record, BootState& state)
+{
+    uint32_t magic = 0;
+    uint32_t crc = 0;
+    memcpy(&magic, record, 4);
+    memcpy(&crc, record + 4 + sizeof(BootState), 4);
+
+    if(magic != recordMagic() || crc != crc32Update(0, record, 4 + sizeof(BootState)))
+    {
+        return false;
+    }
+    memcpy(&state, record + 4, sizeof(BootState));
+
+    // terminate the hostname in any case
+    state.serverHostname[BOOT_STATE_HOSTNAME_SIZE - 1] = '\0';
+    return true;
+}
+
+BootState::BootState()
+{
+    this->Clear();
+}
+
+void BootState::Clear()
+{
+    this->flags = 0;
+    this->serverAddress = 0;
+    this->serverPort = 0;
+    memset(this->serverHostname, 0, sizeof(this->serverHostname));
+    this->wifiChannel = 0;
+    memset(this->wifiBssid, 0, sizeof(this->wifiBssid));
+}
+
+bool BootState::HasServer() const
+{
+    return (this->flags & BOOT_STATE_SERVER) != 0;
+}
+
+bool BootState::HasWifi() const
+{
+    return (this->flags & BOOT_STATE_WIFI) != 0;
+}
+
+void BootState::SetServer(uint32_t address, uint16_t port, const String& hostname)
+{
+    this->serverAddress = address;
+    this->serverPort = port;
+
+    memset(this->serverHostname, 0, sizeof(this->serverHostname));
+    strncpy(this->serverHostname, hostname.c_str(), BOOT_STATE_HOSTNAME_SIZE - 1);
+
+    this->flags |= BOOT_STATE_SERVER;
+}
+
+void BootState::SetWifi(int32_t channel, const uint8_t* bssid)
+{
+    this->wifiChannel = channel;
+    memcpy(this->wifiBssid, bssid, sizeof(this->wifiBssid));
+
+    this->flags |= BOOT_STATE_WIFI;
+}
+
+bool BootState::operator==(const BootState& other) const
+{
+    return (this->flags == other.flags)
+        && (this->serverAddress == other.serverAddress)
+        && (this->serverPort == other.serverPort)
+        && (strcmp(this->serverHostname, other.serverHostname) == 0)
+        && (this->wifiChannel == other.wifiChannel)
+        && (memcmp(this->wifiBssid, other.wifiBssid, sizeof(this->wifiBssid)) == 0);
+}
+
+bool BootState::operator!=(const BootState& other) const
+{
+    return !(*this == other);
+}
+
+FileBootStateStore::FileBootStateStore(const char* _path)
+: path(_path)
+{}
+
+bool FileBootStateStore::Load(BootState& state)
+{
+    unsigned char record[BOOT_STATE_RECORD_SIZE];
+
+    auto file = fopen(this->path.c_str(), "rb");
+    if(file == nullptr)
+    {
+        return false;
+    }
+    bool complete = (fread(record, 1, sizeof(record), file) == sizeof(record));
+    fclose(file);
+
+    return complete && unpackRecord(record, state);
+}
+
+bool FileBootStateStore::Save(const BootState& state)
+{
+    unsigned char record[BOOT_STATE_RECORD_SIZE];
+    packRecord(state, record);
+
+    auto file = fopen(this->path.c_str(), "wb");
+    if(file == nullptr)
+    {
+        return false;
+    }
+    bool written = (fwrite(record, 1, sizeof(record), file) == sizeof(record));
+    return (fclose(file) == 0) && written;
+}
+
+void FileBootStateStore::Clear()
+{
+    remove(this->path.c_str());
+}
+
+#ifdef ESP32
+// kept during deep sleep, zeroed on a cold boot (raw bytes, a constructor would run on every wake up)
+RTC_DATA_ATTR static unsigned char rtcRecord[BOOT_STATE_RECORD_SIZE];
+
+RtcBootStateStore::RtcBootStateStore()
+: warmStart(false)
+{}
+
+bool RtcBootStateStore::Load(BootState& state)
+{
+    if(unpackRecord(rtcRecord, state))
+    {
+        this->warmStart = true;
+        return true;
+    }
+    this->warmStart = false;
+
+    unsigned char record[BOOT_STATE_RECORD_SIZE];
+    bool result = false;
+
+    if(this->preferences.begin("boot", true))
+    {
+        result = (this->preferences.getBytes("state", record, sizeof(record)) == sizeof(record))
+            && unpackRecord(record, state);
+        this->preferences.end();
+    }
+    if(result)
+    {
+        // the next wake up can use the rtc copy
+        memcpy(rtcRecord, record, sizeof(record));
+    }
+    return result;
+}
+
+bool RtcBootStateStore::Save(const BootState& state)
+{
+    BootState previous;
+    bool changed = !unpackRecord(rtcRecord, previous) || (previous != state);
+
+    packRecord(state, rtcRecord);
+
+    if(!changed)
+    {
+        return true;
+    }
+    if(!this->preferences.begin("boot", false))
+    {
+        return false;
+    }
+    bool result = (this->preferences.putBytes("state", rtcRecord, sizeof(rtcRecord)) == sizeof(rtcRecord));
+    this->preferences.end();
+    return result;
+}
+
+void RtcBootStateStore::Clear()
+{
+    memset(rtcRecord, 0, sizeof(rtcRecord));
+
+    if(this->preferences.begin("boot", false))
+    {
+        this->preferences.clear();
+        this->preferences.end();
+    }
+}
+
+bool RtcBootStateStore::IsWarmStart() const
+{
+    return this->warmStart;
+}
+#endif
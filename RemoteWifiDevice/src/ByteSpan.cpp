@@ -0,0 +1,44 @@
+#include "ByteSpan.h"
+
+ByteSpan::ByteSpan()
+: data(nullptr), length(0)
+{}
+
+ByteSpan::ByteSpan(const unsigned char* _data, unsigned int _length)
+: data(_data), length(_length)
+{}
+
+ByteSpan ByteSpan::FromString(const String& text)
+{
+    return ByteSpan((const unsigned char*)text.c_str(), text.length());
+}
+
+bool ByteSpan::Equals(const char* text) const
+{
+    if(text == nullptr)
+    {
+        return false;
+    }
+    return (strlen(text) == this->length) && (memcmp(text, this->data, this->length) == 0);
+}
+
+bool ByteSpan::StartsWith(const char* text) const
+{
+    if(text == nullptr)
+    {
+        return false;
+    }
+    auto textLength = strlen(text);
+    return (textLength <= this->length) && (memcmp(text, this->data, textLength) == 0);
+}
+
+String ByteSpan::ToString() const
+{
+    String result;
+    if(this->length > 0)
+    {
+        result.reserve(this->length);
+        result.concat((const char*)this->data, this->length);
+    }
+    return result;
+}
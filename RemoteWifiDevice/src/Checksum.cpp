@@ -0,0 +1,29 @@
+#include "Checksum.h"
+
+#ifdef ESP32
+#include "esp32/rom/crc.h"
+#endif
+
+uint32_t crc32Update(uint32_t crc, const unsigned char* data, size_t length)
+{
+    if(data == nullptr || length == 0)
+    {
+        return crc;
+    }
+
+#ifdef ESP32
+    return crc32_le(crc, data, length);
+#else
+    crc = ~crc;
+
+    for(size_t i = 0; i < length; i++)
+    {
+        crc ^= data[i];
+        for(unsigned int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & (~(crc & 1) + 1));
+        }
+    }
+    return ~crc;
+#endif
+}
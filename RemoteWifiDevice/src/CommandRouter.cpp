@@ -0,0 +1,237 @@
+#include "CommandRouter.h"
+
+CommandSpan::CommandSpan()
+: data(nullptr), length(0)
+{}
+
+CommandSpan::CommandSpan(const char* _data, unsigned int _length)
+: data(_data), length(_length)
+{}
+
+bool CommandSpan::Equals(const char* text) const
+{
+    if(text == nullptr)
+    {
+        return false;
+    }
+    return (strlen(text) == this->length) && (memcmp(text, this->data, this->length) == 0);
+}
+
+long CommandSpan::ToInt() const
+{
+    long value = 0;
+    bool negative = false;
+    unsigned int i = 0;
+
+    if(this->length > 0 && this->data[0] == '-')
+    {
+        negative = true;
+        i++;
+    }
+    for(; i < this->length; i++)
+    {
+        char c = this->data[i];
+        if(c < '0' || c > '9')
+        {
+            break;
+        }
+        value = (value * 10) + (c - '0');
+    }
+    return negative ? -value : value;
+}
+
+String CommandSpan::ToString() const
+{
+    String result;
+    if(this->length > 0)
+    {
+        result.reserve(this->length);
+        result.concat(this->data, this->length);
+    }
+    return result;
+}
+
+CommandArguments::CommandArguments(const char* data, unsigned int length)
+: raw(data, length), argumentCount(0)
+{
+    if(length == 0)
+    {
+        return;
+    }
+
+    unsigned int start = 0;
+
+    for(unsigned int i = 0; i < length; i++)
+    {
+        if(data[i] == COMMAND_DELIMITER && this->argumentCount < (COMMAND_MAX_ARGUMENTS - 1))
+        {
+            this->arguments[this->argumentCount] = CommandSpan(data + start, i - start);
+            this->argumentCount++;
+            start = i + 1;
+        }
+    }
+    // the last argument takes the rest
+    this->arguments[this->argumentCount] = CommandSpan(data + start, length - start);
+    this->argumentCount++;
+}
+
+unsigned int CommandArguments::GetCount() const
+{
+    return this->argumentCount;
+}
+
+CommandSpan CommandArguments::GetAt(unsigned int index) const
+{
+    return (index < this->argumentCount) ? this->arguments[index] : CommandSpan();
+}
+
+CommandSpan CommandArguments::GetRaw() const
+{
+    return this->raw;
+}
+
+CommandDispatcher::CommandDispatcher(RouteEntry* table, unsigned int capacity)
+: routes(table), mask(capacity - 1), routeCount(0)
+{
+    memset(this->routes, 0, capacity * sizeof(RouteEntry));
+}
+
+bool CommandDispatcher::Register(const char* command, ICommandHandler* handler)
+{
+    if(command == nullptr || handler == nullptr)
+    {
+        return false;
+    }
+
+    // keep the load factor at or below 50 percent, so probe sequences stay short
+    if(this->routeCount >= (this->GetCapacity() / 2))
+    {
+        return false;
+    }
+
+    unsigned int length = strlen(command);
+    uint32_t hash = commandHash(command);
+
+    if(this->find(hash, command, length) != nullptr)
+    {
+        return false;
+    }
+
+    unsigned int index = hash & this->mask;
+    while(this->routes[index].handler != nullptr)
+    {
+        index = (index + 1) & this->mask;
+    }
+
+    this->routes[index].hash = hash;
+    this->routes[index].command = command;
+    this->routes[index].length = length;
+    this->routes[index].handler = handler;
+    this->routeCount++;
+
+    return true;
+}
+
+void CommandDispatcher::Unregister(const char* command)
+{
+    if(command == nullptr)
+    {
+        return;
+    }
+
+    unsigned int length = strlen(command);
+    uint32_t hash = commandHash(command);
+
+    auto entry = this->find(hash, command, length);
+    if(entry != nullptr)
+    {
+        unsigned int index = (unsigned int)(entry - this->routes);
+        memset(&this->routes[index], 0, sizeof(RouteEntry));
+        this->routeCount--;
+
+        // re-insert the following entries of the probe sequence, so no entry becomes unreachable
+        index = (index + 1) & this->mask;
+        while(this->routes[index].handler != nullptr)
+        {
+            RouteEntry moved = this->routes[index];
+            memset(&this->routes[index], 0, sizeof(RouteEntry));
+
+            unsigned int target = moved.hash & this->mask;
+            while(this->routes[target].handler != nullptr)
+            {
+                target = (target + 1) & this->mask;
+            }
+            this->routes[target] = moved;
+
+            index = (index + 1) & this->mask;
+        }
+    }
+}
+
+unsigned int CommandDispatcher::GetCount() const
+{
+    return this->routeCount;
+}
+
+unsigned int CommandDispatcher::GetCapacity() const
+{
+    return this->mask + 1;
+}
+
+bool CommandDispatcher::Dispatch(const char* data, unsigned int length) const
+{
+    if(data == nullptr || length == 0 || this->routeCount == 0)
+    {
+        return false;
+    }
+
+    const RouteEntry* match = nullptr;
+    uint32_t hash = COMMAND_HASH_OFFSET;
+
+    for(unsigned int i = 0; i <= length; i++)
+    {
+        if(i == length || data[i] == COMMAND_DELIMITER)
+        {
+            // the hash of data[0..i) is complete, look up this prefix
+            auto entry = this->find(hash, data, i);
+            if(entry != nullptr)
+            {
+                match = entry;
+            }
+            if(i == length)
+            {
+                break;
+            }
+        }
+        hash = (hash ^ (uint8_t)data[i]) * COMMAND_HASH_PRIME;
+    }
+
+    if(match == nullptr)
+    {
+        return false;
+    }
+
+    // skip the delimiter after the command
+    unsigned int argumentOffset = (match->length < length) ? (match->length + 1) : length;
+
+    CommandArguments arguments(data + argumentOffset, length - argumentOffset);
+    match->handler->OnCommand(match->hash, arguments);
+
+    return true;
+}
+
+const CommandDispatcher::RouteEntry* CommandDispatcher::find(uint32_t hash, const char* data, unsigned int length) const
+{
+    unsigned int index = hash & this->mask;
+
+    while(this->routes[index].handler != nullptr)
+    {
+        const RouteEntry& entry = this->routes[index];
+        if(entry.hash == hash && entry.length == length && memcmp(entry.command, data, length) == 0)
+        {
+            return &entry;
+        }
+        index = (index + 1) & this->mask;
+    }
+    return nullptr;
+}
@@ -0,0 +1,230 @@
+#include "ConnectionManager.h"
+
+static bool timeReached(unsigned long now, unsigned long time)
+{
+    return (long)(now - time) >= 0;
+}
+
+WiFiClientTransport::WiFiClientTransport(WiFiClient& _client)
+: client(_client)
+{}
+
+bool WiFiClientTransport::Connect(const IPAddress& address, uint16_t port)
+{
+    if(!this->client.connect(address, port))
+    {
+        return false;
+    }
+    this->client.setNoDelay(true);
+    return true;
+}
+
+bool WiFiClientTransport::IsConnected()
+{
+    return this->client.connected();
+}
+
+void WiFiClientTransport::Disconnect()
+{
+    this->client.stop();
+}
+
+ConnectionManager::ConnectionManager()
+: transport(nullptr), controller(nullptr), discovery(nullptr), listener(nullptr), state(CS_WAITING),
+  keepaliveInterval(CONNECTION_KEEPALIVE_INTERVAL), deadPeerTimeout(CONNECTION_DEAD_PEER_TIMEOUT),
+  nextAttempt(0), failedAttempts(0), connectedSince(0), keepaliveSent(0), connects(0), deadPeers(0), randomState(1)
+{}
+
+void ConnectionManager::Begin(IConnectionTransport* _transport, TransmissionControl* _controller, ServiceDiscovery* _discovery, uint32_t seed)
+{
+    this->transport = _transport;
+    this->controller = _controller;
+    this->discovery = _discovery;
+    this->randomState = (seed != 0) ? seed : 1;
+
+    // the first attempt is jittered as well, a fleet is often powered up at the same time
+    this->scheduleAttempt();
+}
+
+void ConnectionManager::SetListener(IConnectionListener* _listener)
+{
+    this->listener = _listener;
+}
+
+void ConnectionManager::SetKeepalive(unsigned long interval, unsigned long _deadPeerTimeout)
+{
+    this->keepaliveInterval = interval;
+    this->deadPeerTimeout = _deadPeerTimeout;
+}
+
+void ConnectionManager::OnLoop()
+{
+    if(this->transport == nullptr)
+    {
+        return;
+    }
+
+    if(this->state == CS_CONNECTED)
+    {
+        if(!this->transport->IsConnected())
+        {
+            TRACE_INFO(TE_CONNECTION_LOST, millis() - this->connectedSince, 0);
+            this->onConnectionLost();
+            return;
+        }
+        if(this->failedAttempts > 0 && timeReached(millis(), this->connectedSince + CONNECTION_STABLE_TIME))
+        {
+            this->failedAttempts = 0;
+        }
+        this->checkPeer();
+    }
+    else if(timeReached(millis(), this->nextAttempt))
+    {
+        this->tryConnect();
+    }
+}
+
+void ConnectionManager::ConnectNow()
+{
+    this->nextAttempt = millis();
+}
+
+ConnectionState ConnectionManager::GetState() const
+{
+    return this->state;
+}
+
+unsigned long ConnectionManager::GetNextAttempt() const
+{
+    return this->nextAttempt;
+}
+
+unsigned int ConnectionManager::GetFailedAttempts() const
+{
+    return this->failedAttempts;
+}
+
+unsigned long ConnectionManager::GetConnects() const
+{
+    return this->connects;
+}
+
+unsigned long ConnectionManager::GetDeadPeers() const
+{
+    return this->deadPeers;
+}
+
+void ConnectionManager::tryConnect()
+{
+    DiscoveredServer server;
+
+    if(this->discovery == nullptr || !this->discovery->SelectServer(server))
+    {
+        // no server known yet, look again after the base delay (this is not a failed attempt)
+        this->nextAttempt = millis() + CONNECTION_BACKOFF_BASE;
+        return;
+    }
+
+    auto connectStart = millis();
+    bool connected = this->transport->Connect(server.address, server.port);
+    this->discovery->ReportConnectResult(server, connected, millis() - connectStart);
+
+    if(!connected)
+    {
+        this->failedAttempts++;
+        TRACE_INFO(TE_CONNECTION_FAILED, this->failedAttempts, server.port);
+        this->scheduleAttempt();
+        return;
+    }
+
+    this->state = CS_CONNECTED;
+    this->connectedSince = millis();
+    this->keepaliveSent = this->connectedSince;
+    this->connects++;
+
+    TRACE_INFO(TE_CONNECTION_ESTABLISHED, this->connects, server.port);
+
+    if(this->controller != nullptr)
+    {
+        this->controller->OnClientConnected();
+    }
+    if(this->listener != nullptr)
+    {
+        this->listener->OnConnected(server);
+    }
+}
+
+void ConnectionManager::onConnectionLost()
+{
+    this->transport->Disconnect();
+    this->state = CS_WAITING;
+
+    // a connection which drops right away counts as a failed attempt, so a server which accepts and closes
+    // connections does not get a reconnect after the shortest delay every time
+    if(!timeReached(millis(), this->connectedSince + CONNECTION_STABLE_TIME))
+    {
+        this->failedAttempts++;
+    }
+
+    if(this->controller != nullptr)
+    {
+        this->controller->OnClientDisconnected();
+    }
+    if(this->listener != nullptr)
+    {
+        this->listener->OnDisconnected();
+    }
+    this->scheduleAttempt();
+}
+
+void ConnectionManager::scheduleAttempt()
+{
+    unsigned long backoff = CONNECTION_BACKOFF_BASE;
+    for(unsigned int i = 0; i < this->failedAttempts && backoff < CONNECTION_BACKOFF_CAP; i++)
+    {
+        backoff *= 2;
+    }
+    if(backoff > CONNECTION_BACKOFF_CAP)
+    {
+        backoff = CONNECTION_BACKOFF_CAP;
+    }
+
+    this->nextAttempt = millis() + (this->nextRandom() % (backoff + 1));
+}
+
+void ConnectionManager::checkPeer()
+{
+    if(this->controller == nullptr)
+    {
+        return;
+    }
+
+    auto now = millis();
+    auto idle = now - this->controller->GetLastReceiveTime();
+
+    if(idle >= this->deadPeerTimeout)
+    {
+        // the socket still looks open, but the peer has not even confirmed the keepalives
+        this->deadPeers++;
+        TRACE_INFO(TE_CONNECTION_DEAD_PEER, idle, 0);
+        this->onConnectionLost();
+        return;
+    }
+
+    if(idle >= this->keepaliveInterval && timeReached(now, this->keepaliveSent + this->keepaliveInterval))
+    {
+        this->keepaliveSent = now;
+        this->controller->SendKeepalive();
+    }
+}
+
+uint32_t ConnectionManager::nextRandom()
+{
+    // xorshift32
+    uint32_t x = this->randomState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    this->randomState = x;
+    return x;
+}
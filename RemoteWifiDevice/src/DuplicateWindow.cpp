@@ -0,0 +1,52 @@
+#include "DuplicateWindow.h"
+
+DuplicateWindow::DuplicateWindow()
+{
+    this->Reset();
+}
+
+bool DuplicateWindow::CheckAndMark(unsigned int transmissionID)
+{
+    transmissionID &= TRANSMISSION_ID_MASK;
+
+    if(this->empty)
+    {
+        this->empty = false;
+        this->highestID = transmissionID;
+        this->bitmap = 1;
+        return false;
+    }
+
+    // signed distance to the highest ID, wrap-aware for the 16 bit ID field
+    int16_t distance = (int16_t)(uint16_t)(transmissionID - this->highestID);
+
+    if(distance > 0)
+    {
+        // newer ID, advance the window
+        this->bitmap = (distance >= DUPLICATE_WINDOW_SIZE) ? 0 : (this->bitmap << distance);
+        this->bitmap |= 1;
+        this->highestID = transmissionID;
+        return false;
+    }
+
+    unsigned int offset = (unsigned int)(-distance);
+    if(offset >= DUPLICATE_WINDOW_SIZE)
+    {
+        return true;
+    }
+
+    uint64_t mask = ((uint64_t)1) << offset;
+    if(this->bitmap & mask)
+    {
+        return true;
+    }
+    this->bitmap |= mask;
+    return false;
+}
+
+void DuplicateWindow::Reset()
+{
+    this->bitmap = 0;
+    this->highestID = 0;
+    this->empty = true;
+}
@@ -0,0 +1,246 @@
+#include "FirmwareStorage.h"
+
+FirmwareProgress::FirmwareProgress()
+: imageSize(0), offset(0)
+{
+    memset(this->hash, 0, sizeof(this->hash));
+}
+
+bool FirmwareProgress::Matches(const char* _hash, uint32_t _imageSize) const
+{
+    return (this->imageSize == _imageSize)
+        && (strncmp(this->hash, _hash, FIRMWARE_HASH_HEX_LENGTH) == 0)
+        && (this->offset <= _imageSize);
+}
+
+FileFirmwareStorage::FileFirmwareStorage(const char* _path)
+: path(_path), file(nullptr)
+{
+    this->progressPath = this->path;
+    this->progressPath += ".progress";
+}
+
+FileFirmwareStorage::~FileFirmwareStorage()
+{
+    this->close();
+}
+
+bool FileFirmwareStorage::Begin(uint32_t imageSize, uint32_t resumeOffset)
+{
+    this->close();
+
+    if(resumeOffset > 0)
+    {
+        // keep the data which was written before the interruption
+        this->file = fopen(this->path.c_str(), "r+b");
+    }
+    if(this->file == nullptr)
+    {
+        if(resumeOffset > 0)
+        {
+            return false;
+        }
+        this->file = fopen(this->path.c_str(), "w+b");
+    }
+    return (this->file != nullptr);
+}
+
+bool FileFirmwareStorage::Write(uint32_t offset, const unsigned char* data, unsigned int length)
+{
+    if(this->file == nullptr || fseek(this->file, offset, SEEK_SET) != 0)
+    {
+        return false;
+    }
+    if(fwrite(data, 1, length, this->file) != length)
+    {
+        return false;
+    }
+    // the progress is saved after this write, so the data has to be on the storage
+    return (fflush(this->file) == 0);
+}
+
+bool FileFirmwareStorage::Read(uint32_t offset, unsigned char* buffer, unsigned int length)
+{
+    if(this->file == nullptr || fseek(this->file, offset, SEEK_SET) != 0)
+    {
+        return false;
+    }
+    return (fread(buffer, 1, length, this->file) == length);
+}
+
+bool FileFirmwareStorage::Finalize()
+{
+    if(this->file == nullptr)
+    {
+        return false;
+    }
+    bool result = (fflush(this->file) == 0);
+    this->close();
+    return result;
+}
+
+void FileFirmwareStorage::Abort()
+{
+    this->close();
+}
+
+bool FileFirmwareStorage::LoadProgress(FirmwareProgress& progress)
+{
+    FILE* progressFile = fopen(this->progressPath.c_str(), "rb");
+    if(progressFile == nullptr)
+    {
+        return false;
+    }
+
+    char hash[FIRMWARE_HASH_HEX_LENGTH + 1] = { 0 };
+    unsigned long imageSize = 0;
+    unsigned long offset = 0;
+
+    auto fields = fscanf(progressFile, "%64s %lx %lx", hash, &imageSize, &offset);
+    fclose(progressFile);
+
+    if(fields != 3)
+    {
+        return false;
+    }
+
+    memcpy(progress.hash, hash, sizeof(progress.hash));
+    progress.imageSize = imageSize;
+    progress.offset = offset;
+    return true;
+}
+
+bool FileFirmwareStorage::SaveProgress(const FirmwareProgress& progress)
+{
+    FILE* progressFile = fopen(this->progressPath.c_str(), "wb");
+    if(progressFile == nullptr)
+    {
+        return false;
+    }
+
+    bool result = fprintf(progressFile, "%s %lx %lx\n",
+        progress.hash, (unsigned long)progress.imageSize, (unsigned long)progress.offset) > 0;
+
+    return (fclose(progressFile) == 0) && result;
+}
+
+void FileFirmwareStorage::ClearProgress()
+{
+    remove(this->progressPath.c_str());
+}
+
+void FileFirmwareStorage::close()
+{
+    if(this->file != nullptr)
+    {
+        fclose(this->file);
+        this->file = nullptr;
+    }
+}
+
+#ifdef ESP32
+
+PartitionFirmwareStorage::PartitionFirmwareStorage()
+: partition(nullptr)
+{}
+
+bool PartitionFirmwareStorage::Begin(uint32_t imageSize, uint32_t resumeOffset)
+{
+    this->partition = esp_ota_get_next_update_partition(nullptr);
+
+    if(this->partition == nullptr || imageSize > this->partition->size)
+    {
+        this->partition = nullptr;
+        return false;
+    }
+    // the blocks are erased when they are written, a resumed update keeps the blocks before the offset
+    return true;
+}
+
+bool PartitionFirmwareStorage::Write(uint32_t offset, const unsigned char* data, unsigned int length)
+{
+    if(this->partition == nullptr)
+    {
+        return false;
+    }
+
+    uint32_t eraseLength = ((length + FIRMWARE_BLOCK_SIZE - 1) / FIRMWARE_BLOCK_SIZE) * FIRMWARE_BLOCK_SIZE;
+
+    if(esp_partition_erase_range(this->partition, offset, eraseLength) != ESP_OK)
+    {
+        return false;
+    }
+    return (esp_partition_write(this->partition, offset, data, length) == ESP_OK);
+}
+
+bool PartitionFirmwareStorage::Read(uint32_t offset, unsigned char* buffer, unsigned int length)
+{
+    if(this->partition == nullptr)
+    {
+        return false;
+    }
+    return (esp_partition_read(this->partition, offset, buffer, length) == ESP_OK);
+}
+
+bool PartitionFirmwareStorage::Finalize()
+{
+    if(this->partition == nullptr)
+    {
+        return false;
+    }
+    // this also validates the image header and the checksum of the application
+    return (esp_ota_set_boot_partition(this->partition) == ESP_OK);
+}
+
+void PartitionFirmwareStorage::Abort()
+{
+    this->partition = nullptr;
+}
+
+bool PartitionFirmwareStorage::LoadProgress(FirmwareProgress& progress)
+{
+    if(!this->preferences.begin("ota", true))
+    {
+        return false;
+    }
+
+    bool result = false;
+    String hash = this->preferences.getString("hash");
+
+    if(hash.length() == FIRMWARE_HASH_HEX_LENGTH)
+    {
+        memcpy(progress.hash, hash.c_str(), FIRMWARE_HASH_HEX_LENGTH + 1);
+        progress.imageSize = this->preferences.getUInt("size");
+        progress.offset = this->preferences.getUInt("offset");
+        result = true;
+    }
+    this->preferences.end();
+    return result;
+}
+
+bool PartitionFirmwareStorage::SaveProgress(const FirmwareProgress& progress)
+{
+    if(!this->preferences.begin("ota", false))
+    {
+        return false;
+    }
+
+    bool result =
+        (this->preferences.putString("hash", progress.hash) > 0)
+        && (this->preferences.putUInt("size", progress.imageSize) > 0)
+        && (this->preferences.putUInt("offset", progress.offset) > 0);
+
+    this->preferences.end();
+    return result;
+}
+
+void PartitionFirmwareStorage::ClearProgress()
+{
+    if(this->preferences.begin("ota", false))
+    {
+        this->preferences.clear();
+        this->preferences.end();
+    }
+}
+
+#endif
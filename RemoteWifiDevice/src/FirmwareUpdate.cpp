@@ -0,0 +1,664 @@
+#include "FirmwareUpdate.h"
+
+static bool parseDigest(const char* hex, unsigned char* digest)
+{
+    for(unsigned int i = 0; i < FIRMWARE_DIGEST_SIZE; i++)
+    {
+        char byte[3] = { hex[i * 2], hex[(i * 2) + 1], '\0' };
+        char* end = nullptr;
+
+        digest[i] = (unsigned char)strtoul(byte, &end, 16);
+        if(end != (byte + 2))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+FirmwareUpdate::FirmwareUpdate()
+: controller(nullptr),
+  storage(nullptr),
+  state(US_IDLE),
+  publicKeyLoaded(false),
+  receivedOffset(0),
+  streamID(0),
+  streamBound(false),
+  buffers(nullptr),
+  fillBuffer(nullptr),
+  writeFailed(false),
+  signatureLength(0),
+  verifiedOffset(0)
+#ifdef ESP32
+  , progressLock(nullptr),
+  freeBuffers(nullptr),
+  filledBuffers(nullptr),
+  writerTask(nullptr)
+#endif
+{
+    mbedtls_pk_init(&this->publicKey);
+    mbedtls_sha256_init(&this->hash);
+}
+
+FirmwareUpdate::~FirmwareUpdate()
+{
+    this->releaseBuffers();
+    mbedtls_sha256_free(&this->hash);
+    mbedtls_pk_free(&this->publicKey);
+
+#ifdef ESP32
+    if(this->progressLock != nullptr)
+    {
+        vSemaphoreDelete(this->progressLock);
+    }
+#endif
+}
+
+bool FirmwareUpdate::Begin(TransmissionControl* _controller, IFirmwareStorage* _storage, const char* _publicKey)
+{
+    this->controller = _controller;
+    this->storage = _storage;
+
+    if(this->controller == nullptr || this->storage == nullptr || _publicKey == nullptr)
+    {
+        return false;
+    }
+
+    mbedtls_pk_free(&this->publicKey);
+    mbedtls_pk_init(&this->publicKey);
+
+    // the length of a pem key includes the terminator
+    this->publicKeyLoaded =
+        (mbedtls_pk_parse_public_key(&this->publicKey, (const unsigned char*)_publicKey, strlen(_publicKey) + 1) == 0)
+        && mbedtls_pk_can_do(&this->publicKey, MBEDTLS_PK_RSA);
+
+    if(!this->publicKeyLoaded)
+    {
+        return false;
+    }
+
+#ifdef ESP32
+    if(this->progressLock == nullptr)
+    {
+        this->progressLock = xSemaphoreCreateMutex();
+
+        if(this->progressLock == nullptr)
+        {
+            return false;
+        }
+    }
+#endif
+    return this->controller->RegisterCommand("ota:begin", this)
+        && this->controller->RegisterCommand("ota:abort", this);
+}
+
+void FirmwareUpdate::OnLoop()
+{
+    if(this->state != US_VERIFYING)
+    {
+        return;
+    }
+
+    // hash the data as it is stored, this also covers the blocks of an earlier interrupted transfer
+    unsigned char* chunk = this->buffers[0].data;
+    unsigned int count = this->progress.imageSize - this->verifiedOffset;
+    if(count > FIRMWARE_VERIFY_CHUNK_SIZE)
+    {
+        count = FIRMWARE_VERIFY_CHUNK_SIZE;
+    }
+
+    if(!this->storage->Read(this->verifiedOffset, chunk, count)
+        || mbedtls_sha256_update_ret(&this->hash, chunk, count) != 0)
+    {
+        TRACE_ERROR(TE_OTA_VERIFY_FAILED, this->verifiedOffset, 3);
+        this->fail("read");
+        return;
+    }
+    this->verifiedOffset += count;
+
+    if(this->verifiedOffset == this->progress.imageSize)
+    {
+        unsigned char digest[FIRMWARE_DIGEST_SIZE] = { 0 };
+
+        if(mbedtls_sha256_finish_ret(&this->hash, digest) != 0)
+        {
+            this->fail("read");
+            return;
+        }
+        this->finish(digest);
+    }
+}
+
+bool FirmwareUpdate::IsActive() const
+{
+    return (this->state == US_RECEIVING || this->state == US_VERIFYING);
+}
+
+bool FirmwareUpdate::IsRestartPending() const
+{
+    return (this->state == US_RESTART_PENDING);
+}
+
+bool FirmwareUpdate::OnStreamData(uint16_t _streamID, uint32_t offset, const unsigned char* data, unsigned int length, uint32_t totalLength, bool last)
+{
+    if(this->state != US_RECEIVING)
+    {
+        return false;
+    }
+
+    if(!this->streamBound)
+    {
+        // the first stream which starts after the update was accepted carries the image
+        if(offset != 0)
+        {
+            return false;
+        }
+        this->streamID = _streamID;
+        this->streamBound = true;
+    }
+    else if(_streamID != this->streamID)
+    {
+        return false;
+    }
+
+    if(length <= FIRMWARE_CHUNK_CRC_SIZE)
+    {
+        this->fail("chunk");
+        return true;
+    }
+
+    unsigned int chunkLength = length - FIRMWARE_CHUNK_CRC_SIZE;
+    const unsigned char* crcField = data + chunkLength;
+    uint32_t expectedCrc =
+        (uint32_t)crcField[0]
+        | ((uint32_t)crcField[1] << 8)
+        | ((uint32_t)crcField[2] << 16)
+        | ((uint32_t)crcField[3] << 24);
+
+    if(crc32Update(0, data, chunkLength) != expectedCrc)
+    {
+        TRACE_ERROR(TE_OTA_CHUNK_INVALID, this->receivedOffset, chunkLength);
+        this->fail("crc");
+        return true;
+    }
+    if((this->receivedOffset + chunkLength) > this->progress.imageSize)
+    {
+        this->fail("size");
+        return true;
+    }
+
+    // fill the blocks, every full block is handed to the writer
+    unsigned int position = 0;
+    while(position < chunkLength)
+    {
+        unsigned int space = FIRMWARE_BLOCK_SIZE - this->fillBuffer->length;
+        unsigned int count = (chunkLength - position < space) ? (chunkLength - position) : space;
+
+        memcpy(this->fillBuffer->data + this->fillBuffer->length, data + position, count);
+        this->fillBuffer->length += count;
+        position += count;
+
+        if(this->fillBuffer->length == FIRMWARE_BLOCK_SIZE)
+        {
+            this->submitBuffer(this->fillBuffer);
+            this->fillBuffer = this->acquireBuffer();
+            this->fillBuffer->offset = this->receivedOffset + position;
+            this->fillBuffer->length = 0;
+        }
+    }
+    this->receivedOffset += chunkLength;
+
+    if(this->writeFailed)
+    {
+        this->fail("write");
+    }
+    else if(last)
+    {
+        if(this->receivedOffset != this->progress.imageSize)
+        {
+            this->fail("size");
+        }
+        else
+        {
+            this->complete();
+        }
+    }
+    return true;
+}
+
+bool FirmwareUpdate::OnStreamAborted(uint16_t _streamID)
+{
+    if(this->state != US_RECEIVING || !this->streamBound || _streamID != this->streamID)
+    {
+        return false;
+    }
+    this->fail("aborted");
+    return true;
+}
+
+void FirmwareUpdate::OnClientDisconnected()
+{
+    if(this->state == US_RECEIVING)
+    {
+        // the written blocks are kept, the server continues with a new 'ota:begin' after the reconnect
+        this->stop();
+    }
+}
+
+void FirmwareUpdate::OnCommand(uint32_t commandID, const CommandArguments& arguments)
+{
+    switch(commandID)
+    {
+    case COMMAND_ID("ota:begin"):
+        this->start(arguments);
+        break;
+    case COMMAND_ID("ota:abort"):
+        if(this->IsActive())
+        {
+            this->fail("aborted");
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void FirmwareUpdate::start(const CommandArguments& arguments)
+{
+    if(this->state == US_RESTART_PENDING)
+    {
+        return;
+    }
+    if(this->IsActive())
+    {
+        this->stop();
+    }
+
+    auto imageSize = arguments.GetAt(0).ToInt();
+    auto hash = arguments.GetAt(1);
+    auto signatureText = arguments.GetAt(2);
+
+    bool valid = (arguments.GetCount() >= 3) && (imageSize > 0) && (hash.length == FIRMWARE_HASH_HEX_LENGTH);
+    for(unsigned int i = 0; valid && i < hash.length; i++)
+    {
+        valid = isxdigit((unsigned char)hash.data[i]);
+    }
+
+    unsigned char digest[FIRMWARE_DIGEST_SIZE] = { 0 };
+    valid = valid
+        && parseDigest(hash.data, digest)
+        && base64Decode(signatureText.data, signatureText.length, this->signature, sizeof(this->signature), this->signatureLength);
+
+    if(!valid)
+    {
+        this->progress = FirmwareProgress();
+        this->fail("args");
+        return;
+    }
+
+    // an image which is not signed by the owner of the firmware is rejected before the partition is touched, the
+    // signature is checked again against the hash of the stored image before the boot partition is switched
+    if(!this->verifySignature(digest))
+    {
+        TRACE_ERROR(TE_OTA_VERIFY_FAILED, imageSize, 2);
+        this->progress = FirmwareProgress();
+        this->fail("signature");
+        return;
+    }
+
+    FirmwareProgress newProgress;
+    for(unsigned int i = 0; i < FIRMWARE_HASH_HEX_LENGTH; i++)
+    {
+        newProgress.hash[i] = tolower((unsigned char)hash.data[i]);
+    }
+    newProgress.imageSize = imageSize;
+
+    // continue an interrupted transfer of the same image
+    FirmwareProgress savedProgress;
+    if(this->storage->LoadProgress(savedProgress) && savedProgress.Matches(newProgress.hash, newProgress.imageSize))
+    {
+        newProgress.offset = savedProgress.offset - (savedProgress.offset % FIRMWARE_BLOCK_SIZE);
+    }
+    this->progress = newProgress;
+
+    if(!this->storage->Begin(this->progress.imageSize, this->progress.offset))
+    {
+        this->progress.offset = 0;
+
+        if(!this->storage->Begin(this->progress.imageSize, 0))
+        {
+            this->fail("storage");
+            return;
+        }
+    }
+    if(this->progress.offset == 0)
+    {
+        this->storage->ClearProgress();
+    }
+
+    if(!this->allocateBuffers())
+    {
+        this->storage->Abort();
+        this->fail("memory");
+        return;
+    }
+
+    this->receivedOffset = this->progress.offset;
+    this->streamBound = false;
+    this->writeFailed = false;
+
+    this->fillBuffer = this->acquireBuffer();
+    this->fillBuffer->offset = this->receivedOffset;
+    this->fillBuffer->length = 0;
+
+    this->state = US_RECEIVING;
+    TRACE_INFO(TE_OTA_STARTED, this->progress.imageSize, this->receivedOffset);
+
+    String response = FIRMWARE_READY_RESPONSE;
+    response += this->receivedOffset;
+    this->reply(response);
+}
+
+void FirmwareUpdate::complete()
+{
+    if(this->fillBuffer->length > 0)
+    {
+        this->submitBuffer(this->fillBuffer);
+        this->fillBuffer = nullptr;
+    }
+    if(!this->flushBuffers())
+    {
+        this->fail("write");
+        return;
+    }
+
+    // the image is read back and hashed in OnLoop, a chunk per call
+    mbedtls_sha256_init(&this->hash);
+    this->verifiedOffset = 0;
+    this->state = US_VERIFYING;
+
+    if(mbedtls_sha256_starts_ret(&this->hash, 0) != 0)
+    {
+        this->fail("read");
+    }
+}
+
+void FirmwareUpdate::finish(const unsigned char* digest)
+{
+    unsigned char expected[FIRMWARE_DIGEST_SIZE] = { 0 };
+
+    if(!parseDigest(this->progress.hash, expected) || memcmp(expected, digest, FIRMWARE_DIGEST_SIZE) != 0)
+    {
+        TRACE_ERROR(TE_OTA_VERIFY_FAILED, this->progress.imageSize, 0);
+
+        // the stored data does not match the announced image, the next attempt starts from the beginning
+        this->storage->ClearProgress();
+        this->resetProgressOffset();
+        this->fail("hash");
+        return;
+    }
+    if(!this->verifySignature(digest))
+    {
+        TRACE_ERROR(TE_OTA_VERIFY_FAILED, this->progress.imageSize, 2);
+
+        this->storage->ClearProgress();
+        this->resetProgressOffset();
+        this->fail("signature");
+        return;
+    }
+    if(!this->storage->Finalize())
+    {
+        TRACE_ERROR(TE_OTA_VERIFY_FAILED, this->progress.imageSize, 1);
+
+        this->storage->ClearProgress();
+        this->resetProgressOffset();
+        this->fail("boot");
+        return;
+    }
+
+    mbedtls_sha256_free(&this->hash);
+    this->storage->ClearProgress();
+    this->releaseBuffers();
+    this->state = US_RESTART_PENDING;
+
+    TRACE_INFO(TE_OTA_COMPLETE, this->progress.imageSize, 0);
+    this->reply(FIRMWARE_DONE_RESPONSE);
+}
+
+void FirmwareUpdate::stop()
+{
+    if(this->state == US_VERIFYING)
+    {
+        mbedtls_sha256_free(&this->hash);
+    }
+
+    // wait for the pending blocks, so the saved progress is up to date
+    this->flushBuffers();
+    this->releaseBuffers();
+    this->storage->Abort();
+    this->state = US_IDLE;
+}
+
+void FirmwareUpdate::fail(const char* reason)
+{
+    if(this->IsActive())
+    {
+        this->stop();
+    }
+
+    String response = FIRMWARE_ERROR_RESPONSE;
+    response += reason;
+    response += ':';
+    response += this->getProgressOffset();
+    this->reply(response);
+}
+
+void FirmwareUpdate::reply(const String& data)
+{
+    if(this->controller != nullptr)
+    {
+        this->controller->SendData(data, true);
+    }
+}
+
+bool FirmwareUpdate::allocateBuffers()
+{
+    this->buffers = new WriteBuffer[FIRMWARE_WRITE_BUFFERS];
+    if(this->buffers == nullptr)
+    {
+        return false;
+    }
+
+#ifdef ESP32
+    this->freeBuffers = xQueueCreate(FIRMWARE_WRITE_BUFFERS + 1, sizeof(WriteBuffer*));
+    this->filledBuffers = xQueueCreate(FIRMWARE_WRITE_BUFFERS + 1, sizeof(WriteBuffer*));
+
+    if(this->freeBuffers == nullptr || this->filledBuffers == nullptr
+        || xTaskCreate(
+            &FirmwareUpdate::writerTaskMain, "ota-writer", FIRMWARE_WRITER_STACK_SIZE,
+            this, FIRMWARE_WRITER_PRIORITY, &this->writerTask) != pdPASS)
+    {
+        this->writerTask = nullptr;
+        this->releaseBuffers();
+        return false;
+    }
+
+    for(unsigned int i = 0; i < FIRMWARE_WRITE_BUFFERS; i++)
+    {
+        WriteBuffer* buffer = &this->buffers[i];
+        xQueueSend(this->freeBuffers, &buffer, portMAX_DELAY);
+    }
+#endif
+    return true;
+}
+
+void FirmwareUpdate::releaseBuffers()
+{
+#ifdef ESP32
+    if(this->writerTask != nullptr)
+    {
+        // a null buffer stops the writer, it is returned as acknowledgement before the task ends
+        WriteBuffer* buffer = nullptr;
+        xQueueSend(this->filledBuffers, &buffer, portMAX_DELAY);
+
+        do
+        {
+            xQueueReceive(this->freeBuffers, &buffer, portMAX_DELAY);
+        }
+        while(buffer != nullptr);
+
+        this->writerTask = nullptr;
+    }
+    if(this->freeBuffers != nullptr)
+    {
+        vQueueDelete(this->freeBuffers);
+        this->freeBuffers = nullptr;
+    }
+    if(this->filledBuffers != nullptr)
+    {
+        vQueueDelete(this->filledBuffers);
+        this->filledBuffers = nullptr;
+    }
+#endif
+    if(this->buffers != nullptr)
+    {
+        delete[] this->buffers;
+        this->buffers = nullptr;
+    }
+    this->fillBuffer = nullptr;
+}
+
+FirmwareUpdate::WriteBuffer* FirmwareUpdate::acquireBuffer()
+{
+#ifdef ESP32
+    // blocks while both buffers are in use, the flash is slower than the network then
+    WriteBuffer* buffer = nullptr;
+    xQueueReceive(this->freeBuffers, &buffer, portMAX_DELAY);
+    return buffer;
+#else
+    return &this->buffers[0];
+#endif
+}
+
+void FirmwareUpdate::submitBuffer(WriteBuffer* buffer)
+{
+#ifdef ESP32
+    xQueueSend(this->filledBuffers, &buffer, portMAX_DELAY);
+#else
+    if(!this->writeFailed && !this->writeBlock(buffer))
+    {
+        this->writeFailed = true;
+    }
+#endif
+}
+
+bool FirmwareUpdate::flushBuffers()
+{
+#ifdef ESP32
+    if(this->writerTask != nullptr)
+    {
+        // all blocks are written when every buffer is back in the free queue
+        WriteBuffer* collected[FIRMWARE_WRITE_BUFFERS];
+        unsigned int count = 0;
+
+        if(this->fillBuffer != nullptr)
+        {
+            collected[count++] = this->fillBuffer;
+        }
+        while(count < FIRMWARE_WRITE_BUFFERS)
+        {
+            xQueueReceive(this->freeBuffers, &collected[count], portMAX_DELAY);
+            count++;
+        }
+
+        for(unsigned int i = 0; i < count; i++)
+        {
+            if(collected[i] != this->fillBuffer)
+            {
+                xQueueSend(this->freeBuffers, &collected[i], portMAX_DELAY);
+            }
+        }
+    }
+#endif
+    return !this->writeFailed;
+}
+
+bool FirmwareUpdate::writeBlock(WriteBuffer* buffer)
+{
+    if(!this->storage->Write(buffer->offset, buffer->data, buffer->length))
+    {
+        TRACE_ERROR(TE_OTA_WRITE_FAILED, buffer->offset, buffer->length);
+        return false;
+    }
+
+    // only complete blocks are recorded, a partial block is written again after a resume
+    if(buffer->length == FIRMWARE_BLOCK_SIZE)
+    {
+        this->lockProgress();
+        this->progress.offset = buffer->offset + buffer->length;
+        this->storage->SaveProgress(this->progress);
+        this->unlockProgress();
+    }
+    return true;
+}
+
+void FirmwareUpdate::lockProgress()
+{
+#ifdef ESP32
+    xSemaphoreTake(this->progressLock, portMAX_DELAY);
+#endif
+}
+
+void FirmwareUpdate::unlockProgress()
+{
+#ifdef ESP32
+    xSemaphoreGive(this->progressLock);
+#endif
+}
+
+uint32_t FirmwareUpdate::getProgressOffset()
+{
+    this->lockProgress();
+    uint32_t offset = this->progress.offset;
+    this->unlockProgress();
+    return offset;
+}
+
+void FirmwareUpdate::resetProgressOffset()
+{
+    this->lockProgress();
+    this->progress.offset = 0;
+    this->unlockProgress();
+}
+
+#ifdef ESP32
+
+void FirmwareUpdate::writerTaskMain(void* parameter)
+{
+    auto update = reinterpret_cast<FirmwareUpdate*>(parameter);
+    WriteBuffer* buffer = nullptr;
+
+    while(xQueueReceive(update->filledBuffers, &buffer, portMAX_DELAY) == pdTRUE)
+    {
+        if(buffer != nullptr && !update->writeFailed && !update->writeBlock(buffer))
+        {
+            update->writeFailed = true;
+        }
+        xQueueSend(update->freeBuffers, &buffer, portMAX_DELAY);
+
+        if(buffer == nullptr)
+        {
+            break;
+        }
+    }
+    vTaskDelete(nullptr);
+}
+
+#endif
+
+bool FirmwareUpdate::verifySignature(const unsigned char* digest)
+{
+    return this->publicKeyLoaded
+        && (this->signatureLength > 0)
+        && (mbedtls_pk_verify(&this->publicKey, MBEDTLS_MD_SHA256, digest, FIRMWARE_DIGEST_SIZE, this->signature, this->signatureLength) == 0);
+}
@@ -0,0 +1,159 @@
+#include "FragmentStream.h"
+
+FragmentHeader::FragmentHeader()
+: flags(0), streamID(0), sequence(0), totalLength(0), payloadLength(0)
+{}
+
+void FragmentHeader::Write(unsigned char* buffer) const
+{
+    buffer[0] = FRAGMENT_MARKER;
+    buffer[1] = this->flags;
+    buffer[2] = (unsigned char)(this->streamID & 0xFF);
+    buffer[3] = (unsigned char)(this->streamID >> 8);
+    buffer[4] = (unsigned char)(this->sequence & 0xFF);
+    buffer[5] = (unsigned char)(this->sequence >> 8);
+    buffer[6] = (unsigned char)(this->totalLength & 0xFF);
+    buffer[7] = (unsigned char)((this->totalLength >> 8) & 0xFF);
+    buffer[8] = (unsigned char)((this->totalLength >> 16) & 0xFF);
+    buffer[9] = (unsigned char)((this->totalLength >> 24) & 0xFF);
+    buffer[10] = (unsigned char)(this->payloadLength & 0xFF);
+    buffer[11] = (unsigned char)(this->payloadLength >> 8);
+}
+
+bool FragmentHeader::Read(const unsigned char* data, unsigned int length)
+{
+    if(!IsFragment(data, length))
+    {
+        return false;
+    }
+
+    this->flags = data[1];
+    this->streamID = (uint16_t)(data[2] | (data[3] << 8));
+    this->sequence = (uint16_t)(data[4] | (data[5] << 8));
+    this->totalLength =
+        (uint32_t)data[6]
+        | ((uint32_t)data[7] << 8)
+        | ((uint32_t)data[8] << 16)
+        | ((uint32_t)data[9] << 24);
+    this->payloadLength = (uint16_t)(data[10] | (data[11] << 8));
+
+    return this->payloadLength <= (length - FRAGMENT_HEADER_SIZE);
+}
+
+bool FragmentHeader::IsFragment(const unsigned char* data, unsigned int length)
+{
+    return (data != nullptr) && (length >= FRAGMENT_HEADER_SIZE) && (data[0] == FRAGMENT_MARKER);
+}
+
+StreamReassembler::InboundStream::InboundStream()
+: active(false), streamID(0), nextSequence(0), offset(0), totalLength(0), lastActivity(0)
+{}
+
+StreamReassembler::StreamReassembler()
+{}
+
+StreamReassembler::FragmentResult StreamReassembler::Accept(const FragmentHeader& header, uint32_t& offset)
+{
+    InboundStream* stream = this->find(header.streamID);
+
+    if(header.flags & FRAGMENT_FLAG_ABORT)
+    {
+        if(stream == nullptr)
+        {
+            return FragmentResult::FR_IGNORED;
+        }
+        stream->active = false;
+        return FragmentResult::FR_ABORTED;
+    }
+
+    if(header.flags & FRAGMENT_FLAG_FIRST)
+    {
+        // a new stream (a previous stream with the same ID is replaced)
+        if(stream == nullptr)
+        {
+            stream = this->allocate();
+        }
+        stream->active = true;
+        stream->streamID = header.streamID;
+        stream->nextSequence = 0;
+        stream->offset = 0;
+        stream->totalLength = header.totalLength;
+    }
+    else if(stream == nullptr)
+    {
+        // the beginning of this stream is unknown (e.g. the stream was aborted before)
+        return FragmentResult::FR_IGNORED;
+    }
+
+    if(header.sequence != stream->nextSequence
+        || (stream->offset + header.payloadLength) > stream->totalLength)
+    {
+        stream->active = false;
+        return FragmentResult::FR_ABORTED;
+    }
+
+    offset = stream->offset;
+
+    stream->nextSequence++;
+    stream->offset += header.payloadLength;
+    stream->lastActivity = millis();
+
+    if(header.flags & FRAGMENT_FLAG_LAST)
+    {
+        stream->active = false;
+    }
+    return FragmentResult::FR_ACCEPTED;
+}
+
+bool StreamReassembler::ExpireIdle(unsigned long now, uint16_t& streamID)
+{
+    for(unsigned int i = 0; i < FRAGMENT_MAX_INBOUND_STREAMS; i++)
+    {
+        if(this->streams[i].active && (now - this->streams[i].lastActivity) >= FRAGMENT_INBOUND_IDLE_TIMEOUT)
+        {
+            this->streams[i].active = false;
+            streamID = this->streams[i].streamID;
+            return true;
+        }
+    }
+    return false;
+}
+
+void StreamReassembler::Reset()
+{
+    for(unsigned int i = 0; i < FRAGMENT_MAX_INBOUND_STREAMS; i++)
+    {
+        this->streams[i].active = false;
+    }
+}
+
+StreamReassembler::InboundStream* StreamReassembler::find(uint16_t streamID)
+{
+    for(unsigned int i = 0; i < FRAGMENT_MAX_INBOUND_STREAMS; i++)
+    {
+        if(this->streams[i].active && this->streams[i].streamID == streamID)
+        {
+            return &this->streams[i];
+        }
+    }
+    return nullptr;
+}
+
+StreamReassembler::InboundStream* StreamReassembler::allocate()
+{
+    InboundStream* oldest = &this->streams[0];
+
+    for(unsigned int i = 0; i < FRAGMENT_MAX_INBOUND_STREAMS; i++)
+    {
+        if(!this->streams[i].active)
+        {
+            return &this->streams[i];
+        }
+        if((long)(this->streams[i].lastActivity - oldest->lastActivity) < 0)
+        {
+            oldest = &this->streams[i];
+        }
+    }
+    // all slots are in use, the least recently active stream is dropped
+    return oldest;
+}
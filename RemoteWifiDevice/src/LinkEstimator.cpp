@@ -0,0 +1,233 @@
+#include "LinkEstimator.h"
+
+// clock granularity of the rto (us), the variation term is never smaller
+#define LINK_RTO_GRANULARITY 1000
+
+LinkEstimator::ProbeRecord::ProbeRecord()
+: sequence(0), sentTime(0), state(PS_FREE)
+{}
+
+LinkEstimator::LinkEstimator()
+{
+    this->Reset();
+}
+
+void LinkEstimator::Reset()
+{
+    this->samples = 0;
+    this->latestRTT = 0;
+    this->smoothedRTT = 0;
+    this->rttVariation = 0;
+    this->minRTT = 0;
+    this->jitter = 0;
+
+    for(unsigned int i = 0; i < LINK_PROBE_HISTORY; i++)
+    {
+        this->probes[i] = ProbeRecord();
+    }
+    this->probeSequence = 0;
+    this->pendingProbes = 0;
+    this->probesSent = 0;
+    this->probesLost = 0;
+}
+
+void LinkEstimator::AddSample(uint32_t rtt)
+{
+    if(this->samples == 0)
+    {
+        this->smoothedRTT = rtt;
+        this->rttVariation = rtt / 2;
+        this->minRTT = rtt;
+        this->jitter = 0;
+    }
+    else
+    {
+        int32_t deviation = (int32_t)(rtt - this->smoothedRTT);
+        if(deviation < 0)
+        {
+            deviation = -deviation;
+        }
+        int32_t difference = (int32_t)(rtt - this->latestRTT);
+        if(difference < 0)
+        {
+            difference = -difference;
+        }
+
+        // the variation is updated with the old srtt (RFC 6298, 2.3)
+        this->rttVariation += (deviation - (int32_t)this->rttVariation) / 4;
+        this->smoothedRTT += ((int32_t)rtt - (int32_t)this->smoothedRTT) / 8;
+        this->jitter += (difference - (int32_t)this->jitter) / 16;
+
+        if(rtt < this->minRTT)
+        {
+            this->minRTT = rtt;
+        }
+    }
+    this->latestRTT = rtt;
+    this->samples++;
+}
+
+uint16_t LinkEstimator::OnProbeSent(uint32_t now)
+{
+    this->ExpireProbes(now);
+
+    auto& record = this->probes[this->probeSequence % LINK_PROBE_HISTORY];
+    if(record.state == PS_PENDING)
+    {
+        // not answered during a whole history of probes
+        this->pendingProbes--;
+        this->probesLost++;
+    }
+    record.sequence = this->probeSequence;
+    record.sentTime = now;
+    record.state = PS_PENDING;
+
+    this->pendingProbes++;
+    this->probesSent++;
+
+    return this->probeSequence++;
+}
+
+bool LinkEstimator::OnProbeReply(uint16_t sequence, uint32_t sentTime, uint32_t now)
+{
+    auto& record = this->probes[sequence % LINK_PROBE_HISTORY];
+
+    // the echoed timestamp must match, so a stale or garbled reply does not produce a sample
+    if(record.state != PS_PENDING || record.sequence != sequence || record.sentTime != sentTime)
+    {
+        return false;
+    }
+    record.state = PS_ANSWERED;
+    this->pendingProbes--;
+
+    this->AddSample(now - sentTime);
+    return true;
+}
+
+unsigned int LinkEstimator::ExpireProbes(uint32_t now)
+{
+    if(this->pendingProbes == 0)
+    {
+        return 0;
+    }
+
+    uint32_t timeout = this->GetRetransmissionTimeout() * 2000UL;
+    unsigned int expired = 0;
+
+    for(unsigned int i = 0; i < LINK_PROBE_HISTORY; i++)
+    {
+        if(this->probes[i].state == PS_PENDING && (now - this->probes[i].sentTime) >= timeout)
+        {
+            this->probes[i].state = PS_LOST;
+            expired++;
+        }
+    }
+    this->pendingProbes -= expired;
+    this->probesLost += expired;
+
+    return expired;
+}
+
+bool LinkEstimator::HasSamples() const
+{
+    return this->samples > 0;
+}
+
+unsigned long LinkEstimator::GetSampleCount() const
+{
+    return this->samples;
+}
+
+uint32_t LinkEstimator::GetLatestRTT() const
+{
+    return this->latestRTT;
+}
+
+uint32_t LinkEstimator::GetSmoothedRTT() const
+{
+    return this->smoothedRTT;
+}
+
+uint32_t LinkEstimator::GetRTTVariation() const
+{
+    return this->rttVariation;
+}
+
+uint32_t LinkEstimator::GetMinRTT() const
+{
+    return this->minRTT;
+}
+
+uint32_t LinkEstimator::GetJitter() const
+{
+    return this->jitter;
+}
+
+unsigned long LinkEstimator::GetProbesSent() const
+{
+    return this->probesSent;
+}
+
+unsigned long LinkEstimator::GetProbesLost() const
+{
+    return this->probesLost;
+}
+
+unsigned int LinkEstimator::GetLossPermille() const
+{
+    unsigned int answered = 0;
+    unsigned int lost = 0;
+
+    for(unsigned int i = 0; i < LINK_PROBE_HISTORY; i++)
+    {
+        if(this->probes[i].state == PS_ANSWERED)
+        {
+            answered++;
+        }
+        else if(this->probes[i].state == PS_LOST)
+        {
+            lost++;
+        }
+    }
+    return (answered + lost > 0) ? (lost * 1000) / (answered + lost) : 0;
+}
+
+uint32_t LinkEstimator::GetRetransmissionTimeout() const
+{
+    if(this->samples == 0)
+    {
+        return transmissionProfile.rtoInitial;
+    }
+
+    uint32_t variation = 4 * this->rttVariation;
+    if(variation < LINK_RTO_GRANULARITY)
+    {
+        variation = LINK_RTO_GRANULARITY;
+    }
+    uint32_t rto = (this->smoothedRTT + variation + 999) / 1000;
+
+    if(rto < transmissionProfile.rtoMin)
+    {
+        return transmissionProfile.rtoMin;
+    }
+    if(rto > transmissionProfile.rtoMax)
+    {
+        return transmissionProfile.rtoMax;
+    }
+    return rto;
+}
+
+String LinkEstimator::ToSnapshotString() const
+{
+    // nine fields of up to 16 hex digits (64 bit long) and their separators
+    char buffer[160] = { 0 };
+
+    String snapshot = LINK_SNAPSHOT_VERSION;
+    snprintf(buffer, sizeof(buffer), ":%lx,%lx,%lx,%lx,%lx,%lx,%lx,%x,%lx",
+        (unsigned long)this->smoothedRTT, (unsigned long)this->rttVariation, (unsigned long)this->minRTT,
+        (unsigned long)this->jitter, this->samples, this->probesSent, this->probesLost,
+        this->GetLossPermille(), (unsigned long)this->GetRetransmissionTimeout());
+    snapshot += buffer;
+
+    return snapshot;
+}
@@ -0,0 +1,246 @@
+#include "LinkSimulator.h"
+
+LinkImpairments::LinkImpairments()
+: lossPermille(0), duplicatePermille(0), reorderPermille(0), splitPermille(0), corruptPermille(0), noisePermille(0), latency(0), jitter(0)
+{}
+
+LinkStatistics::LinkStatistics()
+: frames(0), lost(0), duplicated(0), reordered(0), split(0), corrupted(0), noise(0), delivered(0)
+{}
+
+LinkSimulator::SimulatedFrame::SimulatedFrame()
+: dueTime(0), direction(LD_OUTGOING)
+{}
+
+LinkSimulator::LinkSimulator(uint32_t seed)
+: controller(nullptr), interface(nullptr), randomState((seed != 0) ? seed : 1)
+{}
+
+void LinkSimulator::SetController(TransmissionControl* _controller)
+{
+    this->controller = _controller;
+}
+
+void LinkSimulator::SetInterface(ITransmissionControlInterface* _interface)
+{
+    this->interface = _interface;
+}
+
+void LinkSimulator::SetOutgoingImpairments(const LinkImpairments& _impairments)
+{
+    this->impairments[LD_OUTGOING] = _impairments;
+}
+
+void LinkSimulator::SetIncomingImpairments(const LinkImpairments& _impairments)
+{
+    this->impairments[LD_INCOMING] = _impairments;
+}
+
+const LinkStatistics& LinkSimulator::GetOutgoingStatistics() const
+{
+    return this->statistics[LD_OUTGOING];
+}
+
+const LinkStatistics& LinkSimulator::GetIncomingStatistics() const
+{
+    return this->statistics[LD_INCOMING];
+}
+
+void LinkSimulator::Receive(const String& data)
+{
+    this->impair(data, LD_INCOMING);
+}
+
+void LinkSimulator::OutGateway(const String& data)
+{
+    this->impair(data, LD_OUTGOING);
+}
+
+void LinkSimulator::OnDataDecoded(const ByteSpan& data)
+{
+    if(this->interface != nullptr)
+    {
+        this->interface->OnDataDecoded(data);
+    }
+}
+
+void LinkSimulator::OnUnencryptedDataReceived(const ByteSpan& data)
+{
+    if(this->interface != nullptr)
+    {
+        this->interface->OnUnencryptedDataReceived(data);
+    }
+}
+
+void LinkSimulator::OnRecordDecoded(TLVReader& record)
+{
+    if(this->interface != nullptr)
+    {
+        this->interface->OnRecordDecoded(record);
+    }
+}
+
+void LinkSimulator::OnStreamData(uint16_t streamID, uint32_t offset, const unsigned char* data, unsigned int length, uint32_t totalLength, bool last)
+{
+    if(this->interface != nullptr)
+    {
+        this->interface->OnStreamData(streamID, offset, data, length, totalLength, last);
+    }
+}
+
+void LinkSimulator::OnStreamAborted(uint16_t streamID)
+{
+    if(this->interface != nullptr)
+    {
+        this->interface->OnStreamAborted(streamID);
+    }
+}
+
+void LinkSimulator::OnLoop()
+{
+    auto now = millis();
+
+    // release all due frames in the order they were scheduled
+    unsigned int i = 0;
+    while(i < this->pendingFrames.GetCount())
+    {
+        if((long)(now - this->pendingFrames.GetAt(i).dueTime) >= 0)
+        {
+            SimulatedFrame frame = this->pendingFrames.GetAt(i);
+            this->pendingFrames.RemoveAt(i);
+            this->deliver(frame.data, frame.direction);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+void LinkSimulator::impair(const String& original, LinkDirection direction)
+{
+    const LinkImpairments& settings = this->impairments[direction];
+    LinkStatistics& stats = this->statistics[direction];
+
+    stats.frames++;
+
+    if(this->chance(settings.lossPermille))
+    {
+        stats.lost++;
+        return;
+    }
+
+    String data = original;
+    if(data.length() > 0 && this->chance(settings.corruptPermille))
+    {
+        stats.corrupted++;
+        data.setCharAt(this->nextRandom() % data.length(), this->randomCharacter());
+    }
+    if(this->chance(settings.noisePermille))
+    {
+        // bytes of something else on the stream, e.g. a line which was not written by the peer
+        stats.noise++;
+        String noise;
+        unsigned int noiseLength = 1 + (this->nextRandom() % LINK_NOISE_MAX);
+        for(unsigned int i = 0; i < noiseLength; i++)
+        {
+            noise += this->randomCharacter();
+        }
+        noise += data;
+        data = noise;
+    }
+
+    unsigned long delay = settings.latency;
+    if(settings.jitter > 0)
+    {
+        delay += this->nextRandom() % (settings.jitter + 1);
+    }
+
+    if(this->chance(settings.reorderPermille))
+    {
+        // hold the frame back long enough to be overtaken by the next one
+        stats.reordered++;
+        delay += settings.latency + settings.jitter + 1;
+    }
+
+    if(data.length() > 1 && this->chance(settings.splitPermille))
+    {
+        // deliver the frame in two chunks, like a tcp segment boundary inside the frame
+        stats.split++;
+        unsigned int splitPosition = 1 + (this->nextRandom() % (data.length() - 1));
+        this->schedule(data.substring(0, splitPosition), direction, delay);
+        this->schedule(data.substring(splitPosition), direction, delay);
+    }
+    else
+    {
+        this->schedule(data, direction, delay);
+    }
+
+    if(this->chance(settings.duplicatePermille))
+    {
+        stats.duplicated++;
+        this->schedule(data, direction, delay);
+    }
+}
+
+void LinkSimulator::schedule(const String& data, LinkDirection direction, unsigned long delay)
+{
+    if(delay == 0 && this->pendingFrames.GetCount() == 0)
+    {
+        this->deliver(data, direction);
+    }
+    else
+    {
+        SimulatedFrame frame;
+        frame.data = data;
+        frame.dueTime = millis() + delay;
+        frame.direction = direction;
+        this->pendingFrames.AddItem(frame);
+    }
+}
+
+void LinkSimulator::deliver(const String& data, LinkDirection direction)
+{
+    this->statistics[direction].delivered++;
+
+    if(direction == LD_OUTGOING)
+    {
+        if(this->interface != nullptr)
+        {
+            this->interface->OutGateway(data);
+        }
+    }
+    else
+    {
+        if(this->controller != nullptr)
+        {
+            this->controller->OnDataReceived(data);
+        }
+    }
+}
+
+char LinkSimulator::randomCharacter()
+{
+    // printable characters, the String can not hold a zero
+    return (char)(' ' + (this->nextRandom() % 95));
+}
+
+bool LinkSimulator::chance(unsigned int permille)
+{
+    if(permille == 0)
+    {
+        return false;
+    }
+    return (this->nextRandom() % 1000) < permille;
+}
+
+uint32_t LinkSimulator::nextRandom()
+{
+    // xorshift32
+    uint32_t x = this->randomState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    this->randomState = x;
+    return x;
+}
@@ -0,0 +1,244 @@
+#include "LoadGenerator.h"
+
+// delay between two connection attempts of a session
+#define VIRTUAL_DEVICE_CONNECT_TIMEOUT 2000
+
+LoadGeneratorConfig::LoadGeneratorConfig()
+: sessionCount(4), messageInterval(1000), payloadSize(64), encrypt(true), churnPermille(0), reportInterval(10000), firstSession(0)
+{}
+
+LoadGeneratorTotals::LoadGeneratorTotals()
+: sessions(0), connected(0), messages(0), framesOut(0), bytesOut(0), retransmissions(0), drops(0), reconnects(0), ackRTT(0)
+{}
+
+void LoadGeneratorTotals::Add(const LoadGeneratorTotals& other)
+{
+    this->sessions += other.sessions;
+    this->connected += other.connected;
+    this->messages += other.messages;
+    this->framesOut += other.framesOut;
+    this->bytesOut += other.bytesOut;
+    this->retransmissions += other.retransmissions;
+    this->drops += other.drops;
+    this->reconnects += other.reconnects;
+    this->ackRTT.Merge(other.ackRTT);
+}
+
+VirtualDevice::VirtualDevice()
+: port(0), messageTimer(0), connectTimer(0), reconnects(0), messagesSent(0)
+{}
+
+void VirtualDevice::Begin(unsigned int index, const IPAddress& _host, uint16_t _port, unsigned long startDelay)
+{
+    this->host = _host;
+    this->port = _port;
+
+    String name = "esp32-virtual-";
+    name += index;
+
+    this->control.SetInterface(this);
+    this->control.SetDeviceName(name);
+
+    this->messageTimer = millis() + startDelay;
+    this->connect();
+}
+
+void VirtualDevice::OnLoop(const LoadGeneratorConfig& config, const String& payload)
+{
+    this->control.OnLoop();
+
+    if(!this->client.connected())
+    {
+        this->control.OnClientDisconnected();
+
+        if(millis() > (this->connectTimer + VIRTUAL_DEVICE_CONNECT_TIMEOUT))
+        {
+            this->connect();
+        }
+        return;
+    }
+
+    this->control.OnClientConnected();
+    this->receive();
+
+    if(millis() > (this->messageTimer + config.messageInterval))
+    {
+        this->messageTimer = millis();
+
+        if(config.churnPermille > 0 && (unsigned int)random(0, 1000) < config.churnPermille)
+        {
+            // drop the connection, it is reestablished with a new handshake
+            this->client.stop();
+            this->control.OnClientDisconnected();
+            return;
+        }
+
+        if(this->control.SendData(payload, config.encrypt))
+        {
+            this->messagesSent++;
+        }
+    }
+}
+
+bool VirtualDevice::IsConnected()
+{
+    return this->client.connected();
+}
+
+const TransmissionMetrics& VirtualDevice::GetMetrics() const
+{
+    return this->control.GetMetrics();
+}
+
+unsigned long VirtualDevice::GetReconnects() const
+{
+    return this->reconnects;
+}
+
+unsigned long VirtualDevice::GetMessagesSent() const
+{
+    return this->messagesSent;
+}
+
+void VirtualDevice::OutGateway(const String& data)
+{
+    if(this->client.connected())
+    {
+        this->client.println(data);
+    }
+}
+
+void VirtualDevice::OnDataDecoded(const ByteSpan& data)
+{
+    // the load is generated in one direction, incoming application data is only acknowledged
+}
+
+void VirtualDevice::OnUnencryptedDataReceived(const ByteSpan& data)
+{
+}
+
+void VirtualDevice::connect()
+{
+    this->connectTimer = millis();
+
+    if(this->client.connect(this->host, this->port))
+    {
+        this->client.setNoDelay(true);
+        this->reconnects++;
+        this->control.OnClientConnected();
+    }
+}
+
+void VirtualDevice::receive()
+{
+    if(this->client.available())
+    {
+        String data;
+        data.reserve(transmissionProfile.receiveWindowBytes);
+
+        for(unsigned int i = 0; i < transmissionProfile.receiveWindowBytes; i++)
+        {
+            auto c = this->client.read();
+            if(c == -1)
+            {
+                break;
+            }
+            data += (char)c;
+        }
+        this->control.OnDataReceived(data);
+    }
+}
+
+LoadGenerator::LoadGenerator()
+: reportTimer(0), lastFramesOut(0), lastBytesOut(0), lastMessages(0)
+{}
+
+void LoadGenerator::Begin(const IPAddress& host, uint16_t port, const LoadGeneratorConfig& _config)
+{
+    this->config = _config;
+    if(this->config.sessionCount > LOAD_GENERATOR_MAX_SESSIONS)
+    {
+        this->config.sessionCount = LOAD_GENERATOR_MAX_SESSIONS;
+    }
+
+    // printable payload of the requested size
+    this->payload = "";
+    this->payload.reserve(this->config.payloadSize);
+    for(unsigned int i = 0; i < this->config.payloadSize; i++)
+    {
+        this->payload += (char)('a' + (i % 26));
+    }
+
+    for(unsigned int i = 0; i < this->config.sessionCount; i++)
+    {
+        // spread the sessions over the message interval
+        this->sessions[i].Begin(this->config.firstSession + i, host, port, (i * 97) % (this->config.messageInterval + 1));
+    }
+    this->reportTimer = millis();
+}
+
+void LoadGenerator::OnLoop()
+{
+    for(unsigned int i = 0; i < this->config.sessionCount; i++)
+    {
+        this->sessions[i].OnLoop(this->config, this->payload);
+    }
+
+    if(this->config.reportInterval > 0 && millis() > (this->reportTimer + this->config.reportInterval))
+    {
+        this->report();
+        this->reportTimer = millis();
+    }
+}
+
+void LoadGenerator::GetTotals(LoadGeneratorTotals& totals)
+{
+    totals = LoadGeneratorTotals();
+    totals.sessions = this->config.sessionCount;
+
+    for(unsigned int i = 0; i < this->config.sessionCount; i++)
+    {
+        auto& metrics = this->sessions[i].GetMetrics();
+
+        totals.ackRTT.Merge(metrics.ackRTT);
+        totals.framesOut += metrics.framesOut;
+        totals.bytesOut += metrics.bytesOut;
+        totals.retransmissions += metrics.retransmissions;
+        totals.drops += metrics.drops;
+        totals.messages += this->sessions[i].GetMessagesSent();
+        totals.reconnects += this->sessions[i].GetReconnects();
+
+        if(this->sessions[i].IsConnected())
+        {
+            totals.connected++;
+        }
+    }
+}
+
+void LoadGenerator::report()
+{
+    LoadGeneratorTotals totals;
+    this->GetTotals(totals);
+
+    auto elapsed = millis() - this->reportTimer;
+    if(elapsed == 0)
+    {
+        elapsed = 1;
+    }
+
+    char buffer[160] = { 0 };
+    snprintf(buffer, sizeof(buffer),
+        "loadgen: sessions %u/%u msg/s %lu frames/s %lu B/s %lu ack-rtt p50 %lu p90 %lu p99 %lu max %lu ms retx %lu drops %lu connects %lu",
+        totals.connected, totals.sessions,
+        ((totals.messages - this->lastMessages) * 1000) / elapsed,
+        ((totals.framesOut - this->lastFramesOut) * 1000) / elapsed,
+        ((totals.bytesOut - this->lastBytesOut) * 1000) / elapsed,
+        totals.ackRTT.GetPercentile(500), totals.ackRTT.GetPercentile(900), totals.ackRTT.GetPercentile(990), totals.ackRTT.GetMax(),
+        totals.retransmissions, totals.drops, totals.reconnects);
+
+    Serial.println(buffer);
+
+    this->lastMessages = totals.messages;
+    this->lastFramesOut = totals.framesOut;
+    this->lastBytesOut = totals.bytesOut;
+}
@@ -0,0 +1,428 @@
+#include "LoopbackServer.h"
+#include "LinkSimulator.h"
+
+LoopbackServer::LoopbackServer()
+: controller(nullptr), interface(nullptr), receiver(nullptr), link(nullptr), sessionKeyReceived(false), transmissionID(0), receivedCount(0), errorCount(0),
+  answeredCount(0), windowProbeCount(0), callEcho(false), creditSent(false), creditBytes(0), creditPackages(0)
+{
+    memset(this->sessionKey, 0, sizeof(this->sessionKey));
+
+    mbedtls_pk_init(&this->serverKey);
+    mbedtls_entropy_init(&this->entropy);
+    mbedtls_ctr_drbg_init(&this->random);
+    mbedtls_aes_init(&this->aes);
+}
+
+LoopbackServer::~LoopbackServer()
+{
+    mbedtls_aes_free(&this->aes);
+    mbedtls_ctr_drbg_free(&this->random);
+    mbedtls_entropy_free(&this->entropy);
+    mbedtls_pk_free(&this->serverKey);
+}
+
+bool LoopbackServer::Begin(unsigned int rsaBits)
+{
+    const char* personalization = "loopback-server";
+    auto ret = mbedtls_ctr_drbg_seed(&this->random, mbedtls_entropy_func, &this->entropy, (const unsigned char*)personalization, strlen(personalization));
+    if(ret == 0)
+    {
+        ret = mbedtls_pk_setup(&this->serverKey, mbedtls_pk_info_from_type(MBEDTLS_PK_RSA));
+    }
+    if(ret == 0)
+    {
+        ret = mbedtls_rsa_gen_key(mbedtls_pk_rsa(this->serverKey), mbedtls_ctr_drbg_random, &this->random, rsaBits, 65537);
+    }
+
+    unsigned char pem[1024] = { 0 };
+    if(ret == 0)
+    {
+        ret = mbedtls_pk_write_pubkey_pem(&this->serverKey, pem, sizeof(pem));
+    }
+    if(ret != 0)
+    {
+        printMBED_TLSError(ret);
+        return false;
+    }
+
+    // the server sends the key without the pem armor (see TransmissionControl::readAndFormatRSAKey)
+    String armored = (const char*)pem;
+    int start = armored.indexOf('\n');
+    int end = armored.indexOf("-----END");
+    if(start < 0 || end <= start)
+    {
+        return false;
+    }
+    this->publicKey = armored.substring(start + 1, end);
+    return true;
+}
+
+void LoopbackServer::SetController(TransmissionControl* _controller)
+{
+    this->controller = _controller;
+}
+
+void LoopbackServer::SetInterface(ITransmissionControlInterface* _interface)
+{
+    this->interface = _interface;
+}
+
+void LoopbackServer::SetLink(LinkSimulator* _link)
+{
+    this->link = _link;
+}
+
+void LoopbackServer::SetCallEcho(bool enabled)
+{
+    this->callEcho = enabled;
+}
+
+void LoopbackServer::SetReceiver(ITransmissionControlInterface* _receiver)
+{
+    this->receiver = _receiver;
+}
+
+bool LoopbackServer::Handshake()
+{
+    if(this->controller == nullptr)
+    {
+        return false;
+    }
+
+    this->controller->OnClientConnected();
+    this->sendRSAKey();
+    this->Pump();
+
+    return this->sessionKeyReceived;
+}
+
+void LoopbackServer::EndSession()
+{
+    if(this->controller != nullptr)
+    {
+        this->controller->OnClientDisconnected();
+    }
+    this->outgoing.Clear();
+    this->sessionKeyReceived = false;
+    this->creditSent = false;
+    this->transmissionID = 0;
+}
+
+bool LoopbackServer::SendData(const String& data)
+{
+    unsigned char iv[16] = { 0 };
+    unsigned char block[LOOPBACK_PAYLOAD_MAX] = { 0 };
+    char encoded[BASE64_ENCODED_LENGTH(LOOPBACK_PAYLOAD_MAX) + 1] = { 0 };
+
+    size_t length = data.length();
+    if(this->controller == nullptr || !this->sessionKeyReceived || length > LOOPBACK_PAYLOAD_MAX)
+    {
+        return false;
+    }
+    size_t paddedLength = ((length + 15) / 16) * 16;
+    memcpy(block, data.c_str(), length);
+
+    auto ret = mbedtls_ctr_drbg_random(&this->random, iv, sizeof(iv));
+    if(ret != 0)
+    {
+        return false;
+    }
+
+    TransmissionPackage package;
+    package.mode = TransmissionMode::DATA;
+    package.encryptionType = TransmissionEncryptionType::AES;
+    package.dataFormat = TransmissionDataFormat::BASE64;
+    package.transmissionID = this->nextTransmissionID();
+
+    // the iv is updated by the encryption, so it is encoded first
+    base64Encode(iv, sizeof(iv), encoded);
+    package.iv = encoded;
+
+    mbedtls_aes_setkey_enc(&this->aes, this->sessionKey, transmissionProfile.aesKeyBits);
+    ret = mbedtls_aes_crypt_cbc(&this->aes, MBEDTLS_AES_ENCRYPT, paddedLength, iv, block, block);
+    if(ret != 0)
+    {
+        return false;
+    }
+    base64Encode(block, paddedLength, encoded);
+    package.data = encoded;
+
+    this->sendToController(package.ToTransmissionString());
+    return true;
+}
+
+void LoopbackServer::SendCredit(uint32_t bytes, uint16_t packages)
+{
+    char credit[24] = { 0 };
+    snprintf(credit, sizeof(credit), "%lu:%u", (unsigned long)bytes, (unsigned int)packages);
+
+    TransmissionPackage package;
+    package.mode = TransmissionMode::CREDIT;
+    package.encryptionType = TransmissionEncryptionType::TET_NONE;
+    package.dataFormat = TransmissionDataFormat::PLAIN_TEXT;
+    package.data = credit;
+    package.iv = "";
+    package.transmissionID = 0;
+
+    this->creditSent = true;
+    this->creditBytes = bytes;
+    this->creditPackages = packages;
+
+    if(this->controller != nullptr)
+    {
+        this->sendToController(package.ToTransmissionString());
+    }
+}
+
+void LoopbackServer::Pump()
+{
+    if(this->controller == nullptr)
+    {
+        return;
+    }
+
+    for(unsigned int round = 0; round < LOOPBACK_PUMP_ROUNDS; round++)
+    {
+        this->controller->OnLoop();
+
+        if(this->outgoing.GetCount() == 0)
+        {
+            break;
+        }
+        while(this->outgoing.GetCount() > 0)
+        {
+            String frame = this->outgoing.GetAt(0);
+            this->outgoing.RemoveAt(0);
+            this->receive(frame);
+        }
+    }
+}
+
+bool LoopbackServer::HasSessionKey() const
+{
+    return this->sessionKeyReceived;
+}
+
+unsigned long LoopbackServer::GetReceivedCount() const
+{
+    return this->receivedCount;
+}
+
+unsigned long LoopbackServer::GetErrorCount() const
+{
+    return this->errorCount;
+}
+
+unsigned long LoopbackServer::GetAnsweredCount() const
+{
+    return this->answeredCount;
+}
+
+unsigned long LoopbackServer::GetWindowProbeCount() const
+{
+    return this->windowProbeCount;
+}
+
+void LoopbackServer::OutGateway(const String& data)
+{
+    this->outgoing.AddItem(data);
+}
+
+void LoopbackServer::OnDataDecoded(const ByteSpan& data)
+{
+    if(this->interface != nullptr)
+    {
+        this->interface->OnDataDecoded(data);
+    }
+}
+
+void LoopbackServer::OnUnencryptedDataReceived(const ByteSpan& data)
+{
+    if(this->interface != nullptr)
+    {
+        this->interface->OnUnencryptedDataReceived(data);
+    }
+}
+
+void LoopbackServer::OnRecordDecoded(TLVReader& record)
+{
+    if(this->interface != nullptr)
+    {
+        this->interface->OnRecordDecoded(record);
+    }
+}
+
+void LoopbackServer::sendRSAKey()
+{
+    TransmissionPackage package;
+    package.mode = TransmissionMode::RSA_PUBKEY;
+    package.encryptionType = TransmissionEncryptionType::TET_NONE;
+    package.dataFormat = TransmissionDataFormat::PLAIN_TEXT;
+    package.data = this->publicKey;
+    package.iv = "";
+    package.transmissionID = this->nextTransmissionID();
+
+    this->sendToController(package.ToTransmissionString());
+}
+
+void LoopbackServer::receive(const String& frame)
+{
+    TransmissionPackage package;
+    package.FromTransmissionString(frame);
+
+    if(package.errorFlag)
+    {
+        this->errorCount++;
+        return;
+    }
+
+    switch(package.mode)
+    {
+    case TransmissionMode::AES_KEY:
+        {
+            unsigned char encrypted[512] = { 0 };
+            size_t encryptedLength = 0;
+            size_t keyLength = 0;
+
+            if(base64Decode(package.data.c_str(), package.data.length(), encrypted, sizeof(encrypted), encryptedLength)
+                && mbedtls_pk_decrypt(&this->serverKey, encrypted, encryptedLength, this->sessionKey, &keyLength,
+                    sizeof(this->sessionKey), mbedtls_ctr_drbg_random, &this->random) == 0
+                && keyLength == sizeof(this->sessionKey))
+            {
+                this->sessionKeyReceived = true;
+            }
+            this->sendToController(package.ToConfirmationString());
+        }
+        break;
+    case TransmissionMode::DATA:
+        this->sendToController(package.ToConfirmationString());
+
+        if(package.encryptionType == TransmissionEncryptionType::AES)
+        {
+            this->receivedCount++;
+
+            unsigned char block[transmissionProfile.payloadMax + 1] = { 0 };
+            size_t length = 0;
+            if((this->callEcho || this->receiver != nullptr) && this->decrypt(package, block, length))
+            {
+                if(this->receiver != nullptr)
+                {
+                    this->receiver->OnDataDecoded(ByteSpan(block, length));
+                }
+                if(this->callEcho)
+                {
+                    // zero padded text payload
+                    String text;
+                    text.concat((const char*)block, strnlen((const char*)block, length));
+                    this->answerCalls(text);
+                }
+            }
+        }
+        break;
+    case TransmissionMode::PROBE:
+        this->sendToController(package.ToProbeReplyString());
+        break;
+    case TransmissionMode::CREDIT:
+        if(package.data == TRANSMISSION_CREDIT_PROBE)
+        {
+            this->windowProbeCount++;
+            if(this->creditSent)
+            {
+                this->SendCredit(this->creditBytes, this->creditPackages);
+            }
+        }
+        break;
+    default:
+        // confirmations of the controller
+        break;
+    }
+}
+
+bool LoopbackServer::decrypt(const TransmissionPackage& package, unsigned char* block, size_t& length)
+{
+    unsigned char iv[16] = { 0 };
+    size_t ivLength = 0;
+
+    // the block has room for the payload and a terminator
+    if(!base64Decode(package.iv.c_str(), package.iv.length(), iv, sizeof(iv), ivLength) || ivLength != sizeof(iv)
+        || !base64Decode(package.data.c_str(), package.data.length(), block, transmissionProfile.payloadMax, length)
+        || length == 0 || (length % 16) != 0)
+    {
+        return false;
+    }
+
+    mbedtls_aes_setkey_dec(&this->aes, this->sessionKey, transmissionProfile.aesKeyBits);
+    return mbedtls_aes_crypt_cbc(&this->aes, MBEDTLS_AES_DECRYPT, length, iv, block, block) == 0;
+}
+
+void LoopbackServer::answerCalls(const String& batch)
+{
+    const char* prefix = RPC_COMMAND ":";
+    if(!batch.startsWith(prefix))
+    {
+        return;
+    }
+
+    String responses;
+    unsigned int start = strlen(prefix);
+
+    while(start < batch.length())
+    {
+        int end = batch.indexOf(RPC_MESSAGE_SEPARATOR, start);
+        if(end < 0)
+        {
+            end = batch.length();
+        }
+
+        // q<call id>:<method>[:<arguments>] is answered with r<call id>:0[:<arguments>]
+        int idEnd = batch.indexOf(COMMAND_DELIMITER, start);
+        if(batch[start] == RPC_REQUEST_TAG && idEnd > (int)start + 1 && idEnd < end)
+        {
+            String response;
+            response += RPC_RESPONSE_TAG;
+            response += batch.substring(start + 1, idEnd + 1);
+            response += (char)('0' + RS_OK);
+
+            int argumentStart = batch.indexOf(COMMAND_DELIMITER, idEnd + 1);
+            if(argumentStart >= 0 && argumentStart < end)
+            {
+                response += batch.substring(argumentStart, end);
+            }
+
+            if(responses.length() > 0 && (responses.length() + 1 + response.length()) > LOOPBACK_PAYLOAD_MAX)
+            {
+                this->SendData(responses);
+                responses = "";
+            }
+            responses += (responses.length() == 0) ? prefix : "\n";
+            responses += response;
+            this->answeredCount++;
+        }
+        start = end + 1;
+    }
+
+    if(responses.length() > 0)
+    {
+        this->SendData(responses);
+    }
+}
+
+unsigned int LoopbackServer::nextTransmissionID()
+{
+    // the header has 4 hex digits, a long session wraps like the IDs of the controller
+    this->transmissionID = (this->transmissionID + 1) & TRANSMISSION_ID_MASK;
+    return this->transmissionID;
+}
+
+void LoopbackServer::sendToController(const String& frame)
+{
+    if(this->link != nullptr)
+    {
+        // impaired and delivered to the controller by the simulator
+        this->link->Receive(frame);
+    }
+    else
+    {
+        this->controller->OnDataReceived(frame);
+    }
+}
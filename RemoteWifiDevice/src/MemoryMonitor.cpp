@@ -0,0 +1,275 @@
+#include "MemoryMonitor.h"
+
+#ifdef ESP32
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_heap_caps.h>
+#else
+#include <malloc.h>
+#endif
+
+class WatchedTask
+{
+public:
+    const char* name;
+    void* task;
+};
+
+static WatchedTask watchedTasks[MEMORY_MONITOR_TASKS];
+static unsigned int watchedTaskCount = 0;
+
+static MemorySiteCounters siteCounters[MS_SITE_COUNT];
+static MemorySite currentSite = MS_OTHER;
+// task which entered the current site, allocations of other tasks are not counted for the site
+static void* siteTask = nullptr;
+
+// the hooks are called from every task
+static std::atomic<uint32_t> allocationCount(0);
+static std::atomic<uint32_t> releaseCount(0);
+static std::atomic<uint32_t> trackedBytes(0);
+static std::atomic<uint32_t> trackedPeak(0);
+
+static void* currentTask()
+{
+#ifdef ESP32
+    return (void*)xTaskGetCurrentTaskHandle();
+#else
+    return nullptr;
+#endif
+}
+
+MemorySiteCounters::MemorySiteCounters()
+: calls(0), allocations(0), releases(0), allocatedBytes(0), retainedBytes(0)
+{}
+
+void MemorySiteCounters::Reset()
+{
+    this->calls = 0;
+    this->allocations = 0;
+    this->releases = 0;
+    this->allocatedBytes = 0;
+    this->retainedBytes = 0;
+}
+
+MemorySnapshot::MemorySnapshot()
+: heapSize(0), freeHeap(0), minimumFreeHeap(0), largestFreeBlock(0), allocations(0), releases(0), trackedBytes(0), trackedPeak(0)
+{}
+
+void MemoryMonitor::GetSnapshot(MemorySnapshot& snapshot)
+{
+#ifdef ESP32
+    snapshot.heapSize = ESP.getHeapSize();
+    snapshot.freeHeap = ESP.getFreeHeap();
+    snapshot.minimumFreeHeap = ESP.getMinFreeHeap();
+    snapshot.largestFreeBlock = ESP.getMaxAllocHeap();
+#endif
+    snapshot.allocations = allocationCount.load(std::memory_order_relaxed);
+    snapshot.releases = releaseCount.load(std::memory_order_relaxed);
+    snapshot.trackedBytes = trackedBytes.load(std::memory_order_relaxed);
+    snapshot.trackedPeak = trackedPeak.load(std::memory_order_relaxed);
+}
+
+bool MemoryMonitor::WatchTask(const char* name, void* task)
+{
+    if(watchedTaskCount >= MEMORY_MONITOR_TASKS)
+    {
+        return false;
+    }
+    watchedTasks[watchedTaskCount].name = name;
+    watchedTasks[watchedTaskCount].task = (task != nullptr) ? task : currentTask();
+    watchedTaskCount++;
+    return true;
+}
+
+unsigned int MemoryMonitor::GetTaskCount()
+{
+    return watchedTaskCount;
+}
+
+const char* MemoryMonitor::GetTaskName(unsigned int index)
+{
+    return (index < watchedTaskCount) ? watchedTasks[index].name : "";
+}
+
+size_t MemoryMonitor::GetStackHighWaterMark(unsigned int index)
+{
+    if(index >= watchedTaskCount)
+    {
+        return 0;
+    }
+#ifdef ESP32
+    // the esp-idf reports the high-water mark in bytes
+    return (size_t)uxTaskGetStackHighWaterMark((TaskHandle_t)watchedTasks[index].task);
+#else
+    return 0;
+#endif
+}
+
+const MemorySiteCounters& MemoryMonitor::GetSiteCounters(MemorySite site)
+{
+    return siteCounters[(site < MS_SITE_COUNT) ? site : MS_OTHER];
+}
+
+void MemoryMonitor::ResetSiteCounters()
+{
+    for(unsigned int i = 0; i < MS_SITE_COUNT; i++)
+    {
+        siteCounters[i].Reset();
+    }
+}
+
+String MemoryMonitor::ToSnapshotString()
+{
+    // eight counters of 64 bits on the host
+    char buffer[160] = { 0 };
+    MemorySnapshot snapshot;
+    GetSnapshot(snapshot);
+
+    String text = MEMORY_SNAPSHOT_VERSION;
+    snprintf(buffer, sizeof(buffer), ":%lx,%lx,%lx,%lx,%lx,%lx,%lx,%lx|",
+        (unsigned long)snapshot.heapSize, (unsigned long)snapshot.freeHeap, (unsigned long)snapshot.minimumFreeHeap,
+        (unsigned long)snapshot.largestFreeBlock, snapshot.allocations, snapshot.releases,
+        (unsigned long)snapshot.trackedBytes, (unsigned long)snapshot.trackedPeak);
+    text += buffer;
+
+    for(unsigned int i = 0; i < watchedTaskCount; i++)
+    {
+        snprintf(buffer, sizeof(buffer), "%s%s=%lx", (i > 0) ? "," : "", watchedTasks[i].name, (unsigned long)GetStackHighWaterMark(i));
+        text += buffer;
+    }
+
+    for(unsigned int i = 0; i < MS_SITE_COUNT; i++)
+    {
+        const MemorySiteCounters& counters = siteCounters[i];
+        snprintf(buffer, sizeof(buffer), "|%lx,%lx,%lx,%lx,%lx",
+            counters.calls, counters.allocations, counters.releases, counters.allocatedBytes, (unsigned long)counters.retainedBytes);
+        text += buffer;
+    }
+    return text;
+}
+
+void MemoryMonitor::OnAllocate(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    uint32_t tracked = trackedBytes.fetch_add((uint32_t)size, std::memory_order_relaxed) + (uint32_t)size;
+
+    uint32_t peak = trackedPeak.load(std::memory_order_relaxed);
+    while(tracked > peak && !trackedPeak.compare_exchange_weak(peak, tracked, std::memory_order_relaxed))
+    {
+    }
+
+    if(currentSite != MS_OTHER && siteTask == currentTask())
+    {
+        siteCounters[currentSite].allocations++;
+        siteCounters[currentSite].allocatedBytes += size;
+    }
+}
+
+void MemoryMonitor::OnRelease(size_t size)
+{
+    releaseCount.fetch_add(1, std::memory_order_relaxed);
+    trackedBytes.fetch_sub((uint32_t)size, std::memory_order_relaxed);
+
+    if(currentSite != MS_OTHER && siteTask == currentTask())
+    {
+        siteCounters[currentSite].releases++;
+    }
+}
+
+MemorySite MemoryMonitor::EnterSite(MemorySite site, size_t& trackedAtEntry)
+{
+    MemorySite previous = currentSite;
+
+    siteCounters[site].calls++;
+    trackedAtEntry = trackedBytes.load(std::memory_order_relaxed);
+    siteTask = currentTask();
+    currentSite = site;
+    return previous;
+}
+
+void MemoryMonitor::LeaveSite(MemorySite previous, size_t trackedAtEntry)
+{
+    siteCounters[currentSite].retainedBytes += (long)(int32_t)(trackedBytes.load(std::memory_order_relaxed) - (uint32_t)trackedAtEntry);
+    currentSite = previous;
+}
+
+MemorySiteScope::MemorySiteScope(MemorySite site)
+: previous(MS_OTHER), trackedAtEntry(0)
+{
+    this->previous = MemoryMonitor::EnterSite(site, this->trackedAtEntry);
+}
+
+MemorySiteScope::~MemorySiteScope()
+{
+    MemoryMonitor::LeaveSite(this->previous, this->trackedAtEntry);
+}
+
+#ifdef MEMORY_MONITOR_WRAP_MALLOC
+// link with -Wl,--wrap=malloc,--wrap=free,--wrap=calloc,--wrap=realloc, on the host only the allocations of the
+// program itself are counted (not those of shared libraries like mbedtls)
+static size_t allocatedSize(void* pointer)
+{
+#ifdef ESP32
+    return heap_caps_get_allocated_size(pointer);
+#else
+    return malloc_usable_size(pointer);
+#endif
+}
+
+extern "C"
+{
+    void* __real_malloc(size_t size);
+    void __real_free(void* pointer);
+    void* __real_calloc(size_t count, size_t size);
+    void* __real_realloc(void* pointer, size_t size);
+
+    void* __wrap_malloc(size_t size)
+    {
+        void* pointer = __real_malloc(size);
+        if(pointer != nullptr)
+        {
+            MemoryMonitor::OnAllocate(allocatedSize(pointer));
+        }
+        return pointer;
+    }
+
+    void __wrap_free(void* pointer)
+    {
+        if(pointer != nullptr)
+        {
+            MemoryMonitor::OnRelease(allocatedSize(pointer));
+        }
+        __real_free(pointer);
+    }
+
+    void* __wrap_calloc(size_t count, size_t size)
+    {
+        void* pointer = __real_calloc(count, size);
+        if(pointer != nullptr)
+        {
+            MemoryMonitor::OnAllocate(allocatedSize(pointer));
+        }
+        return pointer;
+    }
+
+    void* __wrap_realloc(void* pointer, size_t size)
+    {
+        size_t previousSize = (pointer != nullptr) ? allocatedSize(pointer) : 0;
+        void* resized = __real_realloc(pointer, size);
+
+        // a failed realloc keeps the old block
+        if(resized != nullptr || size == 0)
+        {
+            if(pointer != nullptr)
+            {
+                MemoryMonitor::OnRelease(previousSize);
+            }
+            if(resized != nullptr)
+            {
+                MemoryMonitor::OnAllocate(allocatedSize(resized));
+            }
+        }
+        return resized;
+    }
+}
+#endif
@@ -0,0 +1,192 @@
+#include "MemorySoak.h"
+
+MemorySoakConfig::MemorySoakConfig()
+: cycles(100000), messagesPerCycle(4), payloadSize(64), warmupCycles(100), sampleInterval(10), growthLimit(1024)
+{}
+
+MemorySoakResult::MemorySoakResult()
+: cycles(0), handshakes(0), messagesSent(0), messagesReceived(0), errors(0), firstSample(0), lastSample(0), trend(0), passed(false)
+{}
+
+MemorySoak::MemorySoak()
+: sampleCount(0), sampleStride(1)
+{
+    memset(this->samples, 0, sizeof(this->samples));
+}
+
+bool MemorySoak::Begin(const MemorySoakConfig& _config)
+{
+    this->config = _config;
+    this->result = MemorySoakResult();
+    this->sampleCount = 0;
+    this->sampleStride = 1;
+
+    if(this->config.sampleInterval == 0)
+    {
+        this->config.sampleInterval = 1;
+    }
+    if(this->config.payloadSize > LOOPBACK_PAYLOAD_MAX)
+    {
+        this->config.payloadSize = LOOPBACK_PAYLOAD_MAX;
+    }
+
+    this->payload = "";
+    for(unsigned int i = 0; i < this->config.payloadSize; i++)
+    {
+        this->payload += (char)('a' + (i % 26));
+    }
+
+    this->control.SetDeviceName("soak");
+    this->control.SetInterface(&this->server);
+    this->server.SetController(&this->control);
+    this->server.SetInterface(this);
+
+    return this->server.Begin(MEMORY_SOAK_RSA_BITS);
+}
+
+bool MemorySoak::RunCycle()
+{
+    if(this->result.cycles >= this->config.cycles)
+    {
+        return false;
+    }
+
+    unsigned long sentBefore = this->server.GetReceivedCount();
+    unsigned long receivedBefore = this->result.messagesReceived;
+
+    if(!this->server.Handshake())
+    {
+        this->result.errors++;
+    }
+    else
+    {
+        this->result.handshakes++;
+
+        for(unsigned int i = 0; i < this->config.messagesPerCycle; i++)
+        {
+            this->server.SendData(this->payload);
+            this->control.SendData(this->payload, true);
+            this->server.Pump();
+        }
+
+        this->result.messagesSent = this->server.GetReceivedCount();
+        if(this->result.messagesSent - sentBefore != this->config.messagesPerCycle
+            || this->result.messagesReceived - receivedBefore != this->config.messagesPerCycle)
+        {
+            this->result.errors++;
+        }
+    }
+    this->server.EndSession();
+
+    this->result.cycles++;
+    this->sample();
+
+    if(this->result.cycles >= this->config.cycles)
+    {
+        this->result.trend = this->computeTrend();
+        this->result.passed = (this->result.errors == 0) && (this->result.trend <= this->config.growthLimit);
+        return false;
+    }
+    return true;
+}
+
+const MemorySoakResult& MemorySoak::GetResult() const
+{
+    return this->result;
+}
+
+void MemorySoak::PrintResult(Print& output) const
+{
+    char buffer[160] = { 0 };
+
+    snprintf(buffer, sizeof(buffer), "soak: %lu cycles, %lu handshakes, %lu/%lu messages, %lu errors",
+        this->result.cycles, this->result.handshakes, this->result.messagesSent, this->result.messagesReceived, this->result.errors);
+    output.println(buffer);
+    snprintf(buffer, sizeof(buffer), "soak: used %ld -> %ld bytes, trend %+ld bytes (limit %ld): %s",
+        this->result.firstSample, this->result.lastSample, this->result.trend, this->config.growthLimit,
+        this->result.passed ? "passed" : "FAILED");
+    output.println(buffer);
+}
+
+void MemorySoak::OutGateway(const String& data)
+{
+    // the controller sends to the loopback server, nothing arrives here
+}
+
+void MemorySoak::OnDataDecoded(const ByteSpan& data)
+{
+    if(data.length == this->payload.length())
+    {
+        this->result.messagesReceived++;
+    }
+}
+
+void MemorySoak::sample()
+{
+    if(this->result.cycles <= this->config.warmupCycles)
+    {
+        return;
+    }
+    if(((this->result.cycles - this->config.warmupCycles) % (this->config.sampleInterval * this->sampleStride)) != 0)
+    {
+        return;
+    }
+
+    if(this->sampleCount == MEMORY_SOAK_SAMPLES)
+    {
+        // keep the whole run in the table with half the resolution
+        for(unsigned int i = 0; i < MEMORY_SOAK_SAMPLES / 2; i++)
+        {
+            this->samples[i] = (this->samples[2 * i] + this->samples[(2 * i) + 1]) / 2;
+        }
+        this->sampleCount = MEMORY_SOAK_SAMPLES / 2;
+        this->sampleStride *= 2;
+    }
+
+    long used = this->usedMemory();
+    if(this->sampleCount == 0)
+    {
+        this->result.firstSample = used;
+    }
+    this->result.lastSample = used;
+    this->samples[this->sampleCount++] = used;
+}
+
+long MemorySoak::usedMemory() const
+{
+    MemorySnapshot snapshot;
+    MemoryMonitor::GetSnapshot(snapshot);
+
+    if(snapshot.allocations > 0)
+    {
+        return (long)snapshot.trackedBytes;
+    }
+    return (long)(snapshot.heapSize - snapshot.freeHeap);
+}
+
+long MemorySoak::computeTrend() const
+{
+    if(this->sampleCount < 2)
+    {
+        return 0;
+    }
+
+    // least squares slope over the sample index, scaled to the whole sampled range
+    double n = this->sampleCount;
+    double sumX = 0;
+    double sumY = 0;
+    double sumXY = 0;
+    double sumXX = 0;
+
+    for(unsigned int i = 0; i < this->sampleCount; i++)
+    {
+        double y = (double)(this->samples[i] - this->samples[0]);
+        sumX += i;
+        sumY += y;
+        sumXY += i * y;
+        sumXX += (double)i * i;
+    }
+
+    double slope = ((n * sumXY) - (sumX * sumY)) / ((n * sumXX) - (sumX * sumX));
+    return (long)(slope * (n - 1));
+}
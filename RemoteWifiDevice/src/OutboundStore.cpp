@@ -0,0 +1,247 @@
+#include "OutboundStore.h"
+
+#define OUTBOUND_STORE_MAGIC 0x314C424F  // "OBL1"
+#define OUTBOUND_STORE_HEADER_SIZE 20
+
+static void writeUInt32(unsigned char* buffer, uint32_t value)
+{
+    buffer[0] = (unsigned char)value;
+    buffer[1] = (unsigned char)(value >> 8);
+    buffer[2] = (unsigned char)(value >> 16);
+    buffer[3] = (unsigned char)(value >> 24);
+}
+
+static uint32_t readUInt32(const unsigned char* buffer)
+{
+    return (uint32_t)buffer[0]
+        | ((uint32_t)buffer[1] << 8)
+        | ((uint32_t)buffer[2] << 16)
+        | ((uint32_t)buffer[3] << 24);
+}
+
+FileOutboundStore::FileOutboundStore(const char* _path, uint32_t _capacity)
+: path(_path), file(nullptr), capacity(_capacity), head(0), used(0), count(0), evicted(0)
+{}
+
+FileOutboundStore::~FileOutboundStore()
+{
+    if(this->file != nullptr)
+    {
+        fclose(this->file);
+    }
+}
+
+bool FileOutboundStore::Begin()
+{
+    if(this->file != nullptr)
+    {
+        return true;
+    }
+
+    this->file = fopen(this->path.c_str(), "r+b");
+    if(this->file != nullptr && this->readHeader())
+    {
+        return true;
+    }
+
+    // no valid log, start a new one
+    if(this->file != nullptr)
+    {
+        fclose(this->file);
+    }
+    this->file = fopen(this->path.c_str(), "w+b");
+    if(this->file == nullptr)
+    {
+        return false;
+    }
+
+    this->head = 0;
+    this->used = 0;
+    this->count = 0;
+    return this->writeHeader();
+}
+
+bool FileOutboundStore::Append(const unsigned char* data, unsigned int length, uint8_t flags)
+{
+    uint32_t recordSize = OUTBOUND_RECORD_HEADER_SIZE + length;
+
+    if(this->file == nullptr || data == nullptr || length == 0 || length > 0xFFFF || recordSize > this->capacity)
+    {
+        return false;
+    }
+
+    // drop the oldest messages until the new one fits
+    while((this->capacity - this->used) < recordSize)
+    {
+        if(!this->dropOldest())
+        {
+            return false;
+        }
+        this->evicted++;
+    }
+
+    unsigned char recordHeader[OUTBOUND_RECORD_HEADER_SIZE] = { (unsigned char)length, (unsigned char)(length >> 8), flags, 0 };
+    uint32_t tail = (this->head + this->used) % this->capacity;
+
+    if(!this->writeRing(tail, recordHeader, sizeof(recordHeader))
+        || !this->writeRing((tail + OUTBOUND_RECORD_HEADER_SIZE) % this->capacity, data, length))
+    {
+        return false;
+    }
+
+    this->used += recordSize;
+    this->count++;
+    return this->writeHeader();
+}
+
+unsigned int FileOutboundStore::Peek(unsigned char* buffer, unsigned int size, uint8_t& flags)
+{
+    unsigned int length = 0;
+
+    if(this->file == nullptr || this->count == 0 || !this->readRecordHeader(this->head, length, flags) || length > size)
+    {
+        return 0;
+    }
+    if(!this->readRing((this->head + OUTBOUND_RECORD_HEADER_SIZE) % this->capacity, buffer, length))
+    {
+        return 0;
+    }
+    return length;
+}
+
+bool FileOutboundStore::Pop()
+{
+    if(this->file == nullptr || this->count == 0)
+    {
+        return false;
+    }
+    return this->dropOldest() && this->writeHeader();
+}
+
+unsigned int FileOutboundStore::GetCount() const
+{
+    return this->count;
+}
+
+uint32_t FileOutboundStore::GetUsedBytes() const
+{
+    return this->used;
+}
+
+unsigned long FileOutboundStore::GetEvicted() const
+{
+    return this->evicted;
+}
+
+bool FileOutboundStore::readHeader()
+{
+    unsigned char header[OUTBOUND_STORE_HEADER_SIZE] = { 0 };
+
+    if(fseek(this->file, 0, SEEK_SET) != 0 || fread(header, 1, sizeof(header), this->file) != sizeof(header))
+    {
+        return false;
+    }
+    if(readUInt32(header) != OUTBOUND_STORE_MAGIC || readUInt32(header + 4) != this->capacity)
+    {
+        return false;
+    }
+
+    this->head = readUInt32(header + 8);
+    this->used = readUInt32(header + 12);
+    this->count = readUInt32(header + 16);
+
+    return (this->head < this->capacity) && (this->used <= this->capacity);
+}
+
+bool FileOutboundStore::writeHeader()
+{
+    unsigned char header[OUTBOUND_STORE_HEADER_SIZE] = { 0 };
+
+    writeUInt32(header, OUTBOUND_STORE_MAGIC);
+    writeUInt32(header + 4, this->capacity);
+    writeUInt32(header + 8, this->head);
+    writeUInt32(header + 12, this->used);
+    writeUInt32(header + 16, this->count);
+
+    if(fseek(this->file, 0, SEEK_SET) != 0 || fwrite(header, 1, sizeof(header), this->file) != sizeof(header))
+    {
+        return false;
+    }
+    return (fflush(this->file) == 0);
+}
+
+bool FileOutboundStore::readRing(uint32_t position, unsigned char* buffer, unsigned int length)
+{
+    // the data can wrap around the end of the ring
+    unsigned int first = ((this->capacity - position) < length) ? (this->capacity - position) : length;
+
+    if(fseek(this->file, OUTBOUND_STORE_HEADER_SIZE + position, SEEK_SET) != 0
+        || fread(buffer, 1, first, this->file) != first)
+    {
+        return false;
+    }
+    if(first < length)
+    {
+        if(fseek(this->file, OUTBOUND_STORE_HEADER_SIZE, SEEK_SET) != 0
+            || fread(buffer + first, 1, length - first, this->file) != (length - first))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FileOutboundStore::writeRing(uint32_t position, const unsigned char* data, unsigned int length)
+{
+    unsigned int first = ((this->capacity - position) < length) ? (this->capacity - position) : length;
+
+    if(fseek(this->file, OUTBOUND_STORE_HEADER_SIZE + position, SEEK_SET) != 0
+        || fwrite(data, 1, first, this->file) != first)
+    {
+        return false;
+    }
+    if(first < length)
+    {
+        if(fseek(this->file, OUTBOUND_STORE_HEADER_SIZE, SEEK_SET) != 0
+            || fwrite(data + first, 1, length - first, this->file) != (length - first))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FileOutboundStore::readRecordHeader(uint32_t position, unsigned int& length, uint8_t& flags)
+{
+    unsigned char recordHeader[OUTBOUND_RECORD_HEADER_SIZE] = { 0 };
+
+    if(!this->readRing(position, recordHeader, sizeof(recordHeader)))
+    {
+        return false;
+    }
+    length = (unsigned int)recordHeader[0] | ((unsigned int)recordHeader[1] << 8);
+    flags = recordHeader[2];
+    return true;
+}
+
+bool FileOutboundStore::dropOldest()
+{
+    unsigned int length = 0;
+    uint8_t flags = 0;
+
+    if(this->count == 0 || !this->readRecordHeader(this->head, length, flags))
+    {
+        return false;
+    }
+
+    uint32_t recordSize = OUTBOUND_RECORD_HEADER_SIZE + length;
+    if(recordSize > this->used)
+    {
+        return false;
+    }
+
+    this->head = (this->head + recordSize) % this->capacity;
+    this->used -= recordSize;
+    this->count--;
+    return true;
+}
@@ -0,0 +1,317 @@
+#include "RpcEndpoint.h"
+
+#define RPC_CALL_MASK (RPC_CALL_CAPACITY - 1)
+// "rpc:" in front of the first message of a batch
+#define RPC_BATCH_PREFIX_SIZE (sizeof(RPC_COMMAND))
+
+RpcStatistics::RpcStatistics()
+: calls(0), completed(0), timeouts(0), late(0), served(0), batchesSent(0), malformed(0)
+{}
+
+RpcEndpoint::PendingCall::PendingCall()
+: callID(0), callback(nullptr), startTime(0), timeout(0)
+{}
+
+RpcEndpoint::RpcEndpoint()
+: controller(nullptr), pendingCount(0), nextCallID(1), currentCallID(0)
+{}
+
+bool RpcEndpoint::Begin(TransmissionControl* _controller)
+{
+    this->controller = _controller;
+
+    if(this->controller == nullptr)
+    {
+        return false;
+    }
+    return this->controller->RegisterCommand(RPC_COMMAND, this);
+}
+
+uint16_t RpcEndpoint::Call(const char* method, const String& arguments, IRpcCallback* callback, unsigned long timeout)
+{
+    if(this->controller == nullptr || method == nullptr || *method == '\0' || this->pendingCount >= RPC_CALL_CAPACITY)
+    {
+        return 0;
+    }
+
+    uint16_t callID = this->allocateCallID();
+
+    char prefix[8] = { 0 };
+    sprintf(prefix, "%c%x:", RPC_REQUEST_TAG, (unsigned int)callID);
+
+    if(!this->appendMessage(prefix, method, arguments))
+    {
+        return 0;
+    }
+
+    auto& call = this->calls[callID & RPC_CALL_MASK];
+    call.callID = callID;
+    call.callback = callback;
+    call.startTime = millis();
+    call.timeout = timeout;
+
+    this->pendingCount++;
+    this->statistics.calls++;
+
+    return callID;
+}
+
+bool RpcEndpoint::Cancel(uint16_t callID)
+{
+    auto& call = this->calls[callID & RPC_CALL_MASK];
+    if(callID == 0 || call.callID != callID)
+    {
+        return false;
+    }
+    call = PendingCall();
+    this->pendingCount--;
+
+    return true;
+}
+
+unsigned int RpcEndpoint::GetPendingCount() const
+{
+    return this->pendingCount;
+}
+
+bool RpcEndpoint::RegisterMethod(const char* method, ICommandHandler* handler)
+{
+    return this->methods.Register(method, handler);
+}
+
+uint16_t RpcEndpoint::GetCurrentCallID() const
+{
+    return this->currentCallID;
+}
+
+bool RpcEndpoint::Respond(uint16_t callID, RpcStatus status, const String& result)
+{
+    char prefix[8] = { 0 };
+    char code[4] = { 0 };
+    sprintf(prefix, "%c%x:", RPC_RESPONSE_TAG, (unsigned int)callID);
+    sprintf(code, "%u", (unsigned int)status);
+
+    if(this->controller == nullptr || callID == 0 || !this->appendMessage(prefix, code, result))
+    {
+        return false;
+    }
+    this->statistics.served++;
+
+    return true;
+}
+
+bool RpcEndpoint::Flush()
+{
+    if(this->outgoing.length() == 0)
+    {
+        return true;
+    }
+    if(this->controller == nullptr || !this->controller->SendData(this->outgoing, true))
+    {
+        return false;
+    }
+    this->outgoing = "";
+    this->statistics.batchesSent++;
+
+    return true;
+}
+
+void RpcEndpoint::OnLoop()
+{
+    this->Flush();
+
+    if(this->pendingCount == 0)
+    {
+        return;
+    }
+
+    auto now = millis();
+    for(unsigned int i = 0; i < RPC_CALL_CAPACITY; i++)
+    {
+        if(this->calls[i].callID != 0 && (now - this->calls[i].startTime) >= this->calls[i].timeout)
+        {
+            this->statistics.timeouts++;
+            this->complete(this->calls[i].callID, RS_TIMEOUT, CommandSpan());
+        }
+    }
+}
+
+void RpcEndpoint::OnClientDisconnected()
+{
+    // responses and calls of the old session are not sent, the peer has forgotten the calls
+    this->outgoing = "";
+
+    for(unsigned int i = 0; i < RPC_CALL_CAPACITY && this->pendingCount > 0; i++)
+    {
+        if(this->calls[i].callID != 0)
+        {
+            this->complete(this->calls[i].callID, RS_CANCELLED, CommandSpan());
+        }
+    }
+}
+
+const RpcStatistics& RpcEndpoint::GetStatistics() const
+{
+    return this->statistics;
+}
+
+void RpcEndpoint::OnCommand(uint32_t commandID, const CommandArguments& arguments)
+{
+    if(commandID != COMMAND_ID(RPC_COMMAND))
+    {
+        return;
+    }
+
+    auto batch = arguments.GetRaw();
+    unsigned int start = 0;
+
+    for(unsigned int i = 0; i <= batch.length; i++)
+    {
+        if(i == batch.length || batch.data[i] == RPC_MESSAGE_SEPARATOR)
+        {
+            if(i > start)
+            {
+                this->processMessage(batch.data + start, i - start);
+            }
+            start = i + 1;
+        }
+    }
+
+    // the responses of the batch go out together
+    this->Flush();
+}
+
+uint16_t RpcEndpoint::allocateCallID()
+{
+    // the slot of a call is its ID modulo the capacity, so the lookup of a response is a single compare
+    while(this->nextCallID == 0 || this->calls[this->nextCallID & RPC_CALL_MASK].callID != 0)
+    {
+        this->nextCallID++;
+    }
+    return this->nextCallID++;
+}
+
+bool RpcEndpoint::appendMessage(const char* prefix, const char* name, const String& tail)
+{
+    if(strchr(name, RPC_MESSAGE_SEPARATOR) != nullptr || tail.indexOf(RPC_MESSAGE_SEPARATOR) >= 0)
+    {
+        return false;
+    }
+
+    unsigned int length = strlen(prefix) + strlen(name) + ((tail.length() > 0) ? (tail.length() + 1) : 0);
+    if(RPC_BATCH_PREFIX_SIZE + length > RPC_BATCH_MAX)
+    {
+        return false;
+    }
+
+    // a full batch is sent first, it fails if the transport is full
+    if(this->outgoing.length() > 0 && (this->outgoing.length() + 1 + length) > RPC_BATCH_MAX && !this->Flush())
+    {
+        return false;
+    }
+
+    if(this->outgoing.length() == 0)
+    {
+        this->outgoing.reserve(RPC_BATCH_MAX);
+        this->outgoing += RPC_COMMAND;
+        this->outgoing += COMMAND_DELIMITER;
+    }
+    else
+    {
+        this->outgoing += RPC_MESSAGE_SEPARATOR;
+    }
+    this->outgoing += prefix;
+    this->outgoing += name;
+    if(tail.length() > 0)
+    {
+        this->outgoing += COMMAND_DELIMITER;
+        this->outgoing += tail;
+    }
+    return true;
+}
+
+void RpcEndpoint::processMessage(const char* data, unsigned int length)
+{
+    // tag and hex call ID up to the first delimiter
+    unsigned int callID = 0;
+    unsigned int i = 1;
+
+    for(; i < length && data[i] != COMMAND_DELIMITER; i++)
+    {
+        char c = data[i];
+        unsigned int value = (c >= '0' && c <= '9') ? (c - '0')
+            : (c >= 'a' && c <= 'f') ? (c - 'a' + 10)
+            : (c >= 'A' && c <= 'F') ? (c - 'A' + 10) : 16;
+
+        if(value > 15 || callID > 0xFFF)
+        {
+            break;
+        }
+        callID = (callID << 4) | value;
+    }
+
+    if(i >= length || data[i] != COMMAND_DELIMITER || callID == 0)
+    {
+        this->statistics.malformed++;
+        return;
+    }
+    i++;
+
+    switch(data[0])
+    {
+    case RPC_REQUEST_TAG:
+        this->currentCallID = callID;
+        if(!this->methods.Dispatch(data + i, length - i))
+        {
+            this->Respond(callID, RS_UNKNOWN_METHOD, "");
+        }
+        this->currentCallID = 0;
+        break;
+    case RPC_RESPONSE_TAG:
+        {
+            unsigned int status = 0;
+            for(; i < length && data[i] >= '0' && data[i] <= '9'; i++)
+            {
+                status = (status * 10) + (data[i] - '0');
+            }
+            // skip the delimiter in front of the result
+            if(i < length)
+            {
+                i++;
+            }
+            if(this->complete(callID, (status <= RS_CANCELLED) ? (RpcStatus)status : RS_FAILED, CommandSpan(data + i, length - i)))
+            {
+                this->statistics.completed++;
+            }
+            else
+            {
+                // the call has timed out or was cancelled
+                this->statistics.late++;
+            }
+        }
+        break;
+    default:
+        this->statistics.malformed++;
+        break;
+    }
+}
+
+bool RpcEndpoint::complete(uint16_t callID, RpcStatus status, const CommandSpan& result)
+{
+    auto& call = this->calls[callID & RPC_CALL_MASK];
+    if(call.callID != callID)
+    {
+        return false;
+    }
+
+    // the slot is free before the callback, so it can start the next call
+    auto callback = call.callback;
+    call = PendingCall();
+    this->pendingCount--;
+
+    if(callback != nullptr)
+    {
+        callback->OnCallComplete(callID, status, result);
+    }
+    return true;
+}
@@ -0,0 +1,407 @@
+#include "ServiceDiscovery.h"
+
+// fnv-1a over a string, continued from the given hash
+static uint32_t hashString(uint32_t hash, const char* text)
+{
+    while(*text != '\0')
+    {
+        hash ^= (uint8_t)*text++;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+// final avalanche (murmur3 fmix32), so similar names do not get similar weights
+static uint32_t mixHash(uint32_t hash)
+{
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6BUL;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35UL;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+static bool timeReached(unsigned long now, unsigned long time)
+{
+    return (long)(now - time) >= 0;
+}
+
+ResolvedService::ResolvedService()
+: port(0), ttl(0)
+{}
+
+#ifdef ESP32
+MdnsServiceResolver::MdnsServiceResolver()
+: search(nullptr)
+{}
+
+MdnsServiceResolver::~MdnsServiceResolver()
+{
+    if(this->search != nullptr)
+    {
+        mdns_query_async_delete(this->search);
+    }
+}
+
+bool MdnsServiceResolver::BeginQuery(const char* service, const char* protocol, unsigned long timeout)
+{
+    if(this->search != nullptr)
+    {
+        return false;
+    }
+    this->search = mdns_query_async_new(nullptr, service, protocol, MDNS_TYPE_PTR, timeout, DISCOVERY_MAX_RESULTS);
+    return (this->search != nullptr);
+}
+
+bool MdnsServiceResolver::PollQuery(itemCollection<ResolvedService>& results)
+{
+    mdns_result_t* answers = nullptr;
+
+    if(this->search == nullptr)
+    {
+        return true;
+    }
+    // does not wait, returns false until the query timeout has passed
+    if(!mdns_query_async_get_results(this->search, 0, &answers))
+    {
+        return false;
+    }
+
+    for(auto answer = answers; answer != nullptr; answer = answer->next)
+    {
+        // use the first ipv4 address of the answer
+        for(auto address = answer->addr; address != nullptr; address = address->next)
+        {
+            if(address->addr.type == ESP_IPADDR_TYPE_V4)
+            {
+                ResolvedService resolved;
+                resolved.hostname = (answer->hostname != nullptr) ? answer->hostname : "";
+                resolved.address = IPAddress(address->addr.u_addr.ip4.addr);
+                resolved.port = answer->port;
+                resolved.ttl = answer->ttl * 1000UL;
+                results.AddItem(resolved);
+                break;
+            }
+        }
+    }
+
+    mdns_query_results_free(answers);
+    mdns_query_async_delete(this->search);
+    this->search = nullptr;
+
+    return true;
+}
+#endif
+
+FakeServiceResolver::FakeServiceResolver(unsigned long _delay)
+: delay(_delay), queryStart(0), queryCount(0), queryActive(false)
+{}
+
+void FakeServiceResolver::SetServices(const itemCollection<ResolvedService>& _services)
+{
+    this->services = _services;
+}
+
+unsigned long FakeServiceResolver::GetQueryCount() const
+{
+    return this->queryCount;
+}
+
+bool FakeServiceResolver::BeginQuery(const char* service, const char* protocol, unsigned long timeout)
+{
+    if(this->queryActive)
+    {
+        return false;
+    }
+    this->queryActive = true;
+    this->queryStart = millis();
+    this->queryCount++;
+    return true;
+}
+
+bool FakeServiceResolver::PollQuery(itemCollection<ResolvedService>& results)
+{
+    if(!this->queryActive)
+    {
+        return true;
+    }
+    if(!timeReached(millis(), this->queryStart + this->delay))
+    {
+        return false;
+    }
+
+    for(unsigned int i = 0; i < this->services.GetCount(); i++)
+    {
+        results.AddItem(this->services.GetAt(i));
+    }
+    this->queryActive = false;
+    return true;
+}
+
+DiscoveredServer::DiscoveredServer()
+: port(0), expires(0), connectLatency(0), failures(0), holdoffUntil(0), weight(0)
+{}
+
+ServiceDiscovery::ServiceDiscovery()
+: resolver(nullptr), queryTimer(0), queryActive(false), refreshRequested(false)
+{}
+
+void ServiceDiscovery::Begin(IServiceResolver* _resolver, const char* _service, const char* _protocol, const String& _deviceName)
+{
+    this->resolver = _resolver;
+    this->service = _service;
+    this->protocol = _protocol;
+    this->deviceName = _deviceName;
+
+    // query in the first loop
+    this->refreshRequested = true;
+}
+
+void ServiceDiscovery::OnLoop()
+{
+    if(this->resolver == nullptr)
+    {
+        return;
+    }
+
+    auto now = millis();
+
+    if(this->queryActive)
+    {
+        if(this->resolver->PollQuery(this->results))
+        {
+            this->queryActive = false;
+            this->mergeResults();
+        }
+    }
+    else
+    {
+        unsigned long interval = (this->servers.GetCount() > 0) ? DISCOVERY_QUERY_INTERVAL : DISCOVERY_QUERY_INTERVAL_EMPTY;
+
+        if(this->refreshRequested || timeReached(now, this->queryTimer + interval))
+        {
+            this->refreshRequested = false;
+            this->queryTimer = now;
+            this->results.Clear();
+            this->queryActive = this->resolver->BeginQuery(this->service.c_str(), this->protocol.c_str(), DISCOVERY_QUERY_TIMEOUT);
+        }
+    }
+
+    this->expireServers();
+    this->rankServers();
+}
+
+void ServiceDiscovery::Refresh()
+{
+    this->refreshRequested = true;
+}
+
+bool ServiceDiscovery::SelectServer(DiscoveredServer& server) const
+{
+    if(this->servers.GetCount() == 0)
+    {
+        return false;
+    }
+
+    auto now = millis();
+
+    // the ranking puts the servers which are not held off first
+    for(unsigned int i = 0; i < this->servers.GetCount(); i++)
+    {
+        if(timeReached(now, this->servers.GetAt(i).holdoffUntil))
+        {
+            server = this->servers.GetAt(i);
+            return true;
+        }
+    }
+
+    // all servers failed recently, try the one which is available again first
+    unsigned int next = 0;
+    for(unsigned int i = 1; i < this->servers.GetCount(); i++)
+    {
+        if((long)(this->servers.GetAt(i).holdoffUntil - this->servers.GetAt(next).holdoffUntil) < 0)
+        {
+            next = i;
+        }
+    }
+    server = this->servers.GetAt(next);
+    return true;
+}
+
+void ServiceDiscovery::ReportConnectResult(const DiscoveredServer& server, bool success, unsigned long latency)
+{
+    int index = this->findServer(server.address, server.port);
+    if(index < 0)
+    {
+        return;
+    }
+
+    auto& entry = this->servers.GetAt(index);
+
+    if(success)
+    {
+        entry.failures = 0;
+        entry.holdoffUntil = millis();
+        entry.connectLatency = (entry.connectLatency == 0) ? latency : ((entry.connectLatency * 3) + latency) / 4;
+
+        if(entry.connectLatency == 0)
+        {
+            entry.connectLatency = 1;
+        }
+    }
+    else
+    {
+        unsigned long holdoff = DISCOVERY_FAILURE_HOLDOFF;
+        for(unsigned int i = 0; i < entry.failures && holdoff < DISCOVERY_FAILURE_HOLDOFF_MAX; i++)
+        {
+            holdoff *= 2;
+        }
+        if(holdoff > DISCOVERY_FAILURE_HOLDOFF_MAX)
+        {
+            holdoff = DISCOVERY_FAILURE_HOLDOFF_MAX;
+        }
+
+        entry.failures++;
+        entry.holdoffUntil = millis() + holdoff;
+
+        // the server could have moved or stopped, look for changes in the background
+        this->refreshRequested = true;
+    }
+
+    this->rankServers();
+}
+
+unsigned int ServiceDiscovery::GetServerCount() const
+{
+    return this->servers.GetCount();
+}
+
+const DiscoveredServer& ServiceDiscovery::GetServer(unsigned int index) const
+{
+    return this->servers.GetAt(index);
+}
+
+void ServiceDiscovery::AddServer(const ResolvedService& service)
+{
+    this->updateServer(service, millis());
+    this->rankServers();
+}
+
+void ServiceDiscovery::mergeResults()
+{
+    auto now = millis();
+
+    for(unsigned int i = 0; i < this->results.GetCount(); i++)
+    {
+        this->updateServer(this->results.GetAt(i), now);
+    }
+    this->results.Clear();
+}
+
+void ServiceDiscovery::updateServer(const ResolvedService& resolved, unsigned long now)
+{
+    unsigned long ttl = (resolved.ttl > 0) ? resolved.ttl : DISCOVERY_DEFAULT_TTL;
+
+    int index = this->findServer(resolved.address, resolved.port);
+    if(index >= 0)
+    {
+        auto& entry = this->servers.GetAt(index);
+        entry.hostname = resolved.hostname;
+        entry.expires = now + ttl;
+    }
+    else
+    {
+        DiscoveredServer entry;
+        entry.hostname = resolved.hostname;
+        entry.address = resolved.address;
+        entry.port = resolved.port;
+        entry.expires = now + ttl;
+        entry.holdoffUntil = now;
+        entry.weight = this->serverWeight(entry);
+        this->servers.AddItem(entry);
+    }
+}
+
+void ServiceDiscovery::expireServers()
+{
+    auto now = millis();
+
+    unsigned int i = 0;
+    while(i < this->servers.GetCount())
+    {
+        if(timeReached(now, this->servers.GetAt(i).expires))
+        {
+            this->servers.RemoveAt(i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+void ServiceDiscovery::rankServers()
+{
+    auto now = millis();
+
+    // insertion sort, the table holds only a few entries and is almost always sorted already
+    for(unsigned int i = 1; i < this->servers.GetCount(); i++)
+    {
+        for(unsigned int j = i; j > 0 && ranksBefore(this->servers.GetAt(j), this->servers.GetAt(j - 1), now); j--)
+        {
+            DiscoveredServer temp = this->servers.GetAt(j);
+            this->servers.GetAt(j) = this->servers.GetAt(j - 1);
+            this->servers.GetAt(j - 1) = temp;
+        }
+    }
+}
+
+int ServiceDiscovery::findServer(const IPAddress& address, uint16_t port) const
+{
+    for(unsigned int i = 0; i < this->servers.GetCount(); i++)
+    {
+        if((uint32_t)this->servers.GetAt(i).address == (uint32_t)address && this->servers.GetAt(i).port == port)
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+uint32_t ServiceDiscovery::serverWeight(const DiscoveredServer& server) const
+{
+    char endpoint[24] = { 0 };
+
+    // the hostname is kept if the server gets a new address
+    if(server.hostname.length() > 0)
+    {
+        sprintf(endpoint, ":%u", (unsigned int)server.port);
+    }
+    else
+    {
+        sprintf(endpoint, ":%lx:%u", (unsigned long)(uint32_t)server.address, (unsigned int)server.port);
+    }
+
+    uint32_t hash = hashString(2166136261UL, this->deviceName.c_str());
+    hash = hashString(hash, server.hostname.c_str());
+    hash = hashString(hash, endpoint);
+    return mixHash(hash);
+}
+
+bool ServiceDiscovery::ranksBefore(const DiscoveredServer& a, const DiscoveredServer& b, unsigned long now)
+{
+    bool aAvailable = timeReached(now, a.holdoffUntil);
+    bool bAvailable = timeReached(now, b.holdoffUntil);
+
+    if(aAvailable != bAvailable)
+    {
+        return aAvailable;
+    }
+    if(a.weight != b.weight)
+    {
+        return a.weight > b.weight;
+    }
+    // same weight (hash collision), prefer the faster server
+    return (a.connectLatency != 0) && (b.connectLatency == 0 || a.connectLatency < b.connectLatency);
+}
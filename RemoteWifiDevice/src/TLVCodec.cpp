@@ -0,0 +1,400 @@
+#include "TLVCodec.h"
+
+TLVWriter::TLVWriter(unsigned char* _buffer, unsigned int _capacity)
+: buffer(_buffer), capacity(_capacity), position(TLV_HEADER_SIZE), nestingLevel(0), errorFlag(false)
+{
+    if(this->buffer == nullptr || this->capacity < TLV_HEADER_SIZE)
+    {
+        this->errorFlag = true;
+    }
+    else
+    {
+        this->buffer[0] = TLV_MESSAGE_MARKER;
+    }
+}
+
+void TLVWriter::WriteUInt(uint8_t tag, uint32_t value)
+{
+    this->writeKey(tag, TLVType::TLV_UINT);
+    this->writeVarint(value);
+}
+
+void TLVWriter::WriteInt(uint8_t tag, int32_t value)
+{
+    // zigzag encoding keeps small negative numbers small
+    this->writeKey(tag, TLVType::TLV_INT);
+    this->writeVarint(((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+void TLVWriter::WriteFloat(uint8_t tag, float value)
+{
+    uint32_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+
+    unsigned char raw[4] = {
+        (unsigned char)(bits & 0xFF),
+        (unsigned char)((bits >> 8) & 0xFF),
+        (unsigned char)((bits >> 16) & 0xFF),
+        (unsigned char)((bits >> 24) & 0xFF)
+    };
+
+    this->writeKey(tag, TLVType::TLV_FLOAT);
+    this->writeRaw(raw, sizeof(raw));
+}
+
+void TLVWriter::WriteBytes(uint8_t tag, const unsigned char* data, unsigned int length)
+{
+    if(data == nullptr && length > 0)
+    {
+        this->errorFlag = true;
+        return;
+    }
+    this->writeKey(tag, TLVType::TLV_BYTES);
+    this->writeVarint(length);
+    this->writeRaw(data, length);
+}
+
+void TLVWriter::WriteString(uint8_t tag, const char* text)
+{
+    this->WriteString(tag, text, (text != nullptr) ? strlen(text) : 0);
+}
+
+void TLVWriter::WriteString(uint8_t tag, const char* text, unsigned int length)
+{
+    if(text == nullptr && length > 0)
+    {
+        this->errorFlag = true;
+        return;
+    }
+    this->writeKey(tag, TLVType::TLV_STRING);
+    this->writeVarint(length);
+    this->writeRaw((const unsigned char*)text, length);
+}
+
+void TLVWriter::BeginRecord(uint8_t tag)
+{
+    if(this->nestingLevel >= TLV_MAX_NESTING)
+    {
+        this->errorFlag = true;
+        return;
+    }
+    this->writeKey(tag, TLVType::TLV_RECORD);
+
+    // reserve the length field, it is filled in EndRecord()
+    unsigned char placeholder[2] = { 0, 0 };
+    this->writeRaw(placeholder, sizeof(placeholder));
+
+    if(!this->errorFlag)
+    {
+        this->recordStart[this->nestingLevel] = this->position;
+        this->nestingLevel++;
+    }
+}
+
+void TLVWriter::EndRecord()
+{
+    if(this->errorFlag)
+    {
+        return;
+    }
+    if(this->nestingLevel == 0)
+    {
+        this->errorFlag = true;
+        return;
+    }
+    this->nestingLevel--;
+
+    unsigned int start = this->recordStart[this->nestingLevel];
+    this->writeFixedLength(start - 2, this->position - start);
+}
+
+bool TLVWriter::Finish()
+{
+    if(!this->errorFlag)
+    {
+        if(this->nestingLevel != 0)
+        {
+            this->errorFlag = true;
+        }
+        else
+        {
+            this->writeFixedLength(1, this->position - TLV_HEADER_SIZE);
+        }
+    }
+    return !this->errorFlag;
+}
+
+bool TLVWriter::HasError() const
+{
+    return this->errorFlag;
+}
+
+const unsigned char* TLVWriter::GetData() const
+{
+    return this->buffer;
+}
+
+unsigned int TLVWriter::GetLength() const
+{
+    return this->errorFlag ? 0 : this->position;
+}
+
+void TLVWriter::writeKey(uint8_t tag, TLVType type)
+{
+    if(tag > TLV_MAX_TAG)
+    {
+        this->errorFlag = true;
+        return;
+    }
+    unsigned char key = (unsigned char)((tag << 3) | (uint8_t)type);
+    this->writeRaw(&key, 1);
+}
+
+void TLVWriter::writeVarint(uint32_t value)
+{
+    unsigned char raw[5];
+    unsigned int count = 0;
+
+    do
+    {
+        raw[count] = (unsigned char)(value & 0x7F);
+        value >>= 7;
+        if(value != 0)
+        {
+            raw[count] |= 0x80;
+        }
+        count++;
+    }
+    while(value != 0);
+
+    this->writeRaw(raw, count);
+}
+
+void TLVWriter::writeRaw(const unsigned char* data, unsigned int length)
+{
+    if(this->errorFlag)
+    {
+        return;
+    }
+    if(length > (this->capacity - this->position))
+    {
+        this->errorFlag = true;
+        return;
+    }
+    if(length > 0)
+    {
+        memcpy(this->buffer + this->position, data, length);
+        this->position += length;
+    }
+}
+
+void TLVWriter::writeFixedLength(unsigned int offset, unsigned int length)
+{
+    if(length > TLV_MAX_RECORD_LENGTH)
+    {
+        this->errorFlag = true;
+        return;
+    }
+    // two byte varint (the continuation bit is always set in the first byte, so the field size is fixed)
+    this->buffer[offset] = (unsigned char)((length & 0x7F) | 0x80);
+    this->buffer[offset + 1] = (unsigned char)((length >> 7) & 0x7F);
+}
+
+TLVReader::TLVReader()
+: data(nullptr), length(0), position(0), tag(0), type(TLVType::TLV_UINT), value(0), content(nullptr), contentLength(0), errorFlag(false)
+{}
+
+TLVReader::TLVReader(const unsigned char* _data, unsigned int _length)
+: data(_data), length(_length), position(0), tag(0), type(TLVType::TLV_UINT), value(0), content(nullptr), contentLength(0), errorFlag(false)
+{
+    if(this->data == nullptr)
+    {
+        this->length = 0;
+    }
+}
+
+TLVReader TLVReader::FromMessage(const unsigned char* data, unsigned int length)
+{
+    if(!IsMessage(data, length))
+    {
+        TLVReader reader;
+        reader.errorFlag = true;
+        return reader;
+    }
+    unsigned int bodyLength = (data[1] & 0x7F) | ((unsigned int)(data[2] & 0x7F) << 7);
+    return TLVReader(data + TLV_HEADER_SIZE, bodyLength);
+}
+
+bool TLVReader::IsMessage(const unsigned char* data, unsigned int length)
+{
+    if(data == nullptr || length < TLV_HEADER_SIZE || data[0] != TLV_MESSAGE_MARKER)
+    {
+        return false;
+    }
+    unsigned int bodyLength = (data[1] & 0x7F) | ((unsigned int)(data[2] & 0x7F) << 7);
+    return bodyLength <= (length - TLV_HEADER_SIZE);
+}
+
+bool TLVReader::Next()
+{
+    if(this->errorFlag || this->position >= this->length)
+    {
+        return false;
+    }
+
+    unsigned char key = this->data[this->position];
+    this->position++;
+
+    this->tag = key >> 3;
+    this->type = (TLVType)(key & 0x07);
+    this->value = 0;
+    this->content = nullptr;
+    this->contentLength = 0;
+
+    switch(this->type)
+    {
+    case TLVType::TLV_UINT:
+    case TLVType::TLV_INT:
+        if(!this->readVarint(this->value))
+        {
+            this->errorFlag = true;
+        }
+        break;
+    case TLVType::TLV_FLOAT:
+        if((this->length - this->position) < 4)
+        {
+            this->errorFlag = true;
+        }
+        else
+        {
+            this->content = this->data + this->position;
+            this->contentLength = 4;
+            this->position += 4;
+        }
+        break;
+    case TLVType::TLV_BYTES:
+    case TLVType::TLV_STRING:
+    case TLVType::TLV_RECORD:
+        {
+            uint32_t elementLength = 0;
+            if(!this->readVarint(elementLength) || elementLength > (this->length - this->position))
+            {
+                this->errorFlag = true;
+            }
+            else
+            {
+                this->content = this->data + this->position;
+                this->contentLength = elementLength;
+                this->position += elementLength;
+            }
+        }
+        break;
+    default:
+        this->errorFlag = true;
+        break;
+    }
+    return !this->errorFlag;
+}
+
+uint8_t TLVReader::GetTag() const
+{
+    return this->tag;
+}
+
+TLVType TLVReader::GetType() const
+{
+    return this->type;
+}
+
+uint32_t TLVReader::GetUInt() const
+{
+    return (this->type == TLVType::TLV_UINT) ? this->value : 0;
+}
+
+int32_t TLVReader::GetInt() const
+{
+    if(this->type == TLVType::TLV_INT)
+    {
+        return (int32_t)((this->value >> 1) ^ (~(this->value & 1) + 1));
+    }
+    else if(this->type == TLVType::TLV_UINT)
+    {
+        return (int32_t)this->value;
+    }
+    return 0;
+}
+
+float TLVReader::GetFloat() const
+{
+    float result = 0.0f;
+
+    if(this->type == TLVType::TLV_FLOAT && this->content != nullptr)
+    {
+        uint32_t bits =
+            (uint32_t)this->content[0]
+            | ((uint32_t)this->content[1] << 8)
+            | ((uint32_t)this->content[2] << 16)
+            | ((uint32_t)this->content[3] << 24);
+
+        memcpy(&result, &bits, sizeof(result));
+    }
+    return result;
+}
+
+const unsigned char* TLVReader::GetBytes(unsigned int& _length) const
+{
+    if(this->type == TLVType::TLV_BYTES || this->type == TLVType::TLV_STRING)
+    {
+        _length = this->contentLength;
+        return this->content;
+    }
+    _length = 0;
+    return nullptr;
+}
+
+String TLVReader::GetString() const
+{
+    String result;
+    if(this->type == TLVType::TLV_STRING && this->contentLength > 0)
+    {
+        result.reserve(this->contentLength);
+        result.concat((const char*)this->content, this->contentLength);
+    }
+    return result;
+}
+
+TLVReader TLVReader::GetRecord() const
+{
+    if(this->type == TLVType::TLV_RECORD)
+    {
+        return TLVReader(this->content, this->contentLength);
+    }
+    return TLVReader();
+}
+
+bool TLVReader::HasError() const
+{
+    return this->errorFlag;
+}
+
+bool TLVReader::readVarint(uint32_t& out)
+{
+    out = 0;
+
+    for(unsigned int shift = 0; shift < 35; shift += 7)
+    {
+        if(this->position >= this->length)
+        {
+            return false;
+        }
+        unsigned char current = this->data[this->position];
+        this->position++;
+
+        out |= (uint32_t)(current & 0x7F) << shift;
+        if((current & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
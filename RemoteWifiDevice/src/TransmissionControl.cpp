@@ -1,9 +1,5 @@
 #include "TransmissionControl.h"
 
-// timer params
-long checkupTimer = 0;
-long checkupTimeOut = 500;
-
 TransmissionPackage::TransmissionPackage()
 {
     mode = TransmissionMode::DATA;
@@ -14,6 +10,12 @@ TransmissionPackage::TransmissionPackage()
     dataSize = 0;
     transmissionID = 0;
     errorFlag = false;
+    confirmationParam = 0;
+    sentTimestamp = 0;
+    streamID = 0;
+    stored = false;
+    priority = TP_INTERACTIVE;
+    queuedTimestamp = 0;
 }
 
 TransmissionPackage::TransmissionPackage(const TransmissionPackage& other)
@@ -27,20 +29,29 @@ TransmissionPackage::TransmissionPackage(const TransmissionPackage& other)
     this->transmissionID = other.transmissionID;
     this->errorFlag = other.errorFlag;
     this->confirmationParam = 0;
+    this->sentTimestamp = other.sentTimestamp;
+    this->streamID = other.streamID;
+    this->stored = other.stored;
+    this->frame = other.frame;
+    this->priority = other.priority;
+    this->queuedTimestamp = other.queuedTimestamp;
 }
 
-String TransmissionPackage::ToTransmissionString()
+const String& TransmissionPackage::ToTransmissionString()
 {
-    char buffer[48] = { 0 };
+    if(this->frame.length() == 0)
+    {
+        char buffer[48] = { 0 };
 
-    String transmissionString = "";
-    this->dataSize = 17 + this->data.length() + this->iv.length();
-    sprintf(buffer, "%08x%01d%02x%04x%01d%01d", this->dataSize, this->dataFormat, 17 + this->iv.length(), this->transmissionID, this->encryptionType, this->mode);
-    transmissionString += buffer;
-    transmissionString += this->iv;
-    transmissionString += this->data;
+        this->dataSize = 17 + this->data.length() + this->iv.length();
+        sprintf(buffer, "%08x%01d%02x%04x%01d%01d", this->dataSize, this->dataFormat, 17 + this->iv.length(), this->transmissionID, this->encryptionType, this->mode);
 
-    return transmissionString;
+        this->frame.reserve(this->dataSize);
+        this->frame += buffer;
+        this->frame += this->iv;
+        this->frame += this->data;
+    }
+    return this->frame;
 }
 
 void TransmissionPackage::FromTransmissionString(const String& data)
@@ -83,6 +94,19 @@ String TransmissionPackage::ToConfirmationString() const
     return confirmationString;    
 }
 
+String TransmissionPackage::ToProbeReplyString() const
+{
+    TransmissionPackage reply;
+    reply.mode = TransmissionMode::PROBE_REPLY;
+    reply.dataFormat = this->dataFormat;
+    reply.encryptionType = TransmissionEncryptionType::TET_NONE;
+    reply.iv = this->iv;
+    reply.data = this->data;
+    reply.transmissionID = this->transmissionID;
+
+    return reply.ToTransmissionString();
+}
+
 TransmissionPackage& TransmissionPackage::operator=(const TransmissionPackage& other)
 {
     this->mode = other.mode;
@@ -93,6 +117,12 @@ TransmissionPackage& TransmissionPackage::operator=(const TransmissionPackage& o
     this->dataSize = other.dataSize;
     this->transmissionID = other.transmissionID;
     this->errorFlag = other.errorFlag;
+    this->sentTimestamp = other.sentTimestamp;
+    this->streamID = other.streamID;
+    this->stored = other.stored;
+    this->frame = other.frame;
+    this->priority = other.priority;
+    this->queuedTimestamp = other.queuedTimestamp;
 
     return *this;
 }
@@ -104,11 +134,71 @@ void printMBED_TLSError(int errorCode)
     Serial.println(buf);
 }
 
+void appendSyncFrame(String& output, const String& transmissionString)
+{
+    char prefix[TRANSMISSION_SYNC_PREFIX_SIZE + 1] = { 0 };
+
+    auto headerLength = (transmissionString.length() < TRANSMISSION_HEADER_SIZE) ? transmissionString.length() : TRANSMISSION_HEADER_SIZE;
+    auto crc = crc32Update(0, (const unsigned char*)transmissionString.c_str(), headerLength);
+    sprintf(prefix, "%s%08x", TRANSMISSION_SYNC_MARKER, (unsigned int)crc);
+
+    output.reserve(output.length() + TRANSMISSION_SYNC_PREFIX_SIZE + transmissionString.length());
+    output += prefix;
+    output += transmissionString;
+}
+
+// commands which are handled by the transmission control itself (see OnCommand)
+static const char* const internalCommands[] = {
+    "get-name",
+    "rq:status",
+    "rq:metrics",
+    "rq:memory",
+    "rq:link",
+    "rq:trace"
+};
+
+#define INTERNAL_COMMAND_COUNT (sizeof(internalCommands) / sizeof(internalCommands[0]))
+
+// the router accepts up to half of its capacity, the rest is left for the commands of the application
+static_assert(INTERNAL_COMMAND_COUNT < (COMMAND_ROUTER_CAPACITY / 2), "the command router is too small for the internal commands");
+
 TransmissionControl::TransmissionControl()
-: pk_context_initialized(false), interface(nullptr), connection_state(false), transmissionID(0)
+: interface(nullptr), bulkSkipped(0), receiveWindowBytes(transmissionProfile.receiveWindowBytes), receiveWindowPackages(transmissionProfile.receiveWindowPackages),
+  receivedSinceCreditBytes(0), receivedSinceCreditPackages(0), peerCreditReceived(false), peerCreditBytes(0), peerCreditPackages(0), windowProbeTime(0), windowProbes(0), outboundStore(nullptr), outboundInFlight(false), sessionKeySent(false), sessionEstablished(false), duplicateFilter(true), framing(TRANSMISSION_DEFAULT_FRAMING), receiving(false),
+  streamSource(nullptr), streamID(0), streamSequence(0), streamLength(0), streamOffset(0), pk_context_initialized(false), random_seeded(false), connection_state(false), transmissionID(0)
 {
     memset(this->aes_key, 0, sizeof(this->aes_key));
-    checkupTimer = millis();
+    mbedtls_aes_init(&this->aes);
+    mbedtls_entropy_init(&this->entropy);
+    mbedtls_ctr_drbg_init(&this->ctr_drbg);
+
+    this->lastReceiveTime = millis();
+    this->lastProbeTime = millis();
+
+    // the router is empty, a failure means two internal commands have the same name
+    for(unsigned int i = 0; i < INTERNAL_COMMAND_COUNT; i++)
+    {
+        if(!this->commandRouter.Register(internalCommands[i], this))
+        {
+            TRACE_ERROR(TE_COMMAND_REGISTER_FAILED, i, this->commandRouter.GetCount());
+        }
+    }
+}
+
+TransmissionControl::~TransmissionControl()
+{
+    if(this->pk_context_initialized)
+    {
+        mbedtls_pk_free(&this->pk);
+    }
+    mbedtls_aes_free(&this->aes);
+    mbedtls_ctr_drbg_free(&this->ctr_drbg);
+    mbedtls_entropy_free(&this->entropy);
+}
+
+void TransmissionControl::SetOutboundStore(IOutboundStore* store)
+{
+    this->outboundStore = transmissionProfile.outboundStore ? store : nullptr;
 }
 
 void TransmissionControl::SetInterface(ITransmissionControlInterface* _interface)
@@ -121,11 +211,44 @@ void TransmissionControl::SetDeviceName(const String& name)
     this->device_name = name;
 }
 
-void TransmissionControl::SendData(const String& data, bool encrypt)
+void TransmissionControl::SetFraming(TransmissionFraming _framing)
+{
+    this->framing = transmissionProfile.syncFraming ? _framing : TF_PLAIN;
+    this->receiveBuffer = "";
+}
+
+TransmissionFraming TransmissionControl::GetFraming() const
+{
+    return this->framing;
+}
+
+void TransmissionControl::SetDuplicateFilter(bool enabled)
+{
+    this->duplicateFilter = enabled;
+}
+
+bool TransmissionControl::RegisterCommand(const char* command, ICommandHandler* handler)
+{
+    return this->commandRouter.Register(command, handler);
+}
+
+bool TransmissionControl::SendData(const String& data, bool encrypt, TransmissionPriority priority)
 {
+    MEMORY_SITE(MS_SEND);
+
     //Serial.println("Sending data:");
     //Serial.println(data);
 
+    if(this->storeOutbound((const unsigned char*)data.c_str(), data.length(), encrypt, priority))
+    {
+        return true;
+    }
+    if(priority != TP_CONTROL && this->isQueueFull())
+    {
+        this->metrics.rejected++;
+        return false;
+    }
+
     if(!encrypt)
     {
         TransmissionPackage transmissionPackage;
@@ -133,674 +256,1739 @@ void TransmissionControl::SendData(const String& data, bool encrypt)
         transmissionPackage.dataFormat = TransmissionDataFormat::PLAIN_TEXT;
         transmissionPackage.encryptionType = TransmissionEncryptionType::TET_NONE;
         transmissionPackage.mode = TransmissionMode::DATA;
-        transmissionPackage.transmissionID = this->transmissionID++;
-        
-        if(this->transmissionQueue.GetCount() > 0)
-        {
-            // if there are unconfirmed transmissions in the queue, add the new package to the queue, but don't send it out
-            this->transmissionQueue += transmissionPackage;
-        }
-        else
-        {
-            if(this->interface != nullptr)
-            {
-                this->interface->OutGateway(transmissionPackage.ToTransmissionString());
-                this->transmissionQueue += transmissionPackage;
-            }
-        }
+        transmissionPackage.transmissionID = this->nextTransmissionID();
+        transmissionPackage.priority = priority;
+
+        this->enqueuePackage(transmissionPackage);
+        return true;
     }
     else
     {
-        TransmissionPackage transmissionPackage;
-        transmissionPackage.dataFormat = TransmissionDataFormat::BASE64;
-        transmissionPackage.encryptionType = TransmissionEncryptionType::AES;
-        transmissionPackage.mode = TransmissionMode::DATA;
-        transmissionPackage.transmissionID = this->transmissionID++;
-        transmissionPackage.data = this->EncryptDataWithAES(data, transmissionPackage.iv);
-
-        if(this->transmissionQueue.GetCount() > 0)
-        {
-            // if there are unconfirmed transmissions in the queue, add the new package to the queue, but don't send it out
-            this->transmissionQueue += transmissionPackage;
-        }
-        else
-        {
-            if(this->interface != nullptr)
-            {
-                // send the data out gateway
-                this->interface->OutGateway(transmissionPackage.ToTransmissionString());
-                // add the package to the transmission queue
-                this->transmissionQueue += transmissionPackage;
-            }
-        }
+        return this->sendEncrypted((const unsigned char*)data.c_str(), data.length(), priority);
     }
 }
 
-void TransmissionControl::OnClientConnected()
+bool TransmissionControl::SendRecord(TLVWriter& record, TransmissionPriority priority)
 {
-    if(!this->connection_state)
-    {
-        this->connection_state = true;
+    MEMORY_SITE(MS_SEND);
 
-        // do something on connection state change to 'connected'
+    if(!record.Finish())
+    {
+        return false;
     }
-}
-
-void TransmissionControl::OnClientDisconnected()
-{
-    if(this->pk_context_initialized)
+    if(this->storeOutbound(record.GetData(), record.GetLength(), true, priority))
     {
-        mbedtls_pk_free(&this->pk);
-        this->pk_context_initialized = false;
+        return true;
     }
-    if(this->connection_state)
+    if(priority != TP_CONTROL && this->isQueueFull())
     {
-        this->connection_state = false;
-
-        // do something on connection state change to 'disconnected'
+        this->metrics.rejected++;
+        return false;
     }
+    return this->sendEncrypted(record.GetData(), record.GetLength(), priority);
 }
 
-void TransmissionControl::OnDataReceived(const String& data)
+uint16_t TransmissionControl::SendStream(IStreamSource* source, uint32_t totalLength)
 {
-    // since the server is faster than the client, successive transmissions could be appended in the 
-    // input queue, so check if there are multiple transmissions in the input string
+    if(!transmissionProfile.streams || source == nullptr || totalLength == 0 || this->streamSource != nullptr || !this->sessionKeySent)
+    {
+        return 0;
+    }
 
-    auto dLen = data.length();
-    if(dLen >= 8)
+    this->streamSource = source;
+    this->streamID++;
+    if(this->streamID == 0)
     {
-        unsigned int packageSize = 0;
-        itemCollection<String> inputStrings;
+        this->streamID = 1;
+    }
+    this->streamSequence = 0;
+    this->streamLength = totalLength;
+    this->streamOffset = 0;
 
-        auto ret = sscanf(data.c_str(), "%08x", &packageSize);
-        if(ret > 0)
-        {
-            if(dLen > packageSize)
-            {
-                // size mismatch ->
-                // must be more than one transmission in the input string
-                bool hold = true;
-                String subData = data.substring(packageSize);
-                inputStrings.AddItem(data.substring(0, packageSize));
+    this->pumpStream();
 
-                while(hold)
-                {
-                    auto subDataLen = subData.length();
-                    if(subDataLen >= 8)
-                    {
-                        unsigned int subPackageSize = 0;
-                        ret = sscanf(subData.c_str(), "%08x", &subPackageSize);
-                        if(ret > 0)
-                        {
-                            if(subDataLen > subPackageSize)
-                            {
-                                // size mismatch ->
-                                // must be more than one transmission in the string
-                                subData = subData.substring(subPackageSize);
-                                inputStrings.AddItem(subData.substring(0, subPackageSize));
-                            }
-                            else
-                            {
-                                // size match ->
-                                // only one transmission in the string
-                                inputStrings.AddItem(subData);
-                                hold = false;
-                            }
-                        }
-                        else
-                        {
-                            Serial.println("sscanf - error - sub");
-                            hold = false;
-                        }
-                    }
-                    else
-                    {
-                        Serial.println("transmission length error - sub");
-                        hold = false;
-                    }
-                }
+    return this->streamID;
+}
 
-            }
-            else
-            {
-                // size match ->
-                // only one transmission in the input string
-                this->processTransmission(data);
-                return;
-            }
-        }
+bool TransmissionControl::IsStreamActive() const
+{
+    return this->streamSource != nullptr;
+}
 
-        for(unsigned int i = 0; i < inputStrings.GetCount(); i++)
-        {
-            this->processTransmission(inputStrings.GetAt(i));
-        }
-    }
+bool TransmissionControl::IsThrottled() const
+{
+    return this->isQueueFull() || !this->isPeerWindowOpen();
 }
 
-bool TransmissionControl::readAndFormatRSAKey(const String& data)
+void TransmissionControl::SetReceiveWindow(uint32_t bytes, uint16_t packages)
 {
-    if(data.length() > 0)
-    {
-        // set public key start-sequence for DER encoding
-        this->rsa_key = "-----BEGIN PUBLIC KEY-----\n";
-        // set public key in DER encoding
-        this->rsa_key += data;
-        // set public key end-sequence for DER encoding
-        this->rsa_key += "\n-----END PUBLIC KEY-----\n";
+    this->receiveWindowBytes = bytes;
+    this->receiveWindowPackages = packages;
 
-        return true;
-    }
-    else
+    if(this->connection_state)
     {
-        return false;
+        this->advertiseReceiveWindow();
     }
 }
 
-void TransmissionControl::onRSAKeyReceived(const String& data)
+void TransmissionControl::pumpStream()
 {
-    // extract the rsa params from the transmission
-    auto res = this->readAndFormatRSAKey(data);
-    if(res)
+    if(!transmissionProfile.streams || this->streamSource == nullptr)
     {
-        Serial.println("RSA public key in PEM format:");
-        Serial.println(rsa_key);
-
-        // init rsa context
-        mbedtls_pk_init(&this->pk);
-        this->pk_context_initialized = true;
+        return;
+    }
 
-        auto ret = mbedtls_pk_parse_public_key(&this->pk, (const unsigned char*)this->rsa_key.c_str(), this->rsa_key.length() + 1);
-        if(ret != 0)
+    unsigned int queuedFragments = 0;
+    for(unsigned int i = 0; i < this->transmissionQueue.GetCount(); i++)
+    {
+        if(this->transmissionQueue.GetAt(i).streamID == this->streamID)
         {
-            Serial.println("Error: RSA key could not be parsed!");
-            printMBED_TLSError(ret);
+            queuedFragments++;
         }
-        else
+    }
+    for(unsigned int i = 0; i < this->priorityQueues[TP_BULK].GetCount(); i++)
+    {
+        if(this->priorityQueues[TP_BULK].GetAt(i).streamID == this->streamID)
         {
-            Serial.println("RSA key successfully parsed!");
+            queuedFragments++;
+        }
+    }
 
-            // create the aes key and iv for this session
-            if(createAESData())
-            {  
-                size_t outLen = 0;
-                unsigned char output[256];
+    // keep only a few fragments in the queue, the rest stays in the source until there is room
+    while(queuedFragments < FRAGMENT_QUEUE_WINDOW && this->streamOffset < this->streamLength)
+    {
+        unsigned char fragment[FRAGMENT_HEADER_SIZE + FRAGMENT_PAYLOAD_SIZE];
 
-                // encrypt aes key with rsa public key
-                ret = mbedtls_pk_encrypt(&this->pk, this->aes_key, sizeof(this->aes_key), output, &outLen, 256, mbedtls_ctr_drbg_random, &this->ctr_drbg);
+        uint32_t remaining = this->streamLength - this->streamOffset;
+        unsigned int requested = (remaining < FRAGMENT_PAYLOAD_SIZE) ? remaining : FRAGMENT_PAYLOAD_SIZE;
 
-                //ret = mbedtls_base64_encode(enc_dest, sizeof(enc_dest), &outLen, aes_data, sizeof(aes_data));
-                if(ret != 0)
-                {                            
-                    Serial.print("Error: AES data could not be encrypted!");
-                    printMBED_TLSError(ret);
-                }
-                else
-                {
-                    Serial.println("AES data successfully encrypted!");
+        unsigned int length = this->streamSource->Read(fragment + FRAGMENT_HEADER_SIZE, requested);
+        if(length == 0 || length > requested)
+        {
+            // the source could not provide the announced length
+            this->finishStream(false);
+            return;
+        }
 
-                    unsigned char enc_dest[1024] = {0};
-                                        
-                    // convert aes data to base64 string
-                    ret = mbedtls_base64_encode(enc_dest, sizeof(enc_dest), &outLen, output, outLen);
-                    if(ret != 0)
-                    {
-                        Serial.println("Error: AES data could not be encoded!");
-                        printMBED_TLSError(ret);
-                    }
-                    else
-                    {
-                        Serial.println("AES data successfully encoded to base64!");
-
-                        // encode iv to base 64
-                        unsigned char ivBuffer[256] = {0};
-                        size_t bLen = 0;
-
-                        // dummy iv (not used in this type of transmission)
-                        byte iv[16] = {0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15};
-
-                        ret = mbedtls_base64_encode(ivBuffer, sizeof(ivBuffer), &bLen, iv, sizeof(iv));
-                        if(ret != 0)
-                        {
-                            Serial.println("Error: AES iv could not be encoded!");
-                            printMBED_TLSError(ret);
-                        }
-
-                        String enc_data = (char*)enc_dest;
-
-                        TransmissionPackage transmissionPackage;
-                        transmissionPackage.mode = TransmissionMode::AES_KEY;
-                        transmissionPackage.encryptionType = TransmissionEncryptionType::RSA;
-                        transmissionPackage.dataFormat = TransmissionDataFormat::BASE64;
-                        transmissionPackage.data = enc_data;
-                        transmissionPackage.iv = (char*)ivBuffer;
-                        transmissionPackage.transmissionID = this->transmissionID++;
-
-                        // TODO: new method "sendPackage" ???
-
-                        // send transmission package
-                        if(this->interface != nullptr)
-                        {
-                            this->interface->OutGateway(
-                                transmissionPackage.ToTransmissionString()
-                            );
-                            this->transmissionQueue.AddItem(transmissionPackage);
-                        }
-                    }
-                }
-            }
+        FragmentHeader header;
+        header.streamID = this->streamID;
+        header.sequence = this->streamSequence;
+        header.totalLength = this->streamLength;
+        header.payloadLength = (uint16_t)length;
+        if(this->streamOffset == 0)
+        {
+            header.flags |= FRAGMENT_FLAG_FIRST;
+        }
+        if((this->streamOffset + length) >= this->streamLength)
+        {
+            header.flags |= FRAGMENT_FLAG_LAST;
+        }
+        header.Write(fragment);
+
+        this->streamSequence++;
+        this->streamOffset += length;
+        queuedFragments++;
+
+        if(!this->sendEncrypted(fragment, FRAGMENT_HEADER_SIZE + length, TP_BULK, this->streamID))
+        {
+            // the fragment is missing, the receiver cannot complete the stream
+            this->finishStream(false);
+            return;
         }
     }
-    else
+
+    if(queuedFragments == 0 && this->streamOffset >= this->streamLength)
     {
-        Serial.println("Error: RSA parameters could not be read!");
+        // all fragments are confirmed
+        this->finishStream(true);
     }
 }
 
-String TransmissionControl::decryptReceivedDataWithAESCbc(const String& data, const String& _iv)
+void TransmissionControl::finishStream(bool success)
 {
-    String result = "";
-
-    if(data.length() > 0 && _iv.length() > 0)
+    if(!transmissionProfile.streams || this->streamSource == nullptr)
     {
-        size_t reqLen = 0;
-
-        mbedtls_base64_decode(nullptr, 0, &reqLen, (const unsigned char*)_iv.c_str(), _iv.length());
+        return;
+    }
 
-        if(reqLen > 0)
+    if(!success)
+    {
+        // the remaining fragments are useless for the receiver
+        unsigned int i = 0;
+        while(i < this->transmissionQueue.GetCount())
+        {
+            if(this->transmissionQueue.GetAt(i).streamID == this->streamID)
+            {
+                this->transmissionQueue.RemoveAt(i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+        i = 0;
+        while(i < this->priorityQueues[TP_BULK].GetCount())
         {
-            auto ivBuffer = new unsigned char[reqLen];
-            if(ivBuffer != nullptr)
+            if(this->priorityQueues[TP_BULK].GetAt(i).streamID == this->streamID)
+            {
+                this->priorityQueues[TP_BULK].RemoveAt(i);
+            }
+            else
             {
-                memset(ivBuffer, 0, reqLen);
+                i++;
+            }
+        }
 
-                auto ret = mbedtls_base64_decode(ivBuffer, reqLen, &reqLen, (const unsigned char*)_iv.c_str(), _iv.length());
-                if(ret != 0)
-                {
-                    Serial.println("EncryptDataWithAES:Error: Base64 iv decode failed with:");
-                    printMBED_TLSError(ret);
-                }
-                else
-                {
-                    size_t outlen;
+        if(this->sessionEstablished && this->streamSequence > 0)
+        {
+            // the receiver frees the slot of the stream at once instead of waiting for its idle timeout
+            unsigned char fragment[FRAGMENT_HEADER_SIZE];
 
-                    auto ret =
-                        mbedtls_base64_decode(nullptr, 0, &outlen, (const unsigned char*)data.c_str(), data.length());
-                    
-                    if(outlen > 0)
-                    {
-                        //Serial.print("Base64 decoded data length: ");
-                        //Serial.println(outlen);
-
-                        unsigned char *dataBuffer = new unsigned char[outlen];
-                        if(dataBuffer != nullptr)
-                        {
-
-                            ret =
-                                mbedtls_base64_decode(dataBuffer, outlen, &outlen, (const unsigned char*)data.c_str(), data.length());
-
-                            if(ret != 0)
-                            {
-                                Serial.println("Error: base64 data decode failed!");
-                                printMBED_TLSError(ret);
-                                Serial.print("Source data: ");
-                                Serial.println(data);
-                            }
-                            else
-                            {
-                                ret = mbedtls_aes_setkey_enc(&this->aes, this->aes_key, 256);
-                                if(ret != 0)
-                                {
-                                    Serial.println("Error: Setting AES key failed!");
-                                }
-                                else
-                                {
-                                    unsigned char dataReceiver[1024] = {0}; // TODO: dynamic size
-
-                                    ret = mbedtls_aes_crypt_cbc(&this->aes, MBEDTLS_AES_DECRYPT, outlen, ivBuffer, dataBuffer, dataReceiver);
-                                    if(ret != 0)
-                                    {
-                                        Serial.println("Error: AES decryption failed!");
-                                    }
-                                    else
-                                    {
-                                        //Serial.print("AES data decryption succeeded: ");
-                                        //Serial.println((char*)dataReceiver);
-
-                                        result = (char*)dataReceiver;
-                                    }
-                                }                    
-                            }
-                            delete[] dataBuffer;
-                        }
-                    }
-                    else
-                    {
-                        Serial.println("Error: base64 data out-len was zero");
-                    }
-                }
-                delete[] ivBuffer;
-            }
+            FragmentHeader header;
+            header.flags = FRAGMENT_FLAG_ABORT;
+            header.streamID = this->streamID;
+            header.sequence = this->streamSequence;
+            header.totalLength = this->streamLength;
+            header.Write(fragment);
+
+            this->sendEncrypted(fragment, sizeof(fragment), TP_CONTROL);
         }
     }
-    return result;
+
+    IStreamSource* source = this->streamSource;
+    this->streamSource = nullptr;
+    source->OnStreamComplete(this->streamID, success);
 }
 
-bool TransmissionControl::createAESData()
+void TransmissionControl::processFragment(const unsigned char* data, size_t length)
 {
-    // initialize entropy pool and random number generator
-    mbedtls_entropy_init(&this->entropy);
-    mbedtls_ctr_drbg_init(&this->ctr_drbg);
-
-    // generate random iv
-    unsigned char iv[16] = {0};
-    this->generateRandomIV(iv);
+    if(!transmissionProfile.streams)
+    {
+        // not supported by this profile, the fragment is not forwarded as text either
+        return;
+    }
 
-    // seed random number generator
-    auto ret = mbedtls_ctr_drbg_seed(&this->ctr_drbg, mbedtls_entropy_func, &this->entropy, iv, (size_t)16);
-    if(ret != 0)
+    FragmentHeader header;
+    if(!header.Read(data, length))
     {
-        Serial.print("Error: Random data generation failed with: ");
-        printMBED_TLSError(ret);
-        return false;
+        this->metrics.parseErrors++;
+        return;
     }
-    else
+
+    uint32_t offset = 0;
+    auto result = this->streamReassembler.Accept(header, offset);
+
+    if(this->interface != nullptr)
     {
-        // generate random aes key
-        ret = mbedtls_ctr_drbg_random(&this->ctr_drbg, this->aes_key, 32);
-        if(ret != 0)
+        if(result == StreamReassembler::FragmentResult::FR_ACCEPTED)
         {
-            Serial.print("Error: aes key generation failed with: ");
-            printMBED_TLSError(ret);
-            return false;
+            this->interface->OnStreamData(
+                header.streamID,
+                offset,
+                data + FRAGMENT_HEADER_SIZE,
+                header.payloadLength,
+                header.totalLength,
+                (header.flags & FRAGMENT_FLAG_LAST) != 0
+            );
         }
-        else
+        else if(result == StreamReassembler::FragmentResult::FR_ABORTED)
         {
-            Serial.println("AES key successfully generated!");
-            return true;
+            this->interface->OnStreamAborted(header.streamID);
         }
     }
 }
 
-bool TransmissionControl::generateRandomIV(unsigned char* _iv)
+bool TransmissionControl::sendEncrypted(const unsigned char* data, size_t length, TransmissionPriority priority, unsigned int fragmentOfStream, bool stored)
 {
-    if(_iv == nullptr)
+    if(!this->sessionKeySent)
     {
+        // the key is still zero (or belongs to an old session), the peer could not decrypt the package
+        TRACE_ERROR(TE_SEND_WITHOUT_SESSION, length, priority);
         return false;
     }
-    else
+
+    TransmissionPackage transmissionPackage;
+    transmissionPackage.dataFormat = TransmissionDataFormat::BASE64;
+    transmissionPackage.encryptionType = TransmissionEncryptionType::AES;
+    transmissionPackage.mode = TransmissionMode::DATA;
+    transmissionPackage.transmissionID = this->nextTransmissionID();
+    transmissionPackage.streamID = fragmentOfStream;
+    transmissionPackage.stored = stored;
+    transmissionPackage.priority = priority;
+
+    auto encryptStart = micros();
+    bool encrypted = this->encryptIntoFrame(data, length, transmissionPackage);
+    this->metrics.encryptTime.Record(micros() - encryptStart);
+
+    if(encrypted)
     {
-        for(unsigned int i = 0; i < 16; i++)
-        {
-            _iv[i] = (unsigned char)random(0, 255);
-        }
-        return true;
+        this->enqueuePackage(transmissionPackage);
     }
+    return encrypted;
 }
 
-String TransmissionControl::EncryptDataWithAES(const String& data, String& _iv_out)
+void TransmissionControl::OnClientConnected()
 {
-    String enc_data;
-
-    if(data.length() > 0)
+    if(!this->connection_state)
     {
-        auto ret = mbedtls_aes_setkey_enc(&this->aes, this->aes_key, 256);
-        if(ret != 0)
-        {
-            Serial.println("EncryptDataWithAES:Error: Setting AES key failed with:");
-            printMBED_TLSError(ret);
-        }
-        else
-        {
-            // make sure the buffer is a multiple of 16
-            size_t len = data.length() + (16 - (data.length() % 16));
-
-            unsigned char* enc_receiver = new unsigned char[len];
+        this->connection_state = true;
+        this->lastReceiveTime = millis();
 
-            if(enc_receiver != nullptr)
-            {
-                unsigned char iv[16] = {0};
-                unsigned char iv_copy[16] = {0};
+        // do something on connection state change to 'connected'
+    }
+}
 
-                this->generateRandomIV(iv);
+void TransmissionControl::SendKeepalive()
+{
+    this->SendData(TRANSMISSION_KEEPALIVE_MESSAGE, false, TP_CONTROL);
+}
 
-                // copy iv, because the iv is changed in mbedtls_aes_crypt_cbc, but we need it for the receiver
-                for(unsigned int i = 0; i < 16; i++)
-                {
-                    iv_copy[i] = iv[i];
-                }
+unsigned long TransmissionControl::GetLastReceiveTime() const
+{
+    return this->lastReceiveTime;
+}
 
-                // encrypt data
-                ret = mbedtls_aes_crypt_cbc(&this->aes, MBEDTLS_AES_ENCRYPT, len, iv, (const unsigned char*)data.c_str(), enc_receiver);
-                if(ret != 0)
-                {
-                    Serial.println("EncryptDataWithAES:Error: AES encryption failed with:");
-                    printMBED_TLSError(ret);
-                }
-                else
-                {
-                    size_t reqLen;
+void TransmissionControl::SendProbe()
+{
+    char probe[24] = { 0 };
 
-                    // calculate buffer size for base64 encoding
-                    mbedtls_base64_encode(nullptr, 0, &reqLen, enc_receiver, len);
+    uint32_t now = (uint32_t)micros();
+    uint16_t sequence = this->linkEstimate.OnProbeSent(now);
+    snprintf(probe, sizeof(probe), "%x:%lx", (unsigned int)sequence, (unsigned long)now);
 
-                    unsigned char *encDataBuffer = new unsigned char[reqLen];
-                    if(encDataBuffer != nullptr)
-                    {
-                        memset(encDataBuffer, 0, reqLen);
-
-                        // convert encrypted data to base64
-                        ret = mbedtls_base64_encode(encDataBuffer, reqLen, &reqLen, enc_receiver, len);
-                        if(ret != 0)
-                        {
-                            Serial.println("EncryptDataWithAES:Error: base64 encoding of encrypted data failed with:");
-                            printMBED_TLSError(ret);
-                        }
-                        else
-                        {
-                            enc_data = (char*)encDataBuffer;
-
-                            mbedtls_base64_encode(nullptr, 0, &reqLen, iv_copy, 16);
-
-                            char *ivBuffer = new char[reqLen];
-                            if(ivBuffer != nullptr)
-                            {
-                                memset(ivBuffer, 0, reqLen);
-
-                                ret = mbedtls_base64_encode((unsigned char*)ivBuffer, reqLen, &reqLen, iv_copy, 16);
-                                if(ret != 0)
-                                {
-                                    Serial.println("EncryptDataWithAES:Error: base64 encoding of iv failed with:");
-                                    printMBED_TLSError(ret);
-                                }
-                                else
-                                {
-                                    _iv_out = ivBuffer;
-                                }
-                                delete[] ivBuffer;
-                            }
-                        }
-                        delete[] encDataBuffer;
-                    }
-                }
-                delete[] enc_receiver;
-            }
+    TransmissionPackage transmissionPackage;
+    transmissionPackage.mode = TransmissionMode::PROBE;
+    transmissionPackage.dataFormat = TransmissionDataFormat::PLAIN_TEXT;
+    transmissionPackage.encryptionType = TransmissionEncryptionType::TET_NONE;
+    transmissionPackage.iv = "";
+    transmissionPackage.data = probe;
+    transmissionPackage.transmissionID = sequence & TRANSMISSION_ID_MASK;
+
+    this->lastProbeTime = millis();
+    this->sendOut(transmissionPackage.ToTransmissionString());
+}
+
+const LinkEstimator& TransmissionControl::GetLinkEstimate() const
+{
+    return this->linkEstimate;
+}
+
+void TransmissionControl::OnClientDisconnected()
+{
+    if(this->pk_context_initialized)
+    {
+        mbedtls_pk_free(&this->pk);
+        this->pk_context_initialized = false;
+    }
+    // the key of this session is not used again, the next session gets a new one
+    memset(this->aes_key, 0, sizeof(this->aes_key));
+    mbedtls_aes_free(&this->aes);
+    mbedtls_aes_init(&this->aes);
+
+    // the peer starts a new session with new transmission IDs and advertises its window again
+    this->receiveWindow.Reset();
+    // an incomplete transmission of the old connection is not continued
+    this->receiveBuffer = "";
+    this->peerCreditReceived = false;
+    this->sessionKeySent = false;
+    this->sessionEstablished = false;
+    // a stored message is sent again with the key of the next session
+    this->dropStoredPackages();
+    this->streamReassembler.Reset();
+    // the next connection can take another route
+    this->linkEstimate.Reset();
+
+    // the fragments are encrypted with the key of this session, so the stream cannot be continued
+    this->finishStream(false);
+
+    if(this->connection_state)
+    {
+        this->connection_state = false;
+
+        // do something on connection state change to 'disconnected'
+    }
+}
+
+void TransmissionControl::OnDataReceived(const String& data)
+{
+    MEMORY_SITE(MS_RECEIVE);
+
+    // since the server is faster than the client, successive transmissions could be appended in the 
+    // input queue and a transmission can be split over several reads, so the data is appended to the
+    // incomplete rest of the previous read and all complete transmissions are processed
+
+    auto dLen = data.length();
+    this->metrics.bytesIn += dLen;
+
+    if(dLen == 0)
+    {
+        return;
+    }
+    this->lastReceiveTime = millis();
+
+    if(this->receiving)
+    {
+        // a handler responded immediately to a transmission which is processed right now
+        this->receiveBuffer += data;
+        return;
+    }
+    this->receiving = true;
+
+    if(this->receiveBuffer.length() == 0)
+    {
+        // nothing left from the previous read, the transmissions are taken from the data without a copy
+        auto consumed = this->splitTransmissions(data);
+        if(consumed < dLen || this->receiveBuffer.length() > 0)
+        {
+            String rest = data.substring(consumed);
+            rest += this->receiveBuffer;
+            this->receiveBuffer = rest;
+            this->receiveBuffer.remove(0, this->splitTransmissions(this->receiveBuffer));
         }
     }
     else
     {
-        Serial.println("EncryptDataWithAES:Error: Data or iv length was zero!");
+        this->receiveBuffer += data;
+        this->receiveBuffer.remove(0, this->splitTransmissions(this->receiveBuffer));
     }
-    return enc_data;
+
+    this->receiving = false;
 }
 
-void TransmissionControl::decodeAndProcessEncryptedData(const TransmissionPackage& package)
+// result of the header check, an incomplete header is only checked as far as it was received
+enum FrameHeaderCheck { FHC_VALID, FHC_INCOMPLETE, FHC_INVALID };
+
+static int hexDigitValue(char c)
 {
-    if(package.encryptionType == TransmissionEncryptionType::AES)
+    if(c >= '0' && c <= '9')
     {
-        auto dec_data = this->decryptReceivedDataWithAESCbc(package.data, package.iv);
-        if(!this->internalDataProcessing(dec_data))
+        return c - '0';
+    }
+    if(c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if(c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static FrameHeaderCheck checkFrameHeader(const char* header, unsigned int length, unsigned int& frameSize)
+{
+    unsigned int size = 0;
+    unsigned int dataOffset = 0;
+    int mode = 0;
+
+    for(unsigned int i = 0; i < TRANSMISSION_HEADER_SIZE; i++)
+    {
+        if(i >= length)
         {
-            // if the data was not processed internally, send it to the next layer
-            if(this->interface != nullptr)
+            return FHC_INCOMPLETE;
+        }
+        int value = hexDigitValue(header[i]);
+        if(value < 0)
+        {
+            return FHC_INVALID;
+        }
+
+        switch(i)
+        {
+        case 8:
+            if(value > TransmissionDataFormat::BASE64)
             {
-                this->interface->OnDataDecoded(dec_data);
+                return FHC_INVALID;
             }
+            break;
+        case 9:
+        case 10:
+            dataOffset = (dataOffset << 4) | value;
+            break;
+        case 15:
+            if(value > TransmissionEncryptionType::RSA)
+            {
+                return FHC_INVALID;
+            }
+            break;
+        case 16:
+            if(value > TransmissionMode::PROBE_REPLY)
+            {
+                return FHC_INVALID;
+            }
+            mode = value;
+            break;
+        default:
+            if(i < 8)
+            {
+                size = (size << 4) | value;
+
+                if(i == 7 && (size < TRANSMISSION_HEADER_SIZE || size > transmissionProfile.frameMax))
+                {
+                    return FHC_INVALID;
+                }
+            }
+            break;
         }
     }
-    else
+
+    if(dataOffset < TRANSMISSION_HEADER_SIZE || dataOffset > size)
     {
-        if(this->interface != nullptr)
-        {
-            this->interface->OnUnencryptedDataReceived(package.data);
-        }
+        return FHC_INVALID;
+    }
+    if(mode == TransmissionMode::CONFIRM && size != TRANSMISSION_HEADER_SIZE)
+    {
+        return FHC_INVALID;
     }
+    frameSize = size;
+    return FHC_VALID;
 }
 
-bool TransmissionControl::internalDataProcessing(const String& data)
+static FrameHeaderCheck checkSyncFrameHeader(const char* frame, unsigned int length, unsigned int& frameSize)
 {
-    // return true to indicate that the data was processed
+    // the marker was already found
+    if(length < TRANSMISSION_SYNC_PREFIX_SIZE + TRANSMISSION_HEADER_SIZE)
+    {
+        return FHC_INCOMPLETE;
+    }
 
-    if(data.startsWith("get-name"))
+    uint32_t crc = 0;
+    for(unsigned int i = TRANSMISSION_SYNC_MARKER_SIZE; i < TRANSMISSION_SYNC_PREFIX_SIZE; i++)
     {
-        String devNameResponse = "set-name:";
-        devNameResponse += this->device_name;
-        this->SendData(devNameResponse, true);
-        return true;
+        int value = hexDigitValue(frame[i]);
+        if(value < 0)
+        {
+            return FHC_INVALID;
+        }
+        crc = (crc << 4) | value;
     }
-    else if(data.startsWith("rq:status"))
+
+    const char* header = frame + TRANSMISSION_SYNC_PREFIX_SIZE;
+    if(checkFrameHeader(header, TRANSMISSION_HEADER_SIZE, frameSize) != FHC_VALID
+        || crc32Update(0, (const unsigned char*)header, TRANSMISSION_HEADER_SIZE) != crc)
     {
-        this->SendData(STATUS_REQUEST_RESPONSE, true);
-        return true;
+        return FHC_INVALID;
     }
-    return false;
+    frameSize += TRANSMISSION_SYNC_PREFIX_SIZE;
+    return FHC_VALID;
 }
 
-void TransmissionControl::processTransmission(const String& transmissionString)
+// position of the first sync marker in [from, to) with a valid header or with the beginning of one (only hex digits
+// received so far), to if there is none
+static unsigned int findSyncFrame(const char* buffer, unsigned int length, unsigned int from, unsigned int to)
 {
-    TransmissionPackage transmissionPackage;
-    transmissionPackage.FromTransmissionString(transmissionString);
-    
-    if(!transmissionPackage.errorFlag)
+    while(from < to)
     {
-        switch (transmissionPackage.mode)
+        auto marker = (const char*)memchr(buffer + from, TRANSMISSION_SYNC_MARKER[0], to - from);
+        if(marker == nullptr)
         {
-        case TransmissionMode::DATA:
-            this->confirmPackageReception(transmissionPackage);
-            this->decodeAndProcessEncryptedData(transmissionPackage);
-            break;
-        case TransmissionMode::CONFIRM:
-            // NOTE: do not confirm the confirmation, because it will cause an infinite loop
+            return to;
+        }
+        from = marker - buffer;
 
-            //Serial.print("Confirmation received for package with ID: ");
-            //Serial.println(transmissionPackage.transmissionID);
+        unsigned int frameSize = 0;
+        if(from + TRANSMISSION_SYNC_PREFIX_SIZE + TRANSMISSION_HEADER_SIZE <= length)
+        {
+            if(buffer[from + 1] == TRANSMISSION_SYNC_MARKER[1]
+                && checkSyncFrameHeader(buffer + from, length - from, frameSize) == FHC_VALID)
+            {
+                return from;
+            }
+        }
+        else if(from + 1 == length || buffer[from + 1] == TRANSMISSION_SYNC_MARKER[1])
+        {
+            unsigned int i = from + TRANSMISSION_SYNC_MARKER_SIZE;
+            while(i < length && hexDigitValue(buffer[i]) >= 0)
+            {
+                i++;
+            }
+            if(i >= length)
+            {
+                return from;
+            }
+        }
+        from++;
+    }
+    return to;
+}
 
-            // remove the confirmed package from the transmission queue
-            for(unsigned int i = 0; i < this->transmissionQueue.GetCount(); i++)
+unsigned int TransmissionControl::splitTransmissions(const String& data)
+{
+    unsigned int position = 0;
+    bool sync = transmissionProfile.syncFraming && (this->framing == TF_SYNC);
+    unsigned int prefixSize = sync ? TRANSMISSION_SYNC_PREFIX_SIZE : 0;
+
+    while(true)
+    {
+        // the data can grow while a transmission is processed (see OnDataReceived), so it is read again every time
+        const char* buffer = data.c_str();
+        unsigned int length = data.length();
+
+        // line breaks between the transmissions are not an error
+        while(position < length && (buffer[position] == '\r' || buffer[position] == '\n'))
+        {
+            position++;
+        }
+        if(position == length)
+        {
+            return length;
+        }
+
+        // search the next transmission, every position is checked once (the header check reads at most 27 bytes)
+        unsigned int frameStart = position;
+        unsigned int frameSize = 0;
+        FrameHeaderCheck check = FHC_INVALID;
+
+        while(frameStart < length)
+        {
+            if(sync)
             {
-                if(this->transmissionQueue.GetAt(i).transmissionID == transmissionPackage.transmissionID)
+                auto marker = (const char*)memchr(buffer + frameStart, TRANSMISSION_SYNC_MARKER[0], length - frameStart);
+                if(marker == nullptr)
                 {
-                    this->transmissionQueue.RemoveAt(i);
+                    frameStart = length;
                     break;
                 }
+                frameStart = marker - buffer;
+
+                if(frameStart + 1 == length)
+                {
+                    // the rest of the marker is not received yet
+                    check = FHC_INCOMPLETE;
+                }
+                else if(buffer[frameStart + 1] == TRANSMISSION_SYNC_MARKER[1])
+                {
+                    check = checkSyncFrameHeader(buffer + frameStart, length - frameStart, frameSize);
+                }
             }
-            // if there are waiting transmissions in the queue, send the next one
-            if(this->transmissionQueue.GetCount() > 0)
+            else
             {
-                if(this->interface != nullptr)
+                check = checkFrameHeader(buffer + frameStart, length - frameStart, frameSize);
+            }
+
+            if(check != FHC_INVALID)
+            {
+                break;
+            }
+            frameStart++;
+        }
+
+        if(frameStart > position)
+        {
+            // garbage on the stream (or the rest of a corrupted transmission), resynchronized on the next header
+            TRACE_ERROR(TE_FRAME_RESYNC, frameStart - position, this->framing);
+            this->metrics.parseErrors++;
+        }
+        if(sync && check == FHC_VALID)
+        {
+            // a transmission which lost bytes reaches into the next one, which ends it (the marker cannot appear in
+            // the header or in base64 data)
+            unsigned int frameEnd = (frameStart + frameSize < length) ? (frameStart + frameSize) : length;
+            unsigned int next = findSyncFrame(buffer, length, frameStart + TRANSMISSION_SYNC_PREFIX_SIZE + TRANSMISSION_HEADER_SIZE, frameEnd);
+            if(next < frameEnd)
+            {
+                if(checkSyncFrameHeader(buffer + next, length - next, frameSize) != FHC_VALID)
                 {
-                    this->interface->OutGateway(
-                        this->transmissionQueue.GetAt(0).ToTransmissionString()
-                    );
+                    // the header of the next transmission could be incomplete, a plain text payload with the marker
+                    // near its end waits for the next read
+                    return frameStart;
                 }
+                TRACE_ERROR(TE_FRAME_RESYNC, next - frameStart, this->framing);
+                this->metrics.parseErrors++;
+                position = next;
+                continue;
             }
-            break;
-        case TransmissionMode::AES_KEY:
-            // not valid on this side, but nonetheless confirm the reception
-            this->confirmPackageReception(transmissionPackage);
-            break;
-        case TransmissionMode::RSA_PUBKEY:
-            this->confirmPackageReception(transmissionPackage);
-            this->onRSAKeyReceived(transmissionPackage.data);
-            break;
-        default:
-            break;
         }
-    }
-    else
-    {
-        Serial.println("TransmissionPackage error while reading from input string");
+        if(frameStart == length || check == FHC_INCOMPLETE || frameStart + frameSize > length)
+        {
+            // the rest is kept until the transmission is complete
+            return frameStart;
+        }
+
+        position = frameStart + frameSize;
+
+        if(frameStart == 0 && position == length && prefixSize == 0 && &data != &this->receiveBuffer)
+        {
+            this->processTransmission(data);
+        }
+        else
+        {
+            this->processTransmission(data.substring(frameStart + prefixSize, position));
+        }
     }
 }
 
-void TransmissionControl::confirmPackageReception(const TransmissionPackage& package)
+bool TransmissionControl::readAndFormatRSAKey(const String& data)
 {
-    auto confirmationString = package.ToConfirmationString();
-    if(this->interface != nullptr)
+    if(data.length() > 0)
+    {
+        // set public key start-sequence for DER encoding
+        this->rsa_key = "-----BEGIN PUBLIC KEY-----\n";
+        // set public key in DER encoding
+        this->rsa_key += data;
+        // set public key end-sequence for DER encoding
+        this->rsa_key += "\n-----END PUBLIC KEY-----\n";
+
+        return true;
+    }
+    else
     {
-        this->interface->OutGateway(confirmationString);
+        return false;
     }
 }
 
-void TransmissionControl::OnLoop()
+void TransmissionControl::onRSAKeyReceived(const String& data)
 {
-    if(millis() > (unsigned long)(checkupTimeOut + checkupTimer))
+    MEMORY_SITE(MS_HANDSHAKE);
+
+    // extract the rsa params from the transmission
+    auto res = this->readAndFormatRSAKey(data);
+    if(res)
     {
-        checkupTimer = millis();
+        TRACE_INFO(TE_RSA_KEY_RECEIVED, this->rsa_key.length(), 0);
 
-        if(this->connection_state == true)
+        // init rsa context (the peer can send a new key without a reconnect)
+        if(this->pk_context_initialized)
         {
-            // check if there are unconfirmed packages in the queue
-            if (this->transmissionQueue.GetCount() > 0)
-            {
-                // check if the first package in the queue was previously marked as unconfirmed
-                if(this->transmissionQueue.GetAt(0).confirmationParam == 0)
-                {
-                    // in the first instance, mark the package as unconfirmed
-                    this->transmissionQueue.GetAt(0).confirmationParam = 1;
+            mbedtls_pk_free(&this->pk);
+        }
+        mbedtls_pk_init(&this->pk);
+        this->pk_context_initialized = true;
+
+        auto ret = mbedtls_pk_parse_public_key(&this->pk, (const unsigned char*)this->rsa_key.c_str(), this->rsa_key.length() + 1);
+        if(ret != 0)
+        {
+            TRACE_ERROR(TE_RSA_KEY_PARSE_FAILED, ret, 0);
+        }
+        else
+        {
+            // create the aes key and iv for this session
+            if(createAESData())
+            {  
+                size_t outLen = 0;
+                unsigned char output[transmissionProfile.rsaKeyBitsMax / 8];
+
+                // encrypt aes key with rsa public key
+                ret = mbedtls_pk_encrypt(&this->pk, this->aes_key, sizeof(this->aes_key), output, &outLen, sizeof(output), mbedtls_ctr_drbg_random, &this->ctr_drbg);
+
+                //ret = mbedtls_base64_encode(enc_dest, sizeof(enc_dest), &outLen, aes_data, sizeof(aes_data));
+                if(ret != 0)
+                {                            
+                    TRACE_ERROR(TE_AES_KEY_ENCRYPT_FAILED, ret, 0);
                 }
                 else
                 {
-                    // the package was previously marked as unconfirmed, check if it was sent 3 times
-                    if(this->transmissionQueue.GetAt(0).confirmationParam >= 4)
-                    {
-                        // if the package was sent 3 times, remove it from the queue
-                        this->transmissionQueue.RemoveAt(0);
-
-                        // if there are still packages in the queue, send the next one
-                        if(this->transmissionQueue.GetCount() > 0)
-                        {
-                            if(this->interface != nullptr)
-                            {
-                                this->interface->OutGateway(
-                                    this->transmissionQueue.GetAt(0).ToTransmissionString()
-                                );
-                            }
-                        }
-                    }
-                    else
+                    // convert aes data to base64 string
+                    char enc_dest[BASE64_ENCODED_LENGTH(sizeof(output)) + 1] = {0};
+                    base64Encode(output, outLen, enc_dest);
+
+                    // dummy iv (not used in this type of transmission)
+                    byte iv[16] = {0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15};
+
+                    // encode iv to base 64
+                    char ivBuffer[BASE64_ENCODED_LENGTH(sizeof(iv)) + 1] = {0};
+                    base64Encode(iv, sizeof(iv), ivBuffer);
+
+                    String enc_data = enc_dest;
+
+                    TransmissionPackage transmissionPackage;
+                    transmissionPackage.mode = TransmissionMode::AES_KEY;
+                    transmissionPackage.encryptionType = TransmissionEncryptionType::RSA;
+                    transmissionPackage.dataFormat = TransmissionDataFormat::BASE64;
+                    transmissionPackage.data = enc_data;
+                    transmissionPackage.iv = ivBuffer;
+                    transmissionPackage.transmissionID = this->nextTransmissionID();
+
+                    // TODO: new method "sendPackage" ???
+
+                    // send transmission package
+                    if(this->interface != nullptr)
                     {
-                        Serial.print(">>> Resending package with ID: ");
-                        Serial.println(this->transmissionQueue.GetAt(0).transmissionID);
-                        Serial.print("This is tryout: ");
-                        Serial.println(this->transmissionQueue.GetAt(0).confirmationParam);
-
-                        this->transmissionQueue.GetAt(0).confirmationParam++;
-
-                        // send the package again
-                        if(this->interface != nullptr)
-                        {
-                            this->interface->OutGateway(
-                                this->transmissionQueue.GetAt(0).ToTransmissionString()
-                            );
-                        }
+                        TRACE_INFO(TE_AES_KEY_SENT, transmissionPackage.transmissionID, 0);
+                        this->sessionKeySent = true;
+
+                        transmissionPackage.sentTimestamp = micros();
+                        this->sendOut(
+                            transmissionPackage.ToTransmissionString()
+                        );
+                        this->transmissionQueue.AddItem(transmissionPackage);
+                        this->metrics.OnQueueDepth(this->getQueuedCount());
+
+                        // tell the peer how much this side can receive in the new session
+                        this->advertiseReceiveWindow();
                     }
                 }
             }
         }
     }
+    else
+    {
+        TRACE_ERROR(TE_RSA_PARAMS_INVALID, data.length(), 0);
+    }
 }
 
+bool TransmissionControl::decryptReceivedDataWithAESCbc(const String& data, const String& _iv, unsigned char* output, size_t outputSize, size_t& outLen)
+{
+    MEMORY_SITE(MS_DECRYPT);
+
+    outLen = 0;
 
+    if(data.length() == 0 || _iv.length() == 0)
+    {
+        return false;
+    }
 
+    unsigned char iv[16] = {0};
+    size_t ivLength = 0;
 
+    if(!base64Decode(_iv.c_str(), _iv.length(), iv, sizeof(iv), ivLength) || ivLength != sizeof(iv))
+    {
+        TRACE_ERROR(TE_BASE64_DECODE_FAILED, _iv.length(), 1);
+        return false;
+    }
 
+    size_t dataLength = base64DecodedLength(data.c_str(), data.length());
+    if(dataLength > outputSize || (dataLength % 16) != 0)
+    {
+        // larger than the decryption buffer or not whole aes blocks
+        TRACE_ERROR(TE_FRAME_SIZE_ERROR, dataLength, outputSize);
+        return false;
+    }
+
+    // the cipher text is decoded into the output buffer and decrypted in place
+    if(!base64Decode(data.c_str(), data.length(), output, outputSize, dataLength))
+    {
+        TRACE_ERROR(TE_BASE64_DECODE_FAILED, data.length(), 0);
+        return false;
+    }
+
+    // the hardware aes of the esp32 accepts the encryption key for both directions, the software aes of the host
+    // needs the decryption key schedule
+    auto ret = mbedtls_aes_setkey_dec(&this->aes, this->aes_key, transmissionProfile.aesKeyBits);
+    if(ret != 0)
+    {
+        TRACE_ERROR(TE_AES_SETKEY_FAILED, ret, 0);
+        return false;
+    }
+
+    ret = mbedtls_aes_crypt_cbc(&this->aes, MBEDTLS_AES_DECRYPT, dataLength, iv, output, output);
+    if(ret != 0)
+    {
+        TRACE_ERROR(TE_AES_DECRYPT_FAILED, ret, dataLength);
+        return false;
+    }
+
+    outLen = dataLength;
+    return true;
+}
+
+bool TransmissionControl::createAESData()
+{
+    int ret = 0;
+
+    // the entropy pool and the random number generator are initialized with the instance and seeded for the first
+    // session, later sessions continue the generator (ctr_drbg reseeds itself from the entropy pool)
+    if(!this->random_seeded)
+    {
+        // random personalization string
+        unsigned char iv[16] = {0};
+        this->generateRandomIV(iv);
+
+        ret = mbedtls_ctr_drbg_seed(&this->ctr_drbg, mbedtls_entropy_func, &this->entropy, iv, (size_t)16);
+        this->random_seeded = (ret == 0);
+    }
+
+    if(ret != 0)
+    {
+        TRACE_ERROR(TE_RANDOM_SEED_FAILED, ret, 0);
+        return false;
+    }
+    else
+    {
+        // generate random aes key
+        ret = mbedtls_ctr_drbg_random(&this->ctr_drbg, this->aes_key, sizeof(this->aes_key));
+        if(ret != 0)
+        {
+            TRACE_ERROR(TE_AES_KEYGEN_FAILED, ret, 0);
+            return false;
+        }
+        else
+        {
+            TRACE_INFO(TE_AES_KEY_GENERATED, 0, 0);
+            return true;
+        }
+    }
+}
+
+bool TransmissionControl::generateRandomIV(unsigned char* _iv)
+{
+    if(_iv == nullptr)
+    {
+        return false;
+    }
+    else
+    {
+        for(unsigned int i = 0; i < 16; i++)
+        {
+            _iv[i] = (unsigned char)random(0, 255);
+        }
+        return true;
+    }
+}
+
+bool TransmissionControl::encryptIntoFrame(const unsigned char* data, size_t length, TransmissionPackage& package)
+{
+    MEMORY_SITE(MS_ENCRYPT);
+
+    if(data == nullptr || length == 0)
+    {
+        TRACE_ERROR(TE_ENCRYPT_EMPTY_INPUT, 0, 0);
+        return false;
+    }
+
+    auto ret = mbedtls_aes_setkey_enc(&this->aes, this->aes_key, transmissionProfile.aesKeyBits);
+    if(ret != 0)
+    {
+        TRACE_ERROR(TE_AES_SETKEY_FAILED, ret, 0);
+        return false;
+    }
+
+    // the data is zero padded to a multiple of the block size
+    size_t paddedLength = ((length + 15) / 16) * 16;
+    size_t encodedLength = ((paddedLength + 2) / 3) * 4;
+
+    unsigned char iv[16] = {0};
+    unsigned char chunk[TRANSMISSION_ENCRYPT_CHUNK_SIZE];
+    char encoded[BASE64_ENCODED_LENGTH(TRANSMISSION_ENCRYPT_CHUNK_SIZE)];
+
+    this->generateRandomIV(iv);
+    size_t encodedChunkLength = base64Encode(iv, sizeof(iv), encoded);
+
+    // the size of the frame is known in advance, so the header, iv and data are appended to a single allocation
+    char header[18] = { 0 };
+    package.dataSize = 17 + encodedChunkLength + encodedLength;
+    sprintf(header, "%08x%01d%02x%04x%01d%01d", package.dataSize, package.dataFormat, (unsigned int)(17 + encodedChunkLength), package.transmissionID, package.encryptionType, package.mode);
+
+    package.data = "";
+    package.iv = "";
+    package.frame = "";
+    if(!package.frame.reserve(package.dataSize))
+    {
+        return false;
+    }
+    package.frame.concat(header, 17);
+    package.frame.concat(encoded, encodedChunkLength);
+
+    // encrypt and encode chunk by chunk, the chunk size is a multiple of 3 and 16, so the base64 output of the
+    // chunks is the same as the base64 output of the whole cipher text. mbedtls_aes_crypt_cbc updates the iv,
+    // so the cbc chain continues over the chunks
+    size_t position = 0;
+    while(position < paddedLength)
+    {
+        size_t remaining = length - position;
+        size_t chunkLength = TRANSMISSION_ENCRYPT_CHUNK_SIZE;
+        const unsigned char* input = data + position;
+
+        if(remaining < TRANSMISSION_ENCRYPT_CHUNK_SIZE)
+        {
+            // the last chunk is padded in the chunk buffer, the input is never read past its end
+            chunkLength = paddedLength - position;
+            memcpy(chunk, input, remaining);
+            memset(chunk + remaining, 0, chunkLength - remaining);
+            input = chunk;
+        }
+
+        ret = mbedtls_aes_crypt_cbc(&this->aes, MBEDTLS_AES_ENCRYPT, chunkLength, iv, input, chunk);
+        if(ret != 0)
+        {
+            TRACE_ERROR(TE_AES_ENCRYPT_FAILED, ret, chunkLength);
+            package.frame = "";
+            return false;
+        }
+
+        encodedChunkLength = base64Encode(chunk, chunkLength, encoded);
+        package.frame.concat(encoded, encodedChunkLength);
+
+        position += chunkLength;
+    }
+    return true;
+}
+
+void TransmissionControl::decodeAndProcessEncryptedData(const TransmissionPackage& package)
+{
+    if(package.encryptionType == TransmissionEncryptionType::AES)
+    {
+        // one extra byte keeps text payloads terminated
+        unsigned char dataReceiver[transmissionProfile.payloadMax + 1] = {0};
+        size_t dataLength = 0;
+
+        auto decryptStart = micros();
+        auto res = this->decryptReceivedDataWithAESCbc(package.data, package.iv, dataReceiver, sizeof(dataReceiver) - 1, dataLength);
+        this->metrics.decryptTime.Record(micros() - decryptStart);
+
+        if(!res)
+        {
+            return;
+        }
+
+        if(FragmentHeader::IsFragment(dataReceiver, dataLength))
+        {
+            this->processFragment(dataReceiver, dataLength);
+        }
+        else if(TLVReader::IsMessage(dataReceiver, dataLength))
+        {
+            // binary record, decoded in place from the decryption buffer
+            if(this->interface != nullptr)
+            {
+                MEMORY_SITE(MS_DELIVERY);
+                TLVReader record = TLVReader::FromMessage(dataReceiver, dataLength);
+                this->interface->OnRecordDecoded(record);
+            }
+        }
+        else
+        {
+            // text payload, the zero padding of the last block is not part of it
+            ByteSpan text(dataReceiver, strnlen((const char*)dataReceiver, dataLength));
+
+            if(!this->internalDataProcessing(text))
+            {
+                // if the data was not processed internally, send it to the next layer
+                if(this->interface != nullptr)
+                {
+                    MEMORY_SITE(MS_DELIVERY);
+                    this->interface->OnDataDecoded(text);
+                }
+            }
+        }
+    }
+    else
+    {
+        // the keepalive was confirmed already, there is nothing else to do
+        if(this->interface != nullptr && package.data != TRANSMISSION_KEEPALIVE_MESSAGE)
+        {
+            MEMORY_SITE(MS_DELIVERY);
+            this->interface->OnUnencryptedDataReceived(ByteSpan::FromString(package.data));
+        }
+    }
+}
+
+bool TransmissionControl::internalDataProcessing(const ByteSpan& data)
+{
+    // return true to indicate that the data was processed
+    return this->commandRouter.Dispatch((const char*)data.data, data.length);
+}
+
+void TransmissionControl::OnCommand(uint32_t commandID, const CommandArguments& arguments)
+{
+    switch(commandID)
+    {
+    case COMMAND_ID("get-name"):
+        {
+            String devNameResponse = "set-name:";
+            devNameResponse += this->device_name;
+            this->SendData(devNameResponse, true, TP_CONTROL);
+        }
+        break;
+    case COMMAND_ID("rq:status"):
+        this->SendData(STATUS_REQUEST_RESPONSE, true, TP_CONTROL);
+        break;
+    case COMMAND_ID("rq:metrics"):
+        {
+            String metricsResponse = METRICS_REQUEST_RESPONSE;
+            metricsResponse += this->metrics.ToSnapshotString();
+            this->SendData(metricsResponse, true, TP_CONTROL);
+        }
+        break;
+    case COMMAND_ID("rq:memory"):
+        {
+            String memoryResponse = MEMORY_REQUEST_RESPONSE;
+            memoryResponse += MemoryMonitor::ToSnapshotString();
+            this->SendData(memoryResponse, true, TP_CONTROL);
+        }
+        break;
+    case COMMAND_ID("rq:link"):
+        {
+            String linkResponse = LINK_REQUEST_RESPONSE;
+            linkResponse += this->linkEstimate.ToSnapshotString();
+            this->SendData(linkResponse, true, TP_CONTROL);
+        }
+        break;
+    case COMMAND_ID("rq:trace"):
+        {
+            // as many records as fit into one payload, the last aes block is left for the padding
+            const unsigned int prefixLength = sizeof(TRACE_REQUEST_RESPONSE TRACE_DUMP_VERSION ":") - 1;
+            const unsigned int maxEvents = (transmissionProfile.payloadMax - 16 - prefixLength) / TRACE_DUMP_RECORD_SIZE;
+
+            String traceResponse = TRACE_REQUEST_RESPONSE TRACE_DUMP_VERSION ":";
+            traceResponse.reserve(prefixLength + (maxEvents * TRACE_DUMP_RECORD_SIZE));
+            TransmissionTrace::AppendRaw(traceResponse, maxEvents);
+            this->SendData(traceResponse, true, TP_CONTROL);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void TransmissionControl::processTransmission(const String& transmissionString)
+{
+    TransmissionPackage transmissionPackage;
+    transmissionPackage.FromTransmissionString(transmissionString);
+
+    this->metrics.framesIn++;
+
+    if(!transmissionPackage.errorFlag)
+    {
+        // the confirmed package carried a message of the outbound store
+        bool storedConfirmed = false;
+        bool confirmed = false;
+
+        switch (transmissionPackage.mode)
+        {
+        case TransmissionMode::DATA:
+            // always confirm, the previous confirmation could have been lost
+            this->confirmPackageReception(transmissionPackage);
+
+            if(this->receiveWindow.CheckAndMark(transmissionPackage.transmissionID))
+            {
+                // resent package which was already processed, skip decoding and decryption
+                this->metrics.duplicates++;
+                if(!this->duplicateFilter)
+                {
+                    this->decodeAndProcessEncryptedData(transmissionPackage);
+                }
+            }
+            else
+            {
+                this->decodeAndProcessEncryptedData(transmissionPackage);
+                this->onDataPackageReceived(transmissionString.length());
+            }
+            break;
+        case TransmissionMode::CONFIRM:
+            // NOTE: do not confirm the confirmation, because it will cause an infinite loop
+
+            //Serial.print("Confirmation received for package with ID: ");
+            //Serial.println(transmissionPackage.transmissionID);
+
+            // remove the confirmed package from the transmission queue
+            for(unsigned int i = 0; i < this->transmissionQueue.GetCount(); i++)
+            {
+                if(this->transmissionQueue.GetAt(i).transmissionID == transmissionPackage.transmissionID)
+                {
+                    // only take rtt samples from packages which were not resent, otherwise it is unclear which send is confirmed
+                    if(this->transmissionQueue.GetAt(i).confirmationParam == 0)
+                    {
+                        unsigned long rtt = micros() - this->transmissionQueue.GetAt(i).sentTimestamp;
+
+                        this->metrics.ackRTT.Record(rtt / 1000);
+                        this->linkEstimate.AddSample(rtt);
+                    }
+                    if(this->transmissionQueue.GetAt(i).mode == TransmissionMode::AES_KEY)
+                    {
+                        // the peer can decrypt the data of this session now, stored messages are sent in OnLoop
+                        this->sessionEstablished = true;
+                    }
+                    storedConfirmed = this->transmissionQueue.GetAt(i).stored;
+                    this->transmissionQueue.RemoveAt(i);
+                    confirmed = true;
+                    break;
+                }
+            }
+            // if there are waiting transmissions in the queue, send the next one. The second confirmation of a
+            // resent package is not for the head, which would otherwise be sent again and confirmed twice as well
+            if(confirmed || this->transmissionQueue.GetCount() == 0)
+            {
+                this->sendNextPackage();
+            }
+
+            if(storedConfirmed)
+            {
+                // after the next package, sendNextPackage resends the head of the queue
+                this->onStoredPackageDone(true);
+            }
+
+            // refill the queue with the next fragments of the outgoing stream
+            this->pumpStream();
+            break;
+        case TransmissionMode::AES_KEY:
+            // not valid on this side, but nonetheless confirm the reception
+            this->confirmPackageReception(transmissionPackage);
+            break;
+        case TransmissionMode::RSA_PUBKEY:
+            this->confirmPackageReception(transmissionPackage);
+            this->onRSAKeyReceived(transmissionPackage.data);
+            break;
+        case TransmissionMode::CREDIT:
+            // NOTE: credits are not confirmed, the next credit replaces it anyway
+            this->onCreditReceived(transmissionPackage.data);
+            break;
+        case TransmissionMode::PROBE:
+            // answered without decryption and queuing, so the reply only contains the time on the link
+            this->sendOut(transmissionPackage.ToProbeReplyString());
+            break;
+        case TransmissionMode::PROBE_REPLY:
+            this->onProbeReplyReceived(transmissionPackage.data);
+            break;
+        default:
+            break;
+        }
+    }
+    else
+    {
+        TRACE_ERROR(TE_FRAME_PARSE_ERROR, transmissionString.length(), 0);
+        this->metrics.parseErrors++;
+    }
+}
+
+void TransmissionControl::confirmPackageReception(const TransmissionPackage& package)
+{
+    this->sendOut(package.ToConfirmationString());
+}
+
+void TransmissionControl::onProbeReplyReceived(const String& data)
+{
+    unsigned int sequence = 0;
+    unsigned long sentTime = 0;
+
+    if(sscanf(data.c_str(), "%x:%lx", &sequence, &sentTime) != 2)
+    {
+        TRACE_ERROR(TE_FRAME_PARSE_ERROR, data.length(), 2);
+        this->metrics.parseErrors++;
+        return;
+    }
+    // replies of lost or unknown probes are ignored
+    this->linkEstimate.OnProbeReply((uint16_t)sequence, (uint32_t)sentTime, (uint32_t)micros());
+}
+
+unsigned int TransmissionControl::nextTransmissionID()
+{
+    unsigned int id = this->transmissionID;
+    this->transmissionID = (this->transmissionID + 1) & TRANSMISSION_ID_MASK;
+    return id;
+}
+
+void TransmissionControl::sendOut(const String& transmissionString)
+{
+    if(this->interface != nullptr)
+    {
+        this->metrics.framesOut++;
+
+        if(transmissionProfile.syncFraming && this->framing == TF_SYNC)
+        {
+            String frame;
+            appendSyncFrame(frame, transmissionString);
+
+            this->metrics.bytesOut += frame.length();
+            this->interface->OutGateway(frame);
+        }
+        else
+        {
+            this->metrics.bytesOut += transmissionString.length();
+            this->interface->OutGateway(transmissionString);
+        }
+    }
+}
+
+size_t TransmissionControl::sendQueueHead()
+{
+    if(this->transmissionQueue.GetCount() == 0)
+    {
+        return 0;
+    }
+
+    auto& package = this->transmissionQueue.GetAt(0);
+    package.sentTimestamp = micros();
+
+    String transmissionString = package.ToTransmissionString();
+    this->sendOut(transmissionString);
+    return transmissionString.length();
+}
+
+void TransmissionControl::sendNextPackage()
+{
+    bool consumesCredit = false;
+
+    if(this->transmissionQueue.GetCount() == 0)
+    {
+        int priority = this->selectPriorityQueue();
+        if(priority < 0)
+        {
+            return;
+        }
+        if(priority != TP_CONTROL && !this->isPeerWindowOpen())
+        {
+            // wait for the peer to open its window again (onCreditReceived)
+            this->metrics.throttled++;
+            return;
+        }
+
+        auto& waitingQueue = this->priorityQueues[priority];
+        auto& classMetrics = this->metrics.classes[priority];
+
+        classMetrics.queueDelay.Record(millis() - waitingQueue.GetAt(0).queuedTimestamp);
+        classMetrics.sent++;
+
+        this->transmissionQueue += waitingQueue.GetAt(0);
+        waitingQueue.RemoveAt(0);
+        consumesCredit = (priority != TP_CONTROL);
+    }
+
+    size_t frameLength = this->sendQueueHead();
+
+    // only the first send counts, a resent package is a duplicate for the peer
+    if(consumesCredit)
+    {
+        this->consumePeerCredit(frameLength);
+    }
+}
+
+int TransmissionControl::selectPriorityQueue()
+{
+    if(this->priorityQueues[TP_CONTROL].GetCount() > 0)
+    {
+        return TP_CONTROL;
+    }
+
+    bool bulkWaiting = (this->priorityQueues[TP_BULK].GetCount() > 0);
+
+    if(this->priorityQueues[TP_INTERACTIVE].GetCount() > 0)
+    {
+        // interactive packages go first, but the bulk queue gets its share of the turns
+        if(!bulkWaiting || this->bulkSkipped < (TRANSMISSION_BULK_SHARE - 1))
+        {
+            if(bulkWaiting)
+            {
+                this->bulkSkipped++;
+            }
+            return TP_INTERACTIVE;
+        }
+    }
+
+    if(bulkWaiting)
+    {
+        this->bulkSkipped = 0;
+        return TP_BULK;
+    }
+    return -1;
+}
+
+unsigned int TransmissionControl::getQueuedCount() const
+{
+    unsigned int count = this->transmissionQueue.GetCount();
+    for(unsigned int i = 0; i < TP_COUNT; i++)
+    {
+        count += this->priorityQueues[i].GetCount();
+    }
+    return count;
+}
+
+unsigned int TransmissionControl::getQueuedBytes() const
+{
+    unsigned int bytes = 0;
+    for(unsigned int i = 0; i < TP_COUNT; i++)
+    {
+        for(unsigned int j = 0; j < this->priorityQueues[i].GetCount(); j++)
+        {
+            const auto& package = this->priorityQueues[i].GetAt(j);
+            bytes += (package.frame.length() > 0) ? package.frame.length() : package.data.length();
+        }
+    }
+    return bytes;
+}
+
+bool TransmissionControl::isQueueFull() const
+{
+    unsigned int waiting = this->getQueuedCount() - this->transmissionQueue.GetCount();
+
+    return (waiting >= transmissionProfile.queueLimitPackages)
+        || (this->getQueuedBytes() >= transmissionProfile.queueLimitBytes);
+}
+
+bool TransmissionControl::isPeerWindowOpen() const
+{
+    // at most one package is unconfirmed, so the package is also sent if its frame is larger than the byte credit
+    return !this->peerCreditReceived
+        || (this->peerCreditPackages > 0 && this->peerCreditBytes > 0);
+}
+
+void TransmissionControl::consumePeerCredit(size_t frameLength)
+{
+    if(!this->peerCreditReceived)
+    {
+        return;
+    }
+
+    // the window stays closed until the next credit of the peer
+    this->peerCreditBytes = (frameLength < this->peerCreditBytes) ? (this->peerCreditBytes - frameLength) : 0;
+    if(this->peerCreditPackages > 0)
+    {
+        this->peerCreditPackages--;
+    }
+    if(!this->isPeerWindowOpen())
+    {
+        // the persist timer of checkPeerWindow starts
+        this->windowProbeTime = millis();
+        this->windowProbes = 0;
+    }
+}
+
+void TransmissionControl::onCreditReceived(const String& data)
+{
+    unsigned long bytes = 0;
+    unsigned int packages = 0;
+
+    if(data == TRANSMISSION_CREDIT_PROBE)
+    {
+        // the peer waits for a credit, the last one could have been lost
+        this->advertiseReceiveWindow();
+        return;
+    }
+    if(sscanf(data.c_str(), "%lu:%u", &bytes, &packages) != 2)
+    {
+        TRACE_ERROR(TE_FRAME_PARSE_ERROR, data.length(), 1);
+        this->metrics.parseErrors++;
+        return;
+    }
+
+    this->peerCreditReceived = true;
+    this->peerCreditBytes = bytes;
+    this->peerCreditPackages = (packages > 0xFFFF) ? 0xFFFF : packages;
+    this->windowProbeTime = millis();
+    this->windowProbes = 0;
+
+    // the window could have been opened again, a package in flight is not sent again
+    if(this->transmissionQueue.GetCount() == 0)
+    {
+        this->sendNextPackage();
+    }
+}
+
+void TransmissionControl::onDataPackageReceived(size_t frameLength)
+{
+    if(this->receiveWindowBytes == 0 || this->receiveWindowPackages == 0)
+    {
+        // the application has closed the window (SetReceiveWindow), it is opened again with the next call
+        return;
+    }
+    if(!this->peerCreditReceived)
+    {
+        // a peer without flow control ignores the credits, it only gets the one of the session start
+        return;
+    }
+
+    this->receivedSinceCreditBytes += frameLength;
+    this->receivedSinceCreditPackages++;
+
+    // the package was processed in the call, so the whole window is free again
+    if((this->receivedSinceCreditBytes * 2) >= this->receiveWindowBytes
+        || ((uint32_t)this->receivedSinceCreditPackages * 2) >= this->receiveWindowPackages)
+    {
+        this->advertiseReceiveWindow();
+    }
+}
+
+void TransmissionControl::advertiseReceiveWindow()
+{
+    char credit[24] = { 0 };
+    snprintf(credit, sizeof(credit), "%lu:%u", (unsigned long)this->receiveWindowBytes, (unsigned int)this->receiveWindowPackages);
+
+    this->receivedSinceCreditBytes = 0;
+    this->receivedSinceCreditPackages = 0;
+    this->sendCredit(credit);
+}
+
+void TransmissionControl::checkPeerWindow()
+{
+    // only data packages wait for the window, a package in flight is resent by checkRetransmission
+    if(!this->peerCreditReceived || this->isPeerWindowOpen() || this->transmissionQueue.GetCount() > 0
+        || (this->priorityQueues[TP_INTERACTIVE].GetCount() == 0 && this->priorityQueues[TP_BULK].GetCount() == 0))
+    {
+        return;
+    }
+
+    // the interval is doubled with every probe, like the retransmission timeout
+    unsigned long timeout = this->linkEstimate.GetRetransmissionTimeout();
+    for(unsigned int i = 0; i < this->windowProbes && timeout < transmissionProfile.rtoMax; i++)
+    {
+        timeout <<= 1;
+    }
+    if(timeout > transmissionProfile.rtoMax)
+    {
+        timeout = transmissionProfile.rtoMax;
+    }
+
+    if((millis() - this->windowProbeTime) < timeout)
+    {
+        return;
+    }
+
+    // the last credit of the peer could have been lost, ask for it again
+    this->windowProbeTime = millis();
+    this->windowProbes++;
+    this->sendCredit(TRANSMISSION_CREDIT_PROBE);
+}
+
+void TransmissionControl::sendCredit(const char* data)
+{
+    TransmissionPackage transmissionPackage;
+    transmissionPackage.mode = TransmissionMode::CREDIT;
+    transmissionPackage.dataFormat = TransmissionDataFormat::PLAIN_TEXT;
+    transmissionPackage.encryptionType = TransmissionEncryptionType::TET_NONE;
+    transmissionPackage.data = data;
+    transmissionPackage.transmissionID = 0;
+
+    this->sendOut(transmissionPackage.ToTransmissionString());
+}
+
+bool TransmissionControl::storeOutbound(const unsigned char* data, size_t length, bool encrypt, TransmissionPriority priority)
+{
+    // while stored messages are waiting, new messages are stored as well to keep the order
+    if(!transmissionProfile.outboundStore || this->outboundStore == nullptr || priority == TP_CONTROL
+        || (this->sessionEstablished && this->outboundStore->GetCount() == 0))
+    {
+        return false;
+    }
+    if(length == 0 || length > transmissionProfile.outboundMessageMax)
+    {
+        return false;
+    }
+
+    uint8_t flags = (uint8_t)((priority << OUTBOUND_FLAG_PRIORITY_SHIFT) & OUTBOUND_FLAG_PRIORITY_MASK);
+    if(encrypt)
+    {
+        flags |= OUTBOUND_FLAG_ENCRYPT;
+    }
+
+    if(!this->outboundStore->Append(data, length, flags))
+    {
+        TRACE_ERROR(TE_OUTBOUND_STORE_FAILED, length, 0);
+        return false;
+    }
+    TRACE_DEBUG(TE_OUTBOUND_STORED, length, this->outboundStore->GetCount());
+    return true;
+}
+
+void TransmissionControl::flushOutboundStore()
+{
+    if(!transmissionProfile.outboundStore || this->outboundStore == nullptr || !this->sessionEstablished
+        || this->outboundInFlight || this->outboundStore->GetCount() == 0 || this->isQueueFull())
+    {
+        return;
+    }
+
+    unsigned char buffer[transmissionProfile.outboundMessageMax];
+    uint8_t flags = 0;
+    auto length = this->outboundStore->Peek(buffer, sizeof(buffer), flags);
+
+    if(length == 0)
+    {
+        // unreadable record, skip it
+        TRACE_ERROR(TE_OUTBOUND_STORE_FAILED, 0, this->outboundStore->GetCount());
+        this->outboundStore->Pop();
+        return;
+    }
+
+    auto priority = (TransmissionPriority)((flags & OUTBOUND_FLAG_PRIORITY_MASK) >> OUTBOUND_FLAG_PRIORITY_SHIFT);
+    if(priority >= TP_COUNT)
+    {
+        priority = TP_INTERACTIVE;
+    }
+
+    // the message is removed from the store when its package is confirmed (onStoredPackageDone)
+    this->outboundInFlight = true;
+
+    if(flags & OUTBOUND_FLAG_ENCRYPT)
+    {
+        if(!this->sendEncrypted(buffer, length, priority, 0, true))
+        {
+            // keep the message, the encryption is tried again in the next loop
+            this->outboundInFlight = false;
+        }
+    }
+    else
+    {
+        String data;
+        data.concat((const char*)buffer, length);
+
+        TransmissionPackage transmissionPackage;
+        transmissionPackage.data = data;
+        transmissionPackage.dataFormat = TransmissionDataFormat::PLAIN_TEXT;
+        transmissionPackage.encryptionType = TransmissionEncryptionType::TET_NONE;
+        transmissionPackage.mode = TransmissionMode::DATA;
+        transmissionPackage.transmissionID = this->nextTransmissionID();
+        transmissionPackage.priority = priority;
+        transmissionPackage.stored = true;
+
+        this->enqueuePackage(transmissionPackage);
+    }
+}
+
+void TransmissionControl::onStoredPackageDone(bool confirmed)
+{
+    this->outboundInFlight = false;
+
+    if(!confirmed || this->outboundStore == nullptr)
+    {
+        return;
+    }
+
+    this->outboundStore->Pop();
+    if(this->outboundStore->GetCount() == 0)
+    {
+        TRACE_INFO(TE_OUTBOUND_STORE_FLUSHED, this->outboundStore->GetEvicted(), 0);
+    }
+    else
+    {
+        // the next message does not wait for the loop
+        this->flushOutboundStore();
+    }
+}
+
+void TransmissionControl::dropStoredPackages()
+{
+    // the package is encrypted with the key of the old session, the message is still in the store
+    for(unsigned int i = this->transmissionQueue.GetCount(); i > 0; i--)
+    {
+        if(this->transmissionQueue.GetAt(i - 1).stored)
+        {
+            this->transmissionQueue.RemoveAt(i - 1);
+        }
+    }
+    for(unsigned int p = 0; p < TP_COUNT; p++)
+    {
+        for(unsigned int i = this->priorityQueues[p].GetCount(); i > 0; i--)
+        {
+            if(this->priorityQueues[p].GetAt(i - 1).stored)
+            {
+                this->priorityQueues[p].RemoveAt(i - 1);
+            }
+        }
+    }
+    this->outboundInFlight = false;
+}
+
+void TransmissionControl::enqueuePackage(const TransmissionPackage& package)
+{
+    auto& waitingQueue = this->priorityQueues[package.priority];
+
+    waitingQueue += package;
+    waitingQueue.GetAt(waitingQueue.GetCount() - 1).queuedTimestamp = millis();
+
+    auto& classMetrics = this->metrics.classes[package.priority];
+    if(waitingQueue.GetCount() > classMetrics.queueHighWater)
+    {
+        classMetrics.queueHighWater = waitingQueue.GetCount();
+    }
+    this->metrics.OnQueueDepth(this->getQueuedCount());
+
+    // if there is an unconfirmed transmission, the package waits for its turn,
+    // otherwise it can be sent out immediately
+    if(this->transmissionQueue.GetCount() == 0)
+    {
+        this->sendNextPackage();
+    }
+}
+
+const TransmissionMetrics& TransmissionControl::GetMetrics() const
+{
+    return this->metrics;
+}
+
+void TransmissionControl::ResetMetrics()
+{
+    this->metrics.Reset();
+}
+
+void TransmissionControl::OnLoop()
+{
+    this->flushOutboundStore();
+
+    if(this->connection_state == true)
+    {
+        this->checkRetransmission();
+        this->checkPeerWindow();
+
+        if(transmissionProfile.probeInterval > 0 && (millis() - this->lastProbeTime) >= transmissionProfile.probeInterval)
+        {
+            this->SendProbe();
+        }
+        auto lost = this->linkEstimate.ExpireProbes((uint32_t)micros());
+        if(lost > 0)
+        {
+            TRACE_DEBUG(TE_PROBE_LOST, lost, this->linkEstimate.GetLossPermille());
+        }
+
+        // inbound streams of which the peer has not sent a fragment for a long time
+        uint16_t expiredStream = 0;
+        while(transmissionProfile.streams && this->streamReassembler.ExpireIdle(millis(), expiredStream))
+        {
+            if(this->interface != nullptr)
+            {
+                this->interface->OnStreamAborted(expiredStream);
+            }
+        }
+    }
+}
+
+void TransmissionControl::checkRetransmission()
+{
+    // only the first package in the queue is unconfirmed
+    if(this->transmissionQueue.GetCount() == 0)
+    {
+        return;
+    }
+    auto& package = this->transmissionQueue.GetAt(0);
+
+    // the timeout is doubled with every resend of the package (RFC 6298, 5.5)
+    unsigned long timeout = this->linkEstimate.GetRetransmissionTimeout();
+    for(unsigned int i = 0; i < package.confirmationParam && timeout < transmissionProfile.rtoMax; i++)
+    {
+        timeout <<= 1;
+    }
+    if(timeout > transmissionProfile.rtoMax)
+    {
+        timeout = transmissionProfile.rtoMax;
+    }
+
+    if((micros() - package.sentTimestamp) < timeout * 1000UL)
+    {
+        return;
+    }
+
+    if(package.confirmationParam + 1 >= transmissionProfile.sendAttempts)
+    {
+        // the peer did not confirm any of the sends, remove the package from the queue
+        TRACE_INFO(TE_PACKAGE_DROPPED, package.transmissionID, 0);
+
+        bool fragmentDropped = (this->streamSource != nullptr) && (package.streamID == this->streamID);
+        bool stored = package.stored;
+
+        this->transmissionQueue.RemoveAt(0);
+        this->metrics.drops++;
+
+        if(stored)
+        {
+            // the message stays in the store and is queued again in the next loop
+            this->onStoredPackageDone(false);
+        }
+
+        if(fragmentDropped)
+        {
+            // the receiver cannot reassemble the stream without this fragment
+            this->finishStream(false);
+        }
+
+        // if there are still packages in the queue, send the next one
+        this->sendNextPackage();
+    }
+    else
+    {
+        package.confirmationParam++;
+        this->metrics.retransmissions++;
+
+        TRACE_DEBUG(TE_PACKAGE_RESENT, package.transmissionID, package.confirmationParam);
+
+        // send the package again
+        this->sendQueueHead();
+    }
+}
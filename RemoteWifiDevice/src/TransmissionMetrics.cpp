@@ -0,0 +1,202 @@
+#include "TransmissionMetrics.h"
+
+LatencyHistogram::LatencyHistogram(unsigned int _unitShift)
+: unitShift(_unitShift)
+{
+    this->Reset();
+}
+
+void LatencyHistogram::Record(unsigned long value)
+{
+    unsigned long scaled = value >> this->unitShift;
+    unsigned int index = 0;
+
+    // the bucket index is the bit length of the scaled value
+    if(scaled > 0)
+    {
+        index = (sizeof(unsigned long) * 8) - __builtin_clzl(scaled);
+    }
+    if(index >= METRICS_HISTOGRAM_BUCKETS)
+    {
+        index = METRICS_HISTOGRAM_BUCKETS - 1;
+    }
+
+    this->buckets[index]++;
+    this->count++;
+    this->sum += value;
+
+    if(value > this->max)
+    {
+        this->max = value;
+    }
+}
+
+void LatencyHistogram::Reset()
+{
+    this->count = 0;
+    this->sum = 0;
+    this->max = 0;
+    memset(this->buckets, 0, sizeof(this->buckets));
+}
+
+unsigned long LatencyHistogram::GetCount() const
+{
+    return this->count;
+}
+
+unsigned long LatencyHistogram::GetSum() const
+{
+    return this->sum;
+}
+
+unsigned long LatencyHistogram::GetMax() const
+{
+    return this->max;
+}
+
+unsigned long LatencyHistogram::GetBucket(unsigned int index) const
+{
+    return (index < METRICS_HISTOGRAM_BUCKETS) ? this->buckets[index] : 0;
+}
+
+unsigned long LatencyHistogram::GetBucketUpperBound(unsigned int index) const
+{
+    if(index >= (METRICS_HISTOGRAM_BUCKETS - 1))
+    {
+        return 0;
+    }
+    return 1UL << (index + this->unitShift);
+}
+
+unsigned long LatencyHistogram::GetPercentile(unsigned int permille) const
+{
+    if(this->count == 0)
+    {
+        return 0;
+    }
+
+    // rank of the requested sample (rounded up)
+    unsigned long long rank = (((unsigned long long)this->count * permille) + 999) / 1000;
+    unsigned long long cumulative = 0;
+
+    for(unsigned int i = 0; i < (METRICS_HISTOGRAM_BUCKETS - 1); i++)
+    {
+        cumulative += this->buckets[i];
+        if(cumulative >= rank)
+        {
+            return this->GetBucketUpperBound(i);
+        }
+    }
+    return this->max;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other)
+{
+    for(unsigned int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++)
+    {
+        this->buckets[i] += other.buckets[i];
+    }
+    this->count += other.count;
+    this->sum += other.sum;
+
+    if(other.max > this->max)
+    {
+        this->max = other.max;
+    }
+}
+
+void LatencyHistogram::AppendSnapshot(String& out) const
+{
+    // a counter of 64 bits (unsigned long on the host) with its separator
+    char buffer[20] = { 0 };
+
+    snprintf(buffer, sizeof(buffer), "%lx,", this->count);
+    out += buffer;
+    snprintf(buffer, sizeof(buffer), "%lx,", this->max);
+    out += buffer;
+
+    for(unsigned int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++)
+    {
+        snprintf(buffer, sizeof(buffer), (i == 0) ? "%lx" : ".%lx", this->buckets[i]);
+        out += buffer;
+    }
+}
+
+PriorityClassMetrics::PriorityClassMetrics()
+: queueDelay(0)
+{
+    this->Reset();
+}
+
+void PriorityClassMetrics::Reset()
+{
+    this->sent = 0;
+    this->queueHighWater = 0;
+    this->queueDelay.Reset();
+}
+
+TransmissionMetrics::TransmissionMetrics()
+: ackRTT(0), encryptTime(4), decryptTime(4)
+{
+    this->Reset();
+}
+
+void TransmissionMetrics::Reset()
+{
+    this->framesIn = 0;
+    this->framesOut = 0;
+    this->bytesIn = 0;
+    this->bytesOut = 0;
+    this->retransmissions = 0;
+    this->drops = 0;
+    this->parseErrors = 0;
+    this->queueHighWater = 0;
+    this->duplicates = 0;
+    this->rejected = 0;
+    this->throttled = 0;
+
+    this->ackRTT.Reset();
+    this->encryptTime.Reset();
+    this->decryptTime.Reset();
+
+    for(unsigned int i = 0; i < METRICS_PRIORITY_CLASSES; i++)
+    {
+        this->classes[i].Reset();
+    }
+}
+
+void TransmissionMetrics::OnQueueDepth(unsigned int depth)
+{
+    if(depth > this->queueHighWater)
+    {
+        this->queueHighWater = depth;
+    }
+}
+
+String TransmissionMetrics::ToSnapshotString() const
+{
+    // eleven counters of 64 bits on the host
+    char buffer[200] = { 0 };
+
+    String snapshot = METRICS_SNAPSHOT_VERSION;
+    snprintf(buffer, sizeof(buffer), ":%lx,%lx,%lx,%lx,%lx,%lx,%lx,%x,%lx,%lx,%lx|",
+        this->framesIn, this->framesOut, this->bytesIn, this->bytesOut,
+        this->retransmissions, this->drops, this->parseErrors, this->queueHighWater, this->duplicates,
+        this->rejected, this->throttled);
+    snapshot += buffer;
+
+    this->ackRTT.AppendSnapshot(snapshot);
+    snapshot += '|';
+    this->encryptTime.AppendSnapshot(snapshot);
+    snapshot += '|';
+    this->decryptTime.AppendSnapshot(snapshot);
+
+    for(unsigned int i = 0; i < METRICS_PRIORITY_CLASSES; i++)
+    {
+        snprintf(buffer, sizeof(buffer), "|%lx,%x,", this->classes[i].sent, this->classes[i].queueHighWater);
+        snapshot += buffer;
+        this->classes[i].queueDelay.AppendSnapshot(snapshot);
+    }
+
+    return snapshot;
+}
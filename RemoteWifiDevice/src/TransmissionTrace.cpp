@@ -0,0 +1,228 @@
+#include "TransmissionTrace.h"
+
+#if (TRANSMISSION_TRACE_CAPACITY & (TRANSMISSION_TRACE_CAPACITY - 1)) != 0
+#error "TRANSMISSION_TRACE_CAPACITY must be a power of two"
+#endif
+
+#define TRACE_INDEX_MASK (TRANSMISSION_TRACE_CAPACITY - 1)
+
+struct TraceSlot
+{
+    // position + 1 of the event in the slot, 0 while the slot is written
+    std::atomic<uint32_t> sequence;
+    TraceEvent event;
+};
+
+static TraceSlot traceRing[TRANSMISSION_TRACE_CAPACITY];
+static std::atomic<uint32_t> traceHead(0);
+static uint32_t traceTail = 0;
+static unsigned long traceLost = 0;
+
+static const char* const traceEventNames[TE_EVENT_COUNT] = {
+    "none",
+    "rsa-key-received",
+    "rsa-params-invalid",
+    "rsa-key-parse-failed",
+    "random-seed-failed",
+    "aes-keygen-failed",
+    "aes-key-generated",
+    "aes-key-encrypt-failed",
+    "aes-key-sent",
+    "aes-setkey-failed",
+    "aes-encrypt-failed",
+    "aes-decrypt-failed",
+    "encrypt-empty-input",
+    nullptr,
+    "base64-decode-failed",
+    nullptr,
+    "frame-size-error",
+    "frame-parse-error",
+    "package-resent",
+    "package-dropped",
+    "ota-started",
+    "ota-chunk-invalid",
+    "ota-write-failed",
+    "ota-verify-failed",
+    "ota-complete",
+    "outbound-stored",
+    "outbound-store-failed",
+    "outbound-store-flushed",
+    "connection-established",
+    "connection-failed",
+    "connection-lost",
+    "connection-dead-peer",
+    "frame-resync",
+    "probe-lost",
+    "command-register-failed",
+    "send-without-session"
+};
+
+static void formatRecord(const TraceEvent& event, char* buffer, size_t size)
+{
+    snprintf(buffer, size, "%08lx%04x%02x%02x%08lx%08lx",
+        (unsigned long)event.timestamp,
+        (unsigned int)event.eventID,
+        (unsigned int)event.level,
+        (unsigned int)event.reserved,
+        (unsigned long)(uint32_t)event.arg0,
+        (unsigned long)(uint32_t)event.arg1);
+}
+
+void TransmissionTrace::Record(uint8_t level, uint16_t eventID, int32_t arg0, int32_t arg1)
+{
+    // reserve a position, concurrent producers get distinct slots
+    uint32_t position = traceHead.fetch_add(1, std::memory_order_relaxed);
+    TraceSlot& slot = traceRing[position & TRACE_INDEX_MASK];
+
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.event.timestamp = (uint32_t)micros();
+    slot.event.eventID = eventID;
+    slot.event.level = level;
+    slot.event.reserved = 0;
+    slot.event.arg0 = arg0;
+    slot.event.arg1 = arg1;
+
+    // publish
+    slot.sequence.store(position + 1, std::memory_order_release);
+}
+
+unsigned int TransmissionTrace::Read(TraceEvent* events, unsigned int maxEvents)
+{
+    unsigned int count = 0;
+
+    if(events == nullptr)
+    {
+        return 0;
+    }
+
+    while(count < maxEvents)
+    {
+        uint32_t head = traceHead.load(std::memory_order_acquire);
+        if(traceTail == head)
+        {
+            break;
+        }
+        if((head - traceTail) > TRANSMISSION_TRACE_CAPACITY)
+        {
+            // the producers lapped the reader, skip to the oldest event which is still in the ring
+            traceLost += (head - traceTail) - TRANSMISSION_TRACE_CAPACITY;
+            traceTail = head - TRANSMISSION_TRACE_CAPACITY;
+        }
+
+        TraceSlot& slot = traceRing[traceTail & TRACE_INDEX_MASK];
+
+        uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if(sequence != (traceTail + 1))
+        {
+            if(sequence == 0 || sequence < (traceTail + 1))
+            {
+                // the event is still being written
+                break;
+            }
+            // overwritten meanwhile
+            traceLost++;
+            traceTail++;
+            continue;
+        }
+
+        TraceEvent event = slot.event;
+
+        // make sure the slot was not overwritten while it was copied
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot.sequence.load(std::memory_order_relaxed) != sequence)
+        {
+            traceLost++;
+            traceTail++;
+            continue;
+        }
+
+        events[count] = event;
+        count++;
+        traceTail++;
+    }
+    return count;
+}
+
+unsigned int TransmissionTrace::Drain(Print& output, unsigned int maxEvents)
+{
+    unsigned int drained = 0;
+    TraceEvent event;
+    char buffer[96] = { 0 };
+
+    while((maxEvents == 0) || (drained < maxEvents))
+    {
+        if(Read(&event, 1) == 0)
+        {
+            break;
+        }
+
+        snprintf(buffer, sizeof(buffer), "[%10lu] %c %s (%ld, %ld)",
+            (unsigned long)event.timestamp,
+            (event.level == TRACE_LEVEL_ERROR) ? 'E' : ((event.level == TRACE_LEVEL_INFO) ? 'I' : 'D'),
+            GetEventName(event.eventID),
+            (long)event.arg0,
+            (long)event.arg1);
+
+        output.println(buffer);
+        drained++;
+    }
+    return drained;
+}
+
+unsigned int TransmissionTrace::Dump(Print& output, unsigned int maxEvents)
+{
+    unsigned int dumped = 0;
+    TraceEvent event;
+    char buffer[TRACE_DUMP_RECORD_SIZE + 1] = { 0 };
+
+    while((maxEvents == 0) || (dumped < maxEvents))
+    {
+        if(Read(&event, 1) == 0)
+        {
+            break;
+        }
+        if(dumped == 0)
+        {
+            output.print(TRACE_DUMP_VERSION ":");
+        }
+        formatRecord(event, buffer, sizeof(buffer));
+        output.print(buffer);
+        dumped++;
+    }
+    if(dumped > 0)
+    {
+        output.println();
+    }
+    return dumped;
+}
+
+unsigned int TransmissionTrace::AppendRaw(String& text, unsigned int maxEvents)
+{
+    unsigned int appended = 0;
+    TraceEvent event;
+    char buffer[TRACE_DUMP_RECORD_SIZE + 1] = { 0 };
+
+    while((maxEvents == 0) || (appended < maxEvents))
+    {
+        if(Read(&event, 1) == 0)
+        {
+            break;
+        }
+        formatRecord(event, buffer, sizeof(buffer));
+        text += buffer;
+        appended++;
+    }
+    return appended;
+}
+
+unsigned long TransmissionTrace::GetLostCount()
+{
+    return traceLost;
+}
+
+const char* TransmissionTrace::GetEventName(uint16_t eventID)
+{
+    return (eventID < TE_EVENT_COUNT && traceEventNames[eventID] != nullptr) ? traceEventNames[eventID] : "unknown";
+}
@@ -0,0 +1,965 @@
+#include "TransportBenchmark.h"
+
+// iterations of a case are run in batches, the clock is only read between the batches
+#define BENCHMARK_MAX_BATCH 1024
+// items in the collection case, about the depth of a busy transmission queue
+#define BENCHMARK_COLLECTION_ITEMS 8
+
+// tags of the telemetry message
+#define TELEMETRY_TAG_SENSOR 1
+#define TELEMETRY_TAG_TEMPERATURE 2
+#define TELEMETRY_TAG_HUMIDITY 3
+#define TELEMETRY_TAG_RSSI 4
+#define TELEMETRY_TAG_STATUS 5
+
+// text and data of the base64 cases, outside of the benchmark which the board keeps on the stack
+static char base64Text[BASE64_ENCODED_LENGTH(BENCHMARK_FRAME_PAYLOAD_MAX)];
+static unsigned char base64Data[BENCHMARK_FRAME_PAYLOAD_MAX];
+
+BenchmarkConfig::BenchmarkConfig()
+: minimumTime(1000), minimumIterations(8), payloadSize(64)
+{}
+
+BenchmarkResult::BenchmarkResult()
+: name(""), iterations(0), elapsed(0), nsPerOperation(0), allocationsPerOperation(0), peakBytes(0), messageBytes(0), copiedBytes(0), bytesPerOperation(0), latency(0)
+{}
+
+BenchmarkStringHandler::BenchmarkStringHandler()
+: messages(0)
+{}
+
+void BenchmarkStringHandler::OutGateway(const String& data)
+{
+}
+
+void BenchmarkStringHandler::OnUnencryptedDataReceived(const String& data)
+{
+    this->messages += (data.length() > 0) ? 1 : 0;
+}
+
+BenchmarkSpanHandler::BenchmarkSpanHandler()
+: messages(0)
+{}
+
+void BenchmarkSpanHandler::OutGateway(const String& data)
+{
+}
+
+void BenchmarkSpanHandler::OnUnencryptedDataReceived(const ByteSpan& data)
+{
+    this->messages += (data.length > 0) ? 1 : 0;
+}
+
+BenchmarkStaticHandler::BenchmarkStaticHandler()
+: messages(0)
+{}
+
+TransportBenchmark::TransportBenchmark()
+: staticControl(this->staticHandler), delivered(0), callsCompleted(0), streamPosition(0), flowBase(0), flowPeak(0), statusSent(0), statusAnswered(false), statusLatency(0), statusAnswers(0), tlvLength(0), textLength(0)
+{
+    memset(this->aesKey, 0, sizeof(this->aesKey));
+    mbedtls_aes_init(&this->aes);
+
+    for(unsigned int i = 0; i < BENCHMARK_DISPATCH_COMMANDS; i++)
+    {
+        snprintf(this->dispatchNames[i], sizeof(this->dispatchNames[i]), "sensor-%u", i);
+        snprintf(this->dispatchPayloads[i], sizeof(this->dispatchPayloads[i]), "sensor-%u:%u", i, i * 7);
+    }
+}
+
+TransportBenchmark::~TransportBenchmark()
+{
+    mbedtls_aes_free(&this->aes);
+}
+
+bool TransportBenchmark::Begin(const BenchmarkConfig& _config)
+{
+    this->config = _config;
+
+    if(this->config.payloadSize == 0 || this->config.payloadSize > LOOPBACK_PAYLOAD_MAX)
+    {
+        this->config.payloadSize = 64;
+    }
+
+    this->payload = "";
+    for(unsigned int i = 0; i < this->config.payloadSize; i++)
+    {
+        this->payload += (char)('a' + (i % 26));
+    }
+
+    for(unsigned int i = 0; i < sizeof(this->aesKey); i++)
+    {
+        this->aesKey[i] = (unsigned char)(i * 7 + 1);
+    }
+
+    // encrypted frame for the encode and decode cases
+    unsigned char iv[16] = { 0 };
+    unsigned char block[LOOPBACK_PAYLOAD_MAX] = { 0 };
+    char encoded[BASE64_ENCODED_LENGTH(LOOPBACK_PAYLOAD_MAX) + 1] = { 0 };
+    size_t paddedLength = ((this->payload.length() + 15) / 16) * 16;
+
+    memcpy(block, this->payload.c_str(), this->payload.length());
+    base64Encode(iv, sizeof(iv), encoded);
+    this->encodedPackage.iv = encoded;
+
+    mbedtls_aes_setkey_enc(&this->aes, this->aesKey, 256);
+    mbedtls_aes_crypt_cbc(&this->aes, MBEDTLS_AES_ENCRYPT, paddedLength, iv, block, block);
+    base64Encode(block, paddedLength, encoded);
+
+    this->encodedPackage.data = encoded;
+    this->encodedPackage.mode = TransmissionMode::DATA;
+    this->encodedPackage.encryptionType = TransmissionEncryptionType::AES;
+    this->encodedPackage.dataFormat = TransmissionDataFormat::BASE64;
+    this->encodedPackage.transmissionID = 1;
+    this->encodedFrame = this->encodedPackage.ToTransmissionString();
+
+    // several plain frames in one receive buffer, as they arrive from a fast server, and the same frames with
+    // the sync framing and garbage in front of each of them
+    this->splitBuffer = "";
+    this->resyncBuffer = "";
+    for(unsigned int i = 0; i < BENCHMARK_SPLIT_FRAMES; i++)
+    {
+        TransmissionPackage package;
+        package.mode = TransmissionMode::DATA;
+        package.encryptionType = TransmissionEncryptionType::TET_NONE;
+        package.dataFormat = TransmissionDataFormat::PLAIN_TEXT;
+        package.data = this->payload;
+        package.iv = "";
+        package.transmissionID = i + 1;
+        this->splitBuffer += package.ToTransmissionString();
+        if(i == 0)
+        {
+            this->deliverFrame = package.ToTransmissionString();
+        }
+
+        for(unsigned int k = 0; k < BENCHMARK_RESYNC_NOISE; k++)
+        {
+            this->resyncBuffer += (char)('!' + ((i * 31 + k * 7) % 90));
+        }
+        appendSyncFrame(this->resyncBuffer, package.ToTransmissionString());
+    }
+    // payload of the frame-encrypt cases, they use its first 16 B to 4 KB
+    this->framePayload = "";
+    if(!this->framePayload.reserve(BENCHMARK_FRAME_PAYLOAD_MAX))
+    {
+        return false;
+    }
+    for(unsigned int i = 0; i < BENCHMARK_FRAME_PAYLOAD_MAX; i++)
+    {
+        this->framePayload += (char)('a' + (i % 26));
+    }
+    base64Encode((const unsigned char*)this->framePayload.c_str(), BENCHMARK_FRAME_PAYLOAD_MAX, base64Text);
+    // the messages of the telemetry decode cases
+    this->tlvLength = this->encodeTelemetryTLV(1, this->tlvMessage, sizeof(this->tlvMessage));
+    this->textLength = this->encodeTelemetryText(1, this->textMessage, sizeof(this->textMessage));
+
+    this->splitControl.SetInterface(this);
+    this->resyncControl.SetInterface(this);
+    this->resyncControl.SetFraming(TF_SYNC);
+    this->stringControl.SetInterface(&this->stringHandler);
+    this->stringControl.SetDuplicateFilter(false);
+    this->spanControl.SetInterface(&this->spanHandler);
+    this->spanControl.SetDuplicateFilter(false);
+    this->staticControl.SetDuplicateFilter(false);
+
+    this->control.SetDeviceName("benchmark");
+    this->control.SetInterface(&this->server);
+    this->server.SetController(&this->control);
+    this->server.SetInterface(this);
+    if(!this->rpc.Begin(&this->control))
+    {
+        return false;
+    }
+
+    for(unsigned int i = 0; i < BC_CASE_COUNT; i++)
+    {
+        this->results[i] = BenchmarkResult();
+        this->results[i].name = caseName((BenchmarkCase)i);
+    }
+
+    return this->server.Begin(BENCHMARK_RSA_BITS);
+}
+
+void TransportBenchmark::Run()
+{
+    for(unsigned int i = 0; i < BC_CASE_COUNT; i++)
+    {
+        this->measure((BenchmarkCase)i);
+    }
+}
+
+const BenchmarkResult& TransportBenchmark::GetResult(BenchmarkCase benchmarkCase) const
+{
+    return this->results[(benchmarkCase < BC_CASE_COUNT) ? benchmarkCase : 0];
+}
+
+void TransportBenchmark::PrintJson(Print& output) const
+{
+    // a result with 64 bit counters on the host
+    char buffer[192] = { 0 };
+
+#ifdef ESP32
+    const char* platform = "esp32";
+#else
+    const char* platform = "host";
+#endif
+
+    snprintf(buffer, sizeof(buffer), "{\"suite\":\"%s\",\"version\":%d,\"platform\":\"%s\",\"profile\":\"%s\",\"payload\":%u,\"results\":[",
+        BENCHMARK_SUITE_NAME, BENCHMARK_FORMAT_VERSION, platform, transmissionProfile.name, this->config.payloadSize);
+    output.print(buffer);
+
+    bool first = true;
+    for(unsigned int i = 0; i < BC_CASE_COUNT; i++)
+    {
+        const BenchmarkResult& result = this->results[i];
+        if(result.iterations == 0)
+        {
+            // not run on this platform
+            continue;
+        }
+
+        snprintf(buffer, sizeof(buffer), "%s{\"name\":\"%s\",\"iterations\":%lu,\"ns_per_op\":%lu,\"allocs_per_op\":%lu.%02lu",
+            first ? "" : ",", result.name, result.iterations, result.nsPerOperation,
+            result.allocationsPerOperation / 100, result.allocationsPerOperation % 100);
+        output.print(buffer);
+        if(result.peakBytes > 0)
+        {
+            snprintf(buffer, sizeof(buffer), ",\"peak_bytes\":%lu", (unsigned long)result.peakBytes);
+            output.print(buffer);
+        }
+        if(result.messageBytes > 0)
+        {
+            snprintf(buffer, sizeof(buffer), ",\"message_bytes\":%u", result.messageBytes);
+            output.print(buffer);
+        }
+        if(result.copiedBytes > 0)
+        {
+            snprintf(buffer, sizeof(buffer), ",\"copied_bytes\":%u", result.copiedBytes);
+            output.print(buffer);
+        }
+        if(result.bytesPerOperation > 0 && result.nsPerOperation > 0)
+        {
+            snprintf(buffer, sizeof(buffer), ",\"mb_per_s\":%lu",
+                (unsigned long)(((uint64_t)result.bytesPerOperation * 1000ULL) / result.nsPerOperation));
+            output.print(buffer);
+        }
+        if(result.latency > 0)
+        {
+            snprintf(buffer, sizeof(buffer), ",\"latency_us\":%lu", result.latency);
+            output.print(buffer);
+        }
+        output.print("}");
+        first = false;
+    }
+    output.println("]}");
+}
+
+void TransportBenchmark::OutGateway(const String& data)
+{
+    // the frames of the split case (confirmations) are dropped
+}
+
+void TransportBenchmark::OnDataDecoded(const ByteSpan& data)
+{
+    // the server side receiver of the control-under-bulk case
+    if(!this->statusAnswered && data.StartsWith(STATUS_REQUEST_RESPONSE))
+    {
+        this->statusLatency += micros() - this->statusSent;
+        this->statusAnswers++;
+        this->statusAnswered = true;
+    }
+    this->delivered++;
+}
+
+void TransportBenchmark::OnUnencryptedDataReceived(const ByteSpan& data)
+{
+    this->delivered++;
+}
+
+void TransportBenchmark::OnCallComplete(uint16_t callID, RpcStatus status, const CommandSpan& result)
+{
+    if(status == RS_OK)
+    {
+        this->callsCompleted++;
+    }
+}
+
+unsigned int TransportBenchmark::Read(unsigned char* buffer, unsigned int size)
+{
+    for(unsigned int i = 0; i < size; i++)
+    {
+        buffer[i] = (unsigned char)(this->streamPosition + i);
+    }
+    this->streamPosition += size;
+    return size;
+}
+
+void TransportBenchmark::OnStreamComplete(uint16_t streamID, bool success)
+{
+    if(success)
+    {
+        this->delivered += this->streamPosition;
+    }
+}
+
+void TransportBenchmark::OnCommand(uint32_t commandID, const CommandArguments& arguments)
+{
+    this->delivered += arguments.GetCount();
+}
+
+void TransportBenchmark::measure(BenchmarkCase benchmarkCase)
+{
+    BenchmarkResult& result = this->results[benchmarkCase];
+    MemorySnapshot before;
+    MemorySnapshot after;
+    unsigned long minimumIterations = this->config.minimumIterations;
+
+    if(streamLength(benchmarkCase) > BENCHMARK_STREAM_MAX)
+    {
+        return;
+    }
+
+    this->prepareCase(benchmarkCase);
+
+    if(streamLength(benchmarkCase) > 0)
+    {
+        // a stream takes long and keeps nothing allocated, it runs once without the untimed run
+        minimumIterations = 1;
+    }
+    else
+    {
+        // one untimed run, the first call fills caches and allocates buffers which are kept
+        this->runCase(benchmarkCase, 1);
+    }
+
+    unsigned long batch = 1;
+    unsigned long iterations = 0;
+    unsigned long elapsed = 0;
+
+    MemoryMonitor::GetSnapshot(before);
+    auto start = micros();
+
+    while(elapsed < (this->config.minimumTime * 1000UL) || iterations < minimumIterations)
+    {
+        this->runCase(benchmarkCase, batch);
+        iterations += batch;
+        elapsed = micros() - start;
+
+        if(batch < BENCHMARK_MAX_BATCH && elapsed < (this->config.minimumTime * 100UL))
+        {
+            batch *= 2;
+        }
+    }
+
+    MemoryMonitor::GetSnapshot(after);
+    this->finishCase(benchmarkCase);
+
+    result.iterations = iterations;
+    result.elapsed = elapsed;
+    result.nsPerOperation = (unsigned long)(((uint64_t)elapsed * 1000ULL) / iterations);
+    result.allocationsPerOperation = (unsigned long)(((uint64_t)(after.allocations - before.allocations) * 100ULL) / iterations);
+    result.peakBytes = this->flowPeak - this->flowBase;
+    if(benchmarkCase == BC_TLV_ENCODE)
+    {
+        result.messageBytes = this->tlvLength;
+    }
+    else if(benchmarkCase == BC_TEXT_ENCODE)
+    {
+        result.messageBytes = this->textLength;
+    }
+    else if(framePayloadLength(benchmarkCase) > 0)
+    {
+        TransmissionPackage package;
+        this->control.encryptIntoFrame((const unsigned char*)this->framePayload.c_str(), framePayloadLength(benchmarkCase), package);
+        result.messageBytes = package.frame.length();
+        // the frame is written once, only a tail of the payload below a whole chunk is copied into the padding buffer
+        result.copiedBytes = package.frame.length() + (framePayloadLength(benchmarkCase) % TRANSMISSION_ENCRYPT_CHUNK_SIZE);
+    }
+    else if(benchmarkCase == BC_BASE64_ENCODE || benchmarkCase == BC_BASE64_DECODE)
+    {
+        result.bytesPerOperation = BENCHMARK_FRAME_PAYLOAD_MAX;
+    }
+    else if(benchmarkCase == BC_CONTROL_UNDER_BULK && this->statusAnswers > 0)
+    {
+        result.latency = this->statusLatency / this->statusAnswers;
+    }
+    this->flowBase = 0;
+    this->flowPeak = 0;
+}
+
+void TransportBenchmark::prepareCase(BenchmarkCase benchmarkCase)
+{
+    switch(benchmarkCase)
+    {
+    case BC_FRAME_SPLIT:
+        this->splitControl.OnClientConnected();
+        break;
+    case BC_FRAME_RESYNC:
+        this->resyncControl.OnClientConnected();
+        break;
+    case BC_DELIVER_STRING:
+        this->stringControl.OnClientConnected();
+        break;
+    case BC_DELIVER_VIRTUAL:
+        this->spanControl.OnClientConnected();
+        break;
+    case BC_DELIVER_STATIC:
+        this->staticControl.OnClientConnected();
+        break;
+    case BC_ROUND_TRIP:
+        this->server.Handshake();
+        break;
+    case BC_RPC_CALLS_1:
+    case BC_RPC_CALLS_8:
+    case BC_RPC_CALLS_64:
+        this->server.SetCallEcho(true);
+        this->server.Handshake();
+        break;
+    case BC_STREAM_64K:
+    case BC_STREAM_1M:
+    case BC_STREAM_16M:
+        this->server.Handshake();
+        break;
+    case BC_FLOW_100X:
+        {
+            MemorySnapshot snapshot;
+            this->server.Handshake();
+            // the window of the peer is closed until the first tick
+            this->server.SendCredit(0, 0);
+            this->server.Pump();
+            MemoryMonitor::GetSnapshot(snapshot);
+            this->flowBase = snapshot.trackedBytes;
+            this->flowPeak = snapshot.trackedBytes;
+        }
+        break;
+    case BC_DISPATCH_2:
+    case BC_DISPATCH_20:
+    case BC_DISPATCH_200:
+        for(unsigned int i = 0; i < dispatchCommands(benchmarkCase); i++)
+        {
+            this->dispatchRouter.Register(this->dispatchNames[i], this);
+        }
+        break;
+    case BC_CONTROL_UNDER_BULK:
+        this->server.SetReceiver(this);
+        this->server.Handshake();
+        break;
+    default:
+        break;
+    }
+}
+
+void TransportBenchmark::finishCase(BenchmarkCase benchmarkCase)
+{
+    switch(benchmarkCase)
+    {
+    case BC_FRAME_SPLIT:
+        this->splitControl.OnClientDisconnected();
+        break;
+    case BC_FRAME_RESYNC:
+        this->resyncControl.OnClientDisconnected();
+        break;
+    case BC_DELIVER_STRING:
+        this->stringControl.OnClientDisconnected();
+        break;
+    case BC_DELIVER_VIRTUAL:
+        this->spanControl.OnClientDisconnected();
+        break;
+    case BC_DELIVER_STATIC:
+        this->staticControl.OnClientDisconnected();
+        break;
+    case BC_ROUND_TRIP:
+        this->server.EndSession();
+        break;
+    case BC_RPC_CALLS_1:
+    case BC_RPC_CALLS_8:
+    case BC_RPC_CALLS_64:
+        this->server.EndSession();
+        this->rpc.OnClientDisconnected();
+        this->server.SetCallEcho(false);
+        break;
+    case BC_STREAM_64K:
+    case BC_STREAM_1M:
+    case BC_STREAM_16M:
+    case BC_FLOW_100X:
+        this->server.EndSession();
+        break;
+    case BC_DISPATCH_2:
+    case BC_DISPATCH_20:
+    case BC_DISPATCH_200:
+        for(unsigned int i = 0; i < dispatchCommands(benchmarkCase); i++)
+        {
+            this->dispatchRouter.Unregister(this->dispatchNames[i]);
+        }
+        break;
+    case BC_CONTROL_UNDER_BULK:
+        this->server.EndSession();
+        this->server.SetReceiver(nullptr);
+        break;
+    default:
+        break;
+    }
+}
+
+void TransportBenchmark::runCase(BenchmarkCase benchmarkCase, unsigned long iterations)
+{
+    unsigned char iv[16] = { 0 };
+    unsigned char block[LOOPBACK_PAYLOAD_MAX] = { 0 };
+    char encoded[BASE64_ENCODED_LENGTH(LOOPBACK_PAYLOAD_MAX) + 1] = { 0 };
+    size_t paddedLength = ((this->payload.length() + 15) / 16) * 16;
+    size_t length = 0;
+
+    if(callConcurrency(benchmarkCase) > 0)
+    {
+        // the calls of a run are outstanding together, not one per iteration
+        this->runCalls(callConcurrency(benchmarkCase), iterations);
+        return;
+    }
+
+    for(unsigned long i = 0; i < iterations; i++)
+    {
+        switch(benchmarkCase)
+        {
+        case BC_PACKAGE_ENCODE:
+            {
+                TransmissionPackage package;
+                package.mode = this->encodedPackage.mode;
+                package.encryptionType = this->encodedPackage.encryptionType;
+                package.dataFormat = this->encodedPackage.dataFormat;
+                package.iv = this->encodedPackage.iv;
+                package.data = this->encodedPackage.data;
+                package.transmissionID = i & TRANSMISSION_ID_MASK;
+                this->delivered += package.ToTransmissionString().length();
+            }
+            break;
+        case BC_PACKAGE_DECODE:
+            {
+                TransmissionPackage package;
+                package.FromTransmissionString(this->encodedFrame);
+                this->delivered += package.data.length();
+            }
+            break;
+        case BC_FRAME_SPLIT:
+            this->splitControl.OnDataReceived(this->splitBuffer);
+            // new session, otherwise the frames are dropped as duplicates from the second run on
+            this->splitControl.OnClientDisconnected();
+            this->splitControl.OnClientConnected();
+            break;
+        case BC_FRAME_RESYNC:
+            this->resyncControl.OnDataReceived(this->resyncBuffer);
+            this->resyncControl.OnClientDisconnected();
+            this->resyncControl.OnClientConnected();
+            break;
+        case BC_DELIVER_STRING:
+            this->stringControl.OnDataReceived(this->deliverFrame);
+            break;
+        case BC_DELIVER_VIRTUAL:
+            this->spanControl.OnDataReceived(this->deliverFrame);
+            break;
+        case BC_DELIVER_STATIC:
+            this->staticControl.OnDataReceived(this->deliverFrame);
+            break;
+        case BC_COLLECTION:
+            for(unsigned int k = 0; k < BENCHMARK_COLLECTION_ITEMS; k++)
+            {
+                this->collection.AddItem(this->encodedPackage);
+            }
+            while(this->collection.GetCount() > 0)
+            {
+                this->collection.RemoveAt(0);
+            }
+            break;
+        case BC_AES_ENCRYPT:
+            memcpy(block, this->payload.c_str(), this->payload.length());
+            memset(iv, 0, sizeof(iv));
+            mbedtls_aes_setkey_enc(&this->aes, this->aesKey, 256);
+            mbedtls_aes_crypt_cbc(&this->aes, MBEDTLS_AES_ENCRYPT, paddedLength, iv, block, block);
+            this->delivered += base64Encode(block, paddedLength, encoded);
+            break;
+        case BC_AES_DECRYPT:
+            memset(iv, 0, sizeof(iv));
+            base64Decode(this->encodedPackage.data.c_str(), this->encodedPackage.data.length(), block, sizeof(block), length);
+            // the same key setup as TransmissionControl::decryptReceivedDataWithAESCbc
+            mbedtls_aes_setkey_dec(&this->aes, this->aesKey, 256);
+            mbedtls_aes_crypt_cbc(&this->aes, MBEDTLS_AES_DECRYPT, length, iv, block, block);
+            this->delivered += length;
+            break;
+        case BC_HANDSHAKE:
+            this->server.Handshake();
+            this->server.EndSession();
+            break;
+        case BC_ROUND_TRIP:
+            this->server.SendData(this->payload);
+            this->control.SendData(this->payload, true);
+            this->server.Pump();
+            break;
+        case BC_STREAM_64K:
+        case BC_STREAM_1M:
+        case BC_STREAM_16M:
+            this->runStream(streamLength(benchmarkCase));
+            break;
+        case BC_FLOW_100X:
+            this->runFlow();
+            break;
+        case BC_CONTROL_UNDER_BULK:
+            this->runControlUnderBulk();
+            break;
+        case BC_TRACE_RECORD:
+            TRACE_ERROR(TE_NONE, i, this->delivered);
+            this->delivered++;
+            break;
+        case BC_TRACE_RECORD_DEBUG:
+            TRACE_DEBUG(TE_NONE, i, this->delivered);
+            this->delivered++;
+            break;
+        case BC_DISPATCH_2:
+        case BC_DISPATCH_20:
+        case BC_DISPATCH_200:
+            {
+                const char* command = this->dispatchPayloads[i % dispatchCommands(benchmarkCase)];
+                this->dispatchRouter.Dispatch(command, strlen(command));
+            }
+            break;
+        case BC_TLV_ENCODE:
+            this->delivered += this->encodeTelemetryTLV(i, block, sizeof(block));
+            break;
+        case BC_TLV_DECODE:
+            this->decodeTelemetryTLV();
+            break;
+        case BC_TEXT_ENCODE:
+            this->delivered += this->encodeTelemetryText(i, encoded, sizeof(encoded));
+            break;
+        case BC_TEXT_DECODE:
+            this->decodeTelemetryText();
+            break;
+        case BC_FRAME_ENCRYPT_16:
+        case BC_FRAME_ENCRYPT_256:
+        case BC_FRAME_ENCRYPT_1K:
+        case BC_FRAME_ENCRYPT_4K:
+            {
+                // the same package as TransmissionControl::sendEncrypted
+                TransmissionPackage package;
+                package.dataFormat = TransmissionDataFormat::BASE64;
+                package.encryptionType = TransmissionEncryptionType::AES;
+                package.mode = TransmissionMode::DATA;
+                package.transmissionID = i & TRANSMISSION_ID_MASK;
+                this->control.encryptIntoFrame((const unsigned char*)this->framePayload.c_str(), framePayloadLength(benchmarkCase), package);
+                this->delivered += package.frame.length();
+            }
+            break;
+        case BC_BASE64_ENCODE:
+            this->delivered += base64Encode((const unsigned char*)this->framePayload.c_str(), BENCHMARK_FRAME_PAYLOAD_MAX, base64Text);
+            break;
+        case BC_BASE64_DECODE:
+            base64Decode(base64Text, sizeof(base64Text), base64Data, sizeof(base64Data), length);
+            this->delivered += length;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void TransportBenchmark::runCalls(unsigned int concurrency, unsigned long calls)
+{
+    unsigned long started = 0;
+    unsigned long completed = 0;
+
+    if(concurrency > RPC_CALL_CAPACITY)
+    {
+        concurrency = RPC_CALL_CAPACITY;
+    }
+    this->callsCompleted = 0;
+
+    while(this->callsCompleted < calls)
+    {
+        // refill the outstanding calls, the calls of a round are sent in as few packages as possible
+        while(started < calls && this->rpc.GetPendingCount() < concurrency)
+        {
+            if(this->rpc.Call(BENCHMARK_RPC_METHOD, this->payload, this) == 0)
+            {
+                break;
+            }
+            started++;
+        }
+        this->rpc.Flush();
+        this->server.Pump();
+
+        if(this->callsCompleted == completed)
+        {
+            // no progress, the result shows the missing calls as a slower case
+            break;
+        }
+        completed = this->callsCompleted;
+    }
+}
+
+void TransportBenchmark::runStream(uint32_t length)
+{
+    this->streamPosition = 0;
+    if(this->control.SendStream(this, length) == 0)
+    {
+        return;
+    }
+
+    uint32_t position = 0;
+    while(this->control.IsStreamActive())
+    {
+        this->server.Pump();
+
+        if(this->streamPosition == position && this->control.IsStreamActive())
+        {
+            // no progress, the stream is left to the next session
+            break;
+        }
+        position = this->streamPosition;
+    }
+}
+
+void TransportBenchmark::runFlow()
+{
+    MemorySnapshot snapshot;
+
+    // the rejected messages are dropped by the application
+    for(unsigned int i = 0; i < BENCHMARK_FLOW_OFFERED; i++)
+    {
+        this->control.SendData(this->payload, true);
+    }
+
+    // the peer takes one package per tick
+    this->server.SendCredit(TRANSMISSION_RECEIVE_WINDOW_BYTES, 1);
+    this->server.Pump();
+
+    MemoryMonitor::GetSnapshot(snapshot);
+    if(snapshot.trackedBytes > this->flowPeak)
+    {
+        this->flowPeak = snapshot.trackedBytes;
+    }
+}
+
+void TransportBenchmark::runControlUnderBulk()
+{
+    if(!this->control.IsStreamActive())
+    {
+        this->streamPosition = 0;
+        this->control.SendStream(this, BENCHMARK_BULK_STREAM);
+    }
+    for(unsigned int i = 0; i < BENCHMARK_BULK_MESSAGES; i++)
+    {
+        this->control.SendData(this->payload, true);
+    }
+
+    this->statusAnswered = false;
+    this->statusSent = micros();
+    this->server.SendData("rq:status");
+
+    // the queues are drained, the stream is continued in the next operation
+    this->server.Pump();
+}
+
+unsigned int TransportBenchmark::encodeTelemetryTLV(unsigned long index, unsigned char* buffer, unsigned int size)
+{
+    TLVWriter writer(buffer, size);
+    writer.WriteUInt(TELEMETRY_TAG_SENSOR, index & 0xFF);
+    writer.WriteFloat(TELEMETRY_TAG_TEMPERATURE, 20.0f + (float)(index % 100) / 10.0f);
+    writer.WriteFloat(TELEMETRY_TAG_HUMIDITY, 41.25f);
+    writer.WriteInt(TELEMETRY_TAG_RSSI, -67);
+    writer.WriteString(TELEMETRY_TAG_STATUS, "active");
+
+    return writer.Finish() ? writer.GetLength() : 0;
+}
+
+unsigned int TransportBenchmark::encodeTelemetryText(unsigned long index, char* buffer, unsigned int size)
+{
+    int length = snprintf(buffer, size, "%s:%lu:%.2f:%.2f:%d:%s", BENCHMARK_TELEMETRY_COMMAND, index & 0xFF,
+        20.0 + (double)(index % 100) / 10.0, 41.25, -67, "active");
+
+    return (length > 0 && (unsigned int)length < size) ? (unsigned int)length : 0;
+}
+
+void TransportBenchmark::decodeTelemetryTLV()
+{
+    TLVReader reader = TLVReader::FromMessage(this->tlvMessage, this->tlvLength);
+    unsigned int length = 0;
+    float value = 0;
+
+    while(reader.Next())
+    {
+        switch(reader.GetTag())
+        {
+        case TELEMETRY_TAG_SENSOR:
+            this->delivered += reader.GetUInt();
+            break;
+        case TELEMETRY_TAG_TEMPERATURE:
+        case TELEMETRY_TAG_HUMIDITY:
+            value += reader.GetFloat();
+            break;
+        case TELEMETRY_TAG_RSSI:
+            this->delivered += reader.GetInt();
+            break;
+        case TELEMETRY_TAG_STATUS:
+            reader.GetBytes(length);
+            this->delivered += length;
+            break;
+        default:
+            break;
+        }
+    }
+    this->delivered += (unsigned long)value;
+}
+
+void TransportBenchmark::decodeTelemetryText()
+{
+    // the arguments behind the command, as a registered handler gets them from the router
+    const unsigned int offset = sizeof(BENCHMARK_TELEMETRY_COMMAND);
+    CommandArguments arguments(this->textMessage + offset, this->textLength - offset);
+
+    // the numbers end at the delimiter, strtod reads them in place
+    this->delivered += arguments.GetAt(0).ToInt();
+    float value = (float)strtod(arguments.GetAt(1).data, nullptr);
+    value += (float)strtod(arguments.GetAt(2).data, nullptr);
+    this->delivered += arguments.GetAt(3).ToInt();
+    this->delivered += arguments.GetAt(4).length;
+    this->delivered += (unsigned long)value;
+}
+
+unsigned int TransportBenchmark::callConcurrency(BenchmarkCase benchmarkCase)
+{
+    switch(benchmarkCase)
+    {
+    case BC_RPC_CALLS_1:
+        return 1;
+    case BC_RPC_CALLS_8:
+        return 8;
+    case BC_RPC_CALLS_64:
+        return 64;
+    default:
+        return 0;
+    }
+}
+
+uint32_t TransportBenchmark::streamLength(BenchmarkCase benchmarkCase)
+{
+    switch(benchmarkCase)
+    {
+    case BC_STREAM_64K:
+        return 64UL * 1024UL;
+    case BC_STREAM_1M:
+        return 1024UL * 1024UL;
+    case BC_STREAM_16M:
+        return 16UL * 1024UL * 1024UL;
+    default:
+        return 0;
+    }
+}
+
+unsigned int TransportBenchmark::dispatchCommands(BenchmarkCase benchmarkCase)
+{
+    switch(benchmarkCase)
+    {
+    case BC_DISPATCH_2:
+        return 2;
+    case BC_DISPATCH_20:
+        return 20;
+    case BC_DISPATCH_200:
+        return BENCHMARK_DISPATCH_COMMANDS;
+    default:
+        return 0;
+    }
+}
+
+unsigned int TransportBenchmark::framePayloadLength(BenchmarkCase benchmarkCase)
+{
+    switch(benchmarkCase)
+    {
+    case BC_FRAME_ENCRYPT_16:
+        return 16;
+    case BC_FRAME_ENCRYPT_256:
+        return 256;
+    case BC_FRAME_ENCRYPT_1K:
+        return 1024;
+    case BC_FRAME_ENCRYPT_4K:
+        return BENCHMARK_FRAME_PAYLOAD_MAX;
+    default:
+        return 0;
+    }
+}
+
+const char* TransportBenchmark::caseName(BenchmarkCase benchmarkCase)
+{
+    switch(benchmarkCase)
+    {
+    case BC_PACKAGE_ENCODE:
+        return "package-encode";
+    case BC_PACKAGE_DECODE:
+        return "package-decode";
+    case BC_FRAME_SPLIT:
+        return "frame-split";
+    case BC_FRAME_RESYNC:
+        return "frame-resync";
+    case BC_COLLECTION:
+        return "collection-add-remove";
+    case BC_AES_ENCRYPT:
+        return "aes-encrypt-base64";
+    case BC_AES_DECRYPT:
+        return "base64-aes-decrypt";
+    case BC_HANDSHAKE:
+        return "rsa-handshake";
+    case BC_ROUND_TRIP:
+        return "loopback-round-trip";
+    case BC_RPC_CALLS_1:
+        return "rpc-calls-c1";
+    case BC_RPC_CALLS_8:
+        return "rpc-calls-c8";
+    case BC_RPC_CALLS_64:
+        return "rpc-calls-c64";
+    case BC_STREAM_64K:
+        return "stream-64k";
+    case BC_STREAM_1M:
+        return "stream-1m";
+    case BC_STREAM_16M:
+        return "stream-16m";
+    case BC_FLOW_100X:
+        return "flow-100x";
+    case BC_TRACE_RECORD:
+        return "trace-record";
+    case BC_TRACE_RECORD_DEBUG:
+        return "trace-record-debug";
+    case BC_DISPATCH_2:
+        return "command-dispatch-2";
+    case BC_DISPATCH_20:
+        return "command-dispatch-20";
+    case BC_DISPATCH_200:
+        return "command-dispatch-200";
+    case BC_TLV_ENCODE:
+        return "telemetry-tlv-encode";
+    case BC_TLV_DECODE:
+        return "telemetry-tlv-decode";
+    case BC_TEXT_ENCODE:
+        return "telemetry-text-encode";
+    case BC_TEXT_DECODE:
+        return "telemetry-text-decode";
+    case BC_FRAME_ENCRYPT_16:
+        return "frame-encrypt-16";
+    case BC_FRAME_ENCRYPT_256:
+        return "frame-encrypt-256";
+    case BC_FRAME_ENCRYPT_1K:
+        return "frame-encrypt-1k";
+    case BC_FRAME_ENCRYPT_4K:
+        return "frame-encrypt-4k";
+    case BC_BASE64_ENCODE:
+        return "base64-encode-4k";
+    case BC_BASE64_DECODE:
+        return "base64-decode-4k";
+    case BC_CONTROL_UNDER_BULK:
+        return "control-under-bulk";
+    case BC_DELIVER_STRING:
+        return "deliver-string";
+    case BC_DELIVER_VIRTUAL:
+        return "deliver-virtual";
+    case BC_DELIVER_STATIC:
+        return "deliver-static";
+    default:
+        return "unknown";
+    }
+}
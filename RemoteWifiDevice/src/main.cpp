@@ -3,6 +3,35 @@
 #include <ESPmDNS.h>
 
 #include "TransmissionControl.h"
+#include "RpcEndpoint.h"
+#include "ServiceDiscovery.h"
+#include "ConnectionManager.h"
+#include "BootState.h"
+
+#ifdef LINK_SIMULATION
+#include "LinkSimulator.h"
+#endif
+
+#ifdef LOAD_GENERATOR
+#include "LoadGenerator.h"
+#endif
+
+#ifdef MEMORY_SOAK
+#include "MemorySoak.h"
+#endif
+
+#ifdef BENCHMARK
+#include "TransportBenchmark.h"
+#endif
+
+#ifdef FIRMWARE_UPDATE
+#include "FirmwareUpdate.h"
+#endif
+
+#ifdef OUTBOUND_STORE
+#include <LittleFS.h>
+#include "OutboundStore.h"
+#endif
 
 #define HBUTTON_1 18
 #define LED_RED 4
@@ -10,18 +39,52 @@
 
 char ssid[] = "<enter network name here>";          // network SSID (name)
 char pass[] = "<enter network password here";       // network password
+char deviceName[] = "esp32-AnotherDevice";
+
+// time to join the access point of the boot state before the regular join (with a scan) is started
+#define FAST_BOOT_WIFI_TIMEOUT 3000
+
+// access point and server of the last boot, so a wake up does not wait for a scan and a discovery answer
+RtcBootStateStore bootStateStore;
+BootState bootState;
 
 // Initialize the client library
 WiFiClient client;
 
-// timer params
-long mTimer = 0;
-long mTimeOut = 2000;
-
 // control params
-bool mdns_query_success = false;
 unsigned int dataOutputCounter = 0;
 
+// servers of the '_mydevices._tcp' service, browsed in the background
+MdnsServiceResolver serviceResolver;
+ServiceDiscovery discovery;
+
+// reconnects with backoff and closes connections to dead peers
+WiFiClientTransport clientTransport(client);
+ConnectionManager connectionManager;
+
+#ifdef FIRMWARE_UPDATE
+static_assert(transmissionProfile.payloadMax >= FIRMWARE_BEGIN_COMMAND_MAX, "the 'ota:begin' command must fit into a package");
+
+// public key of the firmware signatures: only images signed with the private key are accepted. Create the key pair
+// with 'openssl genrsa -out firmware.key 2048' and 'openssl rsa -in firmware.key -pubout', sign an image with
+// 'openssl dgst -sha256 -sign firmware.key firmware.bin | base64 -w0' and keep the private key off the device
+const char firmwarePublicKey[] =
+    "-----BEGIN PUBLIC KEY-----\n"
+    "<enter the public key here>\n"
+    "-----END PUBLIC KEY-----\n";
+
+// firmware update over the encrypted connection, the new image is written to the next ota partition
+PartitionFirmwareStorage firmwareStorage;
+FirmwareUpdate firmwareUpdate;
+long restartTimer = 0;
+long restartDelay = 1000;   // time to deliver the 'ota:done' response
+#endif
+
+#ifdef OUTBOUND_STORE
+// messages which are sent while the server is not reachable are kept in flash (stdio path on the mounted littlefs)
+FileOutboundStore outboundStore("/littlefs/outbound.log", OUTBOUND_STORE);
+#endif
+
 // TransmissionController event handler class
 class TransmissionControllerEventHandler : public ITransmissionControlInterface
 {
@@ -32,21 +95,225 @@ public:
             client.println(data);
         }
     }
-    void OnDataDecoded(const String& data) override
+    void OnDataDecoded(const ByteSpan& data) override
     {
+        // printed from the receive buffer, no copy needed
         Serial.print("Received data decoded: ");
-        Serial.println(data);
+        Serial.write(data.data, data.length);
+        Serial.println();
     }
-    void OnUnencryptedDataReceived(const String& data) override
+    void OnUnencryptedDataReceived(const ByteSpan& data) override
     {
         Serial.print("Received unencrypted data: ");
-        Serial.println(data);
+        Serial.write(data.data, data.length);
+        Serial.println();
+    }
+#ifdef FIRMWARE_UPDATE
+    void OnStreamData(uint16_t streamID, uint32_t offset, const unsigned char* data, unsigned int length, uint32_t totalLength, bool last) override
+    {
+        firmwareUpdate.OnStreamData(streamID, offset, data, length, totalLength, last);
+    }
+    void OnStreamAborted(uint16_t streamID) override
+    {
+        firmwareUpdate.OnStreamAborted(streamID);
     }
+#endif
 };
 
+TransmissionControllerEventHandler transmissionEvents;
+
+// calls of the server with call IDs, several queries can be outstanding at the same time
+RpcEndpoint rpcEndpoint;
+
 // Global TransmissionController instance
 TransmissionControl* transmissionController = nullptr;
 
+// rpc methods of the device
+class RpcMethodHandler : public ICommandHandler
+{
+public:
+    void OnCommand(uint32_t commandID, const CommandArguments& arguments) override
+    {
+        auto callID = rpcEndpoint.GetCurrentCallID();
+        String result;
+
+        switch(commandID)
+        {
+        case COMMAND_ID("get-name"):
+            result = deviceName;
+            break;
+        case COMMAND_ID("get-metrics"):
+            result = transmissionController->GetMetrics().ToSnapshotString();
+            break;
+        case COMMAND_ID("get-link"):
+            result = transmissionController->GetLinkEstimate().ToSnapshotString();
+            break;
+        case COMMAND_ID("get-memory"):
+            result = MemoryMonitor::ToSnapshotString();
+            break;
+        default:
+            rpcEndpoint.Respond(callID, RS_UNKNOWN_METHOD, "");
+            return;
+        }
+
+        // the result can be larger than a batch of the profile
+        if(!rpcEndpoint.Respond(callID, RS_OK, result))
+        {
+            rpcEndpoint.Respond(callID, RS_FAILED, "");
+        }
+    }
+};
+
+RpcMethodHandler rpcMethods;
+
+// ConnectionManager event handler class
+class ConnectionEventHandler : public IConnectionListener
+{
+public:
+    void OnConnected(const DiscoveredServer& server) override
+    {
+        Serial.print("Client connection SUCCEEDED! Host: ");
+        Serial.println(server.hostname);
+        digitalWrite(LED_GREEN, HIGH);
+
+        bootState.SetServer((uint32_t)server.address, server.port, server.hostname);
+        bootStateStore.Save(bootState);
+    }
+    void OnDisconnected() override
+    {
+        Serial.println("Client connection lost!");
+        digitalWrite(LED_GREEN, LOW);
+#ifdef FIRMWARE_UPDATE
+        firmwareUpdate.OnClientDisconnected();
+#endif
+        rpcEndpoint.OnClientDisconnected();
+    }
+};
+
+ConnectionEventHandler connectionEvents;
+
+#ifdef LINK_SIMULATION
+// Lossy link between the controller and the tcp client (fault injection for the retransmission logic)
+LinkSimulator linkSimulator(LINK_SIMULATION_SEED);
+#endif
+
+#ifdef LOAD_GENERATOR
+// Emulates several remote devices against the discovered server
+LoadGenerator loadGenerator;
+
+bool loadGeneratorStarted = false;
+
+void startLoadGenerator(const DiscoveredServer& server)
+{
+    LoadGeneratorConfig config;
+    config.sessionCount = LOAD_GENERATOR_SESSIONS;
+    config.messageInterval = LOAD_GENERATOR_INTERVAL;
+    config.payloadSize = LOAD_GENERATOR_PAYLOAD_SIZE;
+    config.churnPermille = LOAD_GENERATOR_CHURN;
+
+    Serial.print("Starting load generator against host: ");
+    Serial.println(server.hostname);
+    loadGenerator.Begin(server.address, server.port, config);
+    loadGeneratorStarted = true;
+    digitalWrite(LED_GREEN, HIGH);
+}
+#endif
+
+#ifdef MEMORY_SOAK
+// runs the configured number of sessions against the simulated server, then stops (no network required)
+void runMemorySoak()
+{
+    MemorySoak soak;
+    MemorySoakConfig config;
+    config.cycles = MEMORY_SOAK;
+
+    Serial.println("Starting memory soak..");
+    if(!soak.Begin(config))
+    {
+        Serial.println("Error: memory soak could not be started!");
+        return;
+    }
+
+    while(soak.RunCycle())
+    {
+        if((soak.GetResult().cycles % 1000) == 0)
+        {
+            Serial.println(MemoryMonitor::ToSnapshotString());
+            // let the idle task run
+            delay(1);
+        }
+    }
+    soak.PrintResult(Serial);
+    Serial.println(MemoryMonitor::ToSnapshotString());
+
+    digitalWrite(soak.GetResult().passed ? LED_GREEN : LED_RED, HIGH);
+    while(true)
+    {
+        delay(1000);
+    }
+}
+#endif
+
+#ifdef BENCHMARK
+// measures the transport layer against the loopback server and prints the results as json (no network required)
+void runBenchmark()
+{
+    TransportBenchmark benchmark;
+    BenchmarkConfig config;
+    config.payloadSize = BENCHMARK;
+
+    Serial.println("Starting benchmark..");
+    if(!benchmark.Begin(config))
+    {
+        Serial.println("Error: benchmark could not be started!");
+        return;
+    }
+    benchmark.Run();
+    benchmark.PrintJson(Serial);
+
+    digitalWrite(LED_GREEN, HIGH);
+    while(true)
+    {
+        delay(1000);
+    }
+}
+#endif
+
+// prints a few recorded transmission events per call so the serial output does not stall the loop, as text
+// lines or with -DTRANSMISSION_TRACE_RAW as raw dump lines for tools/trace_decode.py
+void printTraceEvents()
+{
+#ifdef TRANSMISSION_TRACE_RAW
+    TransmissionTrace::Dump(Serial, 4);
+#else
+    TransmissionTrace::Drain(Serial, 4);
+#endif
+}
+
+bool joinWifiWithBootState()
+{
+    if(!bootState.HasWifi())
+    {
+        return false;
+    }
+
+    // no scan: join the known access point on its channel
+    WiFi.begin(ssid, pass, bootState.wifiChannel, bootState.wifiBssid);
+
+    auto start = millis();
+    while(WiFi.status() != WL_CONNECTED)
+    {
+        if(millis() > (start + FAST_BOOT_WIFI_TIMEOUT))
+        {
+            Serial.println("Access point of the boot state not available!");
+            WiFi.disconnect();
+            return false;
+        }
+        delay(10);
+    }
+    return true;
+}
+
 void setup() {
 
     pinMode(HBUTTON_1, INPUT);
@@ -57,16 +324,34 @@ void setup() {
     digitalWrite(LED_GREEN, LOW);
 
     Serial.begin(115200);
+
+    MemoryMonitor::WatchTask("loop", nullptr);
+
+#ifdef MEMORY_SOAK
+    runMemorySoak();
+#endif
+#ifdef BENCHMARK
+    runBenchmark();
+#endif
+
     Serial.print("Attempting to connect to Network...");
 
-    WiFi.begin(ssid, pass);
+    bootStateStore.Load(bootState);
 
-    while ( WiFi.status() != WL_CONNECTED) {
-        Serial.print(".");
-        digitalWrite(LED_RED, digitalRead(LED_RED) == LOW ? HIGH : LOW);
-        delay(400);
+    if(!joinWifiWithBootState())
+    {
+        WiFi.begin(ssid, pass);
+
+        while ( WiFi.status() != WL_CONNECTED) {
+            Serial.print(".");
+            digitalWrite(LED_RED, digitalRead(LED_RED) == LOW ? HIGH : LOW);
+            delay(400);
+        }
     }
 
+    bootState.SetWifi(WiFi.channel(), WiFi.BSSID());
+    bootStateStore.Save(bootState);
+
     Serial.println("Wifi connection established!");
     Serial.print("Local IP Address: ");
     Serial.println(WiFi.localIP());
@@ -76,111 +361,141 @@ void setup() {
     transmissionController = new TransmissionControl();
     if(transmissionController != nullptr)
     {
-        transmissionController->SetInterface(
-            dynamic_cast<ITransmissionControlInterface*>(new TransmissionControllerEventHandler()
-        ));
-        transmissionController->SetDeviceName("esp32-AnotherDevice");
+        transmissionController->SetInterface(&transmissionEvents);
+        transmissionController->SetDeviceName(deviceName);
+
+#ifdef FIRMWARE_UPDATE
+        if(!firmwareUpdate.Begin(transmissionController, &firmwareStorage, firmwarePublicKey))
+        {
+            Serial.println("Error: firmware update not available (invalid public key or commands not registered)!");
+        }
+#endif
+
+        if(!rpcEndpoint.Begin(transmissionController)
+            || !rpcEndpoint.RegisterMethod("get-name", &rpcMethods)
+            || !rpcEndpoint.RegisterMethod("get-metrics", &rpcMethods)
+            || !rpcEndpoint.RegisterMethod("get-link", &rpcMethods)
+            || !rpcEndpoint.RegisterMethod("get-memory", &rpcMethods))
+        {
+            Serial.println("Error: rpc not available (command or methods not registered)!");
+        }
+
+#ifdef OUTBOUND_STORE
+        if(!LittleFS.begin(true) || !outboundStore.Begin())
+        {
+            Serial.println("Error: outbound store not available!");
+        }
+        else
+        {
+            Serial.print("Stored outbound messages: ");
+            Serial.println(outboundStore.GetCount());
+            transmissionController->SetOutboundStore(&outboundStore);
+        }
+#endif
+
+#ifdef LINK_SIMULATION
+        LinkImpairments impairments;
+        impairments.lossPermille = LINK_SIMULATION_LOSS;
+        impairments.duplicatePermille = 10;
+        impairments.reorderPermille = 10;
+        impairments.latency = 20;
+        impairments.jitter = 30;
+
+        linkSimulator.SetController(transmissionController);
+        linkSimulator.SetInterface(&transmissionEvents);
+        linkSimulator.SetOutgoingImpairments(impairments);
+        linkSimulator.SetIncomingImpairments(impairments);
+
+        transmissionController->SetInterface(&linkSimulator);
+#endif
     }
 
     if(mdns_init() != ESP_OK){
         Serial.println("Error: mdns initialization error!");
     }
     else {
-        auto numServices =
-            MDNS.queryService("_mydevices", "_tcp");
-
-        if(numServices == 0){
-            Serial.println("Warning: No mdns services were found.");
-        }
-        else {
-            mdns_query_success = true;
-
-            Serial.print("Number of services found:  ");
-            Serial.println(numServices);
-
-            for(unsigned int i = 0; i < numServices; i++){
-                Serial.print("Information of Service with index: ");
-                Serial.println(i);
-                Serial.print("Hostname: ");
-                Serial.println(MDNS.hostname(i));
-                Serial.print("IP Address: ");
-                Serial.println(MDNS.IP(i));
-                Serial.print("Port: ");
-                Serial.println(MDNS.port(i));
-            }
-            Serial.print("\r\n");
-            Serial.println("Trying to connect to host with index 0..");
-
-            if(!client.connect(MDNS.IP(0), MDNS.port(0))){
-                Serial.println("Client connection FAILED!");
-            } else {
-                Serial.println("Client connection SUCCEEDED!");
-                digitalWrite(LED_GREEN, HIGH);
-            }
+        // the first query is started in the loop, the connection is made as soon as a server answers
+        discovery.Begin(&serviceResolver, "_mydevices", "_tcp", deviceName);
+    }
+
+    connectionManager.Begin(&clientTransport, transmissionController, &discovery, esp_random());
+    connectionManager.SetListener(&connectionEvents);
+
+    if(bootState.HasServer())
+    {
+        // try the last server first, the discovery finds the others if it does not answer
+        ResolvedService lastServer;
+        lastServer.hostname = bootState.serverHostname;
+        lastServer.address = IPAddress(bootState.serverAddress);
+        lastServer.port = bootState.serverPort;
+        discovery.AddServer(lastServer);
+
+        // a wake up from deep sleep is not synchronized with other devices, no need for the jitter
+        if(bootStateStore.IsWarmStart())
+        {
+            connectionManager.ConnectNow();
         }
     }
-    mTimer = millis();
 }
 
 void loop() {
 
+    discovery.OnLoop();
+
+#ifdef LOAD_GENERATOR
+    if(loadGeneratorStarted)
+    {
+        loadGenerator.OnLoop();
+    }
+    else
+    {
+        // wait for the server to be discovered, then start the sessions
+        DiscoveredServer server;
+        if(discovery.SelectServer(server))
+        {
+            startLoadGenerator(server);
+        }
+    }
+    printTraceEvents();
+    return;
+#endif
+
     if(transmissionController != nullptr)
     {
         transmissionController->OnLoop();
+        rpcEndpoint.OnLoop();
     }
 
-    if(millis() > (unsigned long)(mTimeOut + mTimer)) {
-        mTimer = millis();
+#ifdef FIRMWARE_UPDATE
+    firmwareUpdate.OnLoop();
 
-        if(client.connected())
+    if(firmwareUpdate.IsRestartPending())
+    {
+        if(restartTimer == 0)
         {
-            if(transmissionController != nullptr)
-            {
-                transmissionController->OnClientConnected();
-            }
+            Serial.println("Firmware update complete - restarting..");
+            restartTimer = millis();
         }
-        else
+        else if(millis() > (unsigned long)(restartTimer + restartDelay))
         {
-            if(transmissionController != nullptr)
-            {
-                transmissionController->OnClientDisconnected();
-            }
-
-            // check if there is a service provided by the server
-            if(mdns_query_success == false)
-            {
-                Serial.println("No successful MDNS query - trying again");
-
-                auto numServices =
-                    MDNS.queryService("_mydevices", "_tcp");
-
-                if(numServices != 0){
-                    mdns_query_success = true;
-                }
-            }
-            else
-            {
-                digitalWrite(LED_GREEN, LOW);
-                
-                // try to connect to the server
-                if(!client.connect(MDNS.IP(0), MDNS.port(0)))
-                {
-                    Serial.println("Client connection FAILED!");
-                }
-                else
-                {
-                    Serial.println("Client connection SUCCEEDED!");
-                    digitalWrite(LED_GREEN, HIGH);
-                }
-            }
+            ESP.restart();
         }
     }
+#endif
+
+#ifdef LINK_SIMULATION
+    linkSimulator.OnLoop();
+#endif
+
+    connectionManager.OnLoop();
 
     if(client.available()){
 
         String data;
+        data.reserve(transmissionProfile.receiveWindowBytes);
 
-        while(1){   // read data from client
+        // read at most the advertised receive window, the rest stays in the socket until the next loop
+        for(unsigned int i = 0; i < transmissionProfile.receiveWindowBytes; i++){
             auto c = client.read();
             if(c == -1){
                 break;
@@ -195,7 +510,11 @@ void loop() {
 
         if(transmissionController != nullptr)
         {
+#ifdef LINK_SIMULATION
+            linkSimulator.Receive(data);
+#else
             transmissionController->OnDataReceived(data);
+#endif
         }
     }
 
@@ -207,7 +526,11 @@ void loop() {
 
         if(transmissionController != nullptr)
         {
-            if(dataOutputCounter == 0)
+            if(transmissionController->IsThrottled())
+            {
+                Serial.println("Transmission queue is full - message not sent");
+            }
+            else if(dataOutputCounter == 0)
             {
                 transmissionController->SendData("This is a message from the remote device to the dns-sd server. This message was sent with end to end encryption.", true);
                 dataOutputCounter++;
@@ -228,4 +551,7 @@ void loop() {
 
         delay(20);
     }
+
+    // print recorded transmission events outside of the transmission handling
+    printTraceEvents();
 }
@@ -0,0 +1,210 @@
+#include <unity.h>
+#include "Base64.h"
+#include "mbedtls/base64.h"
+
+#define TEST_DATA_MAX 300
+#define TEST_ALPHABET "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"
+
+static unsigned char data[TEST_DATA_MAX];
+
+static void fillData(size_t length, unsigned int seed)
+{
+    uint32_t value = seed;
+    for(size_t i = 0; i < length; i++)
+    {
+        value = (value * 1103515245u) + 12345u;
+        data[i] = (unsigned char)(value >> 16);
+    }
+}
+
+// decodes the text with the strict decoder, returns false if it is rejected
+static bool decode(const char* text, unsigned char* output, size_t outputSize, size_t& outLen)
+{
+    return base64Decode(text, strlen(text), output, outputSize, outLen);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_rfc4648_vectors()
+{
+    const char* plain[] = { "f", "fo", "foo", "foob", "fooba", "foobar" };
+    const char* encoded[] = { "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy" };
+
+    for(unsigned int i = 0; i < 6; i++)
+    {
+        char text[16] = { 0 };
+        unsigned char decoded[16] = { 0 };
+        size_t length = strlen(plain[i]);
+        size_t decodedLength = 0;
+
+        TEST_ASSERT_EQUAL_UINT(strlen(encoded[i]), base64Encode((const unsigned char*)plain[i], length, text));
+        TEST_ASSERT_EQUAL_STRING(encoded[i], text);
+        TEST_ASSERT_EQUAL_UINT(length, base64DecodedLength(encoded[i], strlen(encoded[i])));
+
+        TEST_ASSERT_TRUE(decode(encoded[i], decoded, sizeof(decoded), decodedLength));
+        TEST_ASSERT_EQUAL_UINT(length, decodedLength);
+        TEST_ASSERT_EQUAL_MEMORY(plain[i], decoded, length);
+    }
+}
+
+void test_round_trip_against_mbedtls()
+{
+    char text[BASE64_ENCODED_LENGTH(TEST_DATA_MAX) + 1];
+    unsigned char reference[BASE64_ENCODED_LENGTH(TEST_DATA_MAX) + 1];
+    unsigned char decoded[TEST_DATA_MAX];
+
+    for(size_t length = 1; length <= TEST_DATA_MAX; length++)
+    {
+        size_t referenceLength = 0;
+        size_t decodedLength = 0;
+        fillData(length, (unsigned int)length);
+
+        // the same characters as the encoder of mbedtls (which the server side mirrors)
+        size_t textLength = base64Encode(data, length, text);
+        TEST_ASSERT_EQUAL_INT(0, mbedtls_base64_encode(reference, sizeof(reference), &referenceLength, data, length));
+        TEST_ASSERT_EQUAL_UINT(referenceLength, textLength);
+        TEST_ASSERT_EQUAL_UINT(base64EncodedLength(length), textLength);
+        TEST_ASSERT_EQUAL_MEMORY(reference, text, textLength);
+
+        // the output of mbedtls is accepted by the strict decoder
+        TEST_ASSERT_TRUE(base64Decode((const char*)reference, referenceLength, decoded, sizeof(decoded), decodedLength));
+        TEST_ASSERT_EQUAL_UINT(length, decodedLength);
+        TEST_ASSERT_EQUAL_MEMORY(data, decoded, length);
+
+        // and mbedtls decodes the output of the encoder
+        TEST_ASSERT_EQUAL_INT(0, mbedtls_base64_decode(decoded, sizeof(decoded), &decodedLength, (const unsigned char*)text, textLength));
+        TEST_ASSERT_EQUAL_UINT(length, decodedLength);
+        TEST_ASSERT_EQUAL_MEMORY(data, decoded, length);
+    }
+}
+
+void test_strict_decoding_rejects_invalid_input()
+{
+    unsigned char decoded[16];
+    size_t decodedLength = 0;
+
+    // the length is not a multiple of 4 (empty input included)
+    TEST_ASSERT_FALSE(decode("", decoded, sizeof(decoded), decodedLength));
+    TEST_ASSERT_FALSE(decode("Zm9", decoded, sizeof(decoded), decodedLength));
+    TEST_ASSERT_FALSE(decode("Zm9vY", decoded, sizeof(decoded), decodedLength));
+
+    // characters outside of the alphabet, line breaks and spaces (mbedtls skips these)
+    TEST_ASSERT_FALSE(decode("Zm9v!mFy", decoded, sizeof(decoded), decodedLength));
+    TEST_ASSERT_FALSE(decode("Zm9v\nYmF", decoded, sizeof(decoded), decodedLength));
+    TEST_ASSERT_FALSE(decode("Zm9v Ym=", decoded, sizeof(decoded), decodedLength));
+    TEST_ASSERT_FALSE(decode("Zm9-", decoded, sizeof(decoded), decodedLength));
+
+    // padding before the end or in the wrong position
+    TEST_ASSERT_FALSE(decode("Zg==Zm9v", decoded, sizeof(decoded), decodedLength));
+    TEST_ASSERT_FALSE(decode("Zg=v", decoded, sizeof(decoded), decodedLength));
+    TEST_ASSERT_FALSE(decode("Z===", decoded, sizeof(decoded), decodedLength));
+    TEST_ASSERT_FALSE(decode("====", decoded, sizeof(decoded), decodedLength));
+
+    // unused bits of the last character are not zero ("Zg==" and "Zm8=" are the canonical forms)
+    TEST_ASSERT_FALSE(decode("Zh==", decoded, sizeof(decoded), decodedLength));
+    TEST_ASSERT_FALSE(decode("Zm9=", decoded, sizeof(decoded), decodedLength));
+
+    // every rejection reports no output
+    TEST_ASSERT_EQUAL_UINT(0, decodedLength);
+}
+
+void test_every_character_in_a_long_input()
+{
+    char text[BASE64_ENCODED_LENGTH(96)];
+    unsigned char decoded[96];
+    size_t decodedLength = 0;
+
+    // the vector loops of the host decode the complete groups in front of the last one
+    fillData(sizeof(decoded), 11);
+    size_t textLength = base64Encode(data, sizeof(decoded), text);
+
+    for(size_t position = 0; position < textLength - 4; position++)
+    {
+        char original = text[position];
+        for(unsigned int character = 0; character < 256; character++)
+        {
+            text[position] = (char)character;
+            bool inAlphabet = character != 0 && strchr(TEST_ALPHABET, character) != nullptr;
+
+            TEST_ASSERT_EQUAL(inAlphabet, base64Decode(text, textLength, decoded, sizeof(decoded), decodedLength));
+            if(character == (unsigned char)original)
+            {
+                TEST_ASSERT_EQUAL_MEMORY(data, decoded, sizeof(decoded));
+            }
+        }
+        text[position] = original;
+    }
+}
+
+void test_padding_after_a_long_input()
+{
+    char text[BASE64_ENCODED_LENGTH(98)];
+    unsigned char decoded[99];
+    size_t decodedLength = 0;
+
+    // one and two bytes in the last group after the vector loops
+    for(size_t length = 97; length <= 98; length++)
+    {
+        fillData(length, (unsigned int)length);
+        size_t textLength = base64Encode(data, length, text);
+
+        // the output is exactly as long as the data, the byte after it stays untouched
+        decoded[length] = 0xA5;
+        TEST_ASSERT_TRUE(base64Decode(text, textLength, decoded, length, decodedLength));
+        TEST_ASSERT_EQUAL_UINT(length, decodedLength);
+        TEST_ASSERT_EQUAL_MEMORY(data, decoded, length);
+        TEST_ASSERT_EQUAL_UINT(0xA5, decoded[length]);
+
+        // the lowest of the unused bits of the last character is set
+        size_t last = textLength - ((length == 97) ? 3 : 2);
+        size_t value = strchr(TEST_ALPHABET, text[last]) - TEST_ALPHABET;
+        text[last] = TEST_ALPHABET[value ^ 1];
+        TEST_ASSERT_FALSE(base64Decode(text, textLength, decoded, length, decodedLength));
+    }
+}
+
+void test_output_size_is_checked()
+{
+    unsigned char decoded[6];
+    size_t decodedLength = 0;
+
+    TEST_ASSERT_FALSE(decode("Zm9vYmFy", decoded, 5, decodedLength));
+    TEST_ASSERT_EQUAL_UINT(0, decodedLength);
+
+    // exactly the decoded length, the padding is taken into account
+    TEST_ASSERT_TRUE(decode("Zm9vYmFy", decoded, 6, decodedLength));
+    TEST_ASSERT_TRUE(decode("Zm9vYg==", decoded, 4, decodedLength));
+    TEST_ASSERT_EQUAL_UINT(4, decodedLength);
+}
+
+void test_in_place_decoding()
+{
+    char buffer[BASE64_ENCODED_LENGTH(TEST_DATA_MAX)];
+    size_t decodedLength = 0;
+
+    fillData(TEST_DATA_MAX, 7);
+    size_t textLength = base64Encode(data, TEST_DATA_MAX, buffer);
+
+    TEST_ASSERT_TRUE(base64Decode(buffer, textLength, (unsigned char*)buffer, sizeof(buffer), decodedLength));
+    TEST_ASSERT_EQUAL_UINT(TEST_DATA_MAX, decodedLength);
+    TEST_ASSERT_EQUAL_MEMORY(data, buffer, TEST_DATA_MAX);
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_rfc4648_vectors);
+    RUN_TEST(test_round_trip_against_mbedtls);
+    RUN_TEST(test_strict_decoding_rejects_invalid_input);
+    RUN_TEST(test_every_character_in_a_long_input);
+    RUN_TEST(test_padding_after_a_long_input);
+    RUN_TEST(test_output_size_is_checked);
+    RUN_TEST(test_in_place_decoding);
+    return UNITY_END();
+}
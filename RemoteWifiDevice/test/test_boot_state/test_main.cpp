@@ -0,0 +1,139 @@
+#include <unity.h>
+#include "BootState.h"
+#include "Checksum.h"
+
+#define TEST_PATH "test_boot_state.bin"
+// magic, state and crc-32 (see BootState.cpp)
+#define TEST_RECORD_SIZE (4 + sizeof(BootState) + 4)
+
+static const uint8_t testBssid[6] = { 0x02, 0x11, 0x22, 0x33, 0x44, 0x55 };
+
+static BootState testState()
+{
+    BootState state;
+    state.SetWifi(11, testBssid);
+    state.SetServer(0x0A01A8C0, 4000, "server");
+    return state;
+}
+
+static bool readRecord(unsigned char* record)
+{
+    auto file = fopen(TEST_PATH, "rb");
+    if(file == nullptr)
+    {
+        return false;
+    }
+    bool complete = (fread(record, 1, TEST_RECORD_SIZE, file) == TEST_RECORD_SIZE);
+    fclose(file);
+    return complete;
+}
+
+static void writeRecord(const unsigned char* record, size_t length)
+{
+    auto file = fopen(TEST_PATH, "wb");
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_EQUAL_UINT(length, fwrite(record, 1, length, file));
+    fclose(file);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+    remove(TEST_PATH);
+}
+
+void test_state_is_loaded_again()
+{
+    FileBootStateStore store(TEST_PATH);
+    BootState state;
+    TEST_ASSERT_FALSE(store.Load(state));
+
+    TEST_ASSERT_TRUE(store.Save(testState()));
+    TEST_ASSERT_TRUE(store.Load(state));
+    TEST_ASSERT_TRUE(state == testState());
+    TEST_ASSERT_TRUE(state.HasServer());
+    TEST_ASSERT_TRUE(state.HasWifi());
+
+    store.Clear();
+    TEST_ASSERT_FALSE(store.Load(state));
+}
+
+void test_damaged_record_is_rejected()
+{
+    FileBootStateStore store(TEST_PATH);
+    TEST_ASSERT_TRUE(store.Save(testState()));
+
+    unsigned char record[TEST_RECORD_SIZE];
+    TEST_ASSERT_TRUE(readRecord(record));
+
+    // every single bit error is found by the crc
+    for(size_t i = 0; i < TEST_RECORD_SIZE; i++)
+    {
+        record[i] ^= 0x10;
+        writeRecord(record, sizeof(record));
+        record[i] ^= 0x10;
+
+        BootState state;
+        TEST_ASSERT_FALSE(store.Load(state));
+        TEST_ASSERT_FALSE(state.HasServer());
+    }
+
+    writeRecord(record, sizeof(record) - 1);
+    BootState state;
+    TEST_ASSERT_FALSE(store.Load(state));
+}
+
+void test_foreign_record_is_rejected()
+{
+    FileBootStateStore store(TEST_PATH);
+    TEST_ASSERT_TRUE(store.Save(testState()));
+
+    unsigned char record[TEST_RECORD_SIZE];
+    TEST_ASSERT_TRUE(readRecord(record));
+
+    // a firmware with another layout of the state, the crc is valid
+    uint32_t magic = 0;
+    memcpy(&magic, record, 4);
+    magic ^= (uint32_t)sizeof(BootState) ^ (uint32_t)(sizeof(BootState) + 4);
+    memcpy(record, &magic, 4);
+    uint32_t crc = crc32Update(0, record, 4 + sizeof(BootState));
+    memcpy(record + 4 + sizeof(BootState), &crc, 4);
+    writeRecord(record, sizeof(record));
+
+    BootState state;
+    TEST_ASSERT_FALSE(store.Load(state));
+}
+
+void test_hostname_is_terminated()
+{
+    FileBootStateStore store(TEST_PATH);
+    TEST_ASSERT_TRUE(store.Save(testState()));
+
+    unsigned char record[TEST_RECORD_SIZE];
+    TEST_ASSERT_TRUE(readRecord(record));
+
+    // a valid record of a state without the terminator
+    BootState unterminated = testState();
+    memset(unterminated.serverHostname, 'a', sizeof(unterminated.serverHostname));
+    memcpy(record + 4, &unterminated, sizeof(BootState));
+    uint32_t crc = crc32Update(0, record, 4 + sizeof(BootState));
+    memcpy(record + 4 + sizeof(BootState), &crc, 4);
+    writeRecord(record, sizeof(record));
+
+    BootState state;
+    TEST_ASSERT_TRUE(store.Load(state));
+    TEST_ASSERT_EQUAL_UINT(BOOT_STATE_HOSTNAME_SIZE - 1, strlen(state.serverHostname));
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_state_is_loaded_again);
+    RUN_TEST(test_damaged_record_is_rejected);
+    RUN_TEST(test_foreign_record_is_rejected);
+    RUN_TEST(test_hostname_is_terminated);
+    return UNITY_END();
+}
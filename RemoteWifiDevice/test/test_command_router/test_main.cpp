@@ -0,0 +1,160 @@
+#include <unity.h>
+#include "CommandRouter.h"
+
+#define TEST_COMMAND_COUNT (COMMAND_ROUTER_CAPACITY / 2)
+
+// remembers the last dispatched command
+class RecordingHandler : public ICommandHandler
+{
+public:
+    uint32_t commandID;
+    String raw;
+    unsigned int argumentCount;
+    unsigned int calls;
+
+    RecordingHandler()
+    : commandID(0), argumentCount(0), calls(0)
+    {}
+
+    void OnCommand(uint32_t _commandID, const CommandArguments& arguments) override
+    {
+        this->commandID = _commandID;
+        this->raw = arguments.GetRaw().ToString();
+        this->argumentCount = arguments.GetCount();
+        this->calls++;
+    }
+};
+
+static char commandNames[TEST_COMMAND_COUNT][8];
+
+static bool dispatch(const CommandDispatcher& router, const char* payload)
+{
+    return router.Dispatch(payload, strlen(payload));
+}
+
+void setUp()
+{
+    for(unsigned int i = 0; i < TEST_COMMAND_COUNT; i++)
+    {
+        snprintf(commandNames[i], sizeof(commandNames[i]), "c%u", i);
+    }
+}
+
+void tearDown()
+{
+}
+
+void test_delimiter_matching()
+{
+    CommandRouter router;
+    RecordingHandler handler;
+
+    TEST_ASSERT_TRUE(router.Register("rq:status", &handler));
+
+    TEST_ASSERT_TRUE(dispatch(router, "rq:status"));
+    TEST_ASSERT_EQUAL_UINT32(COMMAND_ID("rq:status"), handler.commandID);
+    TEST_ASSERT_EQUAL_UINT(0, handler.raw.length());
+
+    // a command ends at a delimiter, a longer word is a different command
+    TEST_ASSERT_FALSE(dispatch(router, "rq:statusx"));
+    TEST_ASSERT_FALSE(dispatch(router, "rq:stat"));
+
+    TEST_ASSERT_TRUE(dispatch(router, "rq:status:a:b"));
+    TEST_ASSERT_EQUAL_STRING("a:b", handler.raw.c_str());
+    TEST_ASSERT_EQUAL_UINT(2, handler.argumentCount);
+    TEST_ASSERT_EQUAL_UINT(2, handler.calls);
+}
+
+void test_longest_match_wins()
+{
+    CommandRouter router;
+    RecordingHandler shortHandler;
+    RecordingHandler longHandler;
+
+    TEST_ASSERT_TRUE(router.Register("ota", &shortHandler));
+    TEST_ASSERT_TRUE(router.Register("ota:begin", &longHandler));
+
+    TEST_ASSERT_TRUE(dispatch(router, "ota:begin:100"));
+    TEST_ASSERT_EQUAL_UINT(1, longHandler.calls);
+    TEST_ASSERT_EQUAL_STRING("100", longHandler.raw.c_str());
+
+    TEST_ASSERT_TRUE(dispatch(router, "ota:abort"));
+    TEST_ASSERT_EQUAL_UINT(1, shortHandler.calls);
+    TEST_ASSERT_EQUAL_STRING("abort", shortHandler.raw.c_str());
+}
+
+void test_register_limits()
+{
+    CommandRouter router;
+    RecordingHandler handler;
+
+    TEST_ASSERT_FALSE(router.Register(nullptr, &handler));
+    TEST_ASSERT_FALSE(router.Register("x", nullptr));
+
+    for(unsigned int i = 0; i < TEST_COMMAND_COUNT; i++)
+    {
+        TEST_ASSERT_TRUE(router.Register(commandNames[i], &handler));
+    }
+    // duplicates and more than half of the capacity are rejected
+    TEST_ASSERT_FALSE(router.Register("c0", &handler));
+    TEST_ASSERT_FALSE(router.Register("full", &handler));
+    TEST_ASSERT_EQUAL_UINT(TEST_COMMAND_COUNT, router.GetCount());
+}
+
+void test_unregister_keeps_probe_sequences()
+{
+    CommandRouter router;
+    RecordingHandler handler;
+
+    for(unsigned int i = 0; i < TEST_COMMAND_COUNT; i++)
+    {
+        TEST_ASSERT_TRUE(router.Register(commandNames[i], &handler));
+    }
+
+    // at half load the table has collisions, every remaining entry must stay reachable after each removal
+    for(unsigned int removed = 0; removed < TEST_COMMAND_COUNT; removed++)
+    {
+        router.Unregister(commandNames[removed]);
+        TEST_ASSERT_EQUAL_UINT(TEST_COMMAND_COUNT - removed - 1, router.GetCount());
+        TEST_ASSERT_FALSE(dispatch(router, commandNames[removed]));
+
+        for(unsigned int i = removed + 1; i < TEST_COMMAND_COUNT; i++)
+        {
+            TEST_ASSERT_TRUE_MESSAGE(dispatch(router, commandNames[i]), commandNames[i]);
+        }
+    }
+
+    // the freed slots can be used again
+    TEST_ASSERT_TRUE(router.Register("c0", &handler));
+    TEST_ASSERT_TRUE(dispatch(router, "c0"));
+}
+
+void test_router_with_a_larger_capacity()
+{
+    BasicCommandRouter<512> router;
+    RecordingHandler handler;
+    static char names[256][12];
+
+    TEST_ASSERT_EQUAL_UINT(512, router.GetCapacity());
+    for(unsigned int i = 0; i < 256; i++)
+    {
+        snprintf(names[i], sizeof(names[i]), "sensor-%u", i);
+        TEST_ASSERT_TRUE(router.Register(names[i], &handler));
+    }
+    TEST_ASSERT_FALSE(router.Register("full", &handler));
+
+    TEST_ASSERT_TRUE(dispatch(router, "sensor-200:1"));
+    TEST_ASSERT_EQUAL_UINT32(COMMAND_ID("sensor-200"), handler.commandID);
+    TEST_ASSERT_EQUAL_STRING("1", handler.raw.c_str());
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_delimiter_matching);
+    RUN_TEST(test_longest_match_wins);
+    RUN_TEST(test_register_limits);
+    RUN_TEST(test_unregister_keeps_probe_sequences);
+    RUN_TEST(test_router_with_a_larger_capacity);
+    return UNITY_END();
+}
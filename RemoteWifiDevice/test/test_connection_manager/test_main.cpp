@@ -0,0 +1,271 @@
+#include <unity.h>
+#include "ConnectionManager.h"
+
+#define TEST_PORT 4000
+#define TEST_FLEET 200
+#define TEST_BUCKETS 10
+#define TEST_KEEPALIVE_INTERVAL 30
+#define TEST_DEAD_PEER_TIMEOUT 100
+
+// socket of the connection manager, the server accepts or refuses every connection
+class FakeTransport : public IConnectionTransport
+{
+public:
+    bool accept;
+    bool connected;
+    unsigned int connectCalls;
+    unsigned int disconnects;
+
+    FakeTransport()
+    : accept(false), connected(false), connectCalls(0), disconnects(0)
+    {}
+
+    bool Connect(const IPAddress& address, uint16_t port) override
+    {
+        this->connectCalls++;
+        this->connected = this->accept;
+        return this->connected;
+    }
+
+    bool IsConnected() override
+    {
+        return this->connected;
+    }
+
+    void Disconnect() override
+    {
+        this->connected = false;
+        this->disconnects++;
+    }
+};
+
+// counts the frames of a controller without a server
+class FrameCounter : public ITransmissionControlInterface
+{
+public:
+    unsigned int frames;
+
+    FrameCounter()
+    : frames(0)
+    {}
+
+    void OutGateway(const String& data) override
+    {
+        this->frames++;
+    }
+};
+
+static void addTestServer(ServiceDiscovery& discovery)
+{
+    ResolvedService service;
+    service.hostname = "server";
+    service.address = IPAddress(192, 168, 1, 10);
+    service.port = TEST_PORT;
+    discovery.AddServer(service);
+}
+
+static unsigned long backoffBound(unsigned int failedAttempts)
+{
+    unsigned long backoff = CONNECTION_BACKOFF_BASE;
+    for(unsigned int i = 0; i < failedAttempts && backoff < CONNECTION_BACKOFF_CAP; i++)
+    {
+        backoff *= 2;
+    }
+    return (backoff > CONNECTION_BACKOFF_CAP) ? CONNECTION_BACKOFF_CAP : backoff;
+}
+
+// the frame of a credit, the peer is alive
+static String creditFrame()
+{
+    TransmissionPackage package;
+    package.mode = TransmissionMode::CREDIT;
+    package.encryptionType = TransmissionEncryptionType::TET_NONE;
+    package.dataFormat = TransmissionDataFormat::PLAIN_TEXT;
+    package.data = "100000:100";
+    package.iv = "";
+    package.transmissionID = 0;
+    return package.ToTransmissionString();
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_first_attempts_of_a_fleet_are_spread()
+{
+    unsigned int buckets[TEST_BUCKETS] = { 0 };
+    FakeTransport transport;
+
+    // a fleet which is powered up at the same time
+    for(unsigned int device = 0; device < TEST_FLEET; device++)
+    {
+        ConnectionManager manager;
+        manager.Begin(&transport, nullptr, nullptr, device + 1);
+
+        unsigned long wait = manager.GetNextAttempt() - millis();
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(CONNECTION_BACKOFF_BASE, wait);
+        buckets[(wait * TEST_BUCKETS) / (CONNECTION_BACKOFF_BASE + 1)]++;
+    }
+
+    // an even share is 20 devices per bucket, not all of them in the first
+    for(unsigned int i = 0; i < TEST_BUCKETS; i++)
+    {
+        TEST_ASSERT_GREATER_THAN_UINT(TEST_FLEET / TEST_BUCKETS / 3, buckets[i]);
+        TEST_ASSERT_LESS_THAN_UINT(TEST_FLEET / TEST_BUCKETS * 2, buckets[i]);
+    }
+}
+
+void test_backoff_doubles_up_to_the_cap()
+{
+    unsigned long longest[8] = { 0 };
+
+    for(unsigned int device = 0; device < TEST_FLEET; device++)
+    {
+        FakeTransport transport;
+        ServiceDiscovery discovery;
+        addTestServer(discovery);
+
+        ConnectionManager manager;
+        manager.Begin(&transport, nullptr, &discovery, device + 1);
+
+        // the server refuses, the attempts are not waited for
+        for(unsigned int attempt = 1; attempt <= 8; attempt++)
+        {
+            manager.ConnectNow();
+            manager.OnLoop();
+            TEST_ASSERT_EQUAL_UINT(attempt, transport.connectCalls);
+            TEST_ASSERT_EQUAL_UINT(attempt, manager.GetFailedAttempts());
+            TEST_ASSERT_TRUE(manager.GetState() == CS_WAITING);
+
+            unsigned long wait = manager.GetNextAttempt() - millis();
+            TEST_ASSERT_LESS_OR_EQUAL_UINT32(backoffBound(attempt), wait);
+            longest[attempt - 1] = (wait > longest[attempt - 1]) ? wait : longest[attempt - 1];
+        }
+    }
+
+    // full jitter: the longest delay of the fleet reaches the backoff of the attempt
+    for(unsigned int attempt = 1; attempt <= 8; attempt++)
+    {
+        TEST_ASSERT_GREATER_THAN_UINT32((backoffBound(attempt) * 9) / 10, longest[attempt - 1]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(CONNECTION_BACKOFF_CAP, backoffBound(8));
+}
+
+void test_connection_which_drops_at_once_is_a_failure()
+{
+    FakeTransport transport;
+    ServiceDiscovery discovery;
+    addTestServer(discovery);
+
+    TransmissionControl controller;
+    FrameCounter counter;
+    controller.SetInterface(&counter);
+
+    ConnectionManager manager;
+    manager.Begin(&transport, &controller, &discovery, 1);
+
+    transport.accept = true;
+    manager.ConnectNow();
+    manager.OnLoop();
+    TEST_ASSERT_TRUE(manager.GetState() == CS_CONNECTED);
+    TEST_ASSERT_EQUAL_UINT32(1, manager.GetConnects());
+    TEST_ASSERT_EQUAL_UINT(0, manager.GetFailedAttempts());
+
+    // the server accepts and closes, the next attempt backs off
+    transport.connected = false;
+    manager.OnLoop();
+    TEST_ASSERT_TRUE(manager.GetState() == CS_WAITING);
+    TEST_ASSERT_EQUAL_UINT(1, manager.GetFailedAttempts());
+    TEST_ASSERT_EQUAL_UINT(1, transport.disconnects);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(backoffBound(1), manager.GetNextAttempt() - millis());
+}
+
+void test_silent_peer_is_dead_after_the_timeout()
+{
+    FakeTransport transport;
+    ServiceDiscovery discovery;
+    addTestServer(discovery);
+
+    TransmissionControl controller;
+    FrameCounter counter;
+    controller.SetInterface(&counter);
+
+    ConnectionManager manager;
+    manager.Begin(&transport, &controller, &discovery, 1);
+    manager.SetKeepalive(TEST_KEEPALIVE_INTERVAL, TEST_DEAD_PEER_TIMEOUT);
+
+    transport.accept = true;
+    manager.ConnectNow();
+    manager.OnLoop();
+    TEST_ASSERT_TRUE(manager.GetState() == CS_CONNECTED);
+    unsigned int frames = counter.frames;
+
+    // the socket stays open, the peer sends nothing
+    auto start = millis();
+    while(manager.GetState() == CS_CONNECTED && (millis() - start) < TEST_DEAD_PEER_TIMEOUT * 3)
+    {
+        manager.OnLoop();
+        controller.OnLoop();
+        delay(1);
+    }
+    auto elapsed = millis() - start;
+
+    TEST_ASSERT_TRUE(manager.GetState() == CS_WAITING);
+    TEST_ASSERT_EQUAL_UINT32(1, manager.GetDeadPeers());
+    TEST_ASSERT_EQUAL_UINT(1, transport.disconnects);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(TEST_DEAD_PEER_TIMEOUT, elapsed);
+    TEST_ASSERT_LESS_THAN_UINT32(TEST_DEAD_PEER_TIMEOUT + 50, elapsed);
+    // the keepalives were sent before
+    TEST_ASSERT_GREATER_THAN_UINT(frames, counter.frames);
+}
+
+void test_received_data_keeps_the_peer_alive()
+{
+    FakeTransport transport;
+    ServiceDiscovery discovery;
+    addTestServer(discovery);
+
+    TransmissionControl controller;
+    FrameCounter counter;
+    controller.SetInterface(&counter);
+
+    ConnectionManager manager;
+    manager.Begin(&transport, &controller, &discovery, 1);
+    manager.SetKeepalive(TEST_KEEPALIVE_INTERVAL, TEST_DEAD_PEER_TIMEOUT);
+
+    transport.accept = true;
+    manager.ConnectNow();
+    manager.OnLoop();
+
+    auto start = millis();
+    auto lastFrame = start;
+    while((millis() - start) < TEST_DEAD_PEER_TIMEOUT * 3)
+    {
+        if((millis() - lastFrame) >= TEST_DEAD_PEER_TIMEOUT / 2)
+        {
+            lastFrame = millis();
+            controller.OnDataReceived(creditFrame());
+        }
+        manager.OnLoop();
+        delay(1);
+    }
+
+    TEST_ASSERT_TRUE(manager.GetState() == CS_CONNECTED);
+    TEST_ASSERT_EQUAL_UINT32(0, manager.GetDeadPeers());
+    TEST_ASSERT_EQUAL_UINT(0, transport.disconnects);
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_attempts_of_a_fleet_are_spread);
+    RUN_TEST(test_backoff_doubles_up_to_the_cap);
+    RUN_TEST(test_connection_which_drops_at_once_is_a_failure);
+    RUN_TEST(test_silent_peer_is_dead_after_the_timeout);
+    RUN_TEST(test_received_data_keeps_the_peer_alive);
+    return UNITY_END();
+}
@@ -0,0 +1,136 @@
+#include <unity.h>
+#include "DuplicateWindow.h"
+#include "TransmissionControl.h"
+
+// counts the plain text payloads which are delivered by the controller
+class DeliveryCounter : public ITransmissionControlInterface
+{
+public:
+    unsigned int deliveries;
+
+    DeliveryCounter()
+    : deliveries(0)
+    {}
+
+    void OutGateway(const String& data) override
+    {
+    }
+
+    void OnUnencryptedDataReceived(const ByteSpan& data) override
+    {
+        this->deliveries++;
+    }
+};
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_repeated_ids_are_duplicates()
+{
+    DuplicateWindow window;
+
+    TEST_ASSERT_FALSE(window.CheckAndMark(10));
+    TEST_ASSERT_TRUE(window.CheckAndMark(10));
+
+    // out of order within the window
+    TEST_ASSERT_FALSE(window.CheckAndMark(12));
+    TEST_ASSERT_FALSE(window.CheckAndMark(11));
+    TEST_ASSERT_TRUE(window.CheckAndMark(11));
+    TEST_ASSERT_TRUE(window.CheckAndMark(12));
+}
+
+void test_ids_behind_the_window_are_duplicates()
+{
+    DuplicateWindow window;
+
+    TEST_ASSERT_FALSE(window.CheckAndMark(100));
+    TEST_ASSERT_FALSE(window.CheckAndMark(100 + DUPLICATE_WINDOW_SIZE));
+
+    // the oldest position of the window can still be received, one further is too old to tell
+    TEST_ASSERT_FALSE(window.CheckAndMark(101));
+    TEST_ASSERT_TRUE(window.CheckAndMark(100));
+
+    // a jump over the whole window forgets every older ID
+    TEST_ASSERT_FALSE(window.CheckAndMark(1000));
+    TEST_ASSERT_FALSE(window.CheckAndMark(999));
+}
+
+void test_wrap_around_of_the_id()
+{
+    DuplicateWindow window;
+
+    for(unsigned int id = TRANSMISSION_ID_MASK - 10; id <= TRANSMISSION_ID_MASK; id++)
+    {
+        TEST_ASSERT_FALSE(window.CheckAndMark(id));
+    }
+    // 0 follows 0xFFFF, so it is newer and the IDs before the wrap stay in the window
+    TEST_ASSERT_FALSE(window.CheckAndMark(0));
+    TEST_ASSERT_FALSE(window.CheckAndMark(1));
+    TEST_ASSERT_TRUE(window.CheckAndMark(TRANSMISSION_ID_MASK));
+    TEST_ASSERT_TRUE(window.CheckAndMark(TRANSMISSION_ID_MASK - 10));
+    TEST_ASSERT_TRUE(window.CheckAndMark(0));
+
+    // IDs above 16 bits are compared like the 4 hex digits of the header
+    TEST_ASSERT_TRUE(window.CheckAndMark(0x10001));
+}
+
+void test_reset_forgets_the_ids()
+{
+    DuplicateWindow window;
+
+    TEST_ASSERT_FALSE(window.CheckAndMark(5));
+    window.Reset();
+    TEST_ASSERT_FALSE(window.CheckAndMark(5));
+    // the first ID after the reset starts the window anywhere
+    window.Reset();
+    TEST_ASSERT_FALSE(window.CheckAndMark(40000));
+    TEST_ASSERT_TRUE(window.CheckAndMark(40000));
+}
+
+void test_resent_package_is_delivered_once()
+{
+    TransmissionControl controller;
+    DeliveryCounter counter;
+    controller.SetInterface(&counter);
+    controller.OnClientConnected();
+
+    TransmissionPackage package;
+    package.mode = TransmissionMode::DATA;
+    package.encryptionType = TransmissionEncryptionType::TET_NONE;
+    package.dataFormat = TransmissionDataFormat::PLAIN_TEXT;
+    package.data = "hello";
+    package.iv = "";
+    package.transmissionID = TRANSMISSION_ID_MASK;
+
+    String frame = package.ToTransmissionString();
+    controller.OnDataReceived(frame);
+    // the confirmation got lost, the peer sends the same frame again
+    controller.OnDataReceived(frame);
+    controller.OnLoop();
+
+    TEST_ASSERT_EQUAL_UINT(1, counter.deliveries);
+    TEST_ASSERT_EQUAL_UINT32(1, controller.GetMetrics().duplicates);
+
+    // a new session starts with an empty window
+    controller.OnClientDisconnected();
+    controller.OnClientConnected();
+    controller.OnDataReceived(frame);
+    controller.OnLoop();
+    TEST_ASSERT_EQUAL_UINT(2, counter.deliveries);
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_repeated_ids_are_duplicates);
+    RUN_TEST(test_ids_behind_the_window_are_duplicates);
+    RUN_TEST(test_wrap_around_of_the_id);
+    RUN_TEST(test_reset_forgets_the_ids);
+    RUN_TEST(test_resent_package_is_delivered_once);
+    return UNITY_END();
+}
@@ -0,0 +1,277 @@
+#include <unity.h>
+#include "LoopbackServer.h"
+#include "FirmwareUpdate.h"
+#include "mbedtls/sha256.h"
+
+#define TEST_RSA_BITS 1024
+#define TEST_IMAGE_PATH "test_firmware_update.bin"
+#define TEST_IMAGE_SIZE (FIRMWARE_BLOCK_SIZE * 3 + 1000)
+
+// the server side of the session: keeps the last response of the update
+class ResponseReceiver : public ITransmissionControlInterface
+{
+public:
+    String last;
+
+    void OutGateway(const String& data) override
+    {
+    }
+
+    void OnDataDecoded(const ByteSpan& data) override
+    {
+        // the block is zero padded
+        String text;
+        text.concat((const char*)data.data, strnlen((const char*)data.data, data.length));
+        this->last = text;
+    }
+};
+
+static LoopbackServer server;
+
+// key pair of the firmware signatures
+static mbedtls_pk_context signingKey;
+static mbedtls_entropy_context signingEntropy;
+static mbedtls_ctr_drbg_context signingRandom;
+static char publicKey[1024];
+
+static unsigned char image[TEST_IMAGE_SIZE];
+
+static void fillImage(unsigned char seed)
+{
+    for(unsigned int i = 0; i < TEST_IMAGE_SIZE; i++)
+    {
+        image[i] = (unsigned char)((i * 7) + seed);
+    }
+}
+
+static void hashImage(unsigned char* digest)
+{
+    mbedtls_sha256_ret(image, TEST_IMAGE_SIZE, digest, 0);
+}
+
+static String hexOf(const unsigned char* digest)
+{
+    char hex[FIRMWARE_HASH_HEX_LENGTH + 1] = { 0 };
+    for(unsigned int i = 0; i < FIRMWARE_DIGEST_SIZE; i++)
+    {
+        snprintf(hex + (i * 2), 3, "%02x", digest[i]);
+    }
+    return String(hex);
+}
+
+static String signatureOf(const unsigned char* digest)
+{
+    unsigned char signature[FIRMWARE_SIGNATURE_MAX] = { 0 };
+    char encoded[BASE64_ENCODED_LENGTH(FIRMWARE_SIGNATURE_MAX) + 1] = { 0 };
+    size_t length = 0;
+
+    if(mbedtls_pk_sign(&signingKey, MBEDTLS_MD_SHA256, digest, FIRMWARE_DIGEST_SIZE, signature, &length, mbedtls_ctr_drbg_random, &signingRandom) != 0)
+    {
+        return String();
+    }
+    base64Encode(signature, length, encoded);
+    return String(encoded);
+}
+
+static String beginCommand(const String& hash, const String& signature)
+{
+    String command = "ota:begin:";
+    command += TEST_IMAGE_SIZE;
+    command += ':';
+    command += hash;
+    command += ':';
+    command += signature;
+    return command;
+}
+
+// sends the image as chunks with their crc like the fragments of the update stream
+static void sendImage(FirmwareUpdate& update, uint32_t offset)
+{
+    unsigned char chunk[FIRMWARE_CHUNK_SIZE + FIRMWARE_CHUNK_CRC_SIZE];
+
+    while(offset < TEST_IMAGE_SIZE)
+    {
+        unsigned int length = TEST_IMAGE_SIZE - offset;
+        if(length > FIRMWARE_CHUNK_SIZE)
+        {
+            length = FIRMWARE_CHUNK_SIZE;
+        }
+        memcpy(chunk, image + offset, length);
+
+        uint32_t crc = crc32Update(0, chunk, length);
+        chunk[length] = (unsigned char)crc;
+        chunk[length + 1] = (unsigned char)(crc >> 8);
+        chunk[length + 2] = (unsigned char)(crc >> 16);
+        chunk[length + 3] = (unsigned char)(crc >> 24);
+
+        update.OnStreamData(1, offset, chunk, length + FIRMWARE_CHUNK_CRC_SIZE, TEST_IMAGE_SIZE, (offset + length) == TEST_IMAGE_SIZE);
+        offset += length;
+    }
+}
+
+// runs the verification, returns the number of loops
+static unsigned int verify(FirmwareUpdate& update)
+{
+    unsigned int loops = 0;
+    while(update.IsActive() && loops < 1000)
+    {
+        update.OnLoop();
+        loops++;
+    }
+    server.Pump();
+    return loops;
+}
+
+void setUp()
+{
+    remove(TEST_IMAGE_PATH);
+    remove(TEST_IMAGE_PATH ".progress");
+}
+
+void tearDown()
+{
+}
+
+void test_invalid_public_key_disables_the_update()
+{
+    TransmissionControl controller;
+    FileFirmwareStorage storage(TEST_IMAGE_PATH);
+    FirmwareUpdate update;
+
+    TEST_ASSERT_FALSE(update.Begin(&controller, &storage, "-----BEGIN PUBLIC KEY-----\n<enter the public key here>\n-----END PUBLIC KEY-----\n"));
+    TEST_ASSERT_FALSE(update.Begin(&controller, &storage, nullptr));
+    TEST_ASSERT_TRUE(update.Begin(&controller, &storage, publicKey));
+}
+
+void test_signed_image_is_verified_in_steps()
+{
+    TransmissionControl controller;
+    ResponseReceiver receiver;
+    FileFirmwareStorage storage(TEST_IMAGE_PATH);
+    FirmwareUpdate update;
+    unsigned char digest[FIRMWARE_DIGEST_SIZE];
+
+    controller.SetInterface(&server);
+    server.SetController(&controller);
+    server.SetReceiver(&receiver);
+    TEST_ASSERT_TRUE(update.Begin(&controller, &storage, publicKey));
+    TEST_ASSERT_TRUE(server.Handshake());
+
+    fillImage(1);
+    hashImage(digest);
+    TEST_ASSERT_TRUE(server.SendData(beginCommand(hexOf(digest), signatureOf(digest))));
+    server.Pump();
+    TEST_ASSERT_EQUAL_STRING("ota:ready:0", receiver.last.c_str());
+
+    sendImage(update, 0);
+    TEST_ASSERT_TRUE(update.IsActive());
+
+    // one chunk of the stored image per loop
+    TEST_ASSERT_EQUAL_UINT((TEST_IMAGE_SIZE + FIRMWARE_VERIFY_CHUNK_SIZE - 1) / FIRMWARE_VERIFY_CHUNK_SIZE, verify(update));
+    TEST_ASSERT_TRUE(update.IsRestartPending());
+    TEST_ASSERT_EQUAL_STRING(FIRMWARE_DONE_RESPONSE, receiver.last.c_str());
+
+    server.EndSession();
+    server.SetReceiver(nullptr);
+}
+
+void test_invalid_signature_is_rejected_before_the_transfer()
+{
+    TransmissionControl controller;
+    ResponseReceiver receiver;
+    FileFirmwareStorage storage(TEST_IMAGE_PATH);
+    FirmwareUpdate update;
+    unsigned char digest[FIRMWARE_DIGEST_SIZE];
+    unsigned char otherDigest[FIRMWARE_DIGEST_SIZE];
+
+    controller.SetInterface(&server);
+    server.SetController(&controller);
+    server.SetReceiver(&receiver);
+    TEST_ASSERT_TRUE(update.Begin(&controller, &storage, publicKey));
+    TEST_ASSERT_TRUE(server.Handshake());
+
+    fillImage(2);
+    hashImage(digest);
+    fillImage(3);
+    hashImage(otherDigest);
+
+    // the signature of another image
+    TEST_ASSERT_TRUE(server.SendData(beginCommand(hexOf(digest), signatureOf(otherDigest))));
+    server.Pump();
+    TEST_ASSERT_EQUAL_STRING("ota:error:signature:0", receiver.last.c_str());
+    TEST_ASSERT_FALSE(update.IsActive());
+
+    // no signature at all
+    TEST_ASSERT_TRUE(server.SendData("ota:begin:100:" + hexOf(digest)));
+    server.Pump();
+    TEST_ASSERT_EQUAL_STRING("ota:error:args:0", receiver.last.c_str());
+    TEST_ASSERT_FALSE(update.IsActive());
+
+    server.EndSession();
+    server.SetReceiver(nullptr);
+}
+
+void test_stored_image_must_match_the_signed_hash()
+{
+    TransmissionControl controller;
+    ResponseReceiver receiver;
+    FileFirmwareStorage storage(TEST_IMAGE_PATH);
+    FirmwareUpdate update;
+    unsigned char digest[FIRMWARE_DIGEST_SIZE];
+
+    controller.SetInterface(&server);
+    server.SetController(&controller);
+    server.SetReceiver(&receiver);
+    TEST_ASSERT_TRUE(update.Begin(&controller, &storage, publicKey));
+    TEST_ASSERT_TRUE(server.Handshake());
+
+    fillImage(4);
+    hashImage(digest);
+    TEST_ASSERT_TRUE(server.SendData(beginCommand(hexOf(digest), signatureOf(digest))));
+    server.Pump();
+
+    // valid chunks of another image
+    fillImage(5);
+    sendImage(update, 0);
+    verify(update);
+
+    TEST_ASSERT_FALSE(update.IsRestartPending());
+    TEST_ASSERT_EQUAL_STRING("ota:error:hash:0", receiver.last.c_str());
+
+    server.EndSession();
+    server.SetReceiver(nullptr);
+}
+
+int main(int argc, char** argv)
+{
+    const char* personalization = "test-firmware-update";
+    unsigned char pem[sizeof(publicKey)] = { 0 };
+
+    mbedtls_pk_init(&signingKey);
+    mbedtls_entropy_init(&signingEntropy);
+    mbedtls_ctr_drbg_init(&signingRandom);
+
+    if(!server.Begin(TEST_RSA_BITS)
+        || mbedtls_ctr_drbg_seed(&signingRandom, mbedtls_entropy_func, &signingEntropy, (const unsigned char*)personalization, strlen(personalization)) != 0
+        || mbedtls_pk_setup(&signingKey, mbedtls_pk_info_from_type(MBEDTLS_PK_RSA)) != 0
+        || mbedtls_rsa_gen_key(mbedtls_pk_rsa(signingKey), mbedtls_ctr_drbg_random, &signingRandom, TEST_RSA_BITS, 65537) != 0
+        || mbedtls_pk_write_pubkey_pem(&signingKey, pem, sizeof(pem)) != 0)
+    {
+        return 1;
+    }
+    memcpy(publicKey, pem, sizeof(publicKey));
+
+    UNITY_BEGIN();
+    RUN_TEST(test_invalid_public_key_disables_the_update);
+    RUN_TEST(test_signed_image_is_verified_in_steps);
+    RUN_TEST(test_invalid_signature_is_rejected_before_the_transfer);
+    RUN_TEST(test_stored_image_must_match_the_signed_hash);
+    int result = UNITY_END();
+
+    remove(TEST_IMAGE_PATH);
+    remove(TEST_IMAGE_PATH ".progress");
+    mbedtls_pk_free(&signingKey);
+    mbedtls_ctr_drbg_free(&signingRandom);
+    mbedtls_entropy_free(&signingEntropy);
+    return result;
+}
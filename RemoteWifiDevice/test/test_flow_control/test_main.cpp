@@ -0,0 +1,252 @@
+#include <unity.h>
+#include "LoopbackServer.h"
+
+#define TEST_RSA_BITS 1024
+#define TEST_MESSAGE "flow control test message"
+// the window probes back off up to rtoMax
+#define TEST_PROBE_TIMEOUT 3000
+
+// collects the credits of a controller without a server
+class CreditCapture : public ITransmissionControlInterface
+{
+public:
+    unsigned int credits;
+    String lastCredit;
+
+    CreditCapture()
+    : credits(0)
+    {}
+
+    void OutGateway(const String& data) override
+    {
+        TransmissionPackage package;
+        package.FromTransmissionString(data);
+
+        if(!package.errorFlag && package.mode == TransmissionMode::CREDIT)
+        {
+            this->credits++;
+            this->lastCredit = package.data;
+        }
+    }
+};
+
+static LoopbackServer server;
+
+static String dataFrame(unsigned int transmissionID)
+{
+    TransmissionPackage package;
+    package.mode = TransmissionMode::DATA;
+    package.encryptionType = TransmissionEncryptionType::TET_NONE;
+    package.dataFormat = TransmissionDataFormat::PLAIN_TEXT;
+    package.data = TEST_MESSAGE;
+    package.iv = "";
+    package.transmissionID = transmissionID;
+    return package.ToTransmissionString();
+}
+
+static String creditFrame(const char* data)
+{
+    TransmissionPackage package;
+    package.mode = TransmissionMode::CREDIT;
+    package.encryptionType = TransmissionEncryptionType::TET_NONE;
+    package.dataFormat = TransmissionDataFormat::PLAIN_TEXT;
+    package.data = data;
+    package.iv = "";
+    package.transmissionID = 0;
+    return package.ToTransmissionString();
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_every_package_consumes_a_package_credit()
+{
+    TransmissionControl controller;
+    controller.SetInterface(&server);
+    server.SetController(&controller);
+    TEST_ASSERT_TRUE(server.Handshake());
+    unsigned long received = server.GetReceivedCount();
+
+    server.SendCredit(100000, 3);
+    for(unsigned int i = 0; i < 5; i++)
+    {
+        TEST_ASSERT_TRUE(controller.SendData(TEST_MESSAGE, true));
+    }
+    server.Pump();
+
+    // the confirmations do not open the window again
+    TEST_ASSERT_EQUAL_UINT32(received + 3, server.GetReceivedCount());
+    TEST_ASSERT_TRUE(controller.IsThrottled());
+    server.Pump();
+    TEST_ASSERT_EQUAL_UINT32(received + 3, server.GetReceivedCount());
+
+    // only a new credit does
+    server.SendCredit(100000, 2);
+    server.Pump();
+    TEST_ASSERT_EQUAL_UINT32(received + 5, server.GetReceivedCount());
+    TEST_ASSERT_TRUE(controller.IsThrottled());
+    TEST_ASSERT_EQUAL_UINT32(0, controller.GetMetrics().retransmissions);
+
+    server.EndSession();
+}
+
+void test_every_package_consumes_its_frame_bytes()
+{
+    TransmissionControl controller;
+    controller.SetInterface(&server);
+    server.SetController(&controller);
+    TEST_ASSERT_TRUE(server.Handshake());
+    unsigned long received = server.GetReceivedCount();
+
+    // a package larger than the byte credit is still sent, the next one waits
+    server.SendCredit(1, 100);
+    TEST_ASSERT_TRUE(controller.SendData(TEST_MESSAGE, true));
+    TEST_ASSERT_TRUE(controller.SendData(TEST_MESSAGE, true));
+    server.Pump();
+    TEST_ASSERT_EQUAL_UINT32(received + 1, server.GetReceivedCount());
+    TEST_ASSERT_TRUE(controller.IsThrottled());
+
+    server.SendCredit(100000, 100);
+    server.Pump();
+    TEST_ASSERT_EQUAL_UINT32(received + 2, server.GetReceivedCount());
+    TEST_ASSERT_FALSE(controller.IsThrottled());
+
+    server.EndSession();
+}
+
+void test_credit_is_renewed_after_half_of_the_window()
+{
+    TransmissionControl controller;
+    CreditCapture capture;
+    controller.SetInterface(&capture);
+    controller.OnClientConnected();
+
+    controller.SetReceiveWindow(100000, 4);
+    TEST_ASSERT_EQUAL_UINT(1, capture.credits);
+    // the peer uses credits itself
+    controller.OnDataReceived(creditFrame("100000:100"));
+
+    controller.OnDataReceived(dataFrame(1));
+    TEST_ASSERT_EQUAL_UINT(1, capture.credits);
+    controller.OnDataReceived(dataFrame(2));
+    TEST_ASSERT_EQUAL_UINT(2, capture.credits);
+    TEST_ASSERT_EQUAL_STRING("100000:4", capture.lastCredit.c_str());
+
+    // a resent package was counted before
+    controller.OnDataReceived(dataFrame(2));
+    controller.OnDataReceived(dataFrame(3));
+    TEST_ASSERT_EQUAL_UINT(2, capture.credits);
+
+    // half of the bytes
+    controller.SetReceiveWindow(dataFrame(4).length() * 2, 100);
+    TEST_ASSERT_EQUAL_UINT(3, capture.credits);
+    controller.OnDataReceived(dataFrame(4));
+    TEST_ASSERT_EQUAL_UINT(4, capture.credits);
+
+    // a closed window is not advertised again
+    controller.SetReceiveWindow(0, 0);
+    TEST_ASSERT_EQUAL_UINT(5, capture.credits);
+    controller.OnDataReceived(dataFrame(5));
+    controller.OnDataReceived(dataFrame(6));
+    TEST_ASSERT_EQUAL_UINT(5, capture.credits);
+}
+
+void test_credit_is_not_renewed_without_a_peer_credit()
+{
+    TransmissionControl controller;
+    CreditCapture capture;
+    controller.SetInterface(&capture);
+    controller.OnClientConnected();
+
+    // a peer without flow control would get a credit after every second package
+    controller.SetReceiveWindow(100000, 2);
+    TEST_ASSERT_EQUAL_UINT(1, capture.credits);
+    for(unsigned int i = 1; i <= 6; i++)
+    {
+        controller.OnDataReceived(dataFrame(i));
+    }
+    TEST_ASSERT_EQUAL_UINT(1, capture.credits);
+
+    controller.OnDataReceived(creditFrame("100000:100"));
+    controller.OnDataReceived(dataFrame(7));
+    TEST_ASSERT_EQUAL_UINT(2, capture.credits);
+}
+
+void test_window_probe_is_answered_with_the_current_window()
+{
+    TransmissionControl controller;
+    CreditCapture capture;
+    controller.SetInterface(&capture);
+    controller.OnClientConnected();
+
+    controller.SetReceiveWindow(100000, 4);
+    TEST_ASSERT_EQUAL_UINT(1, capture.credits);
+
+    controller.OnDataReceived(creditFrame(TRANSMISSION_CREDIT_PROBE));
+    TEST_ASSERT_EQUAL_UINT(2, capture.credits);
+    TEST_ASSERT_EQUAL_STRING("100000:4", capture.lastCredit.c_str());
+    // the probe is no credit of the peer
+    TEST_ASSERT_FALSE(controller.IsThrottled());
+}
+
+void test_closed_window_is_probed_after_the_rto()
+{
+    TransmissionControl controller;
+    controller.SetInterface(&server);
+    server.SetController(&controller);
+    TEST_ASSERT_TRUE(server.Handshake());
+    unsigned long received = server.GetReceivedCount();
+
+    // the renewal of the credit is lost, the server does not send it
+    server.SendCredit(100000, 1);
+    TEST_ASSERT_TRUE(controller.SendData(TEST_MESSAGE, true));
+    TEST_ASSERT_TRUE(controller.SendData(TEST_MESSAGE, true));
+    server.Pump();
+    TEST_ASSERT_EQUAL_UINT32(received + 1, server.GetReceivedCount());
+    TEST_ASSERT_TRUE(controller.IsThrottled());
+    TEST_ASSERT_EQUAL_UINT32(0, server.GetWindowProbeCount());
+
+    // the probe asks the server for its window, the answer lets the next package through
+    auto start = millis();
+    while(server.GetReceivedCount() < received + 2 && (millis() - start) < TEST_PROBE_TIMEOUT)
+    {
+        server.Pump();
+        delay(1);
+    }
+    TEST_ASSERT_EQUAL_UINT32(received + 2, server.GetReceivedCount());
+    TEST_ASSERT_EQUAL_UINT32(1, server.GetWindowProbeCount());
+    TEST_ASSERT_TRUE((millis() - start) >= transmissionProfile.rtoMin);
+
+    // nothing waits, the closed window is not probed again
+    start = millis();
+    while((millis() - start) < transmissionProfile.rtoMax)
+    {
+        server.Pump();
+        delay(1);
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, server.GetWindowProbeCount());
+
+    server.EndSession();
+}
+
+int main(int argc, char** argv)
+{
+    if(!server.Begin(TEST_RSA_BITS))
+    {
+        return 1;
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_every_package_consumes_a_package_credit);
+    RUN_TEST(test_every_package_consumes_its_frame_bytes);
+    RUN_TEST(test_credit_is_renewed_after_half_of_the_window);
+    RUN_TEST(test_credit_is_not_renewed_without_a_peer_credit);
+    RUN_TEST(test_window_probe_is_answered_with_the_current_window);
+    RUN_TEST(test_closed_window_is_probed_after_the_rto);
+    return UNITY_END();
+}
@@ -0,0 +1,260 @@
+#include <unity.h>
+#include "LoopbackServer.h"
+
+#define TEST_RSA_BITS 1024
+
+// message of the stream, byte i is (i * 7) & 0xFF
+class PatternSource : public IStreamSource
+{
+public:
+    uint32_t position;
+    // the source fails after this many bytes (0 = never)
+    uint32_t failAfter;
+    bool completed;
+    bool success;
+
+    PatternSource()
+    : position(0), failAfter(0), completed(false), success(false)
+    {}
+
+    unsigned int Read(unsigned char* buffer, unsigned int size) override
+    {
+        if(this->failAfter > 0 && this->position >= this->failAfter)
+        {
+            return 0;
+        }
+        for(unsigned int i = 0; i < size; i++)
+        {
+            buffer[i] = (unsigned char)((this->position + i) * 7);
+        }
+        this->position += size;
+        return size;
+    }
+
+    void OnStreamComplete(uint16_t streamID, bool _success) override
+    {
+        this->completed = true;
+        this->success = _success;
+    }
+};
+
+// the server side of the session: checks the fragments of the controller against the pattern
+class FragmentReceiver : public ITransmissionControlInterface
+{
+public:
+    StreamReassembler reassembler;
+    uint32_t received;
+    bool matches;
+    bool last;
+    unsigned int aborts;
+
+    FragmentReceiver()
+    : received(0), matches(true), last(false), aborts(0)
+    {}
+
+    void OutGateway(const String& data) override
+    {
+    }
+
+    void OnDataDecoded(const ByteSpan& data) override
+    {
+        FragmentHeader header;
+        uint32_t offset = 0;
+        if(!header.Read(data.data, data.length))
+        {
+            return;
+        }
+
+        auto result = this->reassembler.Accept(header, offset);
+        if(result == StreamReassembler::FR_ABORTED)
+        {
+            this->aborts++;
+            return;
+        }
+        if(result != StreamReassembler::FR_ACCEPTED || offset != this->received)
+        {
+            this->matches = false;
+            return;
+        }
+        for(unsigned int i = 0; i < header.payloadLength; i++)
+        {
+            if(data.data[FRAGMENT_HEADER_SIZE + i] != (unsigned char)((offset + i) * 7))
+            {
+                this->matches = false;
+            }
+        }
+        this->received += header.payloadLength;
+        this->last = (header.flags & FRAGMENT_FLAG_LAST) != 0;
+    }
+};
+
+static FragmentHeader makeHeader(uint8_t flags, uint16_t streamID, uint16_t sequence, uint32_t totalLength, uint16_t payloadLength)
+{
+    FragmentHeader header;
+    header.flags = flags;
+    header.streamID = streamID;
+    header.sequence = sequence;
+    header.totalLength = totalLength;
+    header.payloadLength = payloadLength;
+    return header;
+}
+
+static LoopbackServer server;
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_header_round_trip()
+{
+    unsigned char buffer[FRAGMENT_HEADER_SIZE + 4] = { 0 };
+    makeHeader(FRAGMENT_FLAG_FIRST | FRAGMENT_FLAG_LAST, 0xBEEF, 0x1234, 0x01020304, 4).Write(buffer);
+
+    FragmentHeader header;
+    TEST_ASSERT_TRUE(header.Read(buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_UINT8(FRAGMENT_FLAG_FIRST | FRAGMENT_FLAG_LAST, header.flags);
+    TEST_ASSERT_EQUAL_UINT16(0xBEEF, header.streamID);
+    TEST_ASSERT_EQUAL_UINT16(0x1234, header.sequence);
+    TEST_ASSERT_EQUAL_UINT32(0x01020304, header.totalLength);
+    TEST_ASSERT_EQUAL_UINT16(4, header.payloadLength);
+
+    // payload longer than the data and text without the marker
+    TEST_ASSERT_FALSE(header.Read(buffer, sizeof(buffer) - 1));
+    TEST_ASSERT_FALSE(FragmentHeader::IsFragment((const unsigned char*)"rq:status:active", 16));
+}
+
+void test_reassembler_sequence()
+{
+    StreamReassembler reassembler;
+    uint32_t offset = 0;
+
+    TEST_ASSERT_EQUAL(StreamReassembler::FR_ACCEPTED, reassembler.Accept(makeHeader(FRAGMENT_FLAG_FIRST, 1, 0, 30, 10), offset));
+    TEST_ASSERT_EQUAL_UINT32(0, offset);
+    TEST_ASSERT_EQUAL(StreamReassembler::FR_ACCEPTED, reassembler.Accept(makeHeader(0, 1, 1, 30, 10), offset));
+    TEST_ASSERT_EQUAL_UINT32(10, offset);
+
+    // a gap aborts the stream, the following fragments are unknown
+    TEST_ASSERT_EQUAL(StreamReassembler::FR_ABORTED, reassembler.Accept(makeHeader(0, 1, 3, 30, 10), offset));
+    TEST_ASSERT_EQUAL(StreamReassembler::FR_IGNORED, reassembler.Accept(makeHeader(FRAGMENT_FLAG_LAST, 1, 4, 30, 10), offset));
+
+    // more data than announced
+    TEST_ASSERT_EQUAL(StreamReassembler::FR_ACCEPTED, reassembler.Accept(makeHeader(FRAGMENT_FLAG_FIRST, 2, 0, 15, 10), offset));
+    TEST_ASSERT_EQUAL(StreamReassembler::FR_ABORTED, reassembler.Accept(makeHeader(0, 2, 1, 15, 10), offset));
+}
+
+void test_abort_fragment_frees_the_slot()
+{
+    StreamReassembler reassembler;
+    uint32_t offset = 0;
+
+    TEST_ASSERT_EQUAL(StreamReassembler::FR_ACCEPTED, reassembler.Accept(makeHeader(FRAGMENT_FLAG_FIRST, 5, 0, 100, 10), offset));
+    TEST_ASSERT_EQUAL(StreamReassembler::FR_ABORTED, reassembler.Accept(makeHeader(FRAGMENT_FLAG_ABORT, 5, 1, 100, 0), offset));
+    TEST_ASSERT_EQUAL(StreamReassembler::FR_IGNORED, reassembler.Accept(makeHeader(0, 5, 1, 100, 10), offset));
+
+    // an abort of an unknown stream changes nothing
+    TEST_ASSERT_EQUAL(StreamReassembler::FR_IGNORED, reassembler.Accept(makeHeader(FRAGMENT_FLAG_ABORT, 6, 0, 100, 0), offset));
+}
+
+void test_idle_streams_expire()
+{
+    StreamReassembler reassembler;
+    uint32_t offset = 0;
+    uint16_t streamID = 0;
+
+    TEST_ASSERT_EQUAL(StreamReassembler::FR_ACCEPTED, reassembler.Accept(makeHeader(FRAGMENT_FLAG_FIRST, 7, 0, 100, 10), offset));
+    TEST_ASSERT_EQUAL(StreamReassembler::FR_ACCEPTED, reassembler.Accept(makeHeader(FRAGMENT_FLAG_FIRST, 8, 0, 100, 10), offset));
+    unsigned long now = millis();
+
+    TEST_ASSERT_FALSE(reassembler.ExpireIdle(now + FRAGMENT_INBOUND_IDLE_TIMEOUT / 2, streamID));
+
+    TEST_ASSERT_TRUE(reassembler.ExpireIdle(now + FRAGMENT_INBOUND_IDLE_TIMEOUT, streamID));
+    uint16_t first = streamID;
+    TEST_ASSERT_TRUE(reassembler.ExpireIdle(now + FRAGMENT_INBOUND_IDLE_TIMEOUT, streamID));
+    TEST_ASSERT_NOT_EQUAL(first, streamID);
+    TEST_ASSERT_FALSE(reassembler.ExpireIdle(now + FRAGMENT_INBOUND_IDLE_TIMEOUT, streamID));
+
+    // the slots are free, a continuation of an expired stream is unknown
+    TEST_ASSERT_EQUAL(StreamReassembler::FR_IGNORED, reassembler.Accept(makeHeader(0, 7, 1, 100, 10), offset));
+}
+
+void test_stream_through_the_loopback_server()
+{
+    TransmissionControl controller;
+    FragmentReceiver receiver;
+    PatternSource source;
+    const uint32_t length = FRAGMENT_PAYLOAD_SIZE * 5 + 123;
+
+    controller.SetInterface(&server);
+    server.SetController(&controller);
+    server.SetReceiver(&receiver);
+    TEST_ASSERT_TRUE(server.Handshake());
+
+    TEST_ASSERT_NOT_EQUAL(0, controller.SendStream(&source, length));
+    // only one stream at a time
+    TEST_ASSERT_EQUAL(0, controller.SendStream(&source, length));
+
+    for(unsigned int i = 0; i < 100 && !source.completed; i++)
+    {
+        server.Pump();
+    }
+
+    TEST_ASSERT_TRUE(source.completed);
+    TEST_ASSERT_TRUE(source.success);
+    TEST_ASSERT_TRUE(receiver.matches);
+    TEST_ASSERT_TRUE(receiver.last);
+    TEST_ASSERT_EQUAL_UINT32(length, receiver.received);
+    TEST_ASSERT_FALSE(controller.IsStreamActive());
+
+    server.EndSession();
+    server.SetReceiver(nullptr);
+}
+
+void test_failed_source_sends_an_abort()
+{
+    TransmissionControl controller;
+    FragmentReceiver receiver;
+    PatternSource source;
+    source.failAfter = FRAGMENT_PAYLOAD_SIZE * 3;
+
+    controller.SetInterface(&server);
+    server.SetController(&controller);
+    server.SetReceiver(&receiver);
+    TEST_ASSERT_TRUE(server.Handshake());
+
+    TEST_ASSERT_NOT_EQUAL(0, controller.SendStream(&source, FRAGMENT_PAYLOAD_SIZE * 10));
+    for(unsigned int i = 0; i < 100 && !source.completed; i++)
+    {
+        server.Pump();
+    }
+    server.Pump();
+
+    TEST_ASSERT_TRUE(source.completed);
+    TEST_ASSERT_FALSE(source.success);
+    TEST_ASSERT_EQUAL_UINT32(FRAGMENT_PAYLOAD_SIZE * 3, receiver.received);
+    // the receiver learns about the end of the stream from the abort fragment
+    TEST_ASSERT_EQUAL_UINT(1, receiver.aborts);
+
+    server.EndSession();
+    server.SetReceiver(nullptr);
+}
+
+int main(int argc, char** argv)
+{
+    if(!server.Begin(TEST_RSA_BITS))
+    {
+        return 1;
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_header_round_trip);
+    RUN_TEST(test_reassembler_sequence);
+    RUN_TEST(test_abort_fragment_frees_the_slot);
+    RUN_TEST(test_idle_streams_expire);
+    RUN_TEST(test_stream_through_the_loopback_server);
+    RUN_TEST(test_failed_source_sends_an_abort);
+    return UNITY_END();
+}
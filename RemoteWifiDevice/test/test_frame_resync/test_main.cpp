@@ -0,0 +1,276 @@
+#include <unity.h>
+#include "TransmissionControl.h"
+
+#define TEST_FRAMES 8
+#define TEST_FUZZ_ROUNDS 500
+
+// keeps the plain text payloads which are delivered by the controller
+class DeliveryLog : public ITransmissionControlInterface
+{
+public:
+    String messages[TEST_FRAMES * 4];
+    unsigned int count;
+
+    DeliveryLog()
+    : count(0)
+    {}
+
+    void OutGateway(const String& data) override
+    {
+    }
+
+    void OnUnencryptedDataReceived(const ByteSpan& data) override
+    {
+        if(this->count < (TEST_FRAMES * 4))
+        {
+            this->messages[this->count].concat((const char*)data.data, data.length);
+        }
+        this->count++;
+    }
+};
+
+static uint32_t fuzzState = 1;
+
+static uint32_t nextRandom()
+{
+    fuzzState = (fuzzState * 1103515245u) + 12345u;
+    return fuzzState >> 8;
+}
+
+static String messageOf(unsigned int index)
+{
+    String message = "message ";
+    message += index;
+    return message;
+}
+
+static String syncFrame(unsigned int index)
+{
+    TransmissionPackage package;
+    package.mode = TransmissionMode::DATA;
+    package.encryptionType = TransmissionEncryptionType::TET_NONE;
+    package.dataFormat = TransmissionDataFormat::PLAIN_TEXT;
+    package.data = messageOf(index);
+    package.iv = "";
+    package.transmissionID = index + 1;
+
+    String frame;
+    appendSyncFrame(frame, package.ToTransmissionString());
+    return frame;
+}
+
+static void connect(TransmissionControl& controller, DeliveryLog& log)
+{
+    controller.SetInterface(&log);
+    controller.SetFraming(TF_SYNC);
+    controller.OnClientConnected();
+}
+
+// feeds the data in chunks of random length, like the reads of a socket
+static void receiveInChunks(TransmissionControl& controller, const String& data)
+{
+    unsigned int position = 0;
+    while(position < data.length())
+    {
+        unsigned int length = 1 + (nextRandom() % 40);
+        if(position + length > data.length())
+        {
+            length = data.length() - position;
+        }
+        controller.OnDataReceived(data.substring(position, position + length));
+        position += length;
+    }
+    controller.OnLoop();
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_garbage_between_frames_is_skipped()
+{
+    TransmissionControl controller;
+    DeliveryLog log;
+    connect(controller, log);
+
+    String data = "garbage~\r\n";
+    for(unsigned int i = 0; i < TEST_FRAMES; i++)
+    {
+        data += syncFrame(i);
+        // a marker without a valid header and the stray line break of println
+        data += (i % 2) ? "~~00000000xyz" : "\r\n";
+    }
+    controller.OnDataReceived(data);
+    controller.OnLoop();
+
+    TEST_ASSERT_EQUAL_UINT(TEST_FRAMES, log.count);
+    for(unsigned int i = 0; i < TEST_FRAMES; i++)
+    {
+        String message = messageOf(i);
+        TEST_ASSERT_EQUAL_STRING(message.c_str(), log.messages[i].c_str());
+    }
+    TEST_ASSERT_TRUE(controller.GetMetrics().parseErrors > 0);
+}
+
+void test_corrupted_header_loses_only_its_frame()
+{
+    TransmissionControl controller;
+    DeliveryLog log;
+    connect(controller, log);
+
+    String corrupted = syncFrame(1);
+    // a digit of the data size, the crc does not match anymore
+    corrupted.setCharAt(TRANSMISSION_SYNC_PREFIX_SIZE + 7, corrupted[TRANSMISSION_SYNC_PREFIX_SIZE + 7] == '0' ? '1' : '0');
+
+    controller.OnDataReceived(syncFrame(0) + corrupted + syncFrame(2));
+    controller.OnLoop();
+
+    TEST_ASSERT_EQUAL_UINT(2, log.count);
+    TEST_ASSERT_EQUAL_STRING("message 0", log.messages[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("message 2", log.messages[1].c_str());
+}
+
+void test_truncated_frame_does_not_swallow_the_next_one()
+{
+    TransmissionControl controller;
+    DeliveryLog log;
+    connect(controller, log);
+
+    // the frame claims more bytes than it has, the next frame completes the size
+    String truncated = syncFrame(1);
+    truncated.remove(truncated.length() - 3);
+
+    controller.OnDataReceived(syncFrame(0) + truncated);
+    controller.OnDataReceived(syncFrame(2) + syncFrame(3));
+    controller.OnLoop();
+
+    TEST_ASSERT_EQUAL_UINT(3, log.count);
+    TEST_ASSERT_EQUAL_STRING("message 0", log.messages[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("message 2", log.messages[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("message 3", log.messages[2].c_str());
+}
+
+void test_split_reads_are_reassembled()
+{
+    TransmissionControl controller;
+    DeliveryLog log;
+    connect(controller, log);
+
+    String data;
+    for(unsigned int i = 0; i < TEST_FRAMES; i++)
+    {
+        data += syncFrame(i);
+    }
+
+    // one byte per read, the marker and the header are split as well
+    for(unsigned int i = 0; i < data.length(); i++)
+    {
+        controller.OnDataReceived(data.substring(i, i + 1));
+    }
+    controller.OnLoop();
+
+    TEST_ASSERT_EQUAL_UINT(TEST_FRAMES, log.count);
+    TEST_ASSERT_EQUAL_UINT32(0, controller.GetMetrics().parseErrors);
+}
+
+void test_fuzzed_streams_deliver_every_intact_frame()
+{
+    for(unsigned int round = 0; round < TEST_FUZZ_ROUNDS; round++)
+    {
+        TransmissionControl controller;
+        DeliveryLog log;
+        bool intact[TEST_FRAMES];
+        String data;
+
+        fuzzState = round + 1;
+        connect(controller, log);
+
+        for(unsigned int i = 0; i < TEST_FRAMES; i++)
+        {
+            String frame = syncFrame(i);
+            intact[i] = true;
+
+            switch(nextRandom() % 5)
+            {
+            case 0:
+                {
+                    // noise in front of the frame, without the first character of the marker
+                    unsigned int noise = nextRandom() % 30;
+                    for(unsigned int k = 0; k < noise; k++)
+                    {
+                        data += (char)('!' + (nextRandom() % 90));
+                    }
+                }
+                break;
+            case 1:
+                {
+                    // one byte of the prefix or the header is changed (not only its case, the crc digits are
+                    // read case insensitive)
+                    unsigned int position = nextRandom() % (TRANSMISSION_SYNC_PREFIX_SIZE + TRANSMISSION_HEADER_SIZE);
+                    frame.setCharAt(position, (char)(frame[position] ^ (1 + (nextRandom() % 0x1F))));
+                    intact[i] = false;
+                }
+                break;
+            case 2:
+                data += "\r\n";
+                break;
+            case 3:
+                {
+                    // bytes of the data are lost
+                    unsigned int dataStart = TRANSMISSION_SYNC_PREFIX_SIZE + TRANSMISSION_HEADER_SIZE;
+                    unsigned int lost = 1 + (nextRandom() % (frame.length() - dataStart));
+                    frame.remove(dataStart + (nextRandom() % (frame.length() - dataStart - lost + 1)), lost);
+                    intact[i] = false;
+                }
+                break;
+            default:
+                break;
+            }
+            data += frame;
+        }
+
+        receiveInChunks(controller, data);
+
+        // the intact frames arrive in order, a damaged frame can only be delivered in its own place (plain text has no
+        // checksum of the data, encrypted data would not decrypt)
+        unsigned int delivered = 0;
+        for(unsigned int i = 0; i < TEST_FRAMES; i++)
+        {
+            String message = messageOf(i);
+            if(intact[i])
+            {
+                TEST_ASSERT_TRUE_MESSAGE(delivered < log.count, "intact frame lost");
+                TEST_ASSERT_EQUAL_STRING(message.c_str(), log.messages[delivered].c_str());
+                delivered++;
+                continue;
+            }
+
+            unsigned int next = i + 1;
+            while(next < TEST_FRAMES && !intact[next])
+            {
+                next++;
+            }
+            if(delivered < log.count && (next == TEST_FRAMES || log.messages[delivered] != messageOf(next)))
+            {
+                // the damaged frame itself
+                delivered++;
+            }
+        }
+        TEST_ASSERT_EQUAL_UINT(delivered, log.count);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_garbage_between_frames_is_skipped);
+    RUN_TEST(test_corrupted_header_loses_only_its_frame);
+    RUN_TEST(test_truncated_frame_does_not_swallow_the_next_one);
+    RUN_TEST(test_split_reads_are_reassembled);
+    RUN_TEST(test_fuzzed_streams_deliver_every_intact_frame);
+    return UNITY_END();
+}
@@ -0,0 +1,234 @@
+#include <unity.h>
+#include "LoopbackServer.h"
+#include "LinkSimulator.h"
+
+#define TEST_RSA_BITS 1024
+#define TEST_PROBES 30
+// scheduling of the host and the 1 ms steps of the pump loop (us)
+#define TEST_RTT_TOLERANCE 10000
+
+static LoopbackServer server;
+
+// sends probes over the simulated link and keeps the smallest and largest probe rtt (the handshake before adds
+// samples of the clean link), returns false if a reply is missing
+static bool measureLink(TransmissionControl& controller, LinkSimulator& simulator, uint32_t& minRTT, uint32_t& maxRTT)
+{
+    minRTT = UINT32_MAX;
+    maxRTT = 0;
+
+    for(unsigned int i = 0; i < TEST_PROBES; i++)
+    {
+        unsigned long samples = controller.GetLinkEstimate().GetSampleCount();
+        controller.SendProbe();
+
+        auto start = millis();
+        while(controller.GetLinkEstimate().GetSampleCount() == samples)
+        {
+            if((millis() - start) > 1000)
+            {
+                return false;
+            }
+            simulator.OnLoop();
+            server.Pump();
+            controller.OnLoop();
+            delay(1);
+        }
+
+        uint32_t rtt = controller.GetLinkEstimate().GetLatestRTT();
+        minRTT = (rtt < minRTT) ? rtt : minRTT;
+        maxRTT = (rtt > maxRTT) ? rtt : maxRTT;
+    }
+    return true;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_initial_rto_until_the_first_sample()
+{
+    LinkEstimator estimate;
+
+    TEST_ASSERT_FALSE(estimate.HasSamples());
+    TEST_ASSERT_EQUAL_UINT32(transmissionProfile.rtoInitial, estimate.GetRetransmissionTimeout());
+
+    // the fixed checkup timeout of the earlier versions
+#if TRANSMISSION_PROFILE == TRANSMISSION_PROFILE_DEFAULT
+    TEST_ASSERT_EQUAL_UINT32(500, TRANSMISSION_RTO_INITIAL);
+#endif
+}
+
+void test_first_sample_sets_the_estimate()
+{
+    LinkEstimator estimate;
+    estimate.AddSample(100000);
+
+    TEST_ASSERT_EQUAL_UINT32(100000, estimate.GetSmoothedRTT());
+    TEST_ASSERT_EQUAL_UINT32(50000, estimate.GetRTTVariation());
+    TEST_ASSERT_EQUAL_UINT32(100000, estimate.GetMinRTT());
+    TEST_ASSERT_EQUAL_UINT32(0, estimate.GetJitter());
+    // srtt + 4 * rttvar
+    TEST_ASSERT_EQUAL_UINT32(300, estimate.GetRetransmissionTimeout());
+}
+
+void test_constant_samples_have_no_variation()
+{
+    LinkEstimator estimate;
+    for(unsigned int i = 0; i < 100; i++)
+    {
+        estimate.AddSample(50000);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(50000, estimate.GetSmoothedRTT());
+    TEST_ASSERT_UINT32_WITHIN(3, 0, estimate.GetRTTVariation());
+    TEST_ASSERT_EQUAL_UINT32(0, estimate.GetJitter());
+    TEST_ASSERT_EQUAL_UINT32(transmissionProfile.rtoMin, estimate.GetRetransmissionTimeout());
+}
+
+void test_alternating_samples_give_the_jitter()
+{
+    LinkEstimator estimate;
+    for(unsigned int i = 0; i < 200; i++)
+    {
+        estimate.AddSample((i % 2) ? 60000 : 40000);
+    }
+
+    TEST_ASSERT_UINT32_WITHIN(1000, 50000, estimate.GetSmoothedRTT());
+    TEST_ASSERT_UINT32_WITHIN(200, 20000, estimate.GetJitter());
+    TEST_ASSERT_UINT32_WITHIN(2000, 10000, estimate.GetRTTVariation());
+    TEST_ASSERT_EQUAL_UINT32(40000, estimate.GetMinRTT());
+    TEST_ASSERT_EQUAL_UINT32(60000, estimate.GetLatestRTT());
+}
+
+void test_rto_is_bounded_by_the_profile()
+{
+    LinkEstimator estimate;
+    estimate.AddSample(transmissionProfile.rtoMax * 1000UL);
+
+    TEST_ASSERT_EQUAL_UINT32(transmissionProfile.rtoMax, estimate.GetRetransmissionTimeout());
+}
+
+void test_probe_reply_must_match()
+{
+    LinkEstimator estimate;
+    uint16_t sequence = estimate.OnProbeSent(1000);
+
+    // another timestamp, an unknown sequence
+    TEST_ASSERT_FALSE(estimate.OnProbeReply(sequence, 999, 2000));
+    TEST_ASSERT_FALSE(estimate.OnProbeReply(sequence + 5, 1000, 2000));
+    TEST_ASSERT_FALSE(estimate.HasSamples());
+
+    TEST_ASSERT_TRUE(estimate.OnProbeReply(sequence, 1000, 31000));
+    TEST_ASSERT_EQUAL_UINT32(30000, estimate.GetLatestRTT());
+
+    // answered already
+    TEST_ASSERT_FALSE(estimate.OnProbeReply(sequence, 1000, 32000));
+    TEST_ASSERT_EQUAL_UINT32(1, estimate.GetSampleCount());
+    TEST_ASSERT_EQUAL_UINT(0, estimate.GetLossPermille());
+}
+
+void test_unanswered_probes_are_lost_after_twice_the_rto()
+{
+    LinkEstimator estimate;
+    uint16_t lost = estimate.OnProbeSent(0);
+    uint16_t answered = estimate.OnProbeSent(0);
+
+    // the rto drops to its minimum with the sample
+    TEST_ASSERT_TRUE(estimate.OnProbeReply(answered, 0, 10000));
+    uint32_t timeout = transmissionProfile.rtoMin * 2000UL;
+
+    TEST_ASSERT_EQUAL_UINT(0, estimate.ExpireProbes(timeout - 1));
+    TEST_ASSERT_EQUAL_UINT(1, estimate.ExpireProbes(timeout));
+    TEST_ASSERT_EQUAL_UINT32(1, estimate.GetProbesLost());
+    TEST_ASSERT_EQUAL_UINT(500, estimate.GetLossPermille());
+
+    // a late reply does not count
+    TEST_ASSERT_FALSE(estimate.OnProbeReply(lost, 0, timeout + 1));
+    TEST_ASSERT_EQUAL_UINT32(1, estimate.GetSampleCount());
+}
+
+void test_probe_is_lost_when_its_record_is_reused()
+{
+    LinkEstimator estimate;
+    for(unsigned int i = 0; i <= LINK_PROBE_HISTORY; i++)
+    {
+        estimate.OnProbeSent(i);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(LINK_PROBE_HISTORY + 1, estimate.GetProbesSent());
+    TEST_ASSERT_EQUAL_UINT32(1, estimate.GetProbesLost());
+}
+
+void test_snapshot_format()
+{
+    LinkEstimator estimate;
+    estimate.AddSample(100000);
+    estimate.OnProbeSent(0);
+
+    String snapshot = estimate.ToSnapshotString();
+    TEST_ASSERT_EQUAL_STRING("l1:186a0,c350,186a0,0,1,1,0,0,12c", snapshot.c_str());
+}
+
+void test_rtt_over_the_simulated_link()
+{
+    const unsigned long latencies[] = { 5, 25 };
+
+    for(unsigned int i = 0; i < 2; i++)
+    {
+        TransmissionControl controller;
+        LinkSimulator simulator(i + 1);
+
+        controller.SetInterface(&simulator);
+        simulator.SetController(&controller);
+        simulator.SetInterface(&server);
+        server.SetController(&controller);
+        server.SetLink(&simulator);
+        TEST_ASSERT_TRUE(server.Handshake());
+
+        // the latency applies to both directions
+        LinkImpairments impairments;
+        impairments.latency = latencies[i];
+        simulator.SetOutgoingImpairments(impairments);
+        simulator.SetIncomingImpairments(impairments);
+
+        uint32_t minRTT = 0;
+        uint32_t maxRTT = 0;
+        TEST_ASSERT_TRUE(measureLink(controller, simulator, minRTT, maxRTT));
+
+        // a frame is not released before its latency, the simulator counts whole milliseconds per direction
+        const LinkEstimator& estimate = controller.GetLinkEstimate();
+        uint32_t rtt = latencies[i] * 2000UL;
+        TEST_ASSERT_TRUE(minRTT + 2000 >= rtt);
+        TEST_ASSERT_UINT32_WITHIN(TEST_RTT_TOLERANCE, rtt, maxRTT);
+        TEST_ASSERT_UINT32_WITHIN(TEST_RTT_TOLERANCE, rtt, estimate.GetSmoothedRTT());
+        TEST_ASSERT_EQUAL_UINT(0, estimate.GetLossPermille());
+
+        server.EndSession();
+        server.SetLink(nullptr);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(!server.Begin(TEST_RSA_BITS))
+    {
+        return 1;
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_initial_rto_until_the_first_sample);
+    RUN_TEST(test_first_sample_sets_the_estimate);
+    RUN_TEST(test_constant_samples_have_no_variation);
+    RUN_TEST(test_alternating_samples_give_the_jitter);
+    RUN_TEST(test_rto_is_bounded_by_the_profile);
+    RUN_TEST(test_probe_reply_must_match);
+    RUN_TEST(test_unanswered_probes_are_lost_after_twice_the_rto);
+    RUN_TEST(test_probe_is_lost_when_its_record_is_reused);
+    RUN_TEST(test_snapshot_format);
+    RUN_TEST(test_rtt_over_the_simulated_link);
+    return UNITY_END();
+}
@@ -0,0 +1,129 @@
+#include <unity.h>
+#include "LinkSimulator.h"
+
+// collects the frames which leave the simulator
+class FrameSink : public ITransmissionControlInterface
+{
+public:
+    String received;
+    unsigned int frames;
+
+    FrameSink()
+    : frames(0)
+    {}
+
+    void OutGateway(const String& data) override
+    {
+        this->received += data;
+        this->frames++;
+    }
+};
+
+static void sendFrames(LinkSimulator& simulator, unsigned int count)
+{
+    for(unsigned int i = 0; i < count; i++)
+    {
+        simulator.OutGateway("frame-" + String(i));
+    }
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_clean_link_forwards_in_order()
+{
+    LinkSimulator simulator(1);
+    FrameSink sink;
+    simulator.SetInterface(&sink);
+
+    simulator.OutGateway("a");
+    simulator.OutGateway("b");
+
+    TEST_ASSERT_EQUAL_UINT(2, sink.frames);
+    TEST_ASSERT_EQUAL_STRING("ab", sink.received.c_str());
+    TEST_ASSERT_EQUAL_UINT32(2, simulator.GetOutgoingStatistics().delivered);
+}
+
+void test_same_seed_same_impairments()
+{
+    LinkImpairments impairments;
+    impairments.lossPermille = 100;
+    impairments.duplicatePermille = 50;
+    impairments.corruptPermille = 50;
+    impairments.splitPermille = 50;
+
+    LinkSimulator first(7);
+    LinkSimulator second(7);
+    FrameSink firstSink;
+    FrameSink secondSink;
+    first.SetInterface(&firstSink);
+    second.SetInterface(&secondSink);
+    first.SetOutgoingImpairments(impairments);
+    second.SetOutgoingImpairments(impairments);
+
+    sendFrames(first, 1000);
+    sendFrames(second, 1000);
+
+    TEST_ASSERT_TRUE(firstSink.received == secondSink.received);
+    TEST_ASSERT_EQUAL_UINT32(first.GetOutgoingStatistics().lost, second.GetOutgoingStatistics().lost);
+
+    // about 10 percent are dropped
+    const LinkStatistics& statistics = first.GetOutgoingStatistics();
+    TEST_ASSERT_EQUAL_UINT32(1000, statistics.frames);
+    TEST_ASSERT_UINT32_WITHIN(40, 100, statistics.lost);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, statistics.duplicated);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, statistics.split);
+}
+
+void test_latency_holds_frames_until_due()
+{
+    LinkImpairments impairments;
+    impairments.latency = 30;
+
+    LinkSimulator simulator(1);
+    FrameSink sink;
+    simulator.SetInterface(&sink);
+    simulator.SetOutgoingImpairments(impairments);
+
+    simulator.OutGateway("late");
+    simulator.OnLoop();
+    TEST_ASSERT_EQUAL_UINT(0, sink.frames);
+
+    delay(40);
+    simulator.OnLoop();
+    TEST_ASSERT_EQUAL_UINT(1, sink.frames);
+    TEST_ASSERT_EQUAL_STRING("late", sink.received.c_str());
+}
+
+void test_split_delivers_the_whole_frame()
+{
+    LinkImpairments impairments;
+    impairments.splitPermille = 1000;
+
+    LinkSimulator simulator(3);
+    FrameSink sink;
+    simulator.SetInterface(&sink);
+    simulator.SetOutgoingImpairments(impairments);
+
+    simulator.OutGateway("0123456789");
+    // the first chunk goes out directly, the second one is queued behind it
+    simulator.OnLoop();
+
+    TEST_ASSERT_EQUAL_UINT(2, sink.frames);
+    TEST_ASSERT_EQUAL_STRING("0123456789", sink.received.c_str());
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_clean_link_forwards_in_order);
+    RUN_TEST(test_same_seed_same_impairments);
+    RUN_TEST(test_latency_holds_frames_until_due);
+    RUN_TEST(test_split_delivers_the_whole_frame);
+    return UNITY_END();
+}
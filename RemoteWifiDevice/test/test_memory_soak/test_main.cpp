@@ -0,0 +1,89 @@
+#include <unity.h>
+#include "MemorySoak.h"
+
+// short soak: the native environment counts the allocations, so a leak of a few bytes per session shows in the trend
+#define TEST_SOAK_CYCLES 300
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_sessions_do_not_grow()
+{
+    MemorySoak soak;
+    MemorySoakConfig config;
+    config.cycles = TEST_SOAK_CYCLES;
+    config.warmupCycles = 50;
+    config.sampleInterval = 5;
+
+    TEST_ASSERT_TRUE(soak.Begin(config));
+    while(soak.RunCycle())
+    {
+    }
+
+    const MemorySoakResult& result = soak.GetResult();
+    TEST_ASSERT_EQUAL_UINT(TEST_SOAK_CYCLES, result.cycles);
+    TEST_ASSERT_EQUAL_UINT(TEST_SOAK_CYCLES, result.handshakes);
+    TEST_ASSERT_EQUAL_UINT(TEST_SOAK_CYCLES * config.messagesPerCycle, result.messagesSent);
+    TEST_ASSERT_EQUAL_UINT(TEST_SOAK_CYCLES * config.messagesPerCycle, result.messagesReceived);
+    TEST_ASSERT_EQUAL_UINT(0, result.errors);
+    // the samples come from the allocation hooks
+    TEST_ASSERT_GREATER_THAN(0, result.firstSample);
+    TEST_ASSERT_TRUE(result.passed);
+}
+
+void test_leak_is_detected()
+{
+    MemorySoak soak;
+    MemorySoakConfig config;
+    config.cycles = 120;
+    config.warmupCycles = 10;
+    config.sampleInterval = 2;
+    config.growthLimit = 256;
+    config.messagesPerCycle = 1;
+
+    TEST_ASSERT_TRUE(soak.Begin(config));
+
+    // 16 bytes per session are kept like a leak of the controller would
+    void* leaked[120] = { nullptr };
+    unsigned int count = 0;
+    while(soak.RunCycle())
+    {
+        leaked[count++] = malloc(16);
+    }
+
+    TEST_ASSERT_FALSE(soak.GetResult().passed);
+    TEST_ASSERT_GREATER_THAN(256, soak.GetResult().trend);
+
+    for(unsigned int i = 0; i < count; i++)
+    {
+        free(leaked[i]);
+    }
+}
+
+void test_snapshot_counts_allocations()
+{
+    MemorySnapshot before;
+    MemorySnapshot after;
+
+    MemoryMonitor::GetSnapshot(before);
+    String text = MemoryMonitor::ToSnapshotString();
+    MemoryMonitor::GetSnapshot(after);
+
+    TEST_ASSERT_TRUE(text.startsWith(MEMORY_SNAPSHOT_VERSION ":"));
+    TEST_ASSERT_GREATER_THAN(before.allocations, after.allocations);
+    TEST_ASSERT_GREATER_OR_EQUAL(after.trackedBytes, after.trackedPeak);
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_sessions_do_not_grow);
+    RUN_TEST(test_leak_is_detected);
+    RUN_TEST(test_snapshot_counts_allocations);
+    return UNITY_END();
+}
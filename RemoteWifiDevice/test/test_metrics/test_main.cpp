@@ -0,0 +1,80 @@
+#include <unity.h>
+#include "TransmissionMetrics.h"
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_histogram_buckets_and_percentiles()
+{
+    LatencyHistogram histogram(0);
+
+    // 90 samples below 4, 9 below 64 and one in the open ended bucket
+    for(unsigned int i = 0; i < 90; i++)
+    {
+        histogram.Record(3);
+    }
+    for(unsigned int i = 0; i < 9; i++)
+    {
+        histogram.Record(40);
+    }
+    histogram.Record(100000);
+
+    TEST_ASSERT_EQUAL_UINT(100, histogram.GetCount());
+    TEST_ASSERT_EQUAL_UINT(90, histogram.GetBucket(2));
+    TEST_ASSERT_EQUAL_UINT(9, histogram.GetBucket(6));
+    TEST_ASSERT_EQUAL_UINT(1, histogram.GetBucket(METRICS_HISTOGRAM_BUCKETS - 1));
+
+    TEST_ASSERT_EQUAL_UINT(4, histogram.GetPercentile(500));
+    TEST_ASSERT_EQUAL_UINT(64, histogram.GetPercentile(990));
+    TEST_ASSERT_EQUAL_UINT(100000, histogram.GetPercentile(1000));
+}
+
+void test_snapshot_keeps_64_bit_counters()
+{
+    LatencyHistogram histogram(0);
+    histogram.Record(~0UL);
+
+    String snapshot;
+    histogram.AppendSnapshot(snapshot);
+
+    // count, max and the buckets, the maximum is written completely on a 64 bit host
+    char expected[64] = { 0 };
+    snprintf(expected, sizeof(expected), "1,%lx,0.0.0.0.0.0.0.0.0.0.0.1", ~0UL);
+    TEST_ASSERT_EQUAL_STRING(expected, snapshot.c_str());
+}
+
+void test_metrics_snapshot_format()
+{
+    TransmissionMetrics metrics;
+    metrics.framesIn = ~0UL;
+    metrics.throttled = ~0UL;
+    metrics.ackRTT.Record(5);
+
+    String snapshot = metrics.ToSnapshotString();
+
+    char expected[32] = { 0 };
+    snprintf(expected, sizeof(expected), "%s:%lx,", METRICS_SNAPSHOT_VERSION, ~0UL);
+    TEST_ASSERT_TRUE(snapshot.startsWith(expected));
+
+    // counters, three histograms and a part per priority class
+    unsigned int parts = 1;
+    for(unsigned int i = 0; i < snapshot.length(); i++)
+    {
+        parts += (snapshot[i] == '|') ? 1 : 0;
+    }
+    TEST_ASSERT_EQUAL_UINT(4 + METRICS_PRIORITY_CLASSES, parts);
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_histogram_buckets_and_percentiles);
+    RUN_TEST(test_snapshot_keeps_64_bit_counters);
+    RUN_TEST(test_metrics_snapshot_format);
+    return UNITY_END();
+}
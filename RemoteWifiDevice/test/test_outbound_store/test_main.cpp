@@ -0,0 +1,270 @@
+#include <unity.h>
+#include "LoopbackServer.h"
+#include "OutboundStore.h"
+
+#define TEST_RSA_BITS 1024
+#define TEST_STORE_PATH "test_outbound_store.log"
+#define TEST_STORE_CAPACITY 4096
+
+// the server side of the session: counts the messages and keeps the last one
+class MessageReceiver : public ITransmissionControlInterface
+{
+public:
+    unsigned int messages;
+    String last;
+
+    MessageReceiver()
+    : messages(0)
+    {}
+
+    void OutGateway(const String& data) override
+    {
+    }
+
+    void OnDataDecoded(const ByteSpan& data) override
+    {
+        // the block is zero padded
+        String text;
+        text.concat((const char*)data.data, strnlen((const char*)data.data, data.length));
+        this->last = text;
+        this->messages++;
+    }
+};
+
+// transport of the controller, data packages can be lost while the key exchange still works
+class LossyGateway : public ITransmissionControlInterface
+{
+public:
+    LoopbackServer* server;
+    bool dropData;
+
+    LossyGateway(LoopbackServer* _server)
+    : server(_server), dropData(false)
+    {}
+
+    void OutGateway(const String& data) override
+    {
+        TransmissionPackage package;
+        package.FromTransmissionString(data);
+
+        if(this->dropData && package.mode == TransmissionMode::DATA)
+        {
+            return;
+        }
+        this->server->OutGateway(data);
+    }
+};
+
+static LoopbackServer server;
+
+static String textOfLength(unsigned int length)
+{
+    String text;
+    for(unsigned int i = 0; i < length; i++)
+    {
+        text += (char)('a' + (i % 26));
+    }
+    return text;
+}
+
+void setUp()
+{
+    remove(TEST_STORE_PATH);
+}
+
+void tearDown()
+{
+}
+
+void test_store_keeps_the_order_after_a_reopen()
+{
+    unsigned char buffer[16] = { 0 };
+    uint8_t flags = 0;
+
+    {
+        FileOutboundStore store(TEST_STORE_PATH, TEST_STORE_CAPACITY);
+        TEST_ASSERT_TRUE(store.Begin());
+        TEST_ASSERT_TRUE(store.Append((const unsigned char*)"one", 3, OUTBOUND_FLAG_ENCRYPT));
+        TEST_ASSERT_TRUE(store.Append((const unsigned char*)"two", 3, 0));
+    }
+
+    FileOutboundStore store(TEST_STORE_PATH, TEST_STORE_CAPACITY);
+    TEST_ASSERT_TRUE(store.Begin());
+    TEST_ASSERT_EQUAL_UINT(2, store.GetCount());
+
+    TEST_ASSERT_EQUAL_UINT(3, store.Peek(buffer, sizeof(buffer), flags));
+    TEST_ASSERT_EQUAL_MEMORY("one", buffer, 3);
+    TEST_ASSERT_EQUAL_UINT8(OUTBOUND_FLAG_ENCRYPT, flags);
+
+    // the buffer is too small
+    TEST_ASSERT_EQUAL_UINT(0, store.Peek(buffer, 2, flags));
+
+    TEST_ASSERT_TRUE(store.Pop());
+    TEST_ASSERT_EQUAL_UINT(3, store.Peek(buffer, sizeof(buffer), flags));
+    TEST_ASSERT_EQUAL_MEMORY("two", buffer, 3);
+    TEST_ASSERT_TRUE(store.Pop());
+    TEST_ASSERT_EQUAL_UINT(0, store.GetCount());
+    TEST_ASSERT_FALSE(store.Pop());
+}
+
+void test_oldest_messages_are_evicted()
+{
+    unsigned char message[60] = { 0 };
+    unsigned char buffer[sizeof(message)] = { 0 };
+    uint8_t flags = 0;
+
+    // room for two records
+    FileOutboundStore store(TEST_STORE_PATH, 2 * (OUTBOUND_RECORD_HEADER_SIZE + sizeof(message)) + 10);
+    TEST_ASSERT_TRUE(store.Begin());
+
+    for(unsigned char i = 0; i < 5; i++)
+    {
+        memset(message, 'a' + i, sizeof(message));
+        TEST_ASSERT_TRUE(store.Append(message, sizeof(message), 0));
+    }
+
+    TEST_ASSERT_EQUAL_UINT(2, store.GetCount());
+    TEST_ASSERT_EQUAL_UINT32(3, store.GetEvicted());
+    TEST_ASSERT_EQUAL_UINT(sizeof(message), store.Peek(buffer, sizeof(buffer), flags));
+    TEST_ASSERT_EQUAL_UINT8('d', buffer[0]);
+}
+
+void test_oversize_message_is_rejected_while_offline()
+{
+    TransmissionControl controller;
+    MessageReceiver receiver;
+    FileOutboundStore store(TEST_STORE_PATH, TEST_STORE_CAPACITY);
+
+    TEST_ASSERT_TRUE(store.Begin());
+    controller.SetInterface(&server);
+    controller.SetOutboundStore(&store);
+    server.SetController(&controller);
+    server.SetReceiver(&receiver);
+
+    // neither stored nor encrypted without the key of a session
+    TEST_ASSERT_FALSE(controller.SendData(textOfLength(transmissionProfile.outboundMessageMax + 1), true));
+    TEST_ASSERT_EQUAL_UINT(0, store.GetCount());
+    TEST_ASSERT_TRUE(controller.SendData("stored", true));
+    TEST_ASSERT_EQUAL_UINT(1, store.GetCount());
+
+    TEST_ASSERT_TRUE(server.Handshake());
+    server.Pump();
+    TEST_ASSERT_EQUAL_UINT(1, receiver.messages);
+    TEST_ASSERT_EQUAL_STRING("stored", receiver.last.c_str());
+    TEST_ASSERT_EQUAL_UINT32(0, server.GetErrorCount());
+
+    server.EndSession();
+    server.SetReceiver(nullptr);
+}
+
+void test_encrypted_data_needs_a_session_key()
+{
+    TransmissionControl controller;
+    controller.SetInterface(&server);
+    server.SetController(&controller);
+
+    // no store, the data cannot wait for the session
+    controller.OnClientConnected();
+    TEST_ASSERT_FALSE(controller.SendData("secret", true));
+    TEST_ASSERT_TRUE(controller.SendData("plain", false));
+    controller.OnClientDisconnected();
+
+    TEST_ASSERT_TRUE(server.Handshake());
+    TEST_ASSERT_TRUE(controller.SendData("secret", true));
+
+    // the key is cleared with the session
+    server.EndSession();
+    TEST_ASSERT_FALSE(controller.SendData("secret", true));
+}
+
+void test_stored_messages_are_removed_when_confirmed()
+{
+    TransmissionControl controller;
+    MessageReceiver receiver;
+    FileOutboundStore store(TEST_STORE_PATH, TEST_STORE_CAPACITY);
+
+    TEST_ASSERT_TRUE(store.Begin());
+    controller.SetInterface(&server);
+    controller.SetOutboundStore(&store);
+    server.SetController(&controller);
+    server.SetReceiver(&receiver);
+
+    TEST_ASSERT_TRUE(controller.SendData("first", true));
+    TEST_ASSERT_TRUE(controller.SendData("second", true));
+    TEST_ASSERT_TRUE(controller.SendData("third", false));
+    TEST_ASSERT_EQUAL_UINT(3, store.GetCount());
+
+    TEST_ASSERT_TRUE(server.Handshake());
+    server.Pump();
+
+    TEST_ASSERT_EQUAL_UINT(2, receiver.messages);
+    TEST_ASSERT_EQUAL_STRING("second", receiver.last.c_str());
+    TEST_ASSERT_EQUAL_UINT(0, store.GetCount());
+
+    // with an empty store new messages are sent directly
+    TEST_ASSERT_TRUE(controller.SendData("direct", true));
+    TEST_ASSERT_EQUAL_UINT(0, store.GetCount());
+    server.Pump();
+    TEST_ASSERT_EQUAL_STRING("direct", receiver.last.c_str());
+
+    server.EndSession();
+    server.SetReceiver(nullptr);
+}
+
+void test_unconfirmed_message_is_sent_in_the_next_session()
+{
+    TransmissionControl controller;
+    MessageReceiver receiver;
+    LossyGateway gateway(&server);
+    FileOutboundStore store(TEST_STORE_PATH, TEST_STORE_CAPACITY);
+
+    TEST_ASSERT_TRUE(store.Begin());
+    controller.SetInterface(&gateway);
+    controller.SetOutboundStore(&store);
+    server.SetController(&controller);
+    server.SetReceiver(&receiver);
+
+    TEST_ASSERT_TRUE(controller.SendData("kept", true));
+
+    // the package of the stored message is lost with the connection
+    gateway.dropData = true;
+    TEST_ASSERT_TRUE(server.Handshake());
+    server.Pump();
+    TEST_ASSERT_EQUAL_UINT(0, receiver.messages);
+    TEST_ASSERT_EQUAL_UINT(1, store.GetCount());
+
+    // new messages keep their place behind it
+    TEST_ASSERT_TRUE(controller.SendData("later", true));
+    TEST_ASSERT_EQUAL_UINT(2, store.GetCount());
+    server.EndSession();
+
+    gateway.dropData = false;
+    TEST_ASSERT_TRUE(server.Handshake());
+    server.Pump();
+    TEST_ASSERT_EQUAL_UINT(2, receiver.messages);
+    TEST_ASSERT_EQUAL_STRING("later", receiver.last.c_str());
+    TEST_ASSERT_EQUAL_UINT(0, store.GetCount());
+
+    server.EndSession();
+    server.SetReceiver(nullptr);
+}
+
+int main(int argc, char** argv)
+{
+    if(!server.Begin(TEST_RSA_BITS))
+    {
+        return 1;
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_store_keeps_the_order_after_a_reopen);
+    RUN_TEST(test_oldest_messages_are_evicted);
+    RUN_TEST(test_oversize_message_is_rejected_while_offline);
+    RUN_TEST(test_encrypted_data_needs_a_session_key);
+    RUN_TEST(test_stored_messages_are_removed_when_confirmed);
+    RUN_TEST(test_unconfirmed_message_is_sent_in_the_next_session);
+    int result = UNITY_END();
+
+    remove(TEST_STORE_PATH);
+    return result;
+}
@@ -0,0 +1,242 @@
+#include <unity.h>
+#include "ServiceDiscovery.h"
+
+#define TEST_SERVICE "_remotedevice"
+#define TEST_PROTOCOL "_tcp"
+#define TEST_PORT 4000
+// time the fake resolver takes for an answer (ms)
+#define TEST_QUERY_DELAY 10
+#define TEST_DEVICES 600
+#define TEST_SERVERS 3
+
+static ResolvedService testService(unsigned int index, unsigned long ttl)
+{
+    ResolvedService service;
+    service.hostname = "server-";
+    service.hostname += String(index);
+    service.address = IPAddress(192, 168, 1, 10 + index);
+    service.port = TEST_PORT;
+    service.ttl = ttl;
+    return service;
+}
+
+static void setServices(FakeServiceResolver& resolver, unsigned int count, unsigned long ttl)
+{
+    itemCollection<ResolvedService> services;
+    for(unsigned int i = 0; i < count; i++)
+    {
+        services.AddItem(testService(i, ttl));
+    }
+    resolver.SetServices(services);
+}
+
+// runs the loop of the discovery for the given time, in the steps of a device loop
+static void runLoop(ServiceDiscovery& discovery, unsigned long time)
+{
+    auto start = millis();
+    do
+    {
+        discovery.OnLoop();
+        delay(1);
+    }
+    while((millis() - start) < time);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_entries_expire_with_their_ttl()
+{
+    FakeServiceResolver resolver(TEST_QUERY_DELAY);
+    setServices(resolver, 1, 100);
+
+    ServiceDiscovery discovery;
+    discovery.Begin(&resolver, TEST_SERVICE, TEST_PROTOCOL, "device");
+    runLoop(discovery, TEST_QUERY_DELAY * 3);
+    TEST_ASSERT_EQUAL_UINT(1, discovery.GetServerCount());
+    TEST_ASSERT_EQUAL_UINT32(1, resolver.GetQueryCount());
+
+    // the server stops answering, no query runs before the interval
+    setServices(resolver, 0, 0);
+    runLoop(discovery, 150);
+    TEST_ASSERT_EQUAL_UINT(0, discovery.GetServerCount());
+    TEST_ASSERT_EQUAL_UINT32(1, resolver.GetQueryCount());
+
+    DiscoveredServer server;
+    TEST_ASSERT_FALSE(discovery.SelectServer(server));
+}
+
+void test_answer_extends_the_ttl()
+{
+    FakeServiceResolver resolver(TEST_QUERY_DELAY);
+    setServices(resolver, 1, 200);
+
+    ServiceDiscovery discovery;
+    discovery.Begin(&resolver, TEST_SERVICE, TEST_PROTOCOL, "device");
+    runLoop(discovery, 120);
+
+    discovery.Refresh();
+    runLoop(discovery, 150);
+
+    // older than the first ttl, seen again by the second query
+    TEST_ASSERT_EQUAL_UINT32(2, resolver.GetQueryCount());
+    TEST_ASSERT_EQUAL_UINT(1, discovery.GetServerCount());
+}
+
+void test_rendezvous_spreads_the_devices()
+{
+    FakeServiceResolver resolver(0);
+    unsigned int selected[TEST_SERVERS] = { 0 };
+    unsigned int moved = 0;
+
+    for(unsigned int device = 0; device < TEST_DEVICES; device++)
+    {
+        String name = "device-";
+        name += String(device);
+
+        ServiceDiscovery discovery;
+        discovery.Begin(&resolver, TEST_SERVICE, TEST_PROTOCOL, name);
+        for(unsigned int i = 0; i < TEST_SERVERS; i++)
+        {
+            discovery.AddServer(testService(i, 0));
+        }
+
+        DiscoveredServer server;
+        TEST_ASSERT_TRUE(discovery.SelectServer(server));
+        unsigned int index = server.address[3] - 10;
+        selected[index]++;
+
+        // the last server is gone, only its devices move
+        ServiceDiscovery reduced;
+        reduced.Begin(&resolver, TEST_SERVICE, TEST_PROTOCOL, name);
+        for(unsigned int i = 0; i < TEST_SERVERS - 1; i++)
+        {
+            reduced.AddServer(testService(i, 0));
+        }
+
+        DiscoveredServer other;
+        TEST_ASSERT_TRUE(reduced.SelectServer(other));
+        if(other.address != server.address)
+        {
+            TEST_ASSERT_EQUAL_UINT(TEST_SERVERS - 1, index);
+            moved++;
+        }
+    }
+
+    // an even share is 200 devices per server
+    for(unsigned int i = 0; i < TEST_SERVERS; i++)
+    {
+        TEST_ASSERT_UINT_WITHIN(TEST_DEVICES / TEST_SERVERS / 4, TEST_DEVICES / TEST_SERVERS, selected[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT(selected[TEST_SERVERS - 1], moved);
+}
+
+void test_failed_server_fails_over_without_a_query()
+{
+    FakeServiceResolver resolver(TEST_QUERY_DELAY);
+    setServices(resolver, TEST_SERVERS, 0);
+
+    ServiceDiscovery discovery;
+    discovery.Begin(&resolver, TEST_SERVICE, TEST_PROTOCOL, "device");
+    runLoop(discovery, TEST_QUERY_DELAY * 3);
+    TEST_ASSERT_EQUAL_UINT(TEST_SERVERS, discovery.GetServerCount());
+    unsigned long queries = resolver.GetQueryCount();
+
+    DiscoveredServer first;
+    TEST_ASSERT_TRUE(discovery.SelectServer(first));
+    discovery.ReportConnectResult(first, false, 0);
+
+    // the next server of the ranking is selected at once
+    DiscoveredServer second;
+    TEST_ASSERT_TRUE(discovery.SelectServer(second));
+    TEST_ASSERT_TRUE(second.address != first.address);
+    TEST_ASSERT_EQUAL_UINT32(queries, resolver.GetQueryCount());
+    TEST_ASSERT_EQUAL_UINT(1, discovery.GetServer(TEST_SERVERS - 1).failures);
+
+    // all servers failed, the one which is available again first is selected
+    discovery.ReportConnectResult(second, false, 0);
+    DiscoveredServer third;
+    TEST_ASSERT_TRUE(discovery.SelectServer(third));
+    discovery.ReportConnectResult(third, false, 0);
+
+    DiscoveredServer retry;
+    TEST_ASSERT_TRUE(discovery.SelectServer(retry));
+    TEST_ASSERT_TRUE(retry.address == first.address);
+    TEST_ASSERT_EQUAL_UINT32(queries, resolver.GetQueryCount());
+
+    // a success clears the holdoff
+    discovery.ReportConnectResult(retry, true, 20);
+    TEST_ASSERT_TRUE(discovery.GetServer(0).address == first.address);
+    TEST_ASSERT_EQUAL_UINT(0, discovery.GetServer(0).failures);
+    TEST_ASSERT_EQUAL_UINT32(20, discovery.GetServer(0).connectLatency);
+}
+
+void test_failure_refreshes_in_the_background()
+{
+    FakeServiceResolver resolver(TEST_QUERY_DELAY * 5);
+    setServices(resolver, 1, 0);
+
+    ServiceDiscovery discovery;
+    discovery.Begin(&resolver, TEST_SERVICE, TEST_PROTOCOL, "device");
+    runLoop(discovery, TEST_QUERY_DELAY * 8);
+    TEST_ASSERT_EQUAL_UINT32(1, resolver.GetQueryCount());
+
+    // the server has moved
+    itemCollection<ResolvedService> services;
+    ResolvedService moved = testService(0, 0);
+    moved.address = IPAddress(192, 168, 1, 99);
+    services.AddItem(moved);
+    resolver.SetServices(services);
+
+    DiscoveredServer server;
+    TEST_ASSERT_TRUE(discovery.SelectServer(server));
+    discovery.ReportConnectResult(server, false, 0);
+
+    // the query starts in the next loop and does not block it, the old entry stays selectable
+    discovery.OnLoop();
+    TEST_ASSERT_EQUAL_UINT32(2, resolver.GetQueryCount());
+    TEST_ASSERT_EQUAL_UINT(1, discovery.GetServerCount());
+    TEST_ASSERT_TRUE(discovery.SelectServer(server));
+
+    runLoop(discovery, TEST_QUERY_DELAY * 8);
+    TEST_ASSERT_EQUAL_UINT(2, discovery.GetServerCount());
+
+    // the new address ranks before the one which failed
+    TEST_ASSERT_TRUE(discovery.SelectServer(server));
+    TEST_ASSERT_TRUE(server.address == moved.address);
+    TEST_ASSERT_EQUAL_UINT32(2, resolver.GetQueryCount());
+}
+
+void test_empty_table_is_queried_again()
+{
+    FakeServiceResolver resolver(0);
+
+    ServiceDiscovery discovery;
+    discovery.Begin(&resolver, TEST_SERVICE, TEST_PROTOCOL, "device");
+    runLoop(discovery, 10);
+    TEST_ASSERT_EQUAL_UINT32(1, resolver.GetQueryCount());
+    TEST_ASSERT_EQUAL_UINT(0, discovery.GetServerCount());
+
+    // a server starts after the first query
+    setServices(resolver, 1, 0);
+    runLoop(discovery, DISCOVERY_QUERY_INTERVAL_EMPTY + 50);
+    TEST_ASSERT_EQUAL_UINT32(2, resolver.GetQueryCount());
+    TEST_ASSERT_EQUAL_UINT(1, discovery.GetServerCount());
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_entries_expire_with_their_ttl);
+    RUN_TEST(test_answer_extends_the_ttl);
+    RUN_TEST(test_rendezvous_spreads_the_devices);
+    RUN_TEST(test_failed_server_fails_over_without_a_query);
+    RUN_TEST(test_failure_refreshes_in_the_background);
+    RUN_TEST(test_empty_table_is_queried_again);
+    return UNITY_END();
+}
@@ -0,0 +1,200 @@
+#include <unity.h>
+#include "TLVCodec.h"
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_round_trip_of_all_types()
+{
+    unsigned char buffer[128];
+    const unsigned char bytes[3] = { 0x00, 0xB1, 0xFF };
+
+    TLVWriter writer(buffer, sizeof(buffer));
+    writer.WriteUInt(1, 0xFFFFFFFFu);
+    writer.WriteInt(2, -1);
+    writer.WriteInt(3, INT32_MIN);
+    writer.WriteFloat(4, -2.5f);
+    writer.WriteBytes(5, bytes, sizeof(bytes));
+    writer.WriteString(31, "device");
+    TEST_ASSERT_TRUE(writer.Finish());
+
+    TLVReader reader = TLVReader::FromMessage(writer.GetData(), writer.GetLength());
+
+    TEST_ASSERT_TRUE(reader.Next());
+    TEST_ASSERT_EQUAL_UINT8(1, reader.GetTag());
+    TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFFu, reader.GetUInt());
+
+    TEST_ASSERT_TRUE(reader.Next());
+    TEST_ASSERT_EQUAL_INT32(-1, reader.GetInt());
+
+    TEST_ASSERT_TRUE(reader.Next());
+    TEST_ASSERT_EQUAL_INT32(INT32_MIN, reader.GetInt());
+
+    TEST_ASSERT_TRUE(reader.Next());
+    TEST_ASSERT_EQUAL(TLV_FLOAT, reader.GetType());
+    TEST_ASSERT_EQUAL_FLOAT(-2.5f, reader.GetFloat());
+
+    TEST_ASSERT_TRUE(reader.Next());
+    unsigned int length = 0;
+    const unsigned char* content = reader.GetBytes(length);
+    TEST_ASSERT_EQUAL_UINT(sizeof(bytes), length);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(bytes, content, sizeof(bytes));
+
+    TEST_ASSERT_TRUE(reader.Next());
+    TEST_ASSERT_EQUAL_UINT8(31, reader.GetTag());
+    String name = reader.GetString();
+    TEST_ASSERT_EQUAL_STRING("device", name.c_str());
+
+    TEST_ASSERT_FALSE(reader.Next());
+    TEST_ASSERT_FALSE(reader.HasError());
+}
+
+void test_nested_records()
+{
+    unsigned char buffer[64];
+
+    TLVWriter writer(buffer, sizeof(buffer));
+    writer.BeginRecord(1);
+    writer.WriteUInt(2, 300);
+    writer.BeginRecord(3);
+    writer.WriteString(4, "x");
+    writer.EndRecord();
+    writer.EndRecord();
+    writer.WriteUInt(5, 7);
+    TEST_ASSERT_TRUE(writer.Finish());
+
+    TLVReader reader = TLVReader::FromMessage(writer.GetData(), writer.GetLength());
+    TEST_ASSERT_TRUE(reader.Next());
+    TEST_ASSERT_EQUAL(TLV_RECORD, reader.GetType());
+
+    TLVReader outer = reader.GetRecord();
+    TEST_ASSERT_TRUE(outer.Next());
+    TEST_ASSERT_EQUAL_UINT32(300, outer.GetUInt());
+    TEST_ASSERT_TRUE(outer.Next());
+
+    TLVReader inner = outer.GetRecord();
+    TEST_ASSERT_TRUE(inner.Next());
+    String text = inner.GetString();
+    TEST_ASSERT_EQUAL_STRING("x", text.c_str());
+    TEST_ASSERT_FALSE(inner.Next());
+    TEST_ASSERT_FALSE(outer.Next());
+
+    // the element after the record is found behind its content
+    TEST_ASSERT_TRUE(reader.Next());
+    TEST_ASSERT_EQUAL_UINT8(5, reader.GetTag());
+    TEST_ASSERT_EQUAL_UINT32(7, reader.GetUInt());
+}
+
+void test_writer_errors()
+{
+    unsigned char buffer[8];
+
+    // overflow
+    TLVWriter small(buffer, sizeof(buffer));
+    small.WriteString(1, "too long for the buffer");
+    TEST_ASSERT_FALSE(small.Finish());
+    TEST_ASSERT_EQUAL_UINT(0, small.GetLength());
+
+    // tag out of range
+    TLVWriter tag(buffer, sizeof(buffer));
+    tag.WriteUInt(TLV_MAX_TAG + 1, 1);
+    TEST_ASSERT_FALSE(tag.Finish());
+
+    // open record
+    TLVWriter open(buffer, sizeof(buffer));
+    open.BeginRecord(1);
+    TEST_ASSERT_FALSE(open.Finish());
+
+    // unbalanced end
+    TLVWriter unbalanced(buffer, sizeof(buffer));
+    unbalanced.EndRecord();
+    TEST_ASSERT_FALSE(unbalanced.Finish());
+
+    // nesting limit
+    unsigned char large[64];
+    TLVWriter deep(large, sizeof(large));
+    for(unsigned int i = 0; i <= TLV_MAX_NESTING; i++)
+    {
+        deep.BeginRecord(1);
+    }
+    TEST_ASSERT_TRUE(deep.HasError());
+
+    TLVWriter none(nullptr, 16);
+    TEST_ASSERT_TRUE(none.HasError());
+}
+
+void test_padding_and_truncation()
+{
+    unsigned char buffer[32];
+
+    TLVWriter writer(buffer, sizeof(buffer));
+    writer.WriteString(1, "abc");
+    TEST_ASSERT_TRUE(writer.Finish());
+    unsigned int length = writer.GetLength();
+
+    // the zero padding of the aes block behind the body is not read as elements
+    memset(buffer + length, 0, sizeof(buffer) - length);
+    TLVReader padded = TLVReader::FromMessage(buffer, sizeof(buffer));
+    TEST_ASSERT_TRUE(padded.Next());
+    TEST_ASSERT_FALSE(padded.Next());
+    TEST_ASSERT_FALSE(padded.HasError());
+
+    // a message shorter than its body length is rejected
+    TEST_ASSERT_FALSE(TLVReader::IsMessage(buffer, length - 1));
+    TEST_ASSERT_TRUE(TLVReader::FromMessage(buffer, length - 1).HasError());
+
+    // a string which is longer than the rest of the body
+    TLVReader truncated(buffer + TLV_HEADER_SIZE, length - TLV_HEADER_SIZE - 1);
+    TEST_ASSERT_FALSE(truncated.Next());
+    TEST_ASSERT_TRUE(truncated.HasError());
+
+    // ascii text is not a message
+    TEST_ASSERT_FALSE(TLVReader::IsMessage((const unsigned char*)"rq:status", 9));
+}
+
+void test_invalid_elements()
+{
+    // unknown type 7
+    const unsigned char unknownType[] = { (1 << 3) | 7, 0 };
+    TLVReader unknown(unknownType, sizeof(unknownType));
+    TEST_ASSERT_FALSE(unknown.Next());
+    TEST_ASSERT_TRUE(unknown.HasError());
+
+    // varint without end
+    const unsigned char openVarint[] = { (1 << 3) | TLV_UINT, 0x80, 0x80 };
+    TLVReader varint(openVarint, sizeof(openVarint));
+    TEST_ASSERT_FALSE(varint.Next());
+
+    // varint longer than 5 bytes
+    const unsigned char longVarint[] = { (1 << 3) | TLV_UINT, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 };
+    TLVReader overlong(longVarint, sizeof(longVarint));
+    TEST_ASSERT_FALSE(overlong.Next());
+
+    // float with 3 bytes
+    const unsigned char shortFloat[] = { (1 << 3) | TLV_FLOAT, 0, 0, 0 };
+    TLVReader floatReader(shortFloat, sizeof(shortFloat));
+    TEST_ASSERT_FALSE(floatReader.Next());
+
+    // accessors of another type return nothing
+    const unsigned char text[] = { (1 << 3) | TLV_STRING, 1, 'a' };
+    TLVReader textReader(text, sizeof(text));
+    TEST_ASSERT_TRUE(textReader.Next());
+    TEST_ASSERT_EQUAL_UINT32(0, textReader.GetUInt());
+    TEST_ASSERT_FALSE(textReader.GetRecord().Next());
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip_of_all_types);
+    RUN_TEST(test_nested_records);
+    RUN_TEST(test_writer_errors);
+    RUN_TEST(test_padding_and_truncation);
+    RUN_TEST(test_invalid_elements);
+    return UNITY_END();
+}
@@ -0,0 +1,80 @@
+#include <unity.h>
+#include "TransmissionTrace.h"
+
+// collects the output of the trace
+class StringPrint : public Print
+{
+public:
+    String text;
+
+    size_t write(uint8_t c) override
+    {
+        this->text += (char)c;
+        return 1;
+    }
+};
+
+void setUp()
+{
+    // start every test with an empty ring
+    TraceEvent event;
+    while(TransmissionTrace::Read(&event, 1) > 0);
+}
+
+void tearDown()
+{
+}
+
+void test_raw_record_layout()
+{
+    TransmissionTrace::Record(TRACE_LEVEL_ERROR, TE_FRAME_SIZE_ERROR, 0x1234, -1);
+
+    String text;
+    TEST_ASSERT_EQUAL_UINT(1, TransmissionTrace::AppendRaw(text));
+    TEST_ASSERT_EQUAL_UINT(TRACE_DUMP_RECORD_SIZE, text.length());
+
+    // the timestamp depends on the clock, the rest is fixed
+    TEST_ASSERT_EQUAL_STRING("00100100" "00001234" "ffffffff", text.c_str() + 8);
+}
+
+void test_dump_line()
+{
+    StringPrint output;
+
+    // nothing is written without events
+    TEST_ASSERT_EQUAL_UINT(0, TransmissionTrace::Dump(output));
+    TEST_ASSERT_EQUAL_UINT(0, output.text.length());
+
+    for(int i = 0; i < 3; i++)
+    {
+        TransmissionTrace::Record(TRACE_LEVEL_INFO, TE_PACKAGE_RESENT, i, 0);
+    }
+
+    TEST_ASSERT_EQUAL_UINT(2, TransmissionTrace::Dump(output, 2));
+    TEST_ASSERT_TRUE(output.text.startsWith(TRACE_DUMP_VERSION ":"));
+    TEST_ASSERT_EQUAL_UINT(3 + (2 * TRACE_DUMP_RECORD_SIZE) + 2, output.text.length());
+
+    // the third event is still in the ring
+    String text;
+    TEST_ASSERT_EQUAL_UINT(1, TransmissionTrace::AppendRaw(text, 4));
+}
+
+void test_retired_event_ids()
+{
+    // the IDs of the removed events are not reused
+    TEST_ASSERT_EQUAL_INT(14, TE_BASE64_DECODE_FAILED);
+    TEST_ASSERT_EQUAL_INT(16, TE_FRAME_SIZE_ERROR);
+    TEST_ASSERT_EQUAL_STRING("unknown", TransmissionTrace::GetEventName(13));
+    TEST_ASSERT_EQUAL_STRING("unknown", TransmissionTrace::GetEventName(15));
+    TEST_ASSERT_EQUAL_STRING("frame-size-error", TransmissionTrace::GetEventName(TE_FRAME_SIZE_ERROR));
+    TEST_ASSERT_EQUAL_STRING("probe-lost", TransmissionTrace::GetEventName(TE_PROBE_LOST));
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_raw_record_layout);
+    RUN_TEST(test_dump_line);
+    RUN_TEST(test_retired_event_ids);
+    return UNITY_END();
+}
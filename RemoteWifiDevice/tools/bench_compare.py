@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""Compare the results of the transport benchmark (env az-delivery-devkit-v4-bench) against a baseline.
+
+The input files are the json line printed by TransportBenchmark::PrintJson or a complete serial log which
+contains it. A case regresses if its time per operation rises by more than the threshold or if it allocates more
+per operation than the baseline. A case which reports the peak of its kept bytes (flow-100x) also regresses if
+the peak rises by more than the memory threshold, a case which reports the size of its encoded message (the
+telemetry encode cases) regresses if the message grows and a case which reports the bytes it copies (the
+frame-encrypt cases) if it copies more. The exit code is 1 if any case regressed, so the script can gate a change:
+
+    pio device monitor -e az-delivery-devkit-v4-bench | tee current.log
+    tools/bench_compare.py baseline.json current.log --threshold 10
+
+The host build of the benchmark (env native-bench) runs without a board. Its times depend on the machine, so
+tools/baselines/native-bench.json is only a reference, record a baseline on the machine which runs the gate:
+
+    pio run -e native-bench -t exec | tee current.log
+    tools/bench_compare.py tools/baselines/native-bench.json current.log
+"""
+
+import argparse
+import json
+import sys
+
+
+def load_results(path):
+    with open(path, "r", encoding="utf-8", errors="replace") as source:
+        for line in source:
+            line = line.strip()
+            start = line.find('{"suite"')
+            if start < 0:
+                continue
+            document = json.loads(line[start:])
+            return document, {result["name"]: result for result in document["results"]}
+    raise ValueError("no benchmark results in " + path)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=10.0, help="allowed slowdown in percent (default 10)")
+    parser.add_argument("--allocation-threshold", type=float, default=0.5,
+                        help="allowed additional allocations per operation (default 0.5)")
+    parser.add_argument("--memory-threshold", type=float, default=10.0,
+                        help="allowed rise of the peak bytes in percent (default 10)")
+    arguments = parser.parse_args()
+
+    baseline_document, baseline = load_results(arguments.baseline)
+    current_document, current = load_results(arguments.current)
+
+    for key in ("suite", "platform", "profile", "payload"):
+        if baseline_document.get(key) != current_document.get(key):
+            print("warning: %s differs (%s / %s)" % (key, baseline_document.get(key), current_document.get(key)))
+
+    regressions = 0
+    print("%-24s %12s %12s %8s %10s %10s" % ("case", "baseline ns", "current ns", "change", "allocs", "was"))
+
+    for name, result in current.items():
+        reference = baseline.get(name)
+        if reference is None:
+            print("%-24s %12s %12d %8s %10.2f %10s  new" % (name, "-", result["ns_per_op"], "-", result["allocs_per_op"], "-"))
+            continue
+
+        change = 0.0
+        if reference["ns_per_op"] > 0:
+            change = (result["ns_per_op"] - reference["ns_per_op"]) * 100.0 / reference["ns_per_op"]
+
+        flags = []
+        if change > arguments.threshold:
+            flags.append("SLOWER")
+        if result["allocs_per_op"] - reference["allocs_per_op"] > arguments.allocation_threshold:
+            flags.append("MORE ALLOCATIONS")
+        if reference.get("peak_bytes", 0) > 0 and \
+                result.get("peak_bytes", 0) > reference["peak_bytes"] * (1.0 + arguments.memory_threshold / 100.0):
+            flags.append("MORE MEMORY (%d bytes, was %d)" % (result["peak_bytes"], reference["peak_bytes"]))
+        if result.get("message_bytes", 0) > reference.get("message_bytes", result.get("message_bytes", 0)):
+            flags.append("LARGER MESSAGE (%d bytes, was %d)" % (result["message_bytes"], reference["message_bytes"]))
+        if result.get("copied_bytes", 0) > reference.get("copied_bytes", result.get("copied_bytes", 0)):
+            flags.append("MORE COPIES (%d bytes, was %d)" % (result["copied_bytes"], reference["copied_bytes"]))
+        if flags:
+            regressions += 1
+
+        print("%-24s %12d %12d %+7.1f%% %10.2f %10.2f  %s" % (
+            name, reference["ns_per_op"], result["ns_per_op"], change,
+            result["allocs_per_op"], reference["allocs_per_op"], " ".join(flags)))
+
+    for name in baseline:
+        if name not in current:
+            print("%-24s missing in the current results" % name)
+            regressions += 1
+
+    print("%d regression(s)" % regressions)
+    return 1 if regressions > 0 else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""Decode raw transmission trace dumps (TransmissionTrace::Dump and the rs:trace response) into text lines.
+
+A dump is TRACE_DUMP_VERSION, ':' and records of 32 hex characters. The input can be a serial log of a firmware
+built with -DTRANSMISSION_TRACE_RAW or the logged rs:trace responses, the lines are found anywhere in the input:
+
+    pio device monitor | tee serial.log
+    tools/trace_decode.py serial.log
+
+The event names are read from the TraceEventID enum in include/TransmissionTrace.h, so the script follows the
+firmware without changes as long as the event IDs are stable.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+DUMP_VERSION = "t1"
+RECORD_SIZE = 32
+LEVELS = {1: "E", 2: "I", 3: "D"}
+
+DEFAULT_HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "include", "TransmissionTrace.h")
+DUMP_PATTERN = re.compile(DUMP_VERSION + r":((?:[0-9a-fA-F]{" + str(RECORD_SIZE) + r"})+)")
+
+
+def load_event_names(path):
+    with open(path, "r", encoding="utf-8") as source:
+        text = source.read()
+    match = re.search(r"enum\s+TraceEventID\s*\{(.*?)\};", text, re.S)
+    if match is None:
+        raise ValueError("no TraceEventID enum in " + path)
+
+    names = {}
+    value = 0
+    body = re.sub(r"//[^\n]*", "", match.group(1))
+    for entry in body.split(","):
+        entry = entry.strip()
+        if not entry:
+            continue
+        name, _, explicit = entry.partition("=")
+        name = name.strip()
+        if explicit.strip():
+            value = int(explicit.strip(), 0)
+        if name != "TE_EVENT_COUNT":
+            # same names as the firmware prints: TE_FRAME_SIZE_ERROR -> frame-size-error
+            names[value] = name[len("TE_"):].lower().replace("_", "-")
+        value += 1
+    return names
+
+
+def signed(value):
+    return value - (1 << 32) if value & (1 << 31) else value
+
+
+def decode_record(record, names):
+    timestamp = int(record[0:8], 16)
+    event_id = int(record[8:12], 16)
+    level = int(record[12:14], 16)
+    arg0 = signed(int(record[16:24], 16))
+    arg1 = signed(int(record[24:32], 16))
+    return "[%10u] %s %s (%d, %d)" % (timestamp, LEVELS.get(level, "?"), names.get(event_id, "unknown"), arg0, arg1)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", nargs="?", help="log with raw dump lines (default stdin)")
+    parser.add_argument("--header", default=DEFAULT_HEADER, help="TransmissionTrace.h with the event IDs")
+    arguments = parser.parse_args()
+
+    names = load_event_names(arguments.header)
+    source = open(arguments.input, "r", encoding="utf-8", errors="replace") if arguments.input else sys.stdin
+
+    count = 0
+    with source:
+        for line in source:
+            for match in DUMP_PATTERN.finditer(line):
+                records = match.group(1)
+                for offset in range(0, len(records), RECORD_SIZE):
+                    print(decode_record(records[offset:offset + RECORD_SIZE], names))
+                    count += 1
+
+    if count == 0:
+        print("no " + DUMP_VERSION + " trace records in the input", file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())